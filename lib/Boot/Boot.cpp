@@ -0,0 +1,162 @@
+#include "Boot.h"
+
+Boot boot;
+
+struct BootTaskParameter {
+    Boot *boot;
+    int stage;
+};
+
+Boot::Boot() : _ready(0), _running(0)
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @name inlineStage
+ * @brief Đăng ký bước chạy ngay trong start(), dùng cho việc ngắn mà các bước khác cần có sẵn
+ *
+ * @param {const char*} name - Tên bước, dùng trong báo cáo
+ * @param {Step} step - Hàm khởi tạo
+ * @param {std::initializer_list<int>} after - Các bước nội tuyến phải chạy trước
+ *
+ * @return {int} - ID bước, -1 nếu đã hết chỗ hoặc phụ thuộc không hợp lệ
+ */
+int Boot::inlineStage(const char *name, Step step, std::initializer_list<int> after)
+{
+    for (int dependency : after) {
+        if (dependency < 0 || dependency >= _stageCount || _stages[dependency].background) {
+            ESP_LOGE("Boot", "%s: inline stage can only follow earlier inline stages", name);
+            return -1;
+        }
+    }
+    return add(name, step, after, false, 0, 0);
+}
+
+/**
+ * @name stage
+ * @brief Đăng ký bước chạy trong task riêng khi các bước phụ thuộc đã xong, có thể chặn (vd: chờ WiFi)
+ *
+ * @param {const char*} name - Tên bước, cũng là tên task
+ * @param {Step} step - Hàm khởi tạo
+ * @param {std::initializer_list<int>} after - Các bước phải xong trước
+ * @param {uint32_t} stackSize - Stack của task
+ * @param {BaseType_t} core - Core chạy task
+ *
+ * @return {int} - ID bước, -1 nếu đã hết chỗ hoặc phụ thuộc không hợp lệ
+ */
+int Boot::stage(const char *name, Step step, std::initializer_list<int> after, uint32_t stackSize, BaseType_t core)
+{
+    return add(name, step, after, true, stackSize, core);
+}
+
+int Boot::add(const char *name, Step step, std::initializer_list<int> after, bool background,
+              uint32_t stackSize, BaseType_t core)
+{
+    if (_stageCount >= BOOT_MAX_STAGES) {
+        ESP_LOGE("Boot", "%s: too many stages", name);
+        return -1;
+    }
+    uint32_t mask = 0;
+    for (int dependency : after) {
+        if (dependency < 0 || dependency >= _stageCount) {
+            ESP_LOGE("Boot", "%s: unknown dependency %d", name, dependency);
+            return -1;
+        }
+        mask |= 1u << dependency;
+    }
+    _stages[_stageCount] = {name, step, mask, stackSize, core, background, false, 0, 0};
+    return _stageCount++;
+}
+
+/**
+ * @name start
+ * @brief Chạy các bước nội tuyến theo thứ tự, khởi động các bước nền đã đủ điều kiện rồi trả về ngay
+ *
+ * @param None
+ *
+ * @return None
+ */
+void Boot::start()
+{
+    for (int i = 0; i < _stageCount; ++i) {
+        if (_stages[i].background) continue;
+        _stages[i].started = true;
+        run(i);
+    }
+    launch();
+}
+
+void Boot::run(int stage)
+{
+    Stage &s = _stages[stage];
+    s.startedAt = millis();
+    s.step();
+    s.readyAt = millis();
+    _ready.fetch_or(1u << stage);
+    ESP_LOGI("Boot", "%s ready at %u ms (%u ms)", s.name, (unsigned)s.readyAt, (unsigned)(s.readyAt - s.startedAt));
+}
+
+// Khởi động mọi bước nền có đủ phụ thuộc, gọi lại mỗi khi một bước nền xong
+void Boot::launch()
+{
+    uint32_t ready = _ready.load();
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return;
+    for (int i = 0; i < _stageCount; ++i) {
+        Stage &s = _stages[i];
+        if (!s.background || s.started || (s.after & ready) != s.after) continue;
+        s.started = true;
+        BootTaskParameter *parameter = new BootTaskParameter{this, i};
+        ++_running;
+        if (xTaskCreatePinnedToCore(stageTask, s.name, s.stackSize, parameter, 1, NULL, s.core) != pdPASS) {
+            ESP_LOGE("Boot", "%s: cannot create task", s.name);
+            --_running;
+            delete parameter;
+        }
+    }
+    xSemaphoreGive(_mutex);
+}
+
+void Boot::stageTask(void *parameter)
+{
+    BootTaskParameter *p = (BootTaskParameter *)parameter;
+    Boot *self = p->boot;
+    int stage = p->stage;
+    delete p;
+    self->run(stage);
+    self->launch();
+    --self->_running;
+    vTaskDelete(NULL);
+}
+
+bool Boot::ready(int stage) const
+{
+    return stage >= 0 && (_ready.load() & (1u << stage)) != 0;
+}
+
+// Mọi bước đã xong và mọi task bước nền đã kết thúc
+bool Boot::done() const
+{
+    return _running.load() == 0 && _ready.load() == (1u << _stageCount) - 1;
+}
+
+// millis() lúc bước xong, 0 nếu chưa xong
+uint32_t Boot::readyAt(int stage) const
+{
+    return ready(stage) ? _stages[stage].readyAt : 0;
+}
+
+// "zigbee:12,network:3400,..." - ms từ lúc cấp nguồn tới khi từng bước xong, '-' nếu chưa xong
+String Boot::summary() const
+{
+    String out;
+    for (int i = 0; i < _stageCount; ++i) {
+        if (i > 0) {
+            out += ",";
+        }
+        out += _stages[i].name;
+        out += ":";
+        out += ready(i) ? String(_stages[i].readyAt) : String("-");
+    }
+    return out;
+}
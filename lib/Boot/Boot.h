@@ -0,0 +1,68 @@
+/*
+  Boot.h - Trình tự khởi động theo phụ thuộc: các bước độc lập chạy song song trong task riêng,
+  bước nội tuyến chạy ngay trong setup(), thời điểm sẵn sàng của từng bước được ghi lại.
+*/
+
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+
+#define BOOT_MAX_STAGES 16
+#define BOOT_STACK_SIZE 4096
+
+/**
+ * @name Boot
+ * @brief Mỗi bước chỉ bắt đầu khi mọi bước nó phụ thuộc đã xong. Bước nội tuyến chạy theo thứ tự
+ *        đăng ký trong start() và chỉ được phụ thuộc bước nội tuyến đăng ký trước nó; bước nền
+ *        chạy trong task riêng (được xoá khi xong) và có thể phụ thuộc bất kỳ bước nào.
+ */
+class Boot
+{
+  public:
+    typedef std::function<void()> Step;
+
+    Boot();
+
+    int inlineStage(const char *name, Step step, std::initializer_list<int> after = {});
+    int stage(const char *name, Step step, std::initializer_list<int> after = {},
+              uint32_t stackSize = BOOT_STACK_SIZE, BaseType_t core = 1);
+    void start();
+
+    bool ready(int stage) const;
+    bool done() const;
+    uint32_t readyAt(int stage) const;
+    String summary() const;
+
+  private:
+    struct Stage {
+        const char *name;
+        Step step;
+        uint32_t after;     // Bit các bước phải xong trước
+        uint32_t stackSize;
+        BaseType_t core;
+        bool background;
+        bool started;
+        uint32_t startedAt; // millis()
+        uint32_t readyAt;   // millis()
+    };
+
+    int add(const char *name, Step step, std::initializer_list<int> after, bool background,
+            uint32_t stackSize, BaseType_t core);
+    void run(int stage);
+    void launch();
+    static void stageTask(void *parameter);
+
+    Stage _stages[BOOT_MAX_STAGES];
+    uint8_t _stageCount = 0;
+    std::atomic<uint32_t> _ready;
+    std::atomic<uint8_t> _running;      // Task bước nền chưa kết thúc
+    SemaphoreHandle_t _mutex = NULL;    // Bảo vệ started khi nhiều bước nền cùng xong
+};
+
+extern Boot boot;
+
+#endif
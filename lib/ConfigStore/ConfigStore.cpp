@@ -0,0 +1,193 @@
+#include <ConfigStore.h>
+#include "esp_rom_crc.h"
+
+static const char *SLOT_KEYS[2] = {"cfg_a", "cfg_b"};
+
+NvsConfigBackend::NvsConfigBackend(const char *ns) : _namespace(ns)
+{
+}
+
+size_t NvsConfigBackend::read(uint8_t slot, void *buffer, size_t length)
+{
+    if (!_preferences.begin(_namespace, true))
+    {
+        return 0;
+    }
+    size_t n = 0;
+    if (_preferences.getBytesLength(SLOT_KEYS[slot]) == length)
+    {
+        n = _preferences.getBytes(SLOT_KEYS[slot], buffer, length);
+    }
+    _preferences.end();
+    return n;
+}
+
+bool NvsConfigBackend::write(uint8_t slot, const void *buffer, size_t length)
+{
+    if (!_preferences.begin(_namespace, false))
+    {
+        return false;
+    }
+    size_t n = _preferences.putBytes(SLOT_KEYS[slot], buffer, length);
+    _preferences.end();
+    return n == length;
+}
+
+/**
+ * @name readLegacy
+ * @brief Đọc cấu hình cũ lưu theo từng key (trước khi có ConfigStore)
+ *
+ * @param {Config&} config - Cấu hình nhận được
+ *
+ * @return {bool} - True nếu có cấu hình cũ
+ */
+bool NvsConfigBackend::readLegacy(Config &config)
+{
+    if (!_preferences.begin(_namespace, true))
+    {
+        return false;
+    }
+    bool found = _preferences.isKey("ssid");
+    if (found)
+    {
+        ConfigStore::setField(config.ssid, sizeof(config.ssid), _preferences.getString("ssid", "").c_str());
+        ConfigStore::setField(config.password, sizeof(config.password), _preferences.getString("password", "").c_str());
+        ConfigStore::setField(config.device_id, sizeof(config.device_id), _preferences.getString("device_id", "").c_str());
+        ConfigStore::setField(config.name, sizeof(config.name), _preferences.getString("name", "").c_str());
+        ConfigStore::setField(config.access_token, sizeof(config.access_token), _preferences.getString("access_token", "").c_str());
+        ConfigStore::setField(config.client_id, sizeof(config.client_id), _preferences.getString("client_id", "").c_str());
+        ConfigStore::setField(config.mqtt_username, sizeof(config.mqtt_username), _preferences.getString("mqtt_username", "").c_str());
+        ConfigStore::setField(config.mqtt_password, sizeof(config.mqtt_password), _preferences.getString("mqtt_password", "").c_str());
+    }
+    _preferences.end();
+    return found;
+}
+
+ConfigStore::ConfigStore(ConfigBackend &backend) : _backend(backend)
+{
+    setDefaults(_config);
+}
+
+/**
+ * @name begin
+ * @brief Nạp cấu hình một lần khi khởi động, chọn slot hợp lệ mới nhất
+ *
+ * @param None
+ *
+ * @return {bool} - True nếu đọc được cấu hình đã lưu
+ */
+bool ConfigStore::begin()
+{
+    Config slots[2];
+    uint32_t sequences[2];
+    bool valid[2];
+    for (uint8_t slot = 0; slot < 2; ++slot)
+    {
+        valid[slot] = loadSlot(slot, slots[slot], sequences[slot]);
+    }
+
+    if (valid[0] || valid[1])
+    {
+        // So sánh có dấu để vẫn đúng khi sequence bị tràn
+        uint8_t slot = (valid[0] && (!valid[1] || (int32_t)(sequences[0] - sequences[1]) > 0)) ? 0 : 1;
+        _config = slots[slot];
+        _sequence = sequences[slot];
+        _activeSlot = slot;
+        ESP_LOGI("ConfigStore", "Loaded slot %u, sequence %u", slot, (unsigned)_sequence);
+        return true;
+    }
+
+    setDefaults(_config);
+    if (_backend.readLegacy(_config))
+    {
+        ESP_LOGI("ConfigStore", "Migrating legacy preferences");
+        commit(_config);
+        return true;
+    }
+    ESP_LOGW("ConfigStore", "No stored configuration");
+    return false;
+}
+
+const Config &ConfigStore::get() const
+{
+    return _config;
+}
+
+uint32_t ConfigStore::sequence() const
+{
+    return _sequence;
+}
+
+/**
+ * @name commit
+ * @brief Ghi toàn bộ cấu hình vào slot không hoạt động trong một lần ghi
+ *
+ * Slot đang dùng không bị động tới, nên nếu mất điện giữa chừng thì lần
+ * khởi động sau vẫn đọc được bản cũ nguyên vẹn.
+ *
+ * @param {const Config&} config - Cấu hình mới
+ *
+ * @return {bool} - True nếu ghi thành công
+ */
+bool ConfigStore::commit(const Config &config)
+{
+    uint8_t buffer[sizeof(ConfigHeader) + sizeof(Config)];
+    ConfigHeader header = {CONFIG_STORE_MAGIC, CONFIG_STORE_VERSION, sizeof(Config), _sequence + 1, 0};
+    header.crc = checksum(header, config);
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), &config, sizeof(config));
+
+    uint8_t slot = _activeSlot ^ 1;
+    if (!_backend.write(slot, buffer, sizeof(buffer)))
+    {
+        ESP_LOGE("ConfigStore", "Write slot %u failed", slot);
+        return false;
+    }
+    _config = config;
+    _sequence = header.sequence;
+    _activeSlot = slot;
+    return true;
+}
+
+void ConfigStore::setField(char *field, size_t size, const char *value)
+{
+    strncpy(field, value, size - 1);
+    field[size - 1] = '\0';
+}
+
+bool ConfigStore::loadSlot(uint8_t slot, Config &config, uint32_t &sequence)
+{
+    uint8_t buffer[sizeof(ConfigHeader) + sizeof(Config)];
+    if (_backend.read(slot, buffer, sizeof(buffer)) != sizeof(buffer))
+    {
+        return false;
+    }
+    ConfigHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    memcpy(&config, buffer + sizeof(header), sizeof(config));
+    if (header.magic != CONFIG_STORE_MAGIC || header.version != CONFIG_STORE_VERSION || header.length != sizeof(Config))
+    {
+        return false;
+    }
+    if (checksum(header, config) != header.crc)
+    {
+        ESP_LOGE("ConfigStore", "Slot %u checksum mismatch", slot);
+        return false;
+    }
+    sequence = header.sequence;
+    return true;
+}
+
+uint32_t ConfigStore::checksum(const ConfigHeader &header, const Config &config)
+{
+    ConfigHeader copy = header;
+    copy.crc = 0;
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)&copy, sizeof(copy));
+    return esp_rom_crc32_le(crc, (const uint8_t *)&config, sizeof(config));
+}
+
+void ConfigStore::setDefaults(Config &config)
+{
+    memset(&config, 0, sizeof(config));
+    config.poll_interval = CONFIG_DEFAULT_POLL_INTERVAL;
+}
@@ -0,0 +1,83 @@
+/*
+  ConfigStore.h - Cấu hình thiết bị lưu trong RAM, ghi flash theo khối A/B.
+*/
+
+#ifndef CONFIGSTORE_H
+#define CONFIGSTORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#define CONFIG_STORE_MAGIC 0x47464350 // "PCFG"
+#define CONFIG_STORE_VERSION 1
+#define CONFIG_DEFAULT_POLL_INTERVAL 60
+
+struct Config {
+    char ssid[33];
+    char password[65];
+    char name[33];
+    char device_id[65];
+    char access_token[65];
+    char client_id[65];
+    char mqtt_username[65];
+    char mqtt_password[65];
+    uint32_t poll_interval;
+};
+
+struct ConfigHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint32_t sequence;
+    uint32_t crc;       // CRC32 của header (crc = 0) và payload
+};
+
+/**
+ * @name ConfigBackend
+ * @brief Nơi lưu hai slot cấu hình, mỗi slot được ghi nguyên khối
+ */
+class ConfigBackend
+{
+  public:
+    virtual ~ConfigBackend() {}
+    virtual size_t read(uint8_t slot, void *buffer, size_t length) = 0;
+    virtual bool write(uint8_t slot, const void *buffer, size_t length) = 0;
+    virtual bool readLegacy(Config &config) { return false; }
+};
+
+class NvsConfigBackend : public ConfigBackend
+{
+  public:
+    NvsConfigBackend(const char *ns);
+    size_t read(uint8_t slot, void *buffer, size_t length) override;
+    bool write(uint8_t slot, const void *buffer, size_t length) override;
+    bool readLegacy(Config &config) override;
+
+  private:
+    const char *_namespace;
+    Preferences _preferences;
+};
+
+class ConfigStore
+{
+  public:
+    ConfigStore(ConfigBackend &backend);
+    bool begin();
+    const Config &get() const;
+    bool commit(const Config &config);
+    uint32_t sequence() const;
+
+    static void setField(char *field, size_t size, const char *value);
+
+  private:
+    bool loadSlot(uint8_t slot, Config &config, uint32_t &sequence);
+    static uint32_t checksum(const ConfigHeader &header, const Config &config);
+    static void setDefaults(Config &config);
+
+    ConfigBackend &_backend;
+    Config _config;
+    uint32_t _sequence = 0;
+    uint8_t _activeSlot = 1;
+};
+
+#endif
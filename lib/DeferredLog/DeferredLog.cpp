@@ -0,0 +1,377 @@
+#include <DeferredLog.h>
+
+DeferredLog deferredLog;
+
+static LogModule *moduleList = nullptr;
+static const char LEVEL_CHARS[] = "NEWIDV";
+
+LogModule::LogModule(const char *name, uint8_t level) : name(name), level(level), next(moduleList)
+{
+    moduleList = this;
+}
+
+void LogEncoder::putString(const char *value, size_t length)
+{
+    length = std::min(length, (size_t)DLOG_MAX_STRING);
+    if (_length + 2 > _size) return;
+    length = std::min(length, _size - _length - 2);
+    _buffer[_length++] = 's';
+    _buffer[_length++] = (uint8_t)length;
+    memcpy(_buffer + _length, value, length);
+    _length += length;
+}
+
+DeferredLog::DeferredLog() : _ringCount(0)
+{
+    for (std::atomic<Ring *> &ring : _rings) {
+        ring.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @name begin
+ * @brief Tạo task drain ưu tiên thấp để format và ghi log ra serial
+ *
+ * @param {UBaseType_t} priority - Độ ưu tiên của task drain
+ * @param {BaseType_t} core - Core chạy task drain
+ *
+ * @return None
+ */
+void DeferredLog::begin(UBaseType_t priority, BaseType_t core)
+{
+    if (_taskHandle != NULL) return;
+    xTaskCreatePinnedToCore(
+        [](void *pvParameters)
+        {
+            DeferredLog *log = static_cast<DeferredLog *>(pvParameters);
+            for (;;)
+            {
+                if (log->drain() == 0) {
+                    vTaskDelay(DLOG_DRAIN_INTERVAL / portTICK_PERIOD_MS);
+                }
+            }
+        },
+        "DeferredLogTask",
+        4096,
+        this,
+        priority,
+        &_taskHandle,
+        core);
+}
+
+// Vòng đệm của task hiện tại, tạo mới ở lần log đầu tiên của task
+DeferredLog::Ring *DeferredLog::ring()
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint8_t count = std::min(_ringCount.load(std::memory_order_acquire), (uint8_t)DLOG_MAX_RINGS);
+    for (uint8_t i = 0; i < count; ++i) {
+        Ring *ring = _rings[i].load(std::memory_order_acquire);
+        if (ring != nullptr && ring->owner == self) {
+            return ring;
+        }
+    }
+
+    uint8_t index = _ringCount.fetch_add(1, std::memory_order_acq_rel);
+    if (index >= DLOG_MAX_RINGS) {
+        _ringCount.store(DLOG_MAX_RINGS, std::memory_order_release);
+        return nullptr;
+    }
+    Ring *ring = new Ring();
+    ring->owner = self;
+    ring->head.store(0, std::memory_order_relaxed);
+    ring->tail.store(0, std::memory_order_relaxed);
+    ring->dropped.store(0, std::memory_order_relaxed);
+    ring->reported = 0;
+    _rings[index].store(ring, std::memory_order_release);
+    return ring;
+}
+
+// Một producer (task sở hữu) và một consumer (task drain) nên không cần khoá
+void DeferredLog::push(const uint8_t *record, size_t length)
+{
+    Ring *r = ring();
+    if (r == nullptr) return;
+
+    uint32_t head = r->head.load(std::memory_order_relaxed);
+    uint32_t tail = r->tail.load(std::memory_order_acquire);
+    uint16_t len = length;
+    if (DLOG_RING_SIZE - (head - tail) < length + 2) {
+        r->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint8_t lenBytes[2];
+    memcpy(lenBytes, &len, 2);
+    for (uint8_t i = 0; i < 2; ++i) {
+        r->data[(head + i) & (DLOG_RING_SIZE - 1)] = lenBytes[i];
+    }
+    head += 2;
+    size_t offset = head & (DLOG_RING_SIZE - 1);
+    size_t first = std::min(length, DLOG_RING_SIZE - offset);
+    memcpy(r->data + offset, record, first);
+    memcpy(r->data, record + first, length - first);
+    r->head.store(head + length, std::memory_order_release);
+}
+
+/**
+ * @name drain
+ * @brief Lấy hết bản ghi trong các vòng đệm rồi ghi ra serial (dạng text hoặc nhị phân)
+ *
+ * @param None
+ *
+ * @return {size_t} - Số bản ghi đã xử lý
+ */
+size_t DeferredLog::drain()
+{
+    size_t processed = 0;
+    uint8_t count = std::min(_ringCount.load(std::memory_order_acquire), (uint8_t)DLOG_MAX_RINGS);
+    for (uint8_t i = 0; i < count; ++i) {
+        Ring *r = _rings[i].load(std::memory_order_acquire);
+        if (r == nullptr) continue;
+
+        uint32_t tail = r->tail.load(std::memory_order_relaxed);
+        uint32_t head = r->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            uint8_t record[DLOG_MAX_RECORD];
+            uint8_t lenBytes[2] = {r->data[tail & (DLOG_RING_SIZE - 1)], r->data[(tail + 1) & (DLOG_RING_SIZE - 1)]};
+            uint16_t len;
+            memcpy(&len, lenBytes, 2);
+            tail += 2;
+            size_t offset = tail & (DLOG_RING_SIZE - 1);
+            size_t first = std::min((size_t)len, DLOG_RING_SIZE - offset);
+            memcpy(record, r->data + offset, first);
+            memcpy(record + first, r->data, len - first);
+            tail += len;
+            r->tail.store(tail, std::memory_order_release);
+
+            emit(i, record, len);
+            ++processed;
+        }
+
+        uint32_t dropped = r->dropped.load(std::memory_order_relaxed);
+        if (dropped != r->reported) {
+            uint32_t lost = dropped - r->reported;
+            r->reported = dropped;
+            if (_binary) {
+                uint8_t payload[5] = {i};
+                memcpy(payload + 1, &lost, 4);
+                emitFrame(DLOG_FRAME_DROPPED, payload, sizeof(payload));
+            } else {
+                Serial.printf("W (%lu) DeferredLog: %u records dropped on ring %u\n", millis(), (unsigned)lost, i);
+            }
+        }
+    }
+    return processed;
+}
+
+void DeferredLog::emit(uint8_t ringIndex, const uint8_t *record, size_t length)
+{
+    LogSite *site;
+    uint32_t t;
+    memcpy(&site, record, sizeof(site));
+    memcpy(&t, record + sizeof(site), 4);
+    const uint8_t *args = record + RECORD_HEADER;
+    size_t argsLength = length - RECORD_HEADER;
+
+    if (site->id == 0) {
+        _sites.push_back(site);
+        site->id = _sites.size();
+    }
+
+    if (!_binary) {
+        char line[256];
+        int n = snprintf(line, sizeof(line), "%c (%lu) %s: ", LEVEL_CHARS[site->level], (unsigned long)t, site->module->name);
+        n += format(site->format, args, argsLength, line + n, sizeof(line) - n - 1);
+        line[n++] = '\n';
+        Serial.write((const uint8_t *)line, n);
+        return;
+    }
+
+    if (_resendSites) {
+        _resendSites = false;
+        _siteSent.clear();
+    }
+    if (_siteSent.size() <= site->id) {
+        _siteSent.resize(site->id + 1, false);
+    }
+    if (!_siteSent[site->id]) {
+        uint8_t payload[DLOG_MAX_RECORD + 96];
+        size_t moduleLength = strlen(site->module->name) + 1;
+        size_t formatLength = std::min(strlen(site->format) + 1, sizeof(payload) - 3 - moduleLength);
+        memcpy(payload, &site->id, 2);
+        payload[2] = site->level;
+        memcpy(payload + 3, site->module->name, moduleLength);
+        memcpy(payload + 3 + moduleLength, site->format, formatLength);
+        payload[3 + moduleLength + formatLength - 1] = '\0';
+        emitFrame(DLOG_FRAME_SITE, payload, 3 + moduleLength + formatLength);
+        _siteSent[site->id] = true;
+    }
+
+    uint8_t payload[DLOG_MAX_RECORD];
+    memcpy(payload, &site->id, 2);
+    memcpy(payload + 2, &t, 4);
+    payload[6] = ringIndex;
+    memcpy(payload + 7, args, argsLength);
+    emitFrame(DLOG_FRAME_RECORD, payload, 7 + argsLength);
+}
+
+void DeferredLog::emitFrame(uint8_t type, const uint8_t *payload, size_t length)
+{
+    uint8_t header[5] = {'D', 'L', type};
+    uint16_t len = length;
+    memcpy(header + 3, &len, 2);
+    Serial.write(header, sizeof(header));
+    Serial.write(payload, length);
+}
+
+/**
+ * @name format
+ * @brief Format lại bản ghi từ chuỗi format và tham số thô (dùng chung cho thiết bị và bộ giải mã trên host)
+ *
+ * @param {const char*} fmt - Chuỗi format kiểu printf
+ * @param {const uint8_t*} args - Tham số đã mã hoá bởi LogEncoder
+ * @param {size_t} length - Độ dài tham số
+ * @param {char*} out - Buffer kết quả
+ * @param {size_t} size - Kích thước buffer
+ *
+ * @return {size_t} - Số ký tự đã ghi (không tính '\0')
+ */
+size_t DeferredLog::format(const char *fmt, const uint8_t *args, size_t length, char *out, size_t size)
+{
+    size_t n = 0;
+    size_t pos = 0;
+    auto append = [&](const char *text, size_t len) {
+        len = std::min(len, size - 1 - n);
+        memcpy(out + n, text, len);
+        n += len;
+    };
+    if (size == 0) return 0;
+
+    while (*fmt && n < size - 1) {
+        if (*fmt != '%') {
+            const char *next = strchr(fmt, '%');
+            size_t len = next ? (size_t)(next - fmt) : strlen(fmt);
+            append(fmt, len);
+            fmt += len;
+            continue;
+        }
+        if (fmt[1] == '%') {
+            append("%", 1);
+            fmt += 2;
+            continue;
+        }
+
+        // Tách flags/width/precision, bỏ length modifier rồi tự thêm theo kiểu đã lưu
+        char spec[16] = "%";
+        size_t specLen = 1;
+        const char *p = fmt + 1;
+        while (*p && strchr("-+ #0123456789.*", *p) && specLen < sizeof(spec) - 4) {
+            spec[specLen++] = *p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) ++p;
+        char conv = *p ? *p++ : 's';
+        fmt = p;
+
+        char tag = pos < length ? (char)args[pos++] : 0;
+        char text[80];
+        int written = 0;
+        switch (tag) {
+            case 'i': case 'u': case 'I': case 'U': {
+                uint64_t raw = 0;
+                size_t bytes = (tag == 'i' || tag == 'u') ? 4 : 8;
+                if (pos + bytes > length) { tag = 0; break; }
+                memcpy(&raw, args + pos, bytes);
+                pos += bytes;
+                int64_t value = tag == 'i' ? (int64_t)(int32_t)raw : (int64_t)raw;
+                if (conv == 'c') {
+                    spec[specLen++] = conv;
+                    spec[specLen] = '\0';
+                    written = snprintf(text, sizeof(text), spec, (int)value);
+                } else if (strchr("diuxXo", conv)) {
+                    spec[specLen++] = 'l';
+                    spec[specLen++] = 'l';
+                    spec[specLen++] = conv;
+                    spec[specLen] = '\0';
+                    written = snprintf(text, sizeof(text), spec, (long long)value);
+                } else {
+                    written = snprintf(text, sizeof(text), "%lld", (long long)value);
+                }
+                break;
+            }
+            case 'd': {
+                double value;
+                if (pos + 8 > length) { tag = 0; break; }
+                memcpy(&value, args + pos, 8);
+                pos += 8;
+                spec[specLen++] = strchr("feEgGaA", conv) ? conv : 'f';
+                spec[specLen] = '\0';
+                written = snprintf(text, sizeof(text), spec, value);
+                break;
+            }
+            case 'p': {
+                uint32_t value;
+                if (pos + 4 > length) { tag = 0; break; }
+                memcpy(&value, args + pos, 4);
+                pos += 4;
+                written = snprintf(text, sizeof(text), "0x%08x", (unsigned)value);
+                break;
+            }
+            case 's': {
+                if (pos + 1 > length) { tag = 0; break; }
+                size_t len = args[pos++];
+                len = std::min(len, length - pos);
+                append((const char *)args + pos, len);
+                pos += len;
+                continue;
+            }
+            default:
+                tag = 0;
+                break;
+        }
+        if (tag == 0) {
+            append("<?>", 3);
+            continue;
+        }
+        append(text, std::min((size_t)std::max(written, 0), sizeof(text) - 1));
+    }
+    out[n] = '\0';
+    return n;
+}
+
+bool DeferredLog::setLevel(const char *module, uint8_t level)
+{
+    bool found = false;
+    for (LogModule *m = moduleList; m != nullptr; m = m->next) {
+        if (strcmp(m->name, module) == 0) {
+            m->level.store(level, std::memory_order_relaxed);
+            found = true;
+        }
+    }
+    return found;
+}
+
+LogModule *DeferredLog::modules() const
+{
+    return moduleList;
+}
+
+// Bật chế độ nhị phân thì gửi lại mô tả các site để bộ giải mã đọc được từ giữa luồng
+void DeferredLog::setBinary(bool binary)
+{
+    if (binary && !_binary) {
+        _resendSites = true;
+    }
+    _binary = binary;
+}
+
+uint32_t DeferredLog::dropped() const
+{
+    uint32_t total = 0;
+    uint8_t count = std::min(_ringCount.load(std::memory_order_acquire), (uint8_t)DLOG_MAX_RINGS);
+    for (uint8_t i = 0; i < count; ++i) {
+        Ring *r = _rings[i].load(std::memory_order_acquire);
+        if (r != nullptr) {
+            total += r->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
@@ -0,0 +1,199 @@
+/*
+  DeferredLog.h - Log nhị phân trì hoãn: đường dữ liệu chỉ chép con trỏ format và tham số thô
+  vào vòng đệm riêng của task, việc format và ghi ra serial do một task ưu tiên thấp đảm nhận.
+*/
+
+#ifndef DEFERREDLOG_H
+#define DEFERREDLOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#define DLOG_NONE 0
+#define DLOG_ERROR 1
+#define DLOG_WARN 2
+#define DLOG_INFO 3
+#define DLOG_DEBUG 4
+#define DLOG_VERBOSE 5
+
+// Các lệnh log có mức lớn hơn DLOG_LEVEL bị loại bỏ ngay khi biên dịch
+#ifndef DLOG_LEVEL
+#define DLOG_LEVEL DLOG_DEBUG
+#endif
+// Mức mặc định của mỗi module khi khởi động, đổi được lúc chạy qua setLevel()
+#ifndef DLOG_DEFAULT_LEVEL
+#define DLOG_DEFAULT_LEVEL DLOG_INFO
+#endif
+
+#define DLOG_RING_SIZE 2048     // Byte cho mỗi task, phải là luỹ thừa của 2
+#define DLOG_MAX_RINGS 8        // Số task tối đa được ghi log
+#define DLOG_MAX_RECORD 160     // Kích thước tối đa một bản ghi (header + tham số)
+#define DLOG_MAX_STRING 64      // Chuỗi dài hơn bị cắt
+#define DLOG_DRAIN_INTERVAL 20  // ms
+
+// Định dạng luồng nhị phân (little-endian), mỗi frame: 'D' 'L' | type (1B) | len (2B) | payload
+//   DLOG_FRAME_SITE   : id (2B) | level (1B) | module\0 | format\0
+//   DLOG_FRAME_RECORD : id (2B) | t_ms (4B) | ring (1B) | tham số
+//   DLOG_FRAME_DROPPED: ring (1B) | số bản ghi bị bỏ (4B)
+// Tham số: tag (1B) rồi giá trị - 'i' int32, 'u' uint32, 'I' int64, 'U' uint64,
+//          'd' double, 'p' con trỏ (4B), 's' len (1B) + byte
+#define DLOG_FRAME_SITE 0
+#define DLOG_FRAME_RECORD 1
+#define DLOG_FRAME_DROPPED 2
+
+/**
+ * @name LogModule
+ * @brief Module log (vd: "zigbeeServer"), mức log đổi được lúc chạy
+ */
+struct LogModule {
+    LogModule(const char *name, uint8_t level = DLOG_DEFAULT_LEVEL);
+    const char *name;
+    std::atomic<uint8_t> level;
+    LogModule *next;
+};
+
+/**
+ * @name LogSite
+ * @brief Một lệnh log trong mã nguồn, id được task drain gán khi gặp lần đầu
+ */
+struct LogSite {
+    LogModule *module;
+    uint8_t level;
+    const char *format;
+    uint16_t id;
+};
+
+class LogEncoder
+{
+  public:
+    LogEncoder(uint8_t *buffer, size_t size) : _buffer(buffer), _size(size) {}
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type put(T value)
+    {
+        if (sizeof(T) <= 4) {
+            if (std::is_signed<T>::value) {
+                putValue('i', (int32_t)value);
+            } else {
+                putValue('u', (uint32_t)value);
+            }
+        } else if (std::is_signed<T>::value) {
+            putValue('I', (int64_t)value);
+        } else {
+            putValue('U', (uint64_t)value);
+        }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type put(T value)
+    {
+        putValue('d', (double)value);
+    }
+
+    void put(const char *value) { putString(value ? value : "(null)", value ? strlen(value) : 6); }
+    void put(char *value) { put((const char *)value); }
+    void put(const std::string &value) { putString(value.data(), value.size()); }
+    void put(const String &value) { putString(value.c_str(), value.length()); }
+
+    template <typename T>
+    void put(T *value)
+    {
+        putValue('p', (uint32_t)(uintptr_t)value);
+    }
+
+    size_t length() const { return _length; }
+
+  private:
+    template <typename T>
+    void putValue(char tag, T value)
+    {
+        if (_length + 1 + sizeof(T) > _size) return;
+        _buffer[_length++] = tag;
+        memcpy(_buffer + _length, &value, sizeof(T));
+        _length += sizeof(T);
+    }
+    void putString(const char *value, size_t length);
+
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _length = 0;
+};
+
+class DeferredLog
+{
+  public:
+    DeferredLog();
+    void begin(UBaseType_t priority = 0, BaseType_t core = 1);
+
+    template <typename... Args>
+    void write(LogSite &site, const Args &...args)
+    {
+        uint8_t record[DLOG_MAX_RECORD];
+        // header: site (con trỏ) | t_ms
+        LogSite *sitePtr = &site;
+        uint32_t now = millis();
+        memcpy(record, &sitePtr, sizeof(sitePtr));
+        memcpy(record + sizeof(sitePtr), &now, 4);
+        LogEncoder encoder(record + RECORD_HEADER, sizeof(record) - RECORD_HEADER);
+        int expand[] = {0, (encoder.put(args), 0)...};
+        (void)expand;
+        push(record, RECORD_HEADER + encoder.length());
+    }
+
+    bool setLevel(const char *module, uint8_t level);
+    LogModule *modules() const;
+    void setBinary(bool binary);
+    bool binary() const { return _binary; }
+    uint32_t dropped() const;
+    size_t drain();
+
+    static size_t format(const char *fmt, const uint8_t *args, size_t length, char *out, size_t size);
+
+  private:
+    struct Ring {
+        TaskHandle_t owner;
+        std::atomic<uint32_t> head;   // Chỉ task sở hữu ghi
+        std::atomic<uint32_t> tail;   // Chỉ task drain ghi
+        std::atomic<uint32_t> dropped;
+        uint32_t reported;            // Số bản ghi bỏ đã báo (task drain)
+        uint8_t data[DLOG_RING_SIZE];
+    };
+    static const size_t RECORD_HEADER = sizeof(LogSite *) + 4;
+
+    Ring *ring();
+    void push(const uint8_t *record, size_t length);
+    void emit(uint8_t ringIndex, const uint8_t *record, size_t length);
+    void emitFrame(uint8_t type, const uint8_t *payload, size_t length);
+
+    std::atomic<Ring *> _rings[DLOG_MAX_RINGS];
+    std::atomic<uint8_t> _ringCount;
+    volatile bool _binary = false;
+    volatile bool _resendSites = false;
+    std::vector<LogSite *> _sites;      // Theo id, chỉ task drain dùng
+    std::vector<bool> _siteSent;        // Đã gửi mô tả site trong phiên nhị phân hiện tại
+    TaskHandle_t _taskHandle = NULL;
+};
+
+extern DeferredLog deferredLog;
+
+// Khai báo module ở phạm vi file: DLOG_MODULE(zigbee, "zigbeeServer");
+#define DLOG_MODULE(var, name) static LogModule var(name)
+
+#define DLOG(module, lvl, fmt, ...)                                        \
+    do {                                                                   \
+        if ((lvl) <= DLOG_LEVEL && (lvl) <= (module).level.load(std::memory_order_relaxed)) { \
+            static LogSite dlogSite = {&(module), (lvl), fmt, 0};          \
+            deferredLog.write(dlogSite, ##__VA_ARGS__);                    \
+        }                                                                  \
+    } while (0)
+
+#define DLOGE(module, fmt, ...) DLOG(module, DLOG_ERROR, fmt, ##__VA_ARGS__)
+#define DLOGW(module, fmt, ...) DLOG(module, DLOG_WARN, fmt, ##__VA_ARGS__)
+#define DLOGI(module, fmt, ...) DLOG(module, DLOG_INFO, fmt, ##__VA_ARGS__)
+#define DLOGD(module, fmt, ...) DLOG(module, DLOG_DEBUG, fmt, ##__VA_ARGS__)
+#define DLOGV(module, fmt, ...) DLOG(module, DLOG_VERBOSE, fmt, ##__VA_ARGS__)
+
+#endif
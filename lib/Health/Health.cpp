@@ -0,0 +1,78 @@
+#include <Health.h>
+
+Health health;
+
+static const char *COUNTER_NAMES[HEALTH_COUNTER_COUNT] = {
+    "crc_err", "retries", "timeouts", "mqtt_reconn", "metric_drop", "data_dup"};
+
+Health::Health()
+{
+    for (auto &core : _counters) {
+        for (std::atomic<uint32_t> &counter : core) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint32_t Health::total(HealthCounter counter) const
+{
+    uint32_t sum = 0;
+    for (const auto &core : _counters) {
+        sum += core[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+/**
+ * @name watchTask
+ * @brief Đăng ký task để báo stack còn trống nhỏ nhất (high-water mark)
+ *
+ * @param {const char*} name - Tên ngắn dùng trong telemetry (phải tồn tại suốt chương trình)
+ * @param {TaskHandle_t} handle - Handle của task
+ *
+ * @return None
+ */
+void Health::watchTask(const char *name, TaskHandle_t handle)
+{
+    if (handle == NULL || _tasks.size() >= HEALTH_MAX_TASKS) {
+        return;
+    }
+    _tasks.push_back({name, handle});
+}
+
+void Health::addGauge(const char *name, std::function<uint32_t()> read)
+{
+    _gauges.push_back({name, read});
+}
+
+/**
+ * @name collect
+ * @brief Lấy mẫu toàn bộ chỉ số vào một object JSON phẳng, khoá ngắn gọn để bản tin nhỏ
+ *
+ * @param {JsonObject} out - Object nhận các chỉ số
+ *
+ * @return None
+ */
+void Health::collect(JsonObject out) const
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    out["heap"] = freeHeap;
+    out["heap_min"] = ESP.getMinFreeHeap();
+    out["heap_blk"] = largestBlock;
+    // Phân mảnh: phần heap trống không nằm trong khối liền lớn nhất (%)
+    out["heap_frag"] = freeHeap ? 100 - (uint32_t)((uint64_t)largestBlock * 100 / freeHeap) : 0;
+    out["uptime"] = millis() / 1000;
+
+    char key[24];
+    for (const WatchedTask &task : _tasks) {
+        snprintf(key, sizeof(key), "stk_%s", task.name);
+        out[key] = (uint32_t)uxTaskGetStackHighWaterMark(task.handle);
+    }
+    for (const Gauge &gauge : _gauges) {
+        out[gauge.name] = gauge.read();
+    }
+    for (uint8_t i = 0; i < HEALTH_COUNTER_COUNT; ++i) {
+        out[COUNTER_NAMES[i]] = total((HealthCounter)i);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+  Health.h - Đo sức khoẻ hệ thống: stack các task, heap, độ sâu hàng đợi và bộ đếm lỗi.
+*/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#define HEALTH_REPORT_INTERVAL 60000
+#define HEALTH_MAX_TASKS 8
+
+enum HealthCounter : uint8_t {
+    HEALTH_CRC_ERRORS = 0,   // Khung UART sai CRC
+    HEALTH_CMD_RETRIES,      // Lần gửi lại lệnh Zigbee do chưa có ACK
+    HEALTH_CMD_TIMEOUTS,     // Lệnh Zigbee thất bại sau khi hết retry
+    HEALTH_MQTT_RECONNECTS,  // Kết nối MQTT lại sau lần đầu
+    HEALTH_METRICS_DROPPED,  // Metric bị bỏ khi metricQueue đầy
+    HEALTH_DATA_DUPLICATES,  // Khung DATA trùng SEQ bị bỏ trước khi phân tích
+    HEALTH_COUNTER_COUNT
+};
+
+/**
+ * @name Health
+ * @brief Bộ đếm tách theo core (mỗi core chỉ ghi vào ô của mình, không cần khoá) và
+ *        các giá trị đo được lấy mẫu khi gửi telemetry
+ */
+class Health
+{
+  public:
+    Health();
+
+    inline void count(HealthCounter counter, uint32_t n = 1)
+    {
+        _counters[xPortGetCoreID()][counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    uint32_t total(HealthCounter counter) const;
+
+    void watchTask(const char *name, TaskHandle_t handle);
+    void addGauge(const char *name, std::function<uint32_t()> read);
+    void collect(JsonObject out) const;
+
+  private:
+    struct WatchedTask {
+        const char *name;
+        TaskHandle_t handle;
+    };
+    struct Gauge {
+        const char *name;
+        std::function<uint32_t()> read;
+    };
+
+    std::atomic<uint32_t> _counters[portNUM_PROCESSORS][HEALTH_COUNTER_COUNT];
+    std::vector<WatchedTask> _tasks;
+    std::vector<Gauge> _gauges;
+};
+
+extern Health health;
+
+#endif
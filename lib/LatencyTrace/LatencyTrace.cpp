@@ -0,0 +1,111 @@
+#include <LatencyTrace.h>
+
+#ifdef LATENCY_TRACE
+
+LatencyTrace latencyTrace;
+
+static const char *STAGE_NAMES[TRACE_STAGE_COUNT] = {
+    "cmd_dispatch", "cmd_queue", "cmd_ack", "sample_parse", "sample_queue", "sample_publish"};
+
+LatencyTrace::LatencyTrace()
+{
+    reset();
+}
+
+void LatencyTrace::record(TraceStage stage, uint32_t us)
+{
+    Histogram &h = _stages[stage];
+    uint8_t bucket = us < 2 ? 0 : 31 - __builtin_clz(us);
+    if (bucket >= TRACE_BUCKET_COUNT) {
+        bucket = TRACE_BUCKET_COUNT - 1;
+    }
+    h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t current = h.max.load(std::memory_order_relaxed);
+    while (us > current && !h.max.compare_exchange_weak(current, us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyTrace::reset()
+{
+    for (Histogram &h : _stages) {
+        for (std::atomic<uint32_t> &bucket : h.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        h.count.store(0, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t LatencyTrace::count(TraceStage stage) const
+{
+    return _stages[stage].count.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyTrace::max(TraceStage stage) const
+{
+    return _stages[stage].max.load(std::memory_order_relaxed);
+}
+
+/**
+ * @name percentile
+ * @brief Ước lượng phân vị theo cận trên của bucket chứa nó
+ *
+ * @param {TraceStage} stage - Chặng cần tính
+ * @param {float} p - Phân vị (0..1)
+ *
+ * @return {uint32_t} - Độ trễ (µs), 0 nếu chưa có mẫu
+ */
+uint32_t LatencyTrace::percentile(TraceStage stage, float p) const
+{
+    const Histogram &h = _stages[stage];
+    uint32_t total = h.count.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (uint32_t)(p * total);
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < TRACE_BUCKET_COUNT; ++i) {
+        seen += h.buckets[i].load(std::memory_order_relaxed);
+        if (seen > target) {
+            // Không báo vượt quá giá trị lớn nhất đã thấy
+            return std::min((uint32_t)((2u << i) - 1), max(stage));
+        }
+    }
+    return max(stage);
+}
+
+void LatencyTrace::toJson(JsonObject obj, bool buckets) const
+{
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+        TraceStage stage = (TraceStage)i;
+        JsonObject s = obj[STAGE_NAMES[i]].to<JsonObject>();
+        s["count"] = count(stage);
+        s["p50_us"] = percentile(stage, 0.5f);
+        s["p99_us"] = percentile(stage, 0.99f);
+        s["max_us"] = max(stage);
+        if (buckets) {
+            JsonArray array = s["buckets"].to<JsonArray>();
+            for (const std::atomic<uint32_t> &bucket : _stages[i].buckets) {
+                array.add(bucket.load(std::memory_order_relaxed));
+            }
+        }
+    }
+}
+
+// Chuỗi ngắn gọn để gửi làm attribute: "n=12 p50=63 p99=1023 max=880"
+String LatencyTrace::summary(TraceStage stage) const
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "n=%u p50=%u p99=%u max=%u", (unsigned)count(stage),
+             (unsigned)percentile(stage, 0.5f), (unsigned)percentile(stage, 0.99f), (unsigned)max(stage));
+    return String(buffer);
+}
+
+const char *LatencyTrace::stageName(TraceStage stage)
+{
+    return STAGE_NAMES[stage];
+}
+
+#endif // LATENCY_TRACE
@@ -0,0 +1,70 @@
+/*
+  LatencyTrace.h - Đo độ trễ giữa các chặng của lệnh và sample bằng histogram cố định.
+  Bật bằng build flag -DLATENCY_TRACE, khi tắt mọi điểm đo đều biến mất khỏi bản build.
+*/
+
+#ifndef LATENCYTRACE_H
+#define LATENCYTRACE_H
+
+#include <Arduino.h>
+
+#ifdef LATENCY_TRACE
+
+#include <ArduinoJson.h>
+#include <atomic>
+
+// Bucket i chứa các giá trị trong [2^i, 2^(i+1)) µs, bucket cuối gom mọi giá trị lớn hơn (~8 s trở lên)
+#define TRACE_BUCKET_COUNT 24
+#define LATENCY_TRACE_REPORT_INTERVAL 60000
+
+enum TraceStage : uint8_t {
+    TRACE_CMD_DISPATCH = 0,  // MQTT nhận bản tin -> xử lý xong callback attribute
+    TRACE_CMD_QUEUE,         // Vào messageQueue -> truyền lần đầu qua UART
+    TRACE_CMD_ACK,           // Truyền lần đầu -> nhận ACK (gồm cả retry)
+    TRACE_SAMPLE_PARSE,      // Ký tự xuống dòng trên UART -> gọi onMessage
+    TRACE_SAMPLE_QUEUE,      // Ký tự xuống dòng trên UART -> vào metricQueue
+    TRACE_SAMPLE_PUBLISH,    // Ký tự xuống dòng trên UART -> publish MQTT (mỗi metric)
+    TRACE_STAGE_COUNT
+};
+
+/**
+ * @name LatencyTrace
+ * @brief Histogram log2 cho từng chặng, ghi được từ nhiều task cùng lúc không cần khoá
+ */
+class LatencyTrace
+{
+  public:
+    LatencyTrace();
+    void record(TraceStage stage, uint32_t us);
+    void reset();
+
+    uint32_t count(TraceStage stage) const;
+    uint32_t percentile(TraceStage stage, float p) const;
+    uint32_t max(TraceStage stage) const;
+
+    void toJson(JsonObject obj, bool buckets) const;
+    String summary(TraceStage stage) const;
+    static const char *stageName(TraceStage stage);
+
+  private:
+    struct Histogram {
+        std::atomic<uint32_t> buckets[TRACE_BUCKET_COUNT];
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> max;
+    };
+    Histogram _stages[TRACE_STAGE_COUNT];
+};
+
+extern LatencyTrace latencyTrace;
+
+#define TRACE_STAMP(var) uint32_t var = (uint32_t)micros()
+#define TRACE_SINCE(stage, var) latencyTrace.record(stage, (uint32_t)micros() - (var))
+
+#else
+
+#define TRACE_STAMP(var)
+#define TRACE_SINCE(stage, var) ((void)0)
+
+#endif // LATENCY_TRACE
+
+#endif
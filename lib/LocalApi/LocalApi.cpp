@@ -0,0 +1,500 @@
+#include <LocalApi.h>
+#include <cmath>
+
+LocalApi::LocalApi(AsyncWebServer &server, ZigbeeFleet &fleet, TimeSeries &history)
+    : _server(server), _fleet(fleet), _history(history), _events("/api/events")
+{
+}
+
+/**
+ * @name begin
+ * @brief Đăng ký các endpoint REST và luồng SSE (chỉ ở chế độ station)
+ *
+ * GET  /api/devices          - Danh sách thiết bị và thiết bị đang chờ của mọi shard
+ * POST /api/devices/command  - Gửi lệnh tới thiết bị (id, cmd), 404 nếu chưa shard nào sở hữu thiết bị
+ * POST /api/devices/desired  - Đặt trạng thái mong muốn (id, key, value), chỉ gửi lệnh khi khác trạng thái đã báo
+ * GET  /api/groups           - Danh sách nhóm và thành viên
+ * POST /api/groups           - Tạo/thay nhóm (gid, members = id1,id2,...; members rỗng để xoá)
+ * POST /api/groups/command   - Gửi lệnh tới cả nhóm (gid, cmd), kết quả trả qua SSE "group"
+ * GET  /api/events           - SSE: sample, status, devices, group
+ * GET  /api/capture          - Tải capture khung RX/TX (định dạng ZBCAP) của một shard (?shard=n, mặc định 0)
+ * POST /api/capture          - Bật/tắt capture (size = số byte, 0 để tắt; shard = n, mặc định mọi shard)
+ * GET  /api/log              - Mức log của từng module
+ * POST /api/log              - Đổi mức log (module, level) và/hoặc chế độ nhị phân (binary=0|1)
+ * GET  /api/history          - Các chuỗi metric giữ trên gateway; với id, metric: điểm trong [from, to] (ms,
+ *                              mặc định 24 giờ tới mẫu mới nhất), gộp theo step (ms) hoặc tự gộp khi quá nhiều điểm
+ * GET  /api/trace            - Histogram độ trễ từng chặng (khi bật LATENCY_TRACE, ?reset=1 để xoá)
+ *
+ * @param None
+ *
+ * @return None
+ */
+void LocalApi::begin()
+{
+    _server.on("/api/devices", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleDevices(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/devices/command", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleCommand(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/devices/desired", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleDesired(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/groups", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleGroups(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/groups", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleGroupConfig(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/groups/command", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleGroupCommand(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/capture", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleCaptureDownload(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/capture", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleCaptureConfig(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/log", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleLogLevels(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/log", HTTP_POST, [this](AsyncWebServerRequest *request)
+               { handleLogConfig(request); }).setFilter(ON_STA_FILTER);
+    _server.on("/api/history", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleHistory(request); }).setFilter(ON_STA_FILTER);
+#ifdef LATENCY_TRACE
+    _server.on("/api/trace", HTTP_GET, [this](AsyncWebServerRequest *request)
+               { handleTrace(request); }).setFilter(ON_STA_FILTER);
+#endif
+
+    _events.onConnect([](AsyncEventSourceClient *client)
+                      { client->send("hello", NULL, millis(), 1000); });
+    _events.setFilter(ON_STA_FILTER);
+    _server.addHandler(&_events);
+    ESP_LOGI("LocalApi", "Local API ready");
+}
+
+void LocalApi::handleDevices(AsyncWebServerRequest *request)
+{
+    JsonDocument doc;
+    serializeDevices(doc["devices"].to<JsonArray>(), doc["pending"].to<JsonArray>());
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+void LocalApi::handleCommand(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("id", true) || !request->hasParam("cmd", true))
+    {
+        request->send(400, "application/json", "{\"error\":\"id and cmd are required\"}");
+        return;
+    }
+    String id = request->getParam("id", true)->value();
+    String cmd = request->getParam("cmd", true)->value();
+    // Dấu phẩy và xuống dòng sẽ phá khung bản tin ASCII
+    if (id.length() == 0 || cmd.length() == 0 || id.indexOf(',') >= 0 || cmd.indexOf(',') >= 0 || cmd.indexOf('\n') >= 0)
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid id or cmd\"}");
+        return;
+    }
+
+    if (!_fleet.sendCommand(id.c_str(), cmd.c_str()))
+    {
+        request->send(404, "application/json", "{\"error\":\"unknown device\"}");
+        return;
+    }
+    request->send(202, "application/json", "{\"queued\":true}");
+}
+
+void LocalApi::handleDesired(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("id", true) || !request->hasParam("key", true) || !request->hasParam("value", true))
+    {
+        request->send(400, "application/json", "{\"error\":\"id, key and value are required\"}");
+        return;
+    }
+    String id = request->getParam("id", true)->value();
+    String key = request->getParam("key", true)->value();
+    String value = request->getParam("value", true)->value();
+    if (id.length() == 0 || key.length() == 0 || id.indexOf(',') >= 0 || key.indexOf(',') >= 0 || key.indexOf(':') >= 0 ||
+        value.indexOf(',') >= 0 || value.indexOf('\n') >= 0)
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid id, key or value\"}");
+        return;
+    }
+
+    bool queued = _fleet.setDesired(id.c_str(), key.c_str(), value.c_str());
+    request->send(202, "application/json", queued ? "{\"queued\":true}" : "{\"queued\":false}");
+}
+
+void LocalApi::handleGroups(AsyncWebServerRequest *request)
+{
+    JsonDocument doc;
+    JsonObject groups = doc["groups"].to<JsonObject>();
+    for (const auto &group : _fleet.groups())
+    {
+        JsonArray members = groups[group.first].to<JsonArray>();
+        for (const std::string &id : group.second)
+        {
+            members.add(id);
+        }
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+void LocalApi::handleGroupConfig(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("gid", true) || !request->hasParam("members", true))
+    {
+        request->send(400, "application/json", "{\"error\":\"gid and members are required\"}");
+        return;
+    }
+    String gid = request->getParam("gid", true)->value();
+    String members = request->getParam("members", true)->value();
+    if (members.length() == 0)
+    {
+        _fleet.removeGroup(gid.c_str());
+        request->send(200, "application/json", "{\"removed\":true}");
+        return;
+    }
+
+    std::vector<std::string> ids;
+    std::istringstream stream(members.c_str());
+    std::string id;
+    while (std::getline(stream, id, ','))
+    {
+        ids.push_back(id);
+    }
+    if (!_fleet.defineGroup(gid.c_str(), ids))
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid gid or too many groups\"}");
+        return;
+    }
+    request->send(200, "application/json", "{\"defined\":true}");
+}
+
+void LocalApi::handleGroupCommand(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("gid", true) || !request->hasParam("cmd", true))
+    {
+        request->send(400, "application/json", "{\"error\":\"gid and cmd are required\"}");
+        return;
+    }
+    String cmd = request->getParam("cmd", true)->value();
+    if (cmd.length() == 0 || cmd.indexOf(',') >= 0 || cmd.indexOf('\n') >= 0)
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid cmd\"}");
+        return;
+    }
+    if (!_fleet.sendGroupCommand(request->getParam("gid", true)->value().c_str(), cmd.c_str()))
+    {
+        request->send(404, "application/json", "{\"error\":\"unknown group\"}");
+        return;
+    }
+    request->send(202, "application/json", "{\"queued\":true}");
+}
+
+void LocalApi::handleCaptureDownload(AsyncWebServerRequest *request)
+{
+    long shard = request->hasParam("shard") ? request->getParam("shard")->value().toInt() : 0;
+    if (shard < 0 || (size_t)shard >= _fleet.shardCount() || !_fleet.shard(shard).capture().enabled())
+    {
+        request->send(404, "application/json", "{\"error\":\"capture disabled\"}");
+        return;
+    }
+    std::shared_ptr<std::vector<uint8_t>> data = std::make_shared<std::vector<uint8_t>>();
+    _fleet.shard(shard).capture().snapshot(*data);
+
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/octet-stream",
+        [data](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
+        {
+            if (index >= data->size()) return 0;
+            size_t n = std::min(maxLen, data->size() - index);
+            memcpy(buffer, data->data() + index, n);
+            return n;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"zigbee.zbcap\"");
+    request->send(response);
+}
+
+void LocalApi::handleCaptureConfig(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("size", true))
+    {
+        request->send(400, "application/json", "{\"error\":\"size is required\"}");
+        return;
+    }
+    long size = request->getParam("size", true)->value().toInt();
+    long shard = request->hasParam("shard", true) ? request->getParam("shard", true)->value().toInt() : -1;
+    if (size < 0 || shard >= (long)_fleet.shardCount())
+    {
+        request->send(400, "application/json", "{\"error\":\"invalid size or shard\"}");
+        return;
+    }
+    bool enabled = true;
+    for (size_t i = 0; i < _fleet.shardCount(); ++i)
+    {
+        if (shard < 0 || (size_t)shard == i)
+        {
+            enabled = _fleet.shard(i).enableCapture(size) && enabled;
+        }
+    }
+    if (!enabled)
+    {
+        request->send(500, "application/json", "{\"error\":\"cannot allocate capture\"}");
+        return;
+    }
+    request->send(200, "application/json", size > 0 ? "{\"capture\":true}" : "{\"capture\":false}");
+}
+
+void LocalApi::handleLogLevels(AsyncWebServerRequest *request)
+{
+    JsonDocument doc;
+    JsonObject modules = doc["modules"].to<JsonObject>();
+    for (LogModule *module = deferredLog.modules(); module != nullptr; module = module->next)
+    {
+        modules[module->name] = module->level.load();
+    }
+    doc["binary"] = deferredLog.binary();
+    doc["dropped"] = deferredLog.dropped();
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+void LocalApi::handleLogConfig(AsyncWebServerRequest *request)
+{
+    if (request->hasParam("module", true) && request->hasParam("level", true))
+    {
+        long level = request->getParam("level", true)->value().toInt();
+        if (level < DLOG_NONE || level > DLOG_VERBOSE ||
+            !deferredLog.setLevel(request->getParam("module", true)->value().c_str(), level))
+        {
+            request->send(400, "application/json", "{\"error\":\"unknown module or level\"}");
+            return;
+        }
+    }
+    if (request->hasParam("binary", true))
+    {
+        deferredLog.setBinary(request->getParam("binary", true)->value().toInt() != 0);
+    }
+    handleLogLevels(request);
+}
+
+// Số trong mảng điểm: NaN/Inf không phải JSON hợp lệ
+static void printValue(Print &out, double value)
+{
+    if (std::isfinite(value))
+    {
+        out.printf(",%.7g", value);
+    }
+    else
+    {
+        out.print(",null");
+    }
+}
+
+void LocalApi::handleHistory(AsyncWebServerRequest *request)
+{
+    if (!request->hasParam("id") || !request->hasParam("metric"))
+    {
+        JsonDocument doc;
+        doc["bytes"] = _history.bytesUsed();
+        doc["capacity"] = _history.capacity();
+        doc["evicted"] = _history.evicted();
+        JsonArray series = doc["series"].to<JsonArray>();
+        _history.forEachSeries([&](const SeriesInfo &info)
+        {
+            JsonObject obj = series.add<JsonObject>();
+            obj["id"] = info.device;
+            obj["metric"] = info.name;
+            obj["samples"] = info.samples;
+            obj["first"] = info.first;
+            obj["last"] = info.last;
+            obj["bytes"] = info.bytes;
+        });
+
+        AsyncResponseStream *response = request->beginResponseStream("application/json");
+        serializeJson(doc, *response);
+        request->send(response);
+        return;
+    }
+
+    SeriesInfo info;
+    String id = request->getParam("id")->value();
+    String metric = request->getParam("metric")->value();
+    if (!_history.info(id.c_str(), metric.c_str(), info))
+    {
+        request->send(404, "application/json", "{\"error\":\"unknown series\"}");
+        return;
+    }
+    const uint64_t day = 24ULL * 3600 * 1000;
+    uint64_t to = request->hasParam("to") ? strtoull(request->getParam("to")->value().c_str(), nullptr, 10) : info.last;
+    uint64_t from = request->hasParam("from") ? strtoull(request->getParam("from")->value().c_str(), nullptr, 10)
+                                              : (to > day ? to - day : 0);
+    uint64_t step = request->hasParam("step") ? strtoull(request->getParam("step")->value().c_str(), nullptr, 10) : 0;
+    if (from > to)
+    {
+        request->send(400, "application/json", "{\"error\":\"from is after to\"}");
+        return;
+    }
+    // Không trả quá TIMESERIES_MAX_POINTS điểm: khoảng dài thì tự gộp
+    uint64_t minStep = (to - from) / TIMESERIES_MAX_POINTS + 1;
+    if (minStep > TIMESERIES_TICK_MS && step < minStep)
+    {
+        step = (minStep + TIMESERIES_TICK_MS - 1) / TIMESERIES_TICK_MS * TIMESERIES_TICK_MS;
+    }
+
+    // ID và tên metric lấy từ khung của thiết bị, để ArduinoJson escape thay vì in thẳng vào chuỗi
+    JsonDocument names;
+    names["id"] = info.device;
+    names["metric"] = info.name;
+
+    // Điểm gốc: [ts, value]; điểm gộp: [ts, avg, min, max, count]
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    response->print("{\"id\":");
+    serializeJson(names["id"], *response);
+    response->print(",\"metric\":");
+    serializeJson(names["metric"], *response);
+    response->printf(",\"from\":%llu,\"to\":%llu,\"step\":%llu,\"points\":[",
+                     (unsigned long long)from, (unsigned long long)to, (unsigned long long)step);
+    bool first = true;
+    _history.query(id.c_str(), metric.c_str(), from, to, step, [&](const SeriesPoint &point)
+    {
+        response->printf(first ? "[%llu" : ",[%llu", (unsigned long long)point.ts);
+        printValue(*response, point.value);
+        if (step > 0)
+        {
+            printValue(*response, point.min);
+            printValue(*response, point.max);
+            response->printf(",%u", (unsigned)point.count);
+        }
+        response->print("]");
+        first = false;
+    });
+    response->print("]}");
+    request->send(response);
+}
+
+#ifdef LATENCY_TRACE
+void LocalApi::handleTrace(AsyncWebServerRequest *request)
+{
+    JsonDocument doc;
+    doc["uptime_ms"] = millis();
+    latencyTrace.toJson(doc["stages"].to<JsonObject>(), true);
+    if (request->hasParam("reset"))
+    {
+        latencyTrace.reset();
+    }
+
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+}
+#endif
+
+void LocalApi::serializeDevices(JsonArray devices, JsonArray pendingDevices)
+{
+    bool sharded = _fleet.shardCount() > 1;
+    _fleet.forEachDevice([&](const Device &device, bool pending, size_t shard)
+    {
+        JsonObject obj = (pending ? pendingDevices : devices).add<JsonObject>();
+        obj["id"] = device.id;
+        if (sharded)
+        {
+            obj["shard"] = shard;
+        }
+        if (!pending)
+        {
+            obj["status"] = Device::statusName(device.status);
+            obj["online"] = device.online;
+            obj["received"] = device.received;
+            if (device.seqValid)
+            {
+                obj["lost"] = device.lost;
+            }
+        }
+    });
+}
+
+/**
+ * @name publishSample
+ * @brief Đẩy một sample mới tới các client SSE, bỏ qua nếu client đang bị nghẽn
+ *
+ * @param {const char*} id - ID của thiết bị
+ * @param {const char*} data - Dữ liệu dạng key:value
+ *
+ * @return None
+ */
+void LocalApi::publishSample(const char *id, const char *data)
+{
+    if (_events.count() == 0)
+    {
+        return;
+    }
+    if (_events.avgPacketsWaiting() > LOCAL_API_SAMPLE_BACKLOG)
+    {
+        ++_droppedSamples;
+        return;
+    }
+    JsonDocument doc;
+    doc["id"] = id;
+    doc["data"] = data;
+    doc["t"] = millis();
+
+    // DATA có thể dài tới ZIGBEE_MAX_FRAME (và dài hơn sau khi mở rộng theo schema)
+    String buffer;
+    serializeJson(doc, buffer);
+    _events.send(buffer.c_str(), "sample");
+}
+
+void LocalApi::publishDeviceStatus(const char *id, bool online)
+{
+    if (_events.count() == 0)
+    {
+        return;
+    }
+    JsonDocument doc;
+    doc["id"] = id;
+    doc["online"] = online;
+
+    char buffer[128];
+    serializeJson(doc, buffer);
+    _events.send(buffer, "status");
+}
+
+void LocalApi::publishGroupResult(const GroupResult &result)
+{
+    if (_events.count() == 0)
+    {
+        return;
+    }
+    JsonDocument doc;
+    doc["gid"] = result.group;
+    doc["cmd"] = result.command;
+    JsonArray confirmed = doc["confirmed"].to<JsonArray>();
+    for (const std::string &id : result.confirmed)
+    {
+        confirmed.add(id);
+    }
+    JsonArray missing = doc["missing"].to<JsonArray>();
+    for (const std::string &id : result.missing)
+    {
+        missing.add(id);
+    }
+
+    String buffer;
+    serializeJson(doc, buffer);
+    _events.send(buffer.c_str(), "group");
+}
+
+void LocalApi::publishDevicesChanged()
+{
+    if (_events.count() == 0)
+    {
+        return;
+    }
+    _events.send("{}", "devices");
+}
+
+uint32_t LocalApi::droppedSamples() const
+{
+    return _droppedSamples;
+}
@@ -0,0 +1,58 @@
+/*
+  LocalApi.h - API điều khiển cục bộ qua REST và SSE trên AsyncWebServer.
+*/
+
+#ifndef LOCALAPI_H
+#define LOCALAPI_H
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <memory>
+#include "zigbeeFleet.h"
+#include "TimeSeries.h"
+#include "LatencyTrace.h"
+#include "DeferredLog.h"
+
+// Khi hàng đợi trung bình của các client vượt ngưỡng này thì bỏ bớt sample,
+// các sự kiện trạng thái vẫn được gửi. Hàng đợi mỗi client bị chặn bởi SSE_MAX_QUEUED_MESSAGES.
+#define LOCAL_API_SAMPLE_BACKLOG 8
+
+class LocalApi
+{
+  public:
+    LocalApi(AsyncWebServer &server, ZigbeeFleet &fleet, TimeSeries &history);
+    void begin();
+
+    void publishSample(const char *id, const char *data);
+    void publishDeviceStatus(const char *id, bool online);
+    void publishDevicesChanged();
+    void publishGroupResult(const GroupResult &result);
+
+    uint32_t droppedSamples() const;
+
+  private:
+    void handleDevices(AsyncWebServerRequest *request);
+    void handleCommand(AsyncWebServerRequest *request);
+    void handleDesired(AsyncWebServerRequest *request);
+    void handleGroups(AsyncWebServerRequest *request);
+    void handleGroupConfig(AsyncWebServerRequest *request);
+    void handleGroupCommand(AsyncWebServerRequest *request);
+    void handleCaptureDownload(AsyncWebServerRequest *request);
+    void handleCaptureConfig(AsyncWebServerRequest *request);
+    void handleLogLevels(AsyncWebServerRequest *request);
+    void handleLogConfig(AsyncWebServerRequest *request);
+    void handleHistory(AsyncWebServerRequest *request);
+#ifdef LATENCY_TRACE
+    void handleTrace(AsyncWebServerRequest *request);
+#endif
+    void serializeDevices(JsonArray devices, JsonArray pendingDevices);
+
+    AsyncWebServer &_server;
+    ZigbeeFleet &_fleet;
+    TimeSeries &_history;
+    AsyncEventSource _events;
+    uint32_t _droppedSamples = 0;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <PEClient.h>
+#include <sys/select.h>
 
 PEClient *PEClient::_instance = nullptr;
 char* PEClient::device_ids[MAX_DEVICES] = {0};
@@ -18,34 +19,24 @@ int PEClient::device_count = 0;
  * @return None
  */
 PEClient::PEClient()
-    : _client(_espClient)
+    : _client(_espClient), _reactor("PEClientTask")
 {
+    _clientMutex = xSemaphoreCreateRecursiveMutex();
     _client.setServer(_mqttServer, _mqttPort);
     _client.setCallback(callback);
 
-    _sendMetricTopic = "v1/devices/";
-    _sendMetricTopic += _clientId;
-    _sendMetricTopic += "/metrics";
-
-    _sendAttributeTopic = "v1/devices/";
-    _sendAttributeTopic += _clientId;
-    _sendAttributeTopic += "/attributes";
+    initTopics();
 
     _instance = this;
 }
 PEClient::PEClient(const char *wifiSSID, const char *wifiPassword, const char *mqttServer, int mqttPort, const char *clientId, const char *username, const char *password)
-    : _ssid(wifiSSID), _password(wifiPassword), _mqttServer(mqttServer), _mqttPort(mqttPort), _clientId(clientId), _username(username), _passwordMqtt(password), _client(_espClient)
+    : _ssid(wifiSSID), _password(wifiPassword), _mqttServer(mqttServer), _mqttPort(mqttPort), _clientId(clientId), _username(username), _passwordMqtt(password), _client(_espClient), _reactor("PEClientTask")
 {
+    _clientMutex = xSemaphoreCreateRecursiveMutex();
     _client.setServer(_mqttServer, _mqttPort);
     _client.setCallback(callback);
 
-    _sendMetricTopic = "v1/devices/";
-    _sendMetricTopic += _clientId;
-    _sendMetricTopic += "/metrics";
-
-    _sendAttributeTopic = "v1/devices/";
-    _sendAttributeTopic += _clientId;
-    _sendAttributeTopic += "/attributes";
+    initTopics();
 
     _instance = this;
 }
@@ -69,17 +60,31 @@ void PEClient::init(const char *wifiSSID, const char *wifiPassword, const char *
     _client.setServer(_mqttServer, _mqttPort);
     _client.setCallback(callback);
 
-    _sendMetricTopic = "v1/devices/";
-    _sendMetricTopic += _clientId;
-    _sendMetricTopic += "/metrics";
-
-    _sendAttributeTopic = "v1/devices/";
-    _sendAttributeTopic += _clientId;
-    _sendAttributeTopic += "/attributes";
+    initTopics();
 
     _instance = this;
 }
 
+/**
+ * @name initTopics
+ * @brief Tạo các topic MQTT theo clientId
+ *
+ * @param None
+ *
+ * @return None
+ */
+void PEClient::initTopics()
+{
+    String prefix = "v1/devices/";
+    prefix += _clientId;
+
+    _sendMetricTopic = prefix + "/metrics";
+    _sendAttributeTopic = prefix + "/attributes";
+    _gatewayMetricTopic = prefix + "/gateway/metrics";
+    _gatewayConnectTopic = prefix + "/gateway/connect";
+    _gatewayDisconnectTopic = prefix + "/gateway/disconnect";
+}
+
 /**
  * @name begin
  * @brief Khởi tạo PEClient
@@ -92,23 +97,53 @@ void PEClient::begin() {
     // Serial.begin(115200);
     initWiFi();
     _is_stopped = false;
-    xTaskCreatePinnedToCore(
-        [](void *pvParameters)
+    _client.setBufferSize(GATEWAY_BUFFER_SIZE);
+    // Task thức dậy khi socket MQTT có dữ liệu, hoặc mỗi MQTT_SERVICE_INTERVAL để giữ keepalive/kết nối lại
+    _socketEvent = _reactor.on([this]() {
+        do
         {
-            PEClient *peClient = static_cast<PEClient *>(pvParameters);
-            for (;;)
-            {
-                peClient->loop();
-                vTaskDelay(10);
-            }
-        },
-        "PEClientTask",
-        10000,
-        this,
-        1,
-        &mqttTaskHandle,
-        1 // Chạy trên core 1
-    );
+            loop();
+        } while (connected() && _espClient.available());
+    });
+    _reactor.every(MQTT_SERVICE_INTERVAL, [this]() { loop(); });
+    _reactor.setWaiter([this](TickType_t timeout) { return waitSocket(timeout); });
+    _reactor.start(10000, 1, 1); // Chạy trên core 1
+    mqttTaskHandle = _reactor.taskHandle();
+}
+
+/**
+ * @name waitSocket
+ * @brief Chờ socket MQTT có dữ liệu bằng select(), tối đa timeout tick
+ *
+ * @param {TickType_t} timeout - Thời gian chờ tối đa
+ *
+ * @return {uint32_t} - Bit sự kiện socket nếu có dữ liệu, 0 nếu hết thời gian
+ */
+uint32_t PEClient::waitSocket(TickType_t timeout)
+{
+    int fd = _espClient.fd();
+    if (!connected() || fd < 0)
+    {
+        return _reactor.waitNotify(timeout);
+    }
+    // WiFiClient có bộ đệm riêng, dữ liệu đã nằm trong đó thì select() không thấy
+    if (_espClient.available())
+    {
+        return _socketEvent;
+    }
+    uint32_t ms = timeout == portMAX_DELAY ? MQTT_SERVICE_INTERVAL : timeout * portTICK_PERIOD_MS;
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fd, &readable);
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return select(fd + 1, &readable, NULL, NULL, &tv) > 0 ? _socketEvent : 0;
+}
+
+const Reactor &PEClient::reactor() const
+{
+    return _reactor;
 }
 
 /**
@@ -120,15 +155,23 @@ void PEClient::begin() {
  * @return None
  */
 void PEClient::loop() {
-    if (!_client.connected())
+    if (!connected())
     {
         reconnect();
     }
-    _client.loop();
+    if (xSemaphoreTakeRecursive(_clientMutex, portMAX_DELAY) == pdTRUE)
+    {
+        _client.loop();
+        xSemaphoreGiveRecursive(_clientMutex);
+    }
 }
 
 void PEClient::stop() {
-    _client.disconnect();
+    if (xSemaphoreTakeRecursive(_clientMutex, portMAX_DELAY) == pdTRUE)
+    {
+        _client.disconnect();
+        xSemaphoreGiveRecursive(_clientMutex);
+    }
     _is_stopped = true;
     ESP_LOGI("MqttClient", "Disconnected");
         // Xóa task để giải phóng tài nguyên
@@ -151,7 +194,14 @@ void PEClient::stop() {
  * @return boolean - True nếu kết nối được, False nếu ngược lại
  */
 boolean PEClient::connected() {
-    return _client.connected();
+    // connected() của PubSubClient đóng socket khi phát hiện mất kết nối nên cũng phải giữ mutex
+    boolean result = false;
+    if (xSemaphoreTakeRecursive(_clientMutex, portMAX_DELAY) == pdTRUE)
+    {
+        result = _client.connected();
+        xSemaphoreGiveRecursive(_clientMutex);
+    }
+    return result;
 }
 
 
@@ -191,20 +241,35 @@ void PEClient::initWiFi() {
  */
 void PEClient::reconnect()
 {
-    while (!_client.connected())
+    while (!connected())
     {
         if (WiFi.status() != WL_CONNECTED)
         {
             initWiFi();
         }
         ESP_LOGI("PEClient", "Attempting MQTT connection...");
-        if (_client.connect(_clientId, _username, _passwordMqtt))
+        // Giữ mutex trong lúc connect và subscribe, nhưng không giữ trong lúc chờ thử lại
+        bool ok = false;
+        if (xSemaphoreTakeRecursive(_clientMutex, portMAX_DELAY) == pdTRUE)
+        {
+            ok = _client.connect(_clientId, _username, _passwordMqtt);
+            if (ok)
+            {
+                String topic = "v1/devices/";
+                topic += _clientId;
+                topic += "/attributes/set";
+                _client.subscribe(topic.c_str());
+            }
+            xSemaphoreGiveRecursive(_clientMutex);
+        }
+        if (ok)
         {
             ESP_LOGI("PEClient", "connected");
-            String topic = "v1/devices/";
-            topic += _clientId;
-            topic += "/attributes/set";
-            _client.subscribe(topic.c_str());
+            if (_hasConnected)
+            {
+                health.count(HEALTH_MQTT_RECONNECTS);
+            }
+            _hasConnected = true;
         }
         else
         {
@@ -226,6 +291,7 @@ void PEClient::reconnect()
  */
 void PEClient::callback(char *topic, byte *message, unsigned int length)
 {
+    TRACE_STAMP(received);
     String messageTemp = "";
     for (int i = 0; i < length; i++)
     {
@@ -256,6 +322,7 @@ void PEClient::callback(char *topic, byte *message, unsigned int length)
             _instance->_callbacks[key](value);
         }
     }
+    TRACE_SINCE(TRACE_CMD_DISPATCH, received);
 }
 
 /**
@@ -270,7 +337,7 @@ void PEClient::callback(char *topic, byte *message, unsigned int length)
  */
 void PEClient::sendMetric(uint64_t timestamp, const char *key, double value)
 {
-    if (!_client.connected())
+    if (!connected())
     {
         return;
     }
@@ -283,7 +350,7 @@ void PEClient::sendMetric(uint64_t timestamp, const char *key, double value)
     char buffer[256];
     serializeJson(doc, buffer);
 
-    _client.publish(_sendMetricTopic.c_str(), buffer);
+    publish(_sendMetricTopic.c_str(), buffer);
     ESP_LOGI("PEClient", "Send metric: %s", buffer);
 }
 
@@ -298,7 +365,7 @@ void PEClient::sendMetric(uint64_t timestamp, const char *key, double value)
  */
 void PEClient::sendMetric(const char *key, double value)
 {
-    if (!_client.connected())
+    if (!connected())
     {
         return;
     }
@@ -310,7 +377,27 @@ void PEClient::sendMetric(const char *key, double value)
     char buffer[256];
     serializeJson(doc, buffer);
 
-    _client.publish(_sendMetricTopic.c_str(), buffer);
+    publish(_sendMetricTopic.c_str(), buffer);
+}
+
+/**
+ * @name sendMetrics
+ * @brief Gửi nhiều chỉ số trong một bản tin lên topic metrics
+ *
+ * @param {const JsonDocument&} doc - Bản tin dạng {"metrics":{...}}
+ *
+ * @return {bool} - True nếu publish thành công
+ */
+bool PEClient::sendMetrics(const JsonDocument &doc)
+{
+    if (!connected())
+    {
+        return false;
+    }
+    size_t length = measureJson(doc);
+    std::vector<char> buffer(length + 1);
+    serializeJson(doc, buffer.data(), buffer.size());
+    return publish(_sendMetricTopic.c_str(), (const uint8_t *)buffer.data(), length);
 }
 
 /**
@@ -324,7 +411,7 @@ void PEClient::sendMetric(const char *key, double value)
  */
 void PEClient::sendAttribute(const char *key, double value)
 {
-    if (!_client.connected())
+    if (!connected())
     {
         return;
     }
@@ -336,7 +423,7 @@ void PEClient::sendAttribute(const char *key, double value)
     char buffer[256];
     serializeJson(doc, buffer);
 
-    _client.publish(_sendAttributeTopic.c_str(), buffer);
+    publish(_sendAttributeTopic.c_str(), buffer);
 }
 
 /**
@@ -350,7 +437,7 @@ void PEClient::sendAttribute(const char *key, double value)
  */
 void PEClient::sendAttribute(const char *key, const char *value)
 {
-    if (!_client.connected())
+    if (!connected())
     {
         return;
     }
@@ -362,7 +449,7 @@ void PEClient::sendAttribute(const char *key, const char *value)
     char buffer[256];
     serializeJson(doc, buffer);
 
-    _client.publish(_sendAttributeTopic.c_str(), buffer);
+    publish(_sendAttributeTopic.c_str(), buffer);
 }
 
 /**
@@ -378,3 +465,198 @@ void PEClient::on(const char *key, void (*callback)(String))
 {
     _callbacks[key] = std::bind(callback, std::placeholders::_1);
 }
+
+
+// Cận trên độ dài một chuỗi JSON kể cả hai dấu nháy: ký tự điều khiển có thể thành \u00XX
+static size_t jsonStringBound(const char *text)
+{
+    size_t length = 2;
+    for (; *text; ++text)
+    {
+        unsigned char c = *text;
+        length += c < 0x20 ? 6 : (c == '"' || c == '\\') ? 2 : 1;
+    }
+    return length;
+}
+
+/**
+ * @name gatewayMetric
+ * @brief Thêm một giá trị của thiết bị con vào batch gateway, tự động gửi khi batch đầy
+ *
+ * Batch đầy khi đủ GATEWAY_BATCH_SIZE giá trị hoặc khi bản tin sẽ không còn vừa buffer MQTT.
+ * Nếu gửi batch đầy thất bại thì batch được giữ lại và giá trị mới không được nhận.
+ *
+ * @param {const char*} deviceId - ID của thiết bị con
+ * @param {uint64_t} timestamp - Thời gian
+ * @param {const char*} key - Tên thông số
+ * @param {double} value - Giá trị
+ *
+ * @return {bool} - True nếu giá trị đã vào batch, false thì người gọi giữ lại để gửi sau
+ */
+bool PEClient::gatewayMetric(const char *deviceId, uint64_t timestamp, const char *key, double value)
+{
+    if (!connected())
+    {
+        return false;
+    }
+    // "key":<số>, số double tối đa 24 ký tự; mẫu mới thêm {"ts":<20 chữ số>,"values":{}}, thiết bị mới "id":[]
+    auto valueCost = [&]() {
+        auto device = _gatewayBatch.find(deviceId);
+        size_t cost = jsonStringBound(key) + 1 + 24 + 1;
+        if (device == _gatewayBatch.end())
+        {
+            cost += jsonStringBound(deviceId) + 4 + 40;
+        }
+        else if (device->second.back().ts != timestamp)
+        {
+            cost += 40;
+        }
+        return cost;
+    };
+    // Trừ header MQTT, độ dài topic và cặp {} ngoài cùng
+    size_t budget = GATEWAY_BUFFER_SIZE - MQTT_MAX_HEADER_SIZE - 2 - _gatewayMetricTopic.length() - 2;
+    size_t cost = valueCost();
+    if (_gatewayValueCount >= GATEWAY_BATCH_SIZE || (_gatewayValueCount > 0 && _gatewayBytes + cost > budget))
+    {
+        if (!flushGateway())
+        {
+            return false;
+        }
+        cost = valueCost();
+    }
+
+    std::vector<GatewaySample> &samples = _gatewayBatch[deviceId];
+    // Các giá trị cùng thời điểm được gộp vào một mẫu {ts, values}
+    if (samples.empty() || samples.back().ts != timestamp)
+    {
+        samples.push_back({timestamp, {}});
+    }
+    samples.back().values.emplace_back(key, value);
+    _gatewayBytes += cost;
+
+    if (++_gatewayValueCount >= GATEWAY_BATCH_SIZE)
+    {
+        flushGateway();
+    }
+    return true;
+}
+
+/**
+ * @name flushGateway
+ * @brief Gửi toàn bộ batch gateway trong một bản tin {deviceId: [{ts, values}]}
+ *
+ * Batch chỉ được xoá khi publish thành công, nếu không sẽ được gửi lại ở lần sau.
+ *
+ * @param None
+ *
+ * @return {bool} - True nếu gửi thành công hoặc batch rỗng
+ */
+bool PEClient::flushGateway()
+{
+    if (_gatewayBatch.empty())
+    {
+        return true;
+    }
+    if (!connected())
+    {
+        return false;
+    }
+
+    JsonDocument doc;
+    for (const auto &device : _gatewayBatch)
+    {
+        JsonArray samples = doc[device.first].to<JsonArray>();
+        for (const GatewaySample &sample : device.second)
+        {
+            JsonObject entry = samples.add<JsonObject>();
+            entry["ts"] = sample.ts;
+            JsonObject values = entry["values"].to<JsonObject>();
+            for (const auto &value : sample.values)
+            {
+                values[value.first] = value.second;
+            }
+        }
+    }
+
+    size_t length = measureJson(doc);
+    std::vector<char> buffer(length + 1);
+    serializeJson(doc, buffer.data(), buffer.size());
+
+    bool sent = publish(_gatewayMetricTopic.c_str(), (const uint8_t *)buffer.data(), length);
+    if (!sent)
+    {
+        ESP_LOGE("PEClient", "Gateway publish failed (%u bytes), keeping %u values", (unsigned)length,
+                 (unsigned)_gatewayValueCount);
+        return false;
+    }
+    _gatewayBatch.clear();
+    _gatewayValueCount = 0;
+    _gatewayBytes = 0;
+    return true;
+}
+
+/**
+ * @name connectDevice
+ * @brief Thông báo thiết bị con đã kết nối qua gateway
+ *
+ * @param {const char*} deviceId - ID của thiết bị con
+ *
+ * @return None
+ */
+void PEClient::connectDevice(const char *deviceId)
+{
+    sendDeviceEvent(_gatewayConnectTopic, deviceId);
+}
+
+/**
+ * @name disconnectDevice
+ * @brief Thông báo thiết bị con đã mất kết nối
+ *
+ * @param {const char*} deviceId - ID của thiết bị con
+ *
+ * @return None
+ */
+void PEClient::disconnectDevice(const char *deviceId)
+{
+    sendDeviceEvent(_gatewayDisconnectTopic, deviceId);
+}
+
+/**
+ * @name publish
+ * @brief Publish một bản tin dưới _clientMutex, để các task không ghi xen kẽ vào socket MQTT
+ *
+ * @param {const char*} topic - Chủ đề
+ * @param {const char*} payload - Chuỗi kết thúc bằng '\0'
+ *
+ * @return {bool} - True nếu publish thành công
+ */
+bool PEClient::publish(const char *topic, const char *payload)
+{
+    return publish(topic, (const uint8_t *)payload, strlen(payload));
+}
+
+bool PEClient::publish(const char *topic, const uint8_t *payload, size_t length)
+{
+    bool sent = false;
+    if (xSemaphoreTakeRecursive(_clientMutex, portMAX_DELAY) == pdTRUE)
+    {
+        sent = _client.publish(topic, payload, length, false);
+        xSemaphoreGiveRecursive(_clientMutex);
+    }
+    return sent;
+}
+
+void PEClient::sendDeviceEvent(const String &topic, const char *deviceId)
+{
+    if (!connected())
+    {
+        return;
+    }
+    JsonDocument doc;
+    doc["device"] = deviceId;
+
+    char buffer[128];
+    serializeJson(doc, buffer);
+
+    publish(topic.c_str(), buffer);
+}
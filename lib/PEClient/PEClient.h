@@ -15,10 +15,17 @@
 #include <map>
 #include <functional>
 #include <algorithm>
+#include <string>
 #include "esp_log.h"
+#include "LatencyTrace.h"
+#include "Health.h"
+#include "Reactor.h"
 
 
 #define MAX_DEVICES 10
+#define GATEWAY_BATCH_SIZE 64      // Số giá trị tối đa trong một lần publish gateway
+#define GATEWAY_BUFFER_SIZE 4096   // Kích thước buffer MQTT cho bản tin gateway
+#define MQTT_SERVICE_INTERVAL 1000 // ms, giữ keepalive và kiểm tra kết nối khi socket im lặng
 
 class PEClient
 {
@@ -32,11 +39,19 @@ class PEClient
     boolean connected();
     void sendMetric(uint64_t timestamp, const char *key, double value);
     void sendMetric(const char *key, double value);
+    bool sendMetrics(const JsonDocument &doc);
 
     void sendAttribute(const char *key, double value);
     void sendAttribute(const char *key, const char *value);
 
+    bool gatewayMetric(const char *deviceId, uint64_t timestamp, const char *key, double value);
+    bool flushGateway();
+    size_t gatewayPending() const { return _gatewayValueCount; }
+    void connectDevice(const char *deviceId);
+    void disconnectDevice(const char *deviceId);
+
     void on(const char *key, void (*callback)(String));
+    const Reactor &reactor() const;
 
     ~PEClient();
     TaskHandle_t mqttTaskHandle = NULL;
@@ -45,8 +60,18 @@ class PEClient
     static int device_count;
 
   private:
+    struct GatewaySample {
+      uint64_t ts;
+      std::vector<std::pair<std::string, double>> values;
+    };
+
     void initWiFi();
+    void initTopics();
     void reconnect();
+    uint32_t waitSocket(TickType_t timeout);
+    void sendDeviceEvent(const String &topic, const char *deviceId);
+    bool publish(const char *topic, const char *payload);
+    bool publish(const char *topic, const uint8_t *payload, size_t length);
     static void callback(char *topic, byte *message, unsigned int length);
 
     const char *_ssid;
@@ -58,12 +83,25 @@ class PEClient
     const char *_passwordMqtt;
 
     bool _is_stopped;
+    bool _hasConnected = false;
 
     WiFiClient _espClient;
     PubSubClient _client;
+    // PubSubClient không an toàn đa luồng: mọi lệnh trên _client đi qua mutex này. Đệ quy vì callback
+    // MQTT chạy bên trong _client.loop() và có thể publish
+    SemaphoreHandle_t _clientMutex;
+    Reactor _reactor;
+    uint32_t _socketEvent = 0;
 
     String _sendMetricTopic;
     String _sendAttributeTopic;
+    String _gatewayMetricTopic;
+    String _gatewayConnectTopic;
+    String _gatewayDisconnectTopic;
+
+    std::map<std::string, std::vector<GatewaySample>> _gatewayBatch;
+    size_t _gatewayValueCount = 0;
+    size_t _gatewayBytes = 0;          // Cận trên độ dài JSON của batch, để batch luôn vừa buffer MQTT
 
     std::map<String, std::function<void(String)>> _callbacks;
     static PEClient *_instance;
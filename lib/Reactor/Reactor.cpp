@@ -0,0 +1,222 @@
+#include "Reactor.h"
+
+Reactor::Reactor(const char *name) : _name(name), _posted(0), _wakeups(0), _idleWakeups(0)
+{
+}
+
+/**
+ * @name on
+ * @brief Đăng ký handler cho một sự kiện mới
+ *
+ * @param {Handler} handler - Hàm xử lý
+ *
+ * @return {uint32_t} - Bit sự kiện dùng cho notify(), 0 nếu đã hết chỗ
+ */
+uint32_t Reactor::on(Handler handler)
+{
+    if (_handlerCount >= REACTOR_MAX_EVENTS) {
+        ESP_LOGE("Reactor", "%s: too many events", _name);
+        _overflowed = true;
+        return 0;
+    }
+    _handlers[_handlerCount] = handler;
+    return 1u << _handlerCount++;
+}
+
+/**
+ * @name every
+ * @brief Đăng ký timer lặp lại
+ *
+ * @param {uint32_t} periodMs - Chu kỳ (ms)
+ * @param {Handler} handler - Hàm xử lý
+ *
+ * @return {int} - ID timer, -1 nếu đã hết chỗ
+ */
+int Reactor::every(uint32_t periodMs, Handler handler)
+{
+    if (_timerCount >= REACTOR_MAX_TIMERS) {
+        ESP_LOGE("Reactor", "%s: too many timers", _name);
+        _overflowed = true;
+        return -1;
+    }
+    _timers[_timerCount] = {handler, periodMs, (uint32_t)millis() + periodMs, true};
+    return _timerCount++;
+}
+
+// Timer một lần, gọi arm() để hẹn lại
+int Reactor::after(uint32_t delayMs, Handler handler)
+{
+    int timer = every(0, handler);
+    if (timer >= 0) {
+        _timers[timer].due = millis() + delayMs;
+    }
+    return timer;
+}
+
+void Reactor::arm(int timer, uint32_t delayMs)
+{
+    if (timer < 0 || timer >= _timerCount) return;
+    _timers[timer].due = millis() + delayMs;
+    _timers[timer].armed = true;
+}
+
+void Reactor::disarm(int timer)
+{
+    if (timer < 0 || timer >= _timerCount) return;
+    _timers[timer].armed = false;
+}
+
+// Thay cách chờ mặc định (task notification), vd: chờ socket bằng select()
+void Reactor::setWaiter(Waiter waiter)
+{
+    _waiter = waiter;
+}
+
+/**
+ * @name start
+ * @brief Tạo task chạy vòng sự kiện
+ *
+ * Handler/timer thường được đăng ký trong constructor của đối tượng toàn cục, trước khi Serial chạy nên
+ * lỗi hết chỗ lúc đó không ai thấy. Reactor thiếu handler thì dừng hẳn ở đây thay vì chạy thiếu.
+ *
+ * @param {uint32_t} stackSize - Kích thước stack của task
+ * @param {UBaseType_t} priority - Độ ưu tiên
+ * @param {BaseType_t} core - Core chạy task
+ *
+ * @return {bool} - True nếu tạo được task
+ */
+bool Reactor::start(uint32_t stackSize, UBaseType_t priority, BaseType_t core)
+{
+    if (_overflowed) {
+        ESP_LOGE("Reactor", "%s: handlers or timers were dropped, raise REACTOR_MAX_EVENTS/REACTOR_MAX_TIMERS", _name);
+        abort();
+    }
+    BaseType_t created = xTaskCreatePinnedToCore(
+        [](void *pvParameters)
+        {
+            Reactor *reactor = static_cast<Reactor *>(pvParameters);
+            for (;;)
+            {
+                reactor->runOnce();
+            }
+        },
+        _name,
+        stackSize,
+        this,
+        priority,
+        &_taskHandle,
+        core);
+    return created == pdPASS;
+}
+
+void Reactor::notify(uint32_t bits)
+{
+    _posted.fetch_or(bits);
+    if (_taskHandle != NULL) {
+        xTaskNotifyGive(_taskHandle);
+    }
+}
+
+uint32_t Reactor::waitNotify(TickType_t timeout)
+{
+    ulTaskNotifyTake(pdTRUE, timeout);
+    return 0;
+}
+
+/**
+ * @name waitFor
+ * @brief Chờ một số sự kiện ngay trong handler (vd: chờ ACK), các sự kiện khác được giữ lại cho vòng sau
+ *
+ * @param {uint32_t} bits - Bit sự kiện cần chờ
+ * @param {uint32_t} timeoutMs - Thời gian chờ tối đa (ms)
+ *
+ * @return {bool} - True nếu có sự kiện, False nếu hết thời gian
+ */
+bool Reactor::waitFor(uint32_t bits, uint32_t timeoutMs)
+{
+    uint32_t start = millis();
+    for (;;) {
+        uint32_t posted = _posted.fetch_and(~bits);
+        if (posted & bits) return true;
+        uint32_t elapsed = millis() - start;
+        if (elapsed >= timeoutMs) return false;
+        if (_taskHandle == NULL || xTaskGetCurrentTaskHandle() != _taskHandle) {
+            // Gọi ngoài task của reactor (vd: bản build native gọi loop() trực tiếp)
+            vTaskDelay(1);
+            return false;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs - elapsed));
+    }
+}
+
+TickType_t Reactor::nextTimeout(uint32_t now) const
+{
+    TickType_t timeout = portMAX_DELAY;
+    for (uint8_t i = 0; i < _timerCount; ++i) {
+        if (!_timers[i].armed) continue;
+        int32_t remaining = (int32_t)(_timers[i].due - now);
+        TickType_t ticks = remaining > 0 ? pdMS_TO_TICKS(remaining) : 0;
+        if (ticks < timeout) timeout = ticks;
+    }
+    return timeout;
+}
+
+bool Reactor::fireTimers(uint32_t now)
+{
+    bool fired = false;
+    for (uint8_t i = 0; i < _timerCount; ++i) {
+        Timer &timer = _timers[i];
+        if (!timer.armed || (int32_t)(now - timer.due) < 0) continue;
+        if (timer.period > 0) {
+            timer.due += timer.period;
+            // Trễ quá một chu kỳ thì bỏ qua các lần đã lỡ
+            if ((int32_t)(now - timer.due) >= 0) {
+                timer.due = now + timer.period;
+            }
+        } else {
+            timer.armed = false;
+        }
+        timer.handler();
+        fired = true;
+    }
+    return fired;
+}
+
+// Chạy các timer đã tới hạn mà không chờ, dùng khi không chạy task (vd: bản build native gọi loop())
+bool Reactor::runTimers()
+{
+    return fireTimers(millis());
+}
+
+/**
+ * @name runOnce
+ * @brief Chờ tới khi có sự kiện hoặc timer tới hạn rồi chạy các handler tương ứng
+ *
+ * @param {TickType_t} maxWait - Thời gian chờ tối đa (tick)
+ *
+ * @return {bool} - True nếu có handler được chạy
+ */
+bool Reactor::runOnce(TickType_t maxWait)
+{
+    uint32_t events = _posted.exchange(0);
+    if (events == 0) {
+        TickType_t timeout = nextTimeout(millis());
+        if (timeout > maxWait) timeout = maxWait;
+        if (timeout > 0) {
+            events = _waiter ? _waiter(timeout) : waitNotify(timeout);
+        }
+        events |= _posted.exchange(0);
+    }
+    ++_wakeups;
+
+    bool worked = false;
+    for (uint8_t i = 0; i < _handlerCount; ++i) {
+        if (events & (1u << i)) {
+            _handlers[i]();
+            worked = true;
+        }
+    }
+    if (fireTimers(millis())) worked = true;
+    if (!worked) ++_idleWakeups;
+    return worked;
+}
@@ -0,0 +1,80 @@
+/*
+  Reactor.h - Vòng sự kiện cho một task: handler chạy khi có sự kiện (UART nhận dữ liệu, hàng đợi
+  có phần tử mới...) hoặc khi timer tới hạn, ngoài ra task ngủ hẳn thay vì thức dậy mỗi 10 tick.
+*/
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+
+#ifndef REACTOR_MAX_EVENTS
+#define REACTOR_MAX_EVENTS 8    // Tối đa 32, mỗi sự kiện một bit
+#endif
+#ifndef REACTOR_MAX_TIMERS
+#define REACTOR_MAX_TIMERS 8
+#endif
+
+/**
+ * @name Reactor
+ * @brief Mỗi sự kiện là một bit, notify() có thể gọi từ task bất kỳ (kể cả trước khi start).
+ *        Handler, timer và waitFor() chỉ dùng trong task của reactor.
+ */
+static_assert(REACTOR_MAX_EVENTS <= 32, "REACTOR_MAX_EVENTS must fit in a 32-bit event mask");
+
+class Reactor
+{
+  public:
+    typedef std::function<void()> Handler;
+    // Chờ tối đa timeout tick, trả về bit sự kiện riêng của waiter (vd: socket có dữ liệu)
+    typedef std::function<uint32_t(TickType_t timeout)> Waiter;
+
+    explicit Reactor(const char *name);
+
+    uint32_t on(Handler handler);
+    int every(uint32_t periodMs, Handler handler);
+    int after(uint32_t delayMs, Handler handler);
+    void arm(int timer, uint32_t delayMs);
+    void disarm(int timer);
+    void setWaiter(Waiter waiter);
+
+    bool start(uint32_t stackSize, UBaseType_t priority, BaseType_t core);
+    void notify(uint32_t bits);
+    uint32_t waitNotify(TickType_t timeout);
+    bool waitFor(uint32_t bits, uint32_t timeoutMs);
+    bool runOnce(TickType_t maxWait = portMAX_DELAY);
+    bool runTimers();
+
+    const char *name() const { return _name; }
+    TaskHandle_t taskHandle() const { return _taskHandle; }
+    uint32_t wakeups() const { return _wakeups; }
+    uint32_t idleWakeups() const { return _idleWakeups; }
+    bool overflowed() const { return _overflowed; }
+
+  private:
+    struct Timer {
+        Handler handler;
+        uint32_t period;    // 0 = chạy một lần
+        uint32_t due;       // millis()
+        bool armed;
+    };
+
+    TickType_t nextTimeout(uint32_t now) const;
+    bool fireTimers(uint32_t now);
+
+    const char *_name;
+    TaskHandle_t _taskHandle = NULL;
+    Handler _handlers[REACTOR_MAX_EVENTS];
+    uint8_t _handlerCount = 0;
+    Timer _timers[REACTOR_MAX_TIMERS];
+    uint8_t _timerCount = 0;
+    bool _overflowed = false;           // Có on()/every()/after() không đăng ký được
+    Waiter _waiter;
+    std::atomic<uint32_t> _posted;      // Bit đã notify nhưng chưa xử lý
+    std::atomic<uint32_t> _wakeups;
+    std::atomic<uint32_t> _idleWakeups; // Thức dậy mà không có việc gì
+};
+
+#endif
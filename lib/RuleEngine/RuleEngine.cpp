@@ -0,0 +1,585 @@
+#include <RuleEngine.h>
+#include <ArduinoJson.h>
+#include <cmath>
+#include <algorithm>
+#include "DeferredLog.h"
+
+DLOG_MODULE(rulesLog, "RuleEngine");
+
+#define SLOT_NONE 0xFFFF
+
+// Bytecode máy ngăn xếp: CONST và LOAD mang 2 byte chỉ số (LE), các lệnh khác lấy toán hạng trên ngăn xếp
+enum RuleOp : uint8_t {
+    RULE_OP_CONST = 0,  // Đẩy _constants[i]
+    RULE_OP_LOAD,       // Đẩy giá trị mới nhất của slot i
+    RULE_OP_ADD,
+    RULE_OP_SUB,
+    RULE_OP_MUL,
+    RULE_OP_DIV,
+    RULE_OP_NEG,
+    RULE_OP_NOT,
+    RULE_OP_LT,
+    RULE_OP_LE,
+    RULE_OP_GT,
+    RULE_OP_GE,
+    RULE_OP_EQ,
+    RULE_OP_NE,
+    RULE_OP_AND,
+    RULE_OP_OR
+};
+
+static inline bool truthy(double value)
+{
+    return value != 0 && !std::isnan(value);
+}
+
+static bool identifierChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/**
+ * @name RuleCompiler
+ * @brief Phân tích đệ quy biểu thức "when" và sinh bytecode, theo độ ưu tiên:
+ *   or := and ('||' and)* ; and := cmp ('&&' cmp)* ; cmp := sum (op sum)? ; sum := term (('+'|'-') term)* ;
+ *   term := unary (('*'|'/') unary)* ; unary := ('-'|'!') unary | primary ; primary := số | tên | '(' or ')'
+ */
+class RuleCompiler
+{
+  public:
+    RuleCompiler(RuleSet &set, const std::string &device, const char *text, std::vector<uint8_t> &code)
+        : _set(set), _device(device), _start(text), _p(text), _code(code)
+    {
+    }
+
+    bool compile(std::string &error)
+    {
+        bool ok = parseOr();
+        skipSpace();
+        if (ok && *_p != '\0') {
+            ok = fail("unexpected character");
+        }
+        if (ok && _code.size() > RULE_MAX_CODE) {
+            ok = fail("expression too long");
+        }
+        if (!ok) {
+            char position[16];
+            snprintf(position, sizeof(position), " at %u", (unsigned)(_p - _start));
+            error = std::string(_error) + position;
+        }
+        return ok;
+    }
+
+    std::vector<uint16_t> slots;    // Slot mà biểu thức đọc, không trùng
+
+  private:
+    bool parseOr()
+    {
+        if (!parseAnd()) return false;
+        while (accept("||")) {
+            if (!parseAnd()) return false;
+            emit(RULE_OP_OR, -1);
+        }
+        return true;
+    }
+
+    bool parseAnd()
+    {
+        if (!parseCompare()) return false;
+        while (accept("&&")) {
+            if (!parseCompare()) return false;
+            emit(RULE_OP_AND, -1);
+        }
+        return true;
+    }
+
+    bool parseCompare()
+    {
+        static const struct {
+            const char *token;
+            RuleOp op;
+        } operators[] = {{"<=", RULE_OP_LE}, {">=", RULE_OP_GE}, {"==", RULE_OP_EQ}, {"!=", RULE_OP_NE},
+                         {"<", RULE_OP_LT},  {">", RULE_OP_GT}};
+        if (!parseSum()) return false;
+        for (const auto &entry : operators) {
+            if (accept(entry.token)) {
+                if (!parseSum()) return false;
+                emit(entry.op, -1);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool parseSum()
+    {
+        if (!parseTerm()) return false;
+        while (true) {
+            RuleOp op;
+            if (accept("+")) {
+                op = RULE_OP_ADD;
+            } else if (accept("-")) {
+                op = RULE_OP_SUB;
+            } else {
+                return true;
+            }
+            if (!parseTerm()) return false;
+            emit(op, -1);
+        }
+    }
+
+    bool parseTerm()
+    {
+        if (!parseUnary()) return false;
+        while (true) {
+            RuleOp op;
+            if (accept("*")) {
+                op = RULE_OP_MUL;
+            } else if (accept("/")) {
+                op = RULE_OP_DIV;
+            } else {
+                return true;
+            }
+            if (!parseUnary()) return false;
+            emit(op, -1);
+        }
+    }
+
+    bool parseUnary()
+    {
+        skipSpace();
+        if (accept("-")) {
+            if (!parseUnary()) return false;
+            emit(RULE_OP_NEG, 0);
+            return true;
+        }
+        if (_p[0] == '!' && _p[1] != '=') {
+            ++_p;
+            if (!parseUnary()) return false;
+            emit(RULE_OP_NOT, 0);
+            return true;
+        }
+        return parsePrimary();
+    }
+
+    bool parsePrimary()
+    {
+        skipSpace();
+        if (accept("(")) {
+            if (!parseOr()) return false;
+            return accept(")") || fail("expected ')'");
+        }
+        if (isdigit((unsigned char)*_p) || *_p == '.') {
+            char *end;
+            double value = strtod(_p, &end);
+            if (end == _p) return fail("invalid number");
+            _p = end;
+            if (_set._constants.size() >= SLOT_NONE) return fail("too many constants");
+            _set._constants.push_back(value);
+            return emitIndex(RULE_OP_CONST, _set._constants.size() - 1);
+        }
+        if (!isalpha((unsigned char)*_p) && *_p != '_') {
+            return fail("expected number or metric");
+        }
+        const char *name = _p;
+        while (identifierChar(*_p)) ++_p;
+        std::string device = _device;
+        std::string metric(name, _p - name);
+        if (*_p == '.' && identifierChar(_p[1])) {
+            device = metric;
+            name = ++_p;
+            while (identifierChar(*_p)) ++_p;
+            metric.assign(name, _p - name);
+        }
+        if (device.empty()) return fail("metric without device");
+        int index = _set.slot(device, metric);
+        if (index < 0) return fail("too many metrics");
+        if (std::find(slots.begin(), slots.end(), index) == slots.end()) {
+            slots.push_back(index);
+        }
+        return emitIndex(RULE_OP_LOAD, index);
+    }
+
+    void skipSpace()
+    {
+        while (isspace((unsigned char)*_p)) ++_p;
+    }
+
+    bool accept(const char *token)
+    {
+        skipSpace();
+        size_t length = strlen(token);
+        if (strncmp(_p, token, length) != 0) return false;
+        _p += length;
+        return true;
+    }
+
+    // depth: thay đổi độ sâu ngăn xếp sau lệnh (+1 đẩy, -1 toán tử hai ngôi)
+    void emit(RuleOp op, int depth)
+    {
+        _code.push_back(op);
+        _depth += depth;
+    }
+
+    bool emitIndex(RuleOp op, size_t index)
+    {
+        _code.push_back(op);
+        _code.push_back(index & 0xFF);
+        _code.push_back(index >> 8);
+        if (++_depth > RULE_STACK_DEPTH) return fail("expression too deep");
+        return true;
+    }
+
+    bool fail(const char *message)
+    {
+        if (_error == nullptr) {
+            _error = message;
+        }
+        return false;
+    }
+
+    RuleSet &_set;
+    const std::string &_device;
+    const char *_start;
+    const char *_p;
+    std::vector<uint8_t> &_code;
+    int _depth = 0;
+    const char *_error = nullptr;
+};
+
+RuleSet::RuleSet()
+{
+}
+
+/**
+ * @name add
+ * @brief Biên dịch một luật và đăng ký nó vào các slot mà biểu thức đọc
+ *
+ * @param {const RuleSpec&} spec - Luật
+ * @param {std::string&} error - Lý do khi thất bại
+ *
+ * @return {bool} - false nếu biểu thức sai, thiếu lệnh hoặc quá giới hạn
+ */
+bool RuleSet::add(const RuleSpec &spec, std::string &error)
+{
+    if (_rules.size() >= RULE_MAX_RULES) {
+        error = "too many rules";
+        return false;
+    }
+    if (spec.then.id.empty() && spec.otherwise.id.empty()) {
+        error = "no action";
+        return false;
+    }
+    // Dấu phẩy và xuống dòng sẽ phá khung bản tin ASCII
+    for (const RuleAction *action : {&spec.then, &spec.otherwise}) {
+        if (!action->id.empty() && (action->cmd.empty() || action->cmd.find_first_of(",\n") != std::string::npos ||
+                                    action->id.find(',') != std::string::npos)) {
+            error = "invalid command";
+            return false;
+        }
+    }
+
+    if (spec.when.empty()) {
+        error = "empty condition";
+        return false;
+    }
+    std::vector<uint8_t> code;
+    RuleCompiler compiler(*this, spec.device, spec.when.c_str(), code);
+    if (!compiler.compile(error)) {
+        return false;
+    }
+
+    Rule rule;
+    rule.name = spec.name;
+    rule.code = _code.size();
+    rule.length = code.size();
+    rule.then = spec.then;
+    rule.otherwise = spec.otherwise;
+    rule.cooldown = spec.cooldown;
+    rule.lastAction = 0;
+    rule.epoch = 0;
+    rule.active = false;
+    rule.acted = false;
+    _code.insert(_code.end(), code.begin(), code.end());
+    for (uint16_t index : compiler.slots) {
+        _slots[index].rules.push_back(_rules.size());
+    }
+    _rules.push_back(rule);
+    return true;
+}
+
+// Giữ giá trị mới nhất của các metric mà bộ luật cũ cũng đọc, luật mới không phải chờ sample kế tiếp
+void RuleSet::carryValues(const RuleSet &previous)
+{
+    for (Slot &slot : _slots) {
+        int index = previous.findSlot(slot.device.c_str(), slot.device.length(), slot.metric.c_str(),
+                                      slot.metric.length());
+        if (index >= 0) {
+            slot.value = previous._slots[index].value;
+        }
+    }
+}
+
+uint32_t RuleSet::hash(const char *device, size_t deviceLength, const char *metric, size_t metricLength)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (size_t i = 0; i < deviceLength; ++i) {
+        h = (h ^ (uint8_t)device[i]) * 16777619u;
+    }
+    h = (h ^ '.') * 16777619u;
+    for (size_t i = 0; i < metricLength; ++i) {
+        h = (h ^ (uint8_t)metric[i]) * 16777619u;
+    }
+    return h;
+}
+
+int RuleSet::findSlot(const char *device, size_t deviceLength, const char *metric, size_t metricLength) const
+{
+    if (_index.empty()) return -1;
+    size_t mask = _index.size() - 1;
+    for (size_t i = hash(device, deviceLength, metric, metricLength) & mask; _index[i] != SLOT_NONE;
+         i = (i + 1) & mask) {
+        const Slot &slot = _slots[_index[i]];
+        if (slot.device.length() == deviceLength && slot.metric.length() == metricLength &&
+            memcmp(slot.device.data(), device, deviceLength) == 0 &&
+            memcmp(slot.metric.data(), metric, metricLength) == 0) {
+            return _index[i];
+        }
+    }
+    return -1;
+}
+
+int RuleSet::slot(const std::string &device, const std::string &metric)
+{
+    int index = findSlot(device.c_str(), device.length(), metric.c_str(), metric.length());
+    if (index >= 0) return index;
+    if (_slots.size() >= SLOT_NONE - 1) return -1;
+    _slots.push_back({device, metric, NAN, {}});
+    rehash();
+    return _slots.size() - 1;
+}
+
+// Bảng băm luôn còn ít nhất một nửa ô trống
+void RuleSet::rehash()
+{
+    size_t size = 16;
+    while (size < _slots.size() * 2) {
+        size *= 2;
+    }
+    if (size == _index.size()) {
+        const Slot &slot = _slots.back();
+        size_t mask = size - 1;
+        size_t i = hash(slot.device.c_str(), slot.device.length(), slot.metric.c_str(), slot.metric.length()) & mask;
+        while (_index[i] != SLOT_NONE) {
+            i = (i + 1) & mask;
+        }
+        _index[i] = _slots.size() - 1;
+        return;
+    }
+    _index.assign(size, SLOT_NONE);
+    for (size_t n = 0; n < _slots.size(); ++n) {
+        const Slot &slot = _slots[n];
+        size_t i = hash(slot.device.c_str(), slot.device.length(), slot.metric.c_str(), slot.metric.length()) &
+                   (size - 1);
+        while (_index[i] != SLOT_NONE) {
+            i = (i + 1) & (size - 1);
+        }
+        _index[i] = n;
+    }
+}
+
+double RuleSet::evaluate(const Rule &rule) const
+{
+    double stack[RULE_STACK_DEPTH];
+    int sp = 0;
+    const uint8_t *pc = _code.data() + rule.code;
+    const uint8_t *end = pc + rule.length;
+    while (pc < end) {
+        uint8_t op = *pc++;
+        if (op <= RULE_OP_LOAD) {
+            uint16_t index = pc[0] | pc[1] << 8;
+            pc += 2;
+            stack[sp++] = op == RULE_OP_CONST ? _constants[index] : _slots[index].value;
+            continue;
+        }
+        if (op == RULE_OP_NEG) {
+            stack[sp - 1] = -stack[sp - 1];
+            continue;
+        }
+        if (op == RULE_OP_NOT) {
+            stack[sp - 1] = !truthy(stack[sp - 1]);
+            continue;
+        }
+        double b = stack[--sp];
+        double &a = stack[sp - 1];
+        switch (op) {
+            case RULE_OP_ADD: a = a + b; break;
+            case RULE_OP_SUB: a = a - b; break;
+            case RULE_OP_MUL: a = a * b; break;
+            case RULE_OP_DIV: a = a / b; break;
+            case RULE_OP_LT: a = a < b; break;
+            case RULE_OP_LE: a = a <= b; break;
+            case RULE_OP_GT: a = a > b; break;
+            case RULE_OP_GE: a = a >= b; break;
+            case RULE_OP_EQ: a = a == b; break;
+            case RULE_OP_NE: a = a != b && !std::isnan(a) && !std::isnan(b); break;  // NaN != x cũng là sai
+            case RULE_OP_AND: a = truthy(a) && truthy(b); break;
+            case RULE_OP_OR: a = truthy(a) || truthy(b); break;
+        }
+    }
+    return sp > 0 ? stack[0] : 0;
+}
+
+/**
+ * @name ingest
+ * @brief Cập nhật slot theo khung DATA key:value,... của một thiết bị rồi tính các luật đọc các slot đó
+ *
+ * @param {const char*} id - ID thiết bị
+ * @param {const char*} data - Dữ liệu key:value,...
+ * @param {uint32_t} now - millis(), cho cooldown
+ * @param {std::vector<RuleAction>&} actions - Nhận lệnh của các luật vừa đổi trạng thái
+ *
+ * @return {size_t} - Số luật đã tính
+ */
+size_t RuleSet::ingest(const char *id, const char *data, uint32_t now, std::vector<RuleAction> &actions)
+{
+    if (_slots.empty()) return 0;
+    size_t idLength = strlen(id);
+    ++_epoch;
+    _pending.clear();
+    for (const char *p = data; *p;) {
+        const char *colon = strchr(p, ':');
+        if (colon == nullptr) break;
+        const char *end = strchr(colon, ',');
+        if (end == nullptr) {
+            end = colon + strlen(colon);
+        }
+        int index = findSlot(id, idLength, p, colon - p);
+        if (index >= 0) {
+            Slot &slot = _slots[index];
+            slot.value = strtod(colon + 1, nullptr);
+            for (uint16_t r : slot.rules) {
+                if (_rules[r].epoch != _epoch) {
+                    _rules[r].epoch = _epoch;
+                    _pending.push_back(r);
+                }
+            }
+        }
+        p = *end ? end + 1 : end;
+    }
+
+    // Tính sau khi đã cập nhật cả khung: luật đọc nhiều metric cùng khung chỉ chạy một lần, thấy giá trị đồng bộ
+    for (uint16_t r : _pending) {
+        Rule &rule = _rules[r];
+        bool active = truthy(evaluate(rule));
+        if (active == rule.active) continue;
+        const RuleAction &action = active ? rule.then : rule.otherwise;
+        if (!action.id.empty()) {
+            // Còn trong cooldown: giữ trạng thái cũ để sample sau thử lại
+            if (rule.acted && now - rule.lastAction < rule.cooldown) continue;
+            rule.acted = true;
+            rule.lastAction = now;
+            actions.push_back(action);
+        }
+        rule.active = active;
+    }
+    return _pending.size();
+}
+
+RuleEngine::RuleEngine()
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @name load
+ * @brief Nạp bộ luật từ JSON: mảng luật hoặc {"rules": [...]}, mỗi luật như RuleSpec; mảng rỗng để xoá mọi luật
+ *
+ * @param {const char*} json - Định nghĩa bộ luật
+ * @param {std::string&} error - Lý do khi thất bại (bộ luật đang chạy giữ nguyên)
+ *
+ * @return {bool} - true nếu đã thay bộ luật
+ */
+bool RuleEngine::load(const char *json, std::string &error)
+{
+    JsonDocument doc;
+    DeserializationError parse = deserializeJson(doc, json);
+    if (parse) {
+        error = parse.c_str();
+        return false;
+    }
+    JsonArray rules = doc.is<JsonArray>() ? doc.as<JsonArray>() : doc["rules"].as<JsonArray>();
+    if (rules.isNull()) {
+        error = "rules must be an array";
+        return false;
+    }
+    std::vector<RuleSpec> specs;
+    for (JsonObject rule : rules) {
+        RuleSpec spec;
+        spec.name = rule["name"] | "";
+        spec.device = rule["device"] | "";
+        spec.when = rule["when"] | "";
+        spec.then.id = rule["then"]["id"] | "";
+        spec.then.cmd = rule["then"]["cmd"] | "";
+        spec.otherwise.id = rule["else"]["id"] | "";
+        spec.otherwise.cmd = rule["else"]["cmd"] | "";
+        spec.cooldown = rule["cooldown"] | 0;
+        specs.push_back(spec);
+    }
+    return load(specs, error);
+}
+
+bool RuleEngine::load(const std::vector<RuleSpec> &specs, std::string &error)
+{
+    RuleSet rules;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (!rules.add(specs[i], error)) {
+            error = "rule " + (specs[i].name.empty() ? std::to_string(i) : specs[i].name) + ": " + error;
+            DLOGW(rulesLog, "Rules rejected: %s", error.c_str());
+            return false;
+        }
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    rules.carryValues(_rules);
+    std::swap(_rules, rules);
+    xSemaphoreGive(_mutex);
+    DLOGI(rulesLog, "Loaded %u rules", (unsigned)specs.size());
+    return true;
+}
+
+/**
+ * @name ingest
+ * @brief Gọi từ onCollectData() cho mỗi khung DATA; lệnh của luật được gửi sau khi nhả mutex
+ *
+ * @param {const char*} id - ID thiết bị
+ * @param {const char*} data - Dữ liệu key:value,...
+ *
+ * @return None
+ */
+void RuleEngine::ingest(const char *id, const char *data)
+{
+    std::vector<RuleAction> actions;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _evaluations += _rules.ingest(id, data, millis(), actions);
+    _actions += actions.size(); // Mỗi shard gọi từ task riêng: đếm trong mutex
+    xSemaphoreGive(_mutex);
+    for (const RuleAction &action : actions) {
+        DLOGI(rulesLog, "Rule action %s: %s", action.id.c_str(), action.cmd.c_str());
+        if (_actionCallback) {
+            _actionCallback(action.id.c_str(), action.cmd.c_str());
+        }
+    }
+}
+
+void RuleEngine::onAction(std::function<void(const char *id, const char *cmd)> callback)
+{
+    _actionCallback = callback;
+}
+
+size_t RuleEngine::size()
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    size_t size = _rules.size();
+    xSemaphoreGive(_mutex);
+    return size;
+}
@@ -0,0 +1,124 @@
+/*
+  RuleEngine.h - Luật tự động chạy ngay trên gateway theo từng sample, không cần vòng qua cloud.
+*/
+
+#ifndef RULEENGINE_H
+#define RULEENGINE_H
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef RULE_MAX_RULES
+#define RULE_MAX_RULES 64
+#endif
+#define RULE_STACK_DEPTH 16     // Độ sâu ngăn xếp khi tính biểu thức, biểu thức sâu hơn bị từ chối khi biên dịch
+#define RULE_MAX_CODE 256       // Byte bytecode tối đa của một luật
+
+// Lệnh gửi tới thiết bị khi điều kiện đổi trạng thái; id rỗng = không làm gì
+struct RuleAction {
+    std::string id;
+    std::string cmd;
+};
+
+// Một luật dạng đã tách từ JSON:
+//   {"name": "overcurrent", "device": "TBE01", "when": "current > 10 && TBE02.power > 2000",
+//    "then": {"id": "TBE03", "cmd": "relay:0"}, "else": {"id": "TBE03", "cmd": "relay:1"}, "cooldown": 5000}
+// Tên metric không có "<thiết bị>." thuộc về "device". "then" chạy khi điều kiện chuyển sang đúng, "else" khi
+// chuyển sang sai; cooldown (ms) là khoảng tối thiểu giữa hai lần chạy lệnh của cùng luật.
+struct RuleSpec {
+    std::string name;
+    std::string device;
+    std::string when;
+    RuleAction then;
+    RuleAction otherwise;
+    uint32_t cooldown = 0;
+};
+
+/**
+ * @name RuleSet
+ * @brief Bộ luật đã biên dịch: mỗi biểu thức "when" thành bytecode cho máy ngăn xếp, mỗi (thiết bị, metric) mà
+ * luật đọc là một slot giữ giá trị mới nhất. Bảng băm slot -> các luật phụ thuộc để mỗi sample chỉ tính các
+ * luật có đọc metric đó.
+ *
+ * Biểu thức: số, <metric>, <thiết bị>.<metric>, + - * /, < <= > >= == !=, && || !, ngoặc.
+ * Metric chưa có sample nào có giá trị NaN, mọi so sánh với nó là sai.
+ *
+ * Không tự khoá, RuleEngine giữ mutex khi gọi.
+ */
+class RuleSet
+{
+  public:
+    RuleSet();
+    bool add(const RuleSpec &spec, std::string &error);
+    size_t size() const { return _rules.size(); }
+    size_t slots() const { return _slots.size(); }
+    void carryValues(const RuleSet &previous);
+
+    // Cập nhật các slot của một khung DATA rồi tính các luật bị ảnh hưởng, mỗi luật một lần
+    size_t ingest(const char *id, const char *data, uint32_t now, std::vector<RuleAction> &actions);
+
+  private:
+    struct Slot {
+        std::string device;
+        std::string metric;
+        double value;
+        std::vector<uint16_t> rules;
+    };
+    struct Rule {
+        std::string name;
+        uint16_t code;          // Vị trí trong _code
+        uint16_t length;
+        RuleAction then;
+        RuleAction otherwise;
+        uint32_t cooldown;
+        uint32_t lastAction;
+        uint32_t epoch;         // Lần ingest() cuối đã đưa luật vào hàng chờ tính
+        bool active;            // Kết quả lần tính trước
+        bool acted;             // Đã chạy lệnh ít nhất một lần (cooldown chỉ tính từ lần đó)
+    };
+    friend class RuleCompiler;
+
+    int findSlot(const char *device, size_t deviceLength, const char *metric, size_t metricLength) const;
+    int slot(const std::string &device, const std::string &metric);
+    void rehash();
+    double evaluate(const Rule &rule) const;
+    static uint32_t hash(const char *device, size_t deviceLength, const char *metric, size_t metricLength);
+
+    std::vector<Rule> _rules;
+    std::vector<Slot> _slots;
+    std::vector<uint16_t> _index;       // Bảng băm địa chỉ mở -> chỉ số slot, kích thước luỹ thừa của 2
+    std::vector<uint8_t> _code;
+    std::vector<double> _constants;
+    std::vector<uint16_t> _pending;     // Luật chờ tính trong một lần ingest()
+    uint32_t _epoch = 0;
+};
+
+/**
+ * @name RuleEngine
+ * @brief Giữ bộ luật đang chạy, nhận sample từ onCollectData() và đưa lệnh của luật vào hàng đợi lệnh Zigbee
+ * qua callback onAction(). Nạp bộ luật mới (từ attribute MQTT) biên dịch xong mới thay bộ cũ; lỗi thì giữ bộ cũ.
+ */
+class RuleEngine
+{
+  public:
+    RuleEngine();
+    bool load(const char *json, std::string &error);
+    bool load(const std::vector<RuleSpec> &specs, std::string &error);
+    void ingest(const char *id, const char *data);
+    void onAction(std::function<void(const char *id, const char *cmd)> callback);
+
+    size_t size();
+    uint32_t evaluations() const { return _evaluations; }
+    uint32_t actions() const { return _actions; }
+
+  private:
+    SemaphoreHandle_t _mutex;
+    RuleSet _rules;
+    std::function<void(const char *id, const char *cmd)> _actionCallback;
+    uint32_t _evaluations = 0;
+    uint32_t _actions = 0;
+};
+
+#endif
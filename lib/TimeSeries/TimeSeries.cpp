@@ -0,0 +1,424 @@
+#include <TimeSeries.h>
+
+#define BLOCK_NONE 0xFFFF
+#define LEADING_NONE 0xFF   // Block vừa mở, chưa có cửa sổ XOR trước đó
+#define BLOCK_BITS (TIMESERIES_BLOCK_BYTES * 8)
+
+static void putBits(uint8_t *data, uint16_t &used, uint64_t value, uint8_t count)
+{
+    while (count > 0) {
+        uint8_t room = 8 - (used & 7);
+        uint8_t n = count < room ? count : room;
+        uint8_t chunk = (value >> (count - n)) & ((1u << n) - 1);
+        data[used >> 3] |= chunk << (room - n);
+        used += n;
+        count -= n;
+    }
+}
+
+struct BitReader {
+    const uint8_t *data;
+    uint16_t pos;
+
+    uint64_t get(uint8_t count)
+    {
+        uint64_t value = 0;
+        while (count > 0) {
+            uint8_t room = 8 - (pos & 7);
+            uint8_t n = count < room ? count : room;
+            value = (value << n) | ((data[pos >> 3] >> (room - n)) & ((1u << n) - 1));
+            pos += n;
+            count -= n;
+        }
+        return value;
+    }
+};
+
+// Số bit cho delta-of-delta, 0 nếu không vừa 32 bit (mở block mới, timestamp nằm ở header)
+static uint8_t tickCost(int64_t dod)
+{
+    if (dod == 0) return 1;
+    if (dod >= -64 && dod <= 63) return 2 + 7;
+    if (dod >= -256 && dod <= 255) return 3 + 9;
+    if (dod >= -2048 && dod <= 2047) return 4 + 12;
+    if (dod >= INT32_MIN && dod <= INT32_MAX) return 4 + 32;
+    return 0;
+}
+
+static void putTick(uint8_t *data, uint16_t &used, int64_t dod)
+{
+    switch (tickCost(dod)) {
+        case 1:
+            putBits(data, used, 0, 1);
+            break;
+        case 9:
+            putBits(data, used, 0x2, 2);
+            putBits(data, used, dod, 7);
+            break;
+        case 12:
+            putBits(data, used, 0x6, 3);
+            putBits(data, used, dod, 9);
+            break;
+        case 16:
+            putBits(data, used, 0xE, 4);
+            putBits(data, used, dod, 12);
+            break;
+        default:
+            putBits(data, used, 0xF, 4);
+            putBits(data, used, dod, 32);
+            break;
+    }
+}
+
+static int64_t signExtend(uint64_t value, uint8_t bits)
+{
+    return (int64_t)(value << (64 - bits)) >> (64 - bits);
+}
+
+TimeSeries::TimeSeries(size_t bytes, size_t maxSeries)
+{
+    _mutex = xSemaphoreCreateMutex();
+    _blockCount = std::min(bytes / sizeof(Block), (size_t)BLOCK_NONE);
+    _seriesCapacity = maxSeries;
+    _nameCapacity = std::min(maxSeries * 2, (size_t)UINT8_MAX);
+    _blocks = (Block *)calloc(_blockCount, sizeof(Block));
+    _series = (Series *)calloc(_seriesCapacity, sizeof(Series));
+    _names = (char (*)[TIMESERIES_NAME_SIZE])calloc(_nameCapacity, TIMESERIES_NAME_SIZE);
+    if (_blocks == nullptr || _series == nullptr || _names == nullptr) {
+        ESP_LOGE("TimeSeries", "Cannot allocate %u bytes", (unsigned)bytes);
+        _blockCount = _seriesCapacity = _nameCapacity = 0;
+    }
+    for (size_t i = 0; i < _blockCount; ++i) {
+        _blocks[i].next = i + 1 < _blockCount ? i + 1 : BLOCK_NONE;
+    }
+    _free = _blockCount ? 0 : BLOCK_NONE;
+}
+
+TimeSeries::~TimeSeries()
+{
+    free(_blocks);
+    free(_series);
+    free(_names);
+}
+
+/**
+ * @name append
+ * @brief Thêm một mẫu vào chuỗi (device, name), tạo chuỗi nếu chưa có
+ *
+ * @param {const char*} device - ID thiết bị
+ * @param {const char*} name - Tên metric
+ * @param {uint64_t} ts - Thời gian (ms), làm tròn xuống TIMESERIES_TICK_MS
+ * @param {double} value - Giá trị
+ *
+ * @return {bool} - false nếu mẫu cũ hơn mẫu cuối của chuỗi hoặc hết chỗ cho chuỗi mới
+ */
+bool TimeSeries::append(const char *device, const char *name, uint64_t ts, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    int index = findSeries(device, name, true);
+    bool stored = index >= 0 && store(index, ts / TIMESERIES_TICK_MS, bits);
+    if (!stored) {
+        ++_rejected;
+    }
+    xSemaphoreGive(_mutex);
+    return stored;
+}
+
+bool TimeSeries::store(uint16_t index, uint64_t tick, uint64_t bits)
+{
+    Series &series = _series[index];
+    if (series.last != BLOCK_NONE) {
+        Block &block = _blocks[series.last];
+        if (tick < block.last) return false;
+        int64_t delta = tick - block.last;
+        int64_t dod = delta - series.delta;
+        uint8_t cost = tickCost(dod);
+        bool fits = cost > 0;
+
+        uint64_t x = bits ^ series.bits;
+        uint8_t leading = 0;
+        uint8_t trailing = 0;
+        bool window = false;
+        if (x == 0) {
+            cost += 1;
+        } else {
+            leading = std::min(__builtin_clzll(x), 31);
+            trailing = __builtin_ctzll(x);
+            window = series.leading != LEADING_NONE && leading >= series.leading && trailing >= series.trailing;
+            cost += window ? 2 + 64 - series.leading - series.trailing : 2 + 5 + 6 + 64 - leading - trailing;
+        }
+
+        if (fits && block.used + cost <= BLOCK_BITS && block.count < UINT16_MAX) {
+            putTick(block.data, block.used, dod);
+            if (x == 0) {
+                putBits(block.data, block.used, 0, 1);
+            } else if (window) {
+                putBits(block.data, block.used, 0x2, 2);
+                putBits(block.data, block.used, x >> series.trailing, 64 - series.leading - series.trailing);
+            } else {
+                uint8_t meaningful = 64 - leading - trailing;
+                putBits(block.data, block.used, 0x3, 2);
+                putBits(block.data, block.used, leading, 5);
+                putBits(block.data, block.used, meaningful - 1, 6);
+                putBits(block.data, block.used, x >> trailing, meaningful);
+                series.leading = leading;
+                series.trailing = trailing;
+            }
+            block.last = tick;
+            ++block.count;
+            ++series.samples;
+            series.delta = delta;
+            series.bits = bits;
+            return true;
+        }
+    }
+
+    // Block đầy (hoặc delta không vừa 32 bit): mở block mới, mẫu đầu nằm nguyên trong header
+    uint16_t fresh = allocateBlock(index);
+    if (fresh == BLOCK_NONE) return false;
+    Block &block = _blocks[fresh];
+    memset(block.data, 0, sizeof(block.data));
+    block.first = block.last = tick;
+    block.next = BLOCK_NONE;
+    block.count = 1;
+    block.used = 0;
+    putBits(block.data, block.used, bits, 64);
+    if (series.last == BLOCK_NONE) {
+        series.first = fresh;
+    } else {
+        _blocks[series.last].next = fresh;
+    }
+    series.last = fresh;
+    ++series.blocks;
+    ++series.samples;
+    series.delta = 0;
+    series.bits = bits;
+    series.leading = LEADING_NONE;
+    return true;
+}
+
+// Lấy block rảnh, hết thì lấy block cũ nhất của mọi chuỗi (trừ block đang ghi của chính chuỗi cần block)
+uint16_t TimeSeries::allocateBlock(uint16_t owner)
+{
+    if (_free != BLOCK_NONE) {
+        uint16_t index = _free;
+        _free = _blocks[index].next;
+        return index;
+    }
+    size_t victim = _seriesCount;
+    uint64_t oldest = UINT64_MAX;
+    for (size_t i = 0; i < _seriesCount; ++i) {
+        const Series &series = _series[i];
+        if (series.first == BLOCK_NONE || (i == owner && series.first == series.last)) continue;
+        if (_blocks[series.first].first < oldest) {
+            oldest = _blocks[series.first].first;
+            victim = i;
+        }
+    }
+    if (victim == _seriesCount) return BLOCK_NONE;
+
+    Series &series = _series[victim];
+    uint16_t index = series.first;
+    series.first = _blocks[index].next;
+    series.samples -= _blocks[index].count;
+    --series.blocks;
+    if (series.first == BLOCK_NONE) {
+        series.last = BLOCK_NONE;
+    }
+    ++_evicted;
+    return index;
+}
+
+int TimeSeries::intern(const char *text, bool create)
+{
+    for (size_t i = 0; i < _nameCount; ++i) {
+        if (strcmp(_names[i], text) == 0) {
+            return i;
+        }
+    }
+    if (!create || _nameCount >= _nameCapacity || strlen(text) >= TIMESERIES_NAME_SIZE) {
+        return -1;
+    }
+    strcpy(_names[_nameCount], text);
+    return _nameCount++;
+}
+
+int TimeSeries::findSeries(const char *device, const char *name, bool create)
+{
+    int deviceIndex = intern(device, create);
+    int nameIndex = intern(name, create);
+    if (deviceIndex < 0 || nameIndex < 0) return -1;
+    for (size_t i = 0; i < _seriesCount; ++i) {
+        if (_series[i].device == deviceIndex && _series[i].name == nameIndex) {
+            return i;
+        }
+    }
+    if (!create || _seriesCount >= _seriesCapacity) return -1;
+    Series &series = _series[_seriesCount];
+    memset(&series, 0, sizeof(series));
+    series.device = deviceIndex;
+    series.name = nameIndex;
+    series.first = series.last = BLOCK_NONE;
+    return _seriesCount++;
+}
+
+// Giải nén một block, gọi visit(tick, value) cho từng mẫu theo thứ tự thời gian
+template <typename Visit>
+void TimeSeries::decode(const Block &block, Visit visit) const
+{
+    BitReader reader = {block.data, 0};
+    uint64_t tick = block.first;
+    int64_t delta = 0;
+    uint64_t bits = reader.get(64);
+    uint8_t leading = 0;
+    uint8_t meaningful = 0;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    visit(tick, value);
+
+    for (uint16_t i = 1; i < block.count; ++i) {
+        if (reader.get(1)) {
+            if (!reader.get(1)) {
+                delta += signExtend(reader.get(7), 7);
+            } else if (!reader.get(1)) {
+                delta += signExtend(reader.get(9), 9);
+            } else if (!reader.get(1)) {
+                delta += signExtend(reader.get(12), 12);
+            } else {
+                delta += signExtend(reader.get(32), 32);
+            }
+        }
+        tick += delta;
+
+        if (reader.get(1)) {
+            if (reader.get(1)) {
+                leading = reader.get(5);
+                meaningful = reader.get(6) + 1;
+            }
+            bits ^= reader.get(meaningful) << (64 - leading - meaningful);
+            memcpy(&value, &bits, sizeof(value));
+        }
+        visit(tick, value);
+    }
+}
+
+/**
+ * @name query
+ * @brief Đọc các mẫu trong [from, to] của một chuỗi, mẫu gốc hoặc gộp theo khoảng step
+ *
+ * @param {const char*} device - ID thiết bị
+ * @param {const char*} name - Tên metric
+ * @param {uint64_t} from - Đầu khoảng (ms)
+ * @param {uint64_t} to - Cuối khoảng (ms)
+ * @param {uint64_t} step - Độ dài khoảng gộp (ms), 0 = trả mẫu gốc; khoảng gộp tính từ from
+ * @param {std::function<void(const SeriesPoint&)>} visit - Nhận từng điểm theo thứ tự thời gian (đang giữ _mutex)
+ *
+ * @return {size_t} - Số điểm đã trả
+ */
+size_t TimeSeries::query(const char *device, const char *name, uint64_t from, uint64_t to, uint64_t step,
+                         const std::function<void(const SeriesPoint &point)> &visit)
+{
+    size_t points = 0;
+    uint64_t fromTick = (from + TIMESERIES_TICK_MS - 1) / TIMESERIES_TICK_MS;
+    uint64_t toTick = to / TIMESERIES_TICK_MS;
+    SeriesPoint bucket = {0, 0, 0, 0, 0};
+    uint64_t bucketEnd = 0;
+    auto flush = [&]() {
+        if (bucket.count > 0) {
+            bucket.value /= bucket.count;
+            visit(bucket);
+            ++points;
+            bucket.count = 0;
+        }
+    };
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    int index = findSeries(device, name, false);
+    for (uint16_t b = index >= 0 ? _series[index].first : BLOCK_NONE; b != BLOCK_NONE; b = _blocks[b].next) {
+        const Block &block = _blocks[b];
+        if (block.last < fromTick) continue;
+        if (block.first > toTick) break;
+        decode(block, [&](uint64_t tick, double value) {
+            if (tick < fromTick || tick > toTick) return;
+            uint64_t ts = tick * TIMESERIES_TICK_MS;
+            if (step == 0) {
+                SeriesPoint point = {ts, value, value, value, 1};
+                visit(point);
+                ++points;
+                return;
+            }
+            if (bucket.count > 0 && ts >= bucketEnd) {
+                flush();
+            }
+            if (bucket.count == 0) {
+                bucket.ts = from + (ts - from) / step * step;
+                bucketEnd = bucket.ts + step;
+                bucket.value = 0;
+                bucket.min = bucket.max = value;
+            }
+            bucket.value += value;
+            bucket.min = std::min(bucket.min, value);
+            bucket.max = std::max(bucket.max, value);
+            ++bucket.count;
+        });
+    }
+    flush();
+    xSemaphoreGive(_mutex);
+    return points;
+}
+
+void TimeSeries::describe(const Series &series, SeriesInfo &out) const
+{
+    out.device = _names[series.device];
+    out.name = _names[series.name];
+    out.first = series.first != BLOCK_NONE ? _blocks[series.first].first * TIMESERIES_TICK_MS : 0;
+    out.last = series.last != BLOCK_NONE ? _blocks[series.last].last * TIMESERIES_TICK_MS : 0;
+    out.samples = series.samples;
+    out.bytes = series.blocks * sizeof(Block);
+}
+
+bool TimeSeries::info(const char *device, const char *name, SeriesInfo &out)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    int index = findSeries(device, name, false);
+    if (index >= 0) {
+        describe(_series[index], out);
+    }
+    xSemaphoreGive(_mutex);
+    return index >= 0 && out.samples > 0;
+}
+
+void TimeSeries::forEachSeries(const std::function<void(const SeriesInfo &info)> &visit)
+{
+    SeriesInfo info;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < _seriesCount; ++i) {
+        describe(_series[i], info);
+        visit(info);
+    }
+    xSemaphoreGive(_mutex);
+}
+
+uint32_t TimeSeries::samples()
+{
+    uint32_t total = 0;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < _seriesCount; ++i) {
+        total += _series[i].samples;
+    }
+    xSemaphoreGive(_mutex);
+    return total;
+}
+
+size_t TimeSeries::bytesUsed()
+{
+    size_t blocks = 0;
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < _seriesCount; ++i) {
+        blocks += _series[i].blocks;
+    }
+    xSemaphoreGive(_mutex);
+    return blocks * sizeof(Block);
+}
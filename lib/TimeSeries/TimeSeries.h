@@ -0,0 +1,115 @@
+/*
+  TimeSeries.h - Bộ nhớ chuỗi thời gian nén trong RAM cho metric gần đây (delta-of-delta + XOR kiểu Gorilla).
+*/
+
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <Arduino.h>
+#include <functional>
+
+#ifndef TIMESERIES_BYTES
+#define TIMESERIES_BYTES (32 * 1024)    // RAM cho block nén, cấp một lần khi khởi tạo
+#endif
+#ifndef TIMESERIES_MAX_SERIES
+#define TIMESERIES_MAX_SERIES 64
+#endif
+#define TIMESERIES_BLOCK_BYTES 256      // Phần dữ liệu nén của một block
+#ifndef TIMESERIES_NAME_SIZE
+#define TIMESERIES_NAME_SIZE 24         // ID thiết bị / tên metric kể cả '\0', không nhỏ hơn DEVICE_ID_SIZE
+#endif
+#define TIMESERIES_TICK_MS 1000         // Độ phân giải thời gian lưu (timestamp NTP chỉ đúng tới giây)
+#define TIMESERIES_MAX_POINTS 360       // Số điểm tối đa một lần đọc qua HTTP, khoảng dài hơn thì gộp theo bước
+
+// Một điểm trả về từ query(): step = 0 là mẫu gốc (count = 1), ngược lại là một khoảng gộp
+struct SeriesPoint {
+    uint64_t ts;        // ms, đầu khoảng khi gộp
+    double value;       // Trung bình khi gộp
+    double min;
+    double max;
+    uint32_t count;
+};
+
+struct SeriesInfo {
+    const char *device;
+    const char *name;
+    uint64_t first;     // ms, mẫu cũ nhất còn giữ
+    uint64_t last;      // ms, mẫu mới nhất
+    uint32_t samples;
+    size_t bytes;
+};
+
+/**
+ * @name TimeSeries
+ * @brief Mỗi chuỗi (thiết bị, metric) là một dãy block lấy từ vùng nhớ chung, cũ -> mới. Trong block:
+ *   - mẫu đầu: timestamp nằm ở header, giá trị 64 bit nguyên
+ *   - mẫu sau: delta-of-delta timestamp '0' | '10'+7 | '110'+9 | '1110'+12 | '1111'+32 bit,
+ *     giá trị XOR với giá trị trước '0' (bằng nhau) | '10'+bit có nghĩa (cùng cửa sổ) | '11'+5 leading+6 độ dài+bit
+ * Hết block rảnh thì lấy block cũ nhất của mọi chuỗi, nên RAM cố định và chuỗi giữ được dữ liệu gần nhất.
+ *
+ * append() chạy trên task nhận dữ liệu, query() trên task web: mọi hàm công khai đều giữ _mutex.
+ */
+class TimeSeries
+{
+  public:
+    explicit TimeSeries(size_t bytes = TIMESERIES_BYTES, size_t maxSeries = TIMESERIES_MAX_SERIES);
+    ~TimeSeries();
+
+    bool append(const char *device, const char *name, uint64_t ts, double value);
+    size_t query(const char *device, const char *name, uint64_t from, uint64_t to, uint64_t step,
+                 const std::function<void(const SeriesPoint &point)> &visit);
+    bool info(const char *device, const char *name, SeriesInfo &out);
+    void forEachSeries(const std::function<void(const SeriesInfo &info)> &visit);
+
+    uint32_t samples();
+    size_t bytesUsed();
+    size_t capacity() const { return _blockCount * sizeof(Block); }
+    uint32_t evicted() const { return _evicted; }
+    uint32_t rejected() const { return _rejected; }
+
+  private:
+    struct Block {
+        uint64_t first;     // Tick mẫu đầu
+        uint64_t last;      // Tick mẫu cuối
+        uint16_t next;      // Block mới hơn của cùng chuỗi, hoặc block rảnh kế tiếp
+        uint16_t count;
+        uint16_t used;      // Số bit đã ghi
+        uint8_t data[TIMESERIES_BLOCK_BYTES];
+    };
+    struct Series {
+        uint8_t device;     // Chỉ số trong _names
+        uint8_t name;
+        uint16_t first;     // Block cũ nhất, BLOCK_NONE nếu rỗng
+        uint16_t last;      // Block đang ghi
+        uint16_t blocks;
+        uint32_t samples;
+        // Trạng thái bộ mã hoá của block đang ghi
+        int64_t delta;
+        uint64_t bits;
+        uint8_t leading;
+        uint8_t trailing;
+    };
+
+    int intern(const char *text, bool create);
+    int findSeries(const char *device, const char *name, bool create);
+    bool store(uint16_t index, uint64_t tick, uint64_t bits);
+    uint16_t allocateBlock(uint16_t owner);
+    void describe(const Series &series, SeriesInfo &out) const;
+    template <typename Visit>
+    void decode(const Block &block, Visit visit) const;
+
+    SemaphoreHandle_t _mutex;
+    Block *_blocks = nullptr;
+    size_t _blockCount = 0;
+    uint16_t _free;                             // Đầu danh sách block rảnh
+    Series *_series = nullptr;
+    size_t _seriesCapacity = 0;
+    size_t _seriesCount = 0;
+    char (*_names)[TIMESERIES_NAME_SIZE] = nullptr;
+    size_t _nameCapacity = 0;
+    size_t _nameCount = 0;
+    uint32_t _evicted = 0;                      // Block cũ bị lấy lại cho mẫu mới
+    uint32_t _rejected = 0;                     // Mẫu bị bỏ: lùi thời gian, hết chỗ cho chuỗi mới
+};
+
+#endif
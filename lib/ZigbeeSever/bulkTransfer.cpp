@@ -0,0 +1,342 @@
+#include "bulkTransfer.h"
+#include "esp_rom_crc.h"
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void BulkTransfer::appendBase64(std::string &out, const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if (i + 1 < length) chunk |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+        out += base64Alphabet[(chunk >> 18) & 0x3F];
+        out += base64Alphabet[(chunk >> 12) & 0x3F];
+        out += i + 1 < length ? base64Alphabet[(chunk >> 6) & 0x3F] : '=';
+        out += i + 2 < length ? base64Alphabet[chunk & 0x3F] : '=';
+    }
+}
+
+// Trả về số byte ghi vào out, -1 nếu text không phải base64 hợp lệ hoặc dài hơn capacity
+int BulkTransfer::decodeBase64(const char *text, size_t length, uint8_t *out, size_t capacity)
+{
+    if (length % 4 != 0) return -1;
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 4) {
+        uint32_t chunk = 0;
+        int pad = 0;
+        for (size_t j = 0; j < 4; ++j) {
+            const char c = text[i + j];
+            const char *p = c == '=' || c == '\0' ? nullptr : strchr(base64Alphabet, c);
+            if (c == '=' && i + 4 == length && j >= 2) {
+                ++pad;
+            } else if (!p || pad) {
+                return -1;
+            }
+            chunk = (chunk << 6) | (p ? p - base64Alphabet : 0);
+        }
+        if (written + 3 - pad > capacity) return -1;
+        out[written++] = chunk >> 16;
+        if (pad < 2) out[written++] = chunk >> 8;
+        if (pad < 1) out[written++] = chunk;
+    }
+    return written;
+}
+
+static void appendHex(std::string &out, uint32_t value)
+{
+    char hex[9];
+    snprintf(hex, sizeof(hex), "%08X", (unsigned)value);
+    out += hex;
+}
+
+const char *BulkStatus::stateName(BulkState state)
+{
+    switch (state) {
+        case BULK_OPENING: return "opening";
+        case BULK_SENDING: return "sending";
+        case BULK_CLOSING: return "closing";
+        case BULK_DONE: return "done";
+        case BULK_FAILED: return "failed";
+        case BULK_PAUSED: return "paused";
+        default: return "idle";
+    }
+}
+
+BulkTransfer::BulkTransfer(uint16_t blockSize, uint8_t window, uint32_t timeout)
+    : _blockSize(blockSize), _window(window < 1 ? 1 : window > 33 ? 33 : window), _timeout(timeout)
+{
+    _status.id[0] = '\0';
+}
+
+/**
+ * @name start
+ * @brief Bắt đầu truyền một ảnh, chỉ giữ _window block trong RAM
+ *
+ * @param {const char*} id - ID thiết bị nhận
+ * @param {uint32_t} transfer - ID lần truyền (vd: hash phiên bản firmware), thiết bị dùng nó để resume
+ * @param {uint32_t} size - Số byte của ảnh
+ * @param {BulkSource} source - Hàm đọc ảnh từ flash hoặc stream
+ *
+ * @return {bool} - False nếu đang có lần truyền khác (kể cả đang tạm dừng) hoặc tham số không hợp lệ
+ */
+bool BulkTransfer::start(const char *id, uint32_t transfer, uint32_t size, BulkSource source)
+{
+    if (active() || size == 0 || !source || strlen(id) >= DEVICE_ID_SIZE) return false;
+    _status = BulkStatus();
+    snprintf(_status.id, sizeof(_status.id), "%s", id);
+    _status.transfer = transfer;
+    _status.size = size;
+    _status.blocks = (size + _blockSize - 1) / _blockSize;
+    _status.state = BULK_OPENING;
+    _source = source;
+    _buffer.assign((size_t)_window * _blockSize, 0);
+    _slots.assign(_window, Slot());
+    _next = 0;
+    _crc = 0;
+    _controlDue = true;
+    _controlRetries = 0;
+    return true;
+}
+
+// Mở lại kênh sau khi tạm dừng, thiết bị trả lời OPEN bằng block nó cần tiếp theo
+bool BulkTransfer::resume()
+{
+    if (_status.state != BULK_PAUSED) return false;
+    _status.state = BULK_OPENING;
+    _controlDue = true;
+    _controlRetries = 0;
+    return true;
+}
+
+void BulkTransfer::cancel()
+{
+    _status.state = BULK_IDLE;
+    _source = nullptr;
+    std::vector<uint8_t>().swap(_buffer);
+    std::vector<Slot>().swap(_slots);
+}
+
+bool BulkTransfer::active() const
+{
+    return _status.state != BULK_IDLE && _status.state != BULK_DONE && _status.state != BULK_FAILED;
+}
+
+/**
+ * @name handleAck
+ * @brief Xử lý khung BACK của thiết bị (đã kiểm tra CRC)
+ *
+ * @param {const std::string&} message - "ID:<id>,BACK:<tid>:<next>:<mask>[:OK|:ERR],CRC:..."
+ *
+ * @return {bool} - True nếu khung thuộc lần truyền đang chạy
+ */
+bool BulkTransfer::handleAck(const std::string &message)
+{
+    size_t pos = message.find(",BACK:");
+    if (pos == std::string::npos || !active()) return false;
+    if (message.compare(3, pos - 3, _status.id) != 0) return false;
+
+    char *p = nullptr;
+    const char *fields = message.c_str() + pos + 6;
+    uint32_t transfer = strtoul(fields, &p, 16);
+    if (transfer != _status.transfer || *p != ':') return false;
+    uint32_t next = strtoul(p + 1, &p, 10);
+    uint32_t mask = *p == ':' ? strtoul(p + 1, &p, 16) : 0;
+    if (next > _status.blocks) next = _status.blocks;
+
+    switch (_status.state) {
+        case BULK_OPENING:
+            if (!skipTo(next)) {
+                _status.state = BULK_FAILED;
+            } else if (next == _status.blocks) {
+                _status.state = BULK_CLOSING;
+                _controlDue = true;
+                _controlRetries = 0;
+            } else {
+                _status.state = BULK_SENDING;
+            }
+            return true;
+
+        case BULK_SENDING: {
+            for (uint32_t seq = _status.acked; seq < next && seq < _next; ++seq) {
+                acknowledge(seq);
+            }
+            uint32_t highest = next;
+            for (uint8_t i = 0; i < 32 && mask != 0; ++i, mask >>= 1) {
+                if (mask & 1) {
+                    acknowledge(next + 1 + i);
+                    highest = next + 1 + i;
+                }
+            }
+            while (_status.acked < _next && slot(_status.acked).acked) {
+                ++_status.acked;
+            }
+            // Block sau đã tới mà block này chưa: gần như chắc đã mất, gửi lại ngay thay vì chờ hết hạn
+            for (uint32_t seq = _status.acked; seq < highest && seq < _next; ++seq) {
+                Slot &s = slot(seq);
+                if (!s.acked && !s.fast) {
+                    s.fast = true;
+                    s.resend = true;
+                    ++_status.retransmits;
+                }
+            }
+            if (_status.acked == _status.blocks) {
+                _status.state = BULK_CLOSING;
+                _controlDue = true;
+                _controlRetries = 0;
+            }
+            return true;
+        }
+
+        case BULK_CLOSING:
+            if (strncmp(p, ":OK", 3) == 0) {
+                _status.state = BULK_DONE;
+            } else if (strncmp(p, ":ERR", 4) == 0) {
+                _status.state = BULK_FAILED;
+            }
+            return true;
+
+        default:
+            return true;
+    }
+}
+
+/**
+ * @name poll
+ * @brief Gửi khung tới hạn: OPEN/END, block hết hạn ACK, block mới khi cửa sổ còn chỗ
+ *
+ * @param {uint32_t} now - millis()
+ * @param {const Sender&} send - Gửi một khung (chưa có ",CRC:")
+ *
+ * @return {uint32_t} - ms tới hạn chót gần nhất, 0 nếu không còn gì phải chờ
+ */
+uint32_t BulkTransfer::poll(uint32_t now, const Sender &send)
+{
+    switch (_status.state) {
+        case BULK_OPENING:
+        case BULK_CLOSING:
+            if (!_controlDue && now - _controlAt < _timeout) return _timeout - (now - _controlAt);
+            if (!_controlDue && !retry(_controlRetries)) {
+                _status.state = BULK_PAUSED;
+                return 0;
+            }
+            _controlDue = false;
+            if (_status.state == BULK_OPENING) {
+                _controlAt = sendControl("OPEN", _blockSize, send);
+            } else {
+                _controlAt = sendControl("END", _crc, send);
+            }
+            return _timeout;
+
+        case BULK_SENDING: {
+            for (uint32_t seq = _status.acked; seq < _next; ++seq) {
+                Slot &s = slot(seq);
+                if (s.acked) continue;
+                if (s.resend) {
+                    // Gửi lại nhanh, không tính vào số lần retry
+                    s.resend = false;
+                    now = sendBlock(seq, send);
+                    continue;
+                }
+                if (now - s.sentAt < _timeout) continue;
+                if (!retry(s.retries)) {
+                    _status.state = BULK_PAUSED;
+                    return 0;
+                }
+                s.fast = false;
+                now = sendBlock(seq, send);
+            }
+            while (_next < _status.blocks && _next < _status.acked + _window) {
+                if (!readBlock(_next)) {
+                    _status.state = BULK_FAILED;
+                    return 0;
+                }
+                now = sendBlock(_next, send);
+                ++_next;
+            }
+            uint32_t wait = _timeout;
+            for (uint32_t seq = _status.acked; seq < _next; ++seq) {
+                const Slot &s = slot(seq);
+                if (!s.acked && now - s.sentAt < wait) wait = _timeout - (now - s.sentAt);
+            }
+            return wait > 0 ? wait : 1;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+void BulkTransfer::acknowledge(uint32_t seq)
+{
+    if (seq < _status.acked || seq >= _next) return;
+    slot(seq).acked = true;
+}
+
+// Thiết bị đã có [0, next): đọc lướt phần đó để tính tiếp CRC cả ảnh, gửi tiếp từ next
+bool BulkTransfer::skipTo(uint32_t next)
+{
+    _crc = 0;
+    for (uint32_t seq = 0; seq < next; ++seq) {
+        if (!readBlock(seq)) return false;
+    }
+    for (Slot &s : _slots) {
+        s = Slot();
+    }
+    _next = next;
+    _status.acked = next;
+    return true;
+}
+
+bool BulkTransfer::readBlock(uint32_t seq)
+{
+    uint32_t offset = seq * _blockSize;
+    uint16_t length = std::min<uint32_t>(_blockSize, _status.size - offset);
+    if (_source(offset, data(seq), length) != length) return false;
+    _crc = esp_rom_crc32_le(_crc, data(seq), length);
+    Slot &s = slot(seq);
+    s = Slot();
+    s.seq = seq;
+    s.length = length;
+    return true;
+}
+
+uint32_t BulkTransfer::sendBlock(uint32_t seq, const Sender &send)
+{
+    Slot &s = slot(seq);
+    std::string frame;
+    frame.reserve(48 + (_blockSize + 2) / 3 * 4);
+    frame += "ID:";
+    frame += _status.id;
+    frame += ",BLK:";
+    appendHex(frame, _status.transfer);
+    frame += ':';
+    frame += std::to_string(seq);
+    frame += ':';
+    appendHex(frame, esp_rom_crc32_le(0, data(seq), s.length));
+    frame += ':';
+    appendBase64(frame, data(seq), s.length);
+    ++_status.sent;
+    s.sentAt = send(frame);
+    return s.sentAt;
+}
+
+uint32_t BulkTransfer::sendControl(const char *kind, uint32_t value, const Sender &send)
+{
+    std::string frame = std::string("ID:") + _status.id + ",BULK:";
+    appendHex(frame, _status.transfer);
+    frame += std::string(":") + kind + ":" + std::to_string(_status.size) + ":";
+    if (strcmp(kind, "END") == 0) {
+        appendHex(frame, value);
+    } else {
+        frame += std::to_string(value);
+    }
+    return send(frame);
+}
+
+bool BulkTransfer::retry(uint8_t &retries)
+{
+    if (retries >= ZIGBEE_BULK_MAX_RETRIES) return false;
+    ++retries;
+    ++_status.retransmits;
+    return true;
+}
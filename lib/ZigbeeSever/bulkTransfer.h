@@ -0,0 +1,118 @@
+#ifndef BULKTRANSFER_H
+#define BULKTRANSFER_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include "deviceTable.h"
+
+#ifndef ZIGBEE_BULK_BLOCK_SIZE
+#define ZIGBEE_BULK_BLOCK_SIZE 64   // Byte dữ liệu mỗi block, base64 thành 88 ký tự trên một dòng
+#endif
+#ifndef ZIGBEE_BULK_WINDOW
+#define ZIGBEE_BULK_WINDOW 8        // Block đã gửi mà chưa được ACK tối đa, không quá 33 (mask ACK 32 bit)
+#endif
+#ifndef ZIGBEE_BULK_TIMEOUT
+#define ZIGBEE_BULK_TIMEOUT 800     // ms chờ ACK một block (hoặc OPEN/END) trước khi gửi lại
+#endif
+#define ZIGBEE_BULK_MAX_RETRIES 5   // Lần gửi lại một khung trước khi tạm dừng, resume() tiếp tục được
+
+// Đọc length byte tại offset vào buffer, trả về số byte đọc được. Offset luôn tăng dần trong một lần
+// truyền (block đang chờ ACK được giữ trong RAM), chỉ đọc lại từ 0 khi mở lại kênh để resume
+typedef std::function<size_t(uint32_t offset, uint8_t *buffer, size_t length)> BulkSource;
+
+enum BulkState : uint8_t {
+    BULK_IDLE = 0,
+    BULK_OPENING,   // Đã gửi OPEN, chờ thiết bị báo block tiếp theo nó cần
+    BULK_SENDING,
+    BULK_CLOSING,   // Mọi block đã được ACK, chờ thiết bị kiểm tra CRC cả ảnh
+    BULK_DONE,
+    BULK_FAILED,    // Nguồn đọc lỗi hoặc thiết bị báo sai CRC cả ảnh
+    BULK_PAUSED     // Hết retry, giữ trạng thái để resume()
+};
+
+struct BulkStatus {
+    BulkStatus() : transfer(0), size(0), blocks(0), acked(0), sent(0), retransmits(0), state(BULK_IDLE) {}
+    char id[DEVICE_ID_SIZE];
+    uint32_t transfer;
+    uint32_t size;
+    uint32_t blocks;
+    uint32_t acked;         // Block liên tiếp từ đầu thiết bị đã nhận
+    uint32_t sent;          // Khung block đã gửi, kể cả gửi lại
+    uint32_t retransmits;
+    BulkState state;
+
+    static const char *stateName(BulkState state);
+};
+
+/**
+ * @name BulkTransfer
+ * @brief Truyền một ảnh (firmware, cấu hình) lớn tới một thiết bị theo block đánh số, cửa sổ trượt,
+ * gửi lại có chọn lọc và resume sau khi bị ngắt. Không tự gửi hay đo thời gian: poll() nhận millis()
+ * và hàm gửi khung, nên chạy được trên task của ZigbeeServer lẫn trong benchmark với đồng hồ giả.
+ *
+ * Khung (chưa có ",CRC:"):
+ *   -> ID:<id>,BULK:<tid>:OPEN:<size>:<blockSize>
+ *   -> ID:<id>,BLK:<tid>:<seq>:<crc block>:<base64>
+ *   -> ID:<id>,BULK:<tid>:END:<size>:<crc cả ảnh>
+ *   <- ID:<id>,BACK:<tid>:<next>:<mask>[:OK|:ERR]
+ * next là số block liên tiếp từ đầu thiết bị đã nhận (trả lời OPEN bằng chỗ cần tiếp tục), bit i của
+ * mask là block next+1+i đã nhận. tid, CRC và mask là hex, CRC là CRC32 (esp_rom_crc32_le).
+ */
+class BulkTransfer
+{
+  public:
+    // Gửi một khung (chưa có ",CRC:"), trả về millis() lúc gửi xong: ghi UART chặn khi buffer TX đầy
+    // nên hạn chót ACK tính từ lúc khung thực sự rời đi chứ không phải lúc poll() bắt đầu
+    typedef std::function<uint32_t(const std::string &frame)> Sender;
+
+    BulkTransfer(uint16_t blockSize = ZIGBEE_BULK_BLOCK_SIZE, uint8_t window = ZIGBEE_BULK_WINDOW,
+                 uint32_t timeout = ZIGBEE_BULK_TIMEOUT);
+
+    bool start(const char *id, uint32_t transfer, uint32_t size, BulkSource source);
+    bool resume();
+    void cancel();
+    bool active() const;
+    bool handleAck(const std::string &message);
+    uint32_t poll(uint32_t now, const Sender &send);
+    const BulkStatus &status() const { return _status; }
+
+    static void appendBase64(std::string &out, const uint8_t *data, size_t length);
+    static int decodeBase64(const char *text, size_t length, uint8_t *out, size_t capacity);
+
+  private:
+    struct Slot {
+        uint32_t seq;
+        uint32_t sentAt;
+        uint16_t length;
+        uint8_t retries;
+        bool acked;
+        bool fast;      // Đã gửi lại nhanh vì block sau đã tới, lần sau chỉ gửi lại khi hết hạn
+        bool resend;    // Chờ gửi lại nhanh ở lần poll() tới
+    };
+
+    Slot &slot(uint32_t seq) { return _slots[seq % _window]; }
+    uint8_t *data(uint32_t seq) { return &_buffer[(seq % _window) * _blockSize]; }
+    void acknowledge(uint32_t seq);
+    bool skipTo(uint32_t next);
+    bool readBlock(uint32_t seq);
+    uint32_t sendBlock(uint32_t seq, const Sender &send);
+    uint32_t sendControl(const char *kind, uint32_t value, const Sender &send);
+    bool retry(uint8_t &retries);
+
+    uint16_t _blockSize;
+    uint8_t _window;
+    uint32_t _timeout;
+    BulkSource _source;
+    BulkStatus _status;
+    std::vector<uint8_t> _buffer;   // _window block đang chờ ACK
+    std::vector<Slot> _slots;
+    uint32_t _next = 0;             // Block tiếp theo chưa gửi lần nào
+    uint32_t _crc = 0;              // CRC cả ảnh của các block [0, _next)
+    uint32_t _controlAt = 0;        // millis() gửi OPEN/END gần nhất
+    uint8_t _controlRetries = 0;
+    bool _controlDue = false;
+};
+
+#endif // BULKTRANSFER_H
@@ -0,0 +1,145 @@
+#include "dataSchema.h"
+
+/**
+ * @name intern
+ * @brief Tìm hoặc thêm schema
+ *
+ * @param {const char*} spec - Danh sách field, vd: "voltage@1,current@2,power"
+ *
+ * @return {int} - Chỉ số schema, -1 nếu spec không hợp lệ hoặc bảng đầy
+ */
+int SchemaTable::intern(const char *spec)
+{
+    if (!valid(spec)) return -1;
+    for (uint8_t i = 0; i < _size; ++i) {
+        if (strcmp(_specs[i], spec) == 0) return i;
+    }
+    if (_size >= ZIGBEE_MAX_SCHEMAS) return -1;
+    snprintf(_specs[_size], DATA_SCHEMA_SIZE, "%s", spec);
+    return _size++;
+}
+
+const char *SchemaTable::spec(uint8_t index) const
+{
+    return index < _size ? _specs[index] : nullptr;
+}
+
+// Bỏ schema không còn thiết bị nào dùng và đánh lại chỉ số trong hai bảng thiết bị
+void SchemaTable::compact(DeviceTable &devices, DeviceTable &pending)
+{
+    uint8_t remap[ZIGBEE_MAX_SCHEMAS + 1] = {0};
+    DeviceTable *tables[2] = {&devices, &pending};
+    for (DeviceTable *table : tables) {
+        for (const Device &device : *table) {
+            if (device.schema > 0 && device.schema <= _size) remap[device.schema] = 1;
+        }
+    }
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < _size; ++i) {
+        if (!remap[i + 1]) continue;
+        if (kept != i) memcpy(_specs[kept], _specs[i], DATA_SCHEMA_SIZE);
+        remap[i + 1] = ++kept;
+    }
+    _size = kept;
+    for (DeviceTable *table : tables) {
+        for (Device &device : *table) {
+            device.schema = device.schema <= ZIGBEE_MAX_SCHEMAS ? remap[device.schema] : 0;
+        }
+    }
+}
+
+/**
+ * @name valid
+ * @brief Kiểm tra spec: 1..DATA_SCHEMA_MAX_FIELDS field, tên không rỗng, không chứa ':', số chữ số thập phân 0..6
+ *
+ * @param {const char*} spec - Danh sách field
+ *
+ * @return {bool} - True nếu dùng được
+ */
+bool SchemaTable::valid(const char *spec)
+{
+    size_t length = strlen(spec);
+    if (length == 0 || length >= DATA_SCHEMA_SIZE) return false;
+    size_t fields = 0;
+    const char *p = spec;
+    while (true) {
+        const char *name = p;
+        while (*p && *p != ',' && *p != '@' && *p != ':') ++p;
+        if (p == name || *p == ':') return false;
+        if (*p == '@') {
+            ++p;
+            if (*p < '0' || *p > '0' + DATA_SCHEMA_MAX_DECIMALS) return false;
+            ++p;
+        }
+        if (++fields > DATA_SCHEMA_MAX_FIELDS) return false;
+        if (*p == '\0') return true;
+        if (*p != ',') return false;
+        ++p;
+    }
+}
+
+// Số nguyên có dấu -> thập phân có decimals chữ số sau dấu chấm, không đi qua float
+static bool appendFixed(std::string &out, const char *value, size_t length, uint8_t decimals)
+{
+    bool negative = length > 0 && value[0] == '-';
+    if (negative) {
+        ++value;
+        --length;
+    }
+    if (length == 0) return false;
+    for (size_t i = 0; i < length; ++i) {
+        if (value[i] < '0' || value[i] > '9') return false;
+    }
+    if (negative) out += '-';
+    if (length <= decimals) {
+        out += "0.";
+        out.append(decimals - length, '0');
+        out.append(value, length);
+    } else {
+        out.append(value, length - decimals);
+        out += '.';
+        out.append(value + length - decimals, decimals);
+    }
+    return true;
+}
+
+/**
+ * @name expand
+ * @brief Ghép tên field với giá trị theo vị trí thành dạng key:value như khung DATA cũ
+ *
+ * @param {const char*} spec - Schema của thiết bị
+ * @param {const std::string&} values - Phần sau DATA:, vd: "2301,125,288"
+ * @param {std::string&} out - Nhận "voltage:230.1,current:1.25,power:288"
+ *
+ * @return {bool} - False nếu số giá trị khác số field hoặc giá trị fixed-point không phải số nguyên
+ */
+bool SchemaTable::expand(const char *spec, const std::string &values, std::string &out)
+{
+    out.clear();
+    out.reserve(strlen(spec) + values.size() + DATA_SCHEMA_MAX_FIELDS * 2);
+    const char *field = spec;
+    size_t pos = 0;
+    while (true) {
+        const char *nameEnd = field;
+        while (*nameEnd && *nameEnd != ',' && *nameEnd != '@') ++nameEnd;
+        uint8_t decimals = *nameEnd == '@' ? nameEnd[1] - '0' : 0;
+        const char *next = *nameEnd == '@' ? nameEnd + 2 : nameEnd;
+
+        size_t end = values.find(',', pos);
+        if (end == std::string::npos) end = values.size();
+
+        if (!out.empty()) out += ',';
+        out.append(field, nameEnd - field);
+        out += ':';
+        if (decimals == 0) {
+            out.append(values, pos, end - pos);
+        } else if (!appendFixed(out, values.data() + pos, end - pos, decimals)) {
+            return false;
+        }
+        pos = end + 1;
+
+        if (*next == '\0') return end == values.size();
+        if (end == values.size()) return false;
+        field = next + 1;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef DATASCHEMA_H
+#define DATASCHEMA_H
+
+#include <Arduino.h>
+#include <string>
+#include "deviceTable.h"
+
+#define DATA_SCHEMA_SIZE 96         // "voltage@1,current@2,power" kể cả '\0'
+#define DATA_SCHEMA_MAX_FIELDS 16
+#define DATA_SCHEMA_MAX_DECIMALS 6
+#ifndef ZIGBEE_MAX_SCHEMAS
+#define ZIGBEE_MAX_SCHEMAS 8
+#endif
+
+/**
+ * @name SchemaTable
+ * @brief Danh sách field mà thiết bị báo một lần khi tham gia mạng (CMD:schema:<spec>), sau đó khung DATA
+ * chỉ mang giá trị theo vị trí. Thiết bị cùng firmware dùng chung một schema, Device::schema là chỉ số + 1.
+ *
+ * spec: các field cách nhau bởi ',', "name@d" nghĩa là giá trị là số nguyên fixed-point có d chữ số thập phân
+ *   vd: spec "voltage@1,current@2,power" + DATA "2301,125,288" -> "voltage:230.1,current:1.25,power:288"
+ */
+class SchemaTable
+{
+  public:
+    int intern(const char *spec);
+    const char *spec(uint8_t index) const;
+    size_t size() const { return _size; }
+    void clear() { _size = 0; }
+    void compact(DeviceTable &devices, DeviceTable &pending);
+
+    static bool valid(const char *spec);
+    static bool expand(const char *spec, const std::string &values, std::string &out);
+
+  private:
+    char _specs[ZIGBEE_MAX_SCHEMAS][DATA_SCHEMA_SIZE];
+    uint8_t _size = 0;
+};
+
+#endif // DATASCHEMA_H
@@ -0,0 +1,144 @@
+#include "deviceShadow.h"
+
+DeviceShadow::DeviceShadow(size_t capacity) : _capacity(capacity)
+{
+    _entries = (ShadowEntry *)calloc(capacity, sizeof(ShadowEntry));
+    if (_entries == nullptr) {
+        ESP_LOGE("DeviceShadow", "Cannot allocate %u entries", (unsigned)capacity);
+        _capacity = 0;
+    }
+}
+
+DeviceShadow::~DeviceShadow()
+{
+    free(_entries);
+}
+
+ShadowEntry *DeviceShadow::find(const char *id, const char *key)
+{
+    for (size_t i = 0; i < _size; ++i) {
+        if (strcmp(_entries[i].id, id) == 0 && strcmp(_entries[i].key, key) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @name setDesired
+ * @brief Đặt giá trị mong muốn, ghi đè giá trị chưa gửi trước đó
+ *
+ * @param {const char*} id - ID của thiết bị
+ * @param {const char*} key - Thuộc tính (vd: led_status)
+ * @param {const char*} value - Giá trị mong muốn
+ *
+ * @return {bool} - True nếu cần gửi lệnh, False nếu thiết bị đã ở trạng thái đó (hoặc không lưu được)
+ */
+bool DeviceShadow::setDesired(const char *id, const char *key, const char *value)
+{
+    if (strlen(id) >= DEVICE_ID_SIZE || strlen(key) >= SHADOW_KEY_SIZE || strlen(value) >= SHADOW_VALUE_SIZE) {
+        ESP_LOGE("DeviceShadow", "Value too long: %s %s:%s", id, key, value);
+        return false;
+    }
+    ShadowEntry *entry = find(id, key);
+    if (entry == nullptr) {
+        if (_size >= _capacity) {
+            ESP_LOGE("DeviceShadow", "Shadow full (%u)", (unsigned)_capacity);
+            return false;
+        }
+        entry = &_entries[_size++];
+        memset(entry, 0, sizeof(ShadowEntry));
+        strcpy(entry->id, id);
+        strcpy(entry->key, key);
+    } else if (entry->inflight && strcmp(entry->desired, value) == 0) {
+        // Lệnh với đúng giá trị này đang chờ thiết bị báo lại
+        ++_suppressed;
+        return false;
+    }
+    strcpy(entry->desired, value);
+    entry->failed = false;
+    if (!entry->diverged()) {
+        ++_suppressed;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @name setReported
+ * @brief Cập nhật giá trị thiết bị báo về, chỉ với thuộc tính đang có trong shadow
+ *
+ * @return {bool} - True nếu thuộc tính có trong shadow
+ */
+bool DeviceShadow::setReported(const char *id, const char *key, const char *value)
+{
+    ShadowEntry *entry = find(id, key);
+    if (entry == nullptr) return false;
+    snprintf(entry->reported, sizeof(entry->reported), "%s", value);
+    entry->hasReported = true;
+    entry->inflight = false;
+    entry->failed = false;
+    return true;
+}
+
+void DeviceShadow::commandFailed(const char *id, const char *key)
+{
+    ShadowEntry *entry = find(id, key);
+    if (entry == nullptr) return;
+    entry->inflight = false;
+    entry->failed = true;
+}
+
+// Thiết bị kết nối lại có thể đã mất trạng thái: coi như chưa biết giá trị thực tế để đồng bộ lại
+void DeviceShadow::rejoined(const char *id)
+{
+    for (size_t i = 0; i < _size; ++i) {
+        if (strcmp(_entries[i].id, id) == 0) {
+            _entries[i].hasReported = false;
+            _entries[i].inflight = false;
+            _entries[i].failed = false;
+        }
+    }
+}
+
+// Thiết bị liên lạc lại sau khi lệnh thất bại: cho phép gửi lại
+void DeviceShadow::retry(const char *id)
+{
+    for (size_t i = 0; i < _size; ++i) {
+        if (strcmp(_entries[i].id, id) == 0) {
+            _entries[i].failed = false;
+        }
+    }
+}
+
+void DeviceShadow::remove(const char *id)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < _size; ++i) {
+        if (strcmp(_entries[i].id, id) != 0) {
+            if (kept != i) _entries[kept] = _entries[i];
+            ++kept;
+        }
+    }
+    _size = kept;
+}
+
+/**
+ * @name pending
+ * @brief Duyệt các thuộc tính lệch cần gửi lệnh (chưa có lệnh đang chờ và chưa thất bại)
+ *
+ * @param {std::function<void(ShadowEntry&)>} callback - Gọi với từng thuộc tính, callback đặt inflight khi đã gửi
+ *
+ * @return {size_t} - Số thuộc tính cần gửi
+ */
+size_t DeviceShadow::pending(std::function<void(ShadowEntry &entry)> callback)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < _size; ++i) {
+        ShadowEntry &entry = _entries[i];
+        if (entry.inflight || entry.failed || !entry.diverged()) continue;
+        callback(entry);
+        ++count;
+    }
+    return count;
+}
@@ -0,0 +1,61 @@
+#ifndef DEVICESHADOW_H
+#define DEVICESHADOW_H
+
+#include <Arduino.h>
+#include <string>
+#include <functional>
+#include "deviceTable.h"
+
+#define SHADOW_KEY_SIZE 16
+#define SHADOW_VALUE_SIZE 16
+#ifndef ZIGBEE_SHADOW_SIZE
+#define ZIGBEE_SHADOW_SIZE 64
+#endif
+
+// Một thuộc tính của thiết bị (vd: led_status): giá trị mong muốn và giá trị thiết bị đã báo
+struct ShadowEntry {
+    char id[DEVICE_ID_SIZE];
+    char key[SHADOW_KEY_SIZE];
+    char desired[SHADOW_VALUE_SIZE];
+    char reported[SHADOW_VALUE_SIZE];
+    bool hasReported : 1;
+    bool inflight : 1;  // Đã đưa lệnh vào hàng đợi, chờ thiết bị báo lại
+    bool failed : 1;    // Lệnh gần nhất hết retry, chờ thiết bị kết nối lại
+
+    bool diverged() const { return !hasReported || strcmp(desired, reported) != 0; }
+};
+
+/**
+ * @name DeviceShadow
+ * @brief Bảng shadow kích thước cố định, chỉ giữ các thuộc tính đã từng được đặt giá trị mong muốn
+ */
+class DeviceShadow
+{
+  public:
+    explicit DeviceShadow(size_t capacity);
+    ~DeviceShadow();
+    DeviceShadow(const DeviceShadow &) = delete;
+    DeviceShadow &operator=(const DeviceShadow &) = delete;
+
+    bool setDesired(const char *id, const char *key, const char *value);
+    bool setReported(const char *id, const char *key, const char *value);
+    void commandFailed(const char *id, const char *key);
+    void rejoined(const char *id);
+    void retry(const char *id);
+    void remove(const char *id);
+    size_t pending(std::function<void(ShadowEntry &entry)> callback);
+
+    size_t size() const { return _size; }
+    size_t bytes() const { return _capacity * sizeof(ShadowEntry); }
+    uint32_t suppressed() const { return _suppressed; }
+
+  private:
+    ShadowEntry *find(const char *id, const char *key);
+
+    ShadowEntry *_entries;
+    size_t _capacity;
+    size_t _size = 0;
+    uint32_t _suppressed = 0;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "deviceTable.h"
+
+DeviceStatus Device::parseStatus(const std::string &value)
+{
+    if (value == "1" || value == "on" || value == "true") return DEVICE_STATUS_ON;
+    if (value == "0" || value == "off" || value == "false") return DEVICE_STATUS_OFF;
+    return DEVICE_STATUS_UNKNOWN;
+}
+
+const char *Device::statusName(DeviceStatus status)
+{
+    switch (status) {
+        case DEVICE_STATUS_ON: return "on";
+        case DEVICE_STATUS_OFF: return "off";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @name acceptSeq
+ * @brief Cập nhật cửa sổ chống trùng theo SEQ (16 bit, quay vòng) của khung DATA
+ *
+ * @param {uint16_t} value - SEQ trong khung
+ *
+ * @return {SeqVerdict} - SEQ_DUPLICATE và SEQ_STALE là khung phải bỏ
+ */
+SeqVerdict Device::acceptSeq(uint16_t value)
+{
+    int16_t delta = (int16_t)(uint16_t)(value - seq);
+    if (!seqValid || delta <= -DEVICE_SEQ_RESTART) {
+        SeqVerdict verdict = seqValid ? SEQ_RESTART : SEQ_NEW;
+        seqValid = true;
+        seq = value;
+        seqWindow = 1;
+        return verdict;
+    }
+    if (delta > 0) {
+        lost += delta - 1;
+        seqWindow = delta >= DEVICE_SEQ_WINDOW ? 1 : (seqWindow << delta) | 1;
+        seq = value;
+        return SEQ_NEW;
+    }
+    uint16_t age = -delta;
+    if (age >= DEVICE_SEQ_WINDOW) return SEQ_STALE;
+    if (seqWindow & (1u << age)) return SEQ_DUPLICATE;
+    seqWindow |= 1u << age;
+    if (lost > 0) --lost;
+    return SEQ_LATE;
+}
+
+DeviceTable::DeviceTable(size_t capacity) : _capacity(capacity)
+{
+    _records = (Device *)calloc(capacity, sizeof(Device));
+    if (_records == nullptr) {
+        ESP_LOGE("DeviceTable", "Cannot allocate %u devices", (unsigned)capacity);
+        _capacity = 0;
+    }
+}
+
+DeviceTable::~DeviceTable()
+{
+    free(_records);
+}
+
+Device *DeviceTable::find(const char *id)
+{
+    for (size_t i = 0; i < _size; ++i) {
+        if (_records[i].is(id)) {
+            return &_records[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @name add
+ * @brief Thêm thiết bị mới vào cuối bảng
+ *
+ * @param {const char*} id - ID của thiết bị
+ *
+ * @return {Device*} - Bản ghi mới, nullptr nếu bảng đầy hoặc ID quá dài
+ */
+Device *DeviceTable::add(const char *id)
+{
+    size_t length = strlen(id);
+    if (length == 0 || length >= DEVICE_ID_SIZE || _size >= _capacity) {
+        ESP_LOGE("DeviceTable", "Cannot add device %s (%u/%u)", id, (unsigned)_size, (unsigned)_capacity);
+        return nullptr;
+    }
+    Device *device = &_records[_size++];
+    memset(device, 0, sizeof(Device));
+    memcpy(device->id, id, length + 1);
+    return device;
+}
+
+void DeviceTable::erase(Device *device)
+{
+    if (device == nullptr || device < begin() || device >= end()) return;
+    memmove(device, device + 1, (end() - device - 1) * sizeof(Device));
+    --_size;
+}
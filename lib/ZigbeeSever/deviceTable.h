@@ -0,0 +1,90 @@
+#ifndef DEVICETABLE_H
+#define DEVICETABLE_H
+
+#include <Arduino.h>
+#include <string>
+
+#define DEVICE_ID_SIZE 24       // ID dài tối đa 23 ký tự
+#define DEVICE_KEY_SIZE 24
+#ifndef ZIGBEE_MAX_DEVICES
+#define ZIGBEE_MAX_DEVICES 64
+#endif
+#ifndef ZIGBEE_MAX_PENDING
+#define ZIGBEE_MAX_PENDING 16
+#endif
+#define DEVICE_SEQ_WINDOW 32        // Khung DATA tới muộn (đảo thứ tự) trong khoảng này vẫn được nhận, tối đa 32
+#define DEVICE_SEQ_RESTART 1024     // SEQ lùi xa hơn thế là thiết bị đã khởi động lại
+
+enum DeviceStatus : uint8_t {
+    DEVICE_STATUS_UNKNOWN = 0,
+    DEVICE_STATUS_OFF,
+    DEVICE_STATUS_ON
+};
+
+// Kết quả kiểm tra SEQ của một khung DATA
+enum SeqVerdict : uint8_t {
+    SEQ_NEW = 0,    // Mới hơn mọi khung đã nhận, SEQ bị nhảy qua được tính là mất
+    SEQ_LATE,       // Tới muộn nhưng chưa nhận, bù lại một khung đã tính là mất
+    SEQ_RESTART,    // Thiết bị đếm lại từ đầu
+    SEQ_DUPLICATE,  // Đã nhận rồi
+    SEQ_STALE       // Quá cũ so với cửa sổ, không phân biệt được với khung trùng
+};
+
+// Bản ghi cố định, không có con trỏ hay cấp phát riêng
+struct Device {
+    char id[DEVICE_ID_SIZE];
+    char secret_key[DEVICE_KEY_SIZE];
+    uint32_t lastest_t;
+    DeviceStatus status : 2;
+    bool online : 1;
+    bool schemaRequested : 1;   // Đã gửi get_schema, chờ thiết bị báo lại CMD:schema
+    uint8_t schema;             // Chỉ số + 1 trong SchemaTable của server, 0 nếu chưa có
+    bool seqValid : 1;          // Đã nhận khung DATA có SEQ
+    uint16_t seq;               // SEQ lớn nhất đã nhận
+    uint32_t seqWindow;         // Bit i: đã nhận seq - i
+    uint32_t received;          // Khung DATA đã nhận, không tính khung trùng
+    uint32_t lost;              // SEQ bị nhảy qua mà chưa tới
+
+    bool is(const char *other) const { return strcmp(id, other) == 0; }
+    SeqVerdict acceptSeq(uint16_t value);
+    static DeviceStatus parseStatus(const std::string &value);
+    static const char *statusName(DeviceStatus status);
+};
+
+/**
+ * @name DeviceTable
+ * @brief Danh sách thiết bị trong một vùng nhớ cấp phát một lần lúc khởi động, giữ nguyên thứ tự
+ */
+class DeviceTable
+{
+  public:
+    explicit DeviceTable(size_t capacity);
+    ~DeviceTable();
+    DeviceTable(const DeviceTable &) = delete;
+    DeviceTable &operator=(const DeviceTable &) = delete;
+
+    Device *begin() { return _records; }
+    Device *end() { return _records + _size; }
+    const Device *begin() const { return _records; }
+    const Device *end() const { return _records + _size; }
+    Device &operator[](size_t index) { return _records[index]; }
+    const Device &operator[](size_t index) const { return _records[index]; }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    size_t capacity() const { return _capacity; }
+    size_t bytes() const { return _capacity * sizeof(Device); }
+
+    Device *find(const char *id);
+    Device *find(const std::string &id) { return find(id.c_str()); }
+    Device *add(const char *id);
+    void erase(Device *device);
+    void clear() { _size = 0; }
+
+  private:
+    Device *_records;
+    size_t _capacity;
+    size_t _size = 0;
+};
+
+#endif
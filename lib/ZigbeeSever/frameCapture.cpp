@@ -0,0 +1,119 @@
+#include "frameCapture.h"
+
+FrameCapture::FrameCapture()
+{
+    _mutex = xSemaphoreCreateMutex();
+}
+
+FrameCapture::~FrameCapture()
+{
+    end();
+}
+
+bool FrameCapture::begin(size_t bytes)
+{
+    end();
+    uint8_t *buffer = (uint8_t *)malloc(bytes);
+    if (buffer == nullptr) {
+        ESP_LOGE("FrameCapture", "Cannot allocate %u bytes", (unsigned)bytes);
+        return false;
+    }
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _buffer = buffer;
+    _capacity = bytes;
+    _head = _tail = _used = 0;
+    _dropped = 0;
+    xSemaphoreGive(_mutex);
+    return true;
+}
+
+void FrameCapture::end()
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    free(_buffer);
+    _buffer = nullptr;
+    _capacity = 0;
+    xSemaphoreGive(_mutex);
+}
+
+void FrameCapture::record(FrameDirection dir, const char *data, size_t length)
+{
+    if (_buffer == nullptr) return;
+    length = std::min(length, (size_t)UINT16_MAX);
+    size_t total = FRAME_CAPTURE_RECORD_SIZE + length;
+
+    uint32_t t = micros();
+    uint16_t len = length;
+    uint8_t header[FRAME_CAPTURE_RECORD_SIZE];
+    memcpy(header, &t, 4);
+    header[4] = dir;
+    memcpy(header + 5, &len, 2);
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    if (_buffer == nullptr || total > _capacity) {
+        xSemaphoreGive(_mutex);
+        return;
+    }
+    while (_capacity - _used < total) {
+        dropOldest();
+    }
+    put(header, sizeof(header));
+    put((const uint8_t *)data, length);
+    xSemaphoreGive(_mutex);
+}
+
+/**
+ * @name snapshot
+ * @brief Sao chép toàn bộ capture (kèm header) để gửi đi mà không giữ khoá
+ *
+ * @param {std::vector<uint8_t>&} out - Buffer nhận dữ liệu
+ *
+ * @return None
+ */
+void FrameCapture::snapshot(std::vector<uint8_t> &out)
+{
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    uint32_t length = _used;
+    out.resize(FRAME_CAPTURE_HEADER_SIZE + length);
+    memcpy(out.data(), FRAME_CAPTURE_MAGIC, 5);
+    out[5] = FRAME_CAPTURE_VERSION;
+    out[6] = out[7] = 0;
+    memcpy(out.data() + 8, &length, 4);
+    get(_tail, out.data() + FRAME_CAPTURE_HEADER_SIZE, length);
+    xSemaphoreGive(_mutex);
+}
+
+size_t FrameCapture::dump(Print &out)
+{
+    std::vector<uint8_t> data;
+    snapshot(data);
+    return out.write(data.data(), data.size());
+}
+
+void FrameCapture::put(const uint8_t *data, size_t length)
+{
+    size_t first = std::min(length, _capacity - _head);
+    memcpy(_buffer + _head, data, first);
+    memcpy(_buffer, data + first, length - first);
+    _head = (_head + length) % _capacity;
+    _used += length;
+}
+
+void FrameCapture::get(size_t pos, uint8_t *data, size_t length) const
+{
+    size_t first = std::min(length, _capacity - pos);
+    memcpy(data, _buffer + pos, first);
+    memcpy(data + first, _buffer, length - first);
+}
+
+void FrameCapture::dropOldest()
+{
+    uint8_t header[FRAME_CAPTURE_RECORD_SIZE];
+    get(_tail, header, sizeof(header));
+    uint16_t len;
+    memcpy(&len, header + 5, 2);
+    size_t total = FRAME_CAPTURE_RECORD_SIZE + len;
+    _tail = (_tail + total) % _capacity;
+    _used -= total;
+    ++_dropped;
+}
@@ -0,0 +1,52 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Định dạng capture (little-endian):
+//   header  : "ZBCAP" | version (1B) | reserved (2B) | length (4B, số byte bản ghi phía sau)
+//   record  : t_us (4B, micros()) | dir (1B) | len (2B) | len byte khung (không có '\n')
+#define FRAME_CAPTURE_MAGIC "ZBCAP"
+#define FRAME_CAPTURE_VERSION 1
+#define FRAME_CAPTURE_HEADER_SIZE 12
+#define FRAME_CAPTURE_RECORD_SIZE 7
+
+enum FrameDirection : uint8_t {
+    FRAME_RX = 0,
+    FRAME_TX = 1
+};
+
+/**
+ * @name FrameCapture
+ * @brief Vòng đệm nhị phân lưu các khung RX/TX, ghi đè bản ghi cũ nhất khi đầy
+ */
+class FrameCapture
+{
+  public:
+    FrameCapture();
+    ~FrameCapture();
+    bool begin(size_t bytes);
+    void end();
+    bool enabled() const { return _buffer != nullptr; }
+
+    void record(FrameDirection dir, const char *data, size_t length);
+    void snapshot(std::vector<uint8_t> &out);
+    size_t dump(Print &out);
+    uint32_t dropped() const { return _dropped; }
+
+  private:
+    void put(const uint8_t *data, size_t length);
+    void get(size_t pos, uint8_t *data, size_t length) const;
+    void dropOldest();
+
+    SemaphoreHandle_t _mutex;
+    uint8_t *_buffer = nullptr;
+    size_t _capacity = 0;
+    size_t _head = 0;   // Vị trí ghi tiếp theo
+    size_t _tail = 0;   // Bản ghi cũ nhất
+    size_t _used = 0;
+    uint32_t _dropped = 0;
+};
+
+#endif
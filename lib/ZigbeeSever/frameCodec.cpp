@@ -0,0 +1,346 @@
+#include "frameCodec.h"
+#include "bulkTransfer.h"
+#include "esp_rom_crc.h"
+
+static void appendU32(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out += (char)(value >> (8 * i));
+    }
+}
+
+static uint32_t readU32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static bool startsWith(const char *text, const char *prefix)
+{
+    return strncmp(text, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * @name encode
+ * @brief Dịch một khung ASCII (chưa có ",CRC:") sang khung nhị phân, kèm khung BIND nếu ID chưa có chỉ số
+ *
+ * @param {const std::string&} body - vd: "ID:TBE0123456789ZB,SECRECT_KEY:123,CMD:led_status:1"
+ * @param {std::string&} wire - Nhận thêm các byte cần ghi ra UART
+ *
+ * @return {size_t} - Số byte đã thêm vào wire
+ */
+size_t FrameCodec::encode(const std::string &body, std::string &wire)
+{
+    size_t start = wire.size();
+    if (_fresh) {
+        // Peer có thể còn chỉ số từ lần chạy trước
+        bind(FRAME_INDEX_INLINE, "", wire);
+        _fresh = false;
+    }
+
+    std::string payload;
+    payload.reserve(body.size());
+    const char *text = body.c_str();
+    size_t comma = body.find(',');
+
+    if (startsWith(text, "ID:") && comma != std::string::npos && comma - 3 <= 0xFF) {
+        std::string id = body.substr(3, comma - 3);
+        const char *rest = text + comma + 1;
+        const char *key = nullptr;
+        size_t keyLength = 0;
+        unsigned transfer, seq, crc;
+        int header = 0;
+        char *end = nullptr;
+        FrameType type = FRAME_TYPE_TEXT;
+
+        if (startsWith(rest, "CMD:")) {
+            type = FRAME_TYPE_CMD;
+            rest += 4;
+        } else if (startsWith(rest, "DATA:")) {
+            type = FRAME_TYPE_DATA;
+            rest += 5;
+        } else if (startsWith(rest, "BULK:")) {
+            type = FRAME_TYPE_BULK;
+            rest += 5;
+        } else if (startsWith(rest, "BACK:")) {
+            type = FRAME_TYPE_BACK;
+            rest += 5;
+        } else if (startsWith(rest, "SECRECT_KEY:")) {
+            key = rest + 12;
+            const char *cmd = strstr(key, ",CMD:");
+            if (cmd && cmd - key <= 0xFF) {
+                type = FRAME_TYPE_KEYED_CMD;
+                keyLength = cmd - key;
+                rest = cmd + 5;
+            }
+        } else if (startsWith(rest, "SEQ:") && (seq = strtoul(rest + 4, &end, 10)) <= 0xFFFF && end != rest + 4 &&
+                   startsWith(end, ",DATA:")) {
+            type = FRAME_TYPE_DATA_SEQ;
+            rest = end + 6;
+        } else if (startsWith(rest, "BLK:") &&
+                   sscanf(rest + 4, "%x:%u:%x:%n", &transfer, &seq, &crc, &header) == 3 && header > 0) {
+            type = FRAME_TYPE_BLOCK;
+            rest += 4 + header;
+        }
+
+        if (type == FRAME_TYPE_BLOCK) {
+            size_t length = strlen(rest);
+            std::vector<uint8_t> block(length / 4 * 3);
+            int decoded = BulkTransfer::decodeBase64(rest, length, block.data(), block.size());
+            if (decoded < 0) {
+                type = FRAME_TYPE_TEXT;
+            } else {
+                payload += (char)type;
+                appendIndex(payload, id, wire);
+                appendU32(payload, transfer);
+                appendU32(payload, seq);
+                appendU32(payload, crc);
+                payload.append((const char *)block.data(), decoded);
+            }
+        } else if (type != FRAME_TYPE_TEXT) {
+            payload += (char)type;
+            appendIndex(payload, id, wire);
+            if (key) {
+                payload += (char)keyLength;
+                payload.append(key, keyLength);
+            } else if (type == FRAME_TYPE_DATA_SEQ) {
+                payload += (char)(seq & 0xFF);
+                payload += (char)(seq >> 8);
+            }
+            payload += rest;
+        }
+    } else if (startsWith(text, "GROUP:") && comma != std::string::npos && comma - 6 <= 0xFF &&
+               body.compare(comma, 5, ",CMD:") == 0) {
+        payload += (char)FRAME_TYPE_GROUP;
+        payload += (char)(comma - 6);
+        payload.append(body, 6, comma - 6);
+        payload.append(body, comma + 5, std::string::npos);
+    } else if (startsWith(text, "CMD:")) {
+        payload += (char)FRAME_TYPE_BROADCAST;
+        payload.append(body, 4, std::string::npos);
+    }
+
+    if (payload.empty()) {
+        payload += (char)FRAME_TYPE_TEXT;
+        payload += body;
+    }
+    appendFrame(wire, payload);
+    return wire.size() - start;
+}
+
+/**
+ * @name decode
+ * @brief Kiểm tra CRC và dịch khung nhị phân (phần giữa hai byte 0x00) về dạng ASCII chưa có ",CRC:"
+ *
+ * @param {const uint8_t*} data - Byte COBS, không gồm dấu phân cách
+ * @param {size_t} length - Số byte
+ * @param {std::string&} body - Nhận khung ASCII
+ *
+ * @return {bool} - False nếu sai CRC, khung hỏng hoặc chỉ số chưa được BIND (xem takeControl()). Khung
+ * BIND/REBIND được xử lý ngay, trả về true với body rỗng
+ */
+bool FrameCodec::decode(const uint8_t *data, size_t length, std::string &body)
+{
+    _frame.resize(length);
+    size_t size = cobsDecode(data, length, _frame.data());
+    if (size < 5) return false;
+    size -= 4;
+    const uint8_t *frame = _frame.data();
+    if (esp_rom_crc32_le(0, frame, size) != readU32(frame + size)) return false;
+
+    const uint8_t *p = frame + 1;
+    const uint8_t *end = frame + size;
+    std::string id;
+    body.clear();
+    switch (frame[0]) {
+        case FRAME_TYPE_TEXT:
+            break;
+        case FRAME_TYPE_BROADCAST:
+            body = "CMD:";
+            break;
+        case FRAME_TYPE_GROUP:
+            if (p == end || end - p - 1 < *p) return false;
+            body = "GROUP:";
+            body.append((const char *)p + 1, *p);
+            body += ",CMD:";
+            p += 1 + *p;
+            break;
+        case FRAME_TYPE_CMD:
+        case FRAME_TYPE_KEYED_CMD:
+        case FRAME_TYPE_DATA:
+        case FRAME_TYPE_BULK:
+        case FRAME_TYPE_BLOCK:
+        case FRAME_TYPE_BACK:
+        case FRAME_TYPE_DATA_SEQ:
+            if (!readIndex(p, end, id)) return false;
+            body = "ID:" + id;
+            if (frame[0] == FRAME_TYPE_CMD) {
+                body += ",CMD:";
+            } else if (frame[0] == FRAME_TYPE_DATA) {
+                body += ",DATA:";
+            } else if (frame[0] == FRAME_TYPE_BULK) {
+                body += ",BULK:";
+            } else if (frame[0] == FRAME_TYPE_BACK) {
+                body += ",BACK:";
+            } else if (frame[0] == FRAME_TYPE_DATA_SEQ) {
+                if (end - p < 2) return false;
+                body += ",SEQ:" + std::to_string(p[0] | p[1] << 8) + ",DATA:";
+                p += 2;
+            } else if (frame[0] == FRAME_TYPE_KEYED_CMD) {
+                if (p == end || end - p - 1 < *p) return false;
+                body += ",SECRECT_KEY:";
+                body.append((const char *)p + 1, *p);
+                body += ",CMD:";
+                p += 1 + *p;
+            } else {
+                if (end - p < 12) return false;
+                char header[40];
+                snprintf(header, sizeof(header), ",BLK:%08X:%u:%08X:", (unsigned)readU32(p),
+                         (unsigned)readU32(p + 4), (unsigned)readU32(p + 8));
+                body += header;
+                BulkTransfer::appendBase64(body, p + 12, end - p - 12);
+                p = end;
+            }
+            break;
+        case FRAME_TYPE_BIND:
+            if (p == end) return false;
+            if (*p == FRAME_INDEX_INLINE) {
+                _peerIds.clear();
+            } else {
+                if (_peerIds.size() <= *p) _peerIds.resize(*p + 1);
+                _peerIds[*p].assign((const char *)p + 1, end - p - 1);
+            }
+            return true;
+        case FRAME_TYPE_REBIND:
+            _ids.clear();
+            _fresh = true;
+            return true;
+        default:
+            return false;
+    }
+    body.append((const char *)p, end - p);
+    return true;
+}
+
+// Lấy khung REBIND mà decode() cần gửi cho peer
+bool FrameCodec::takeControl(std::string &wire)
+{
+    if (_control.empty()) return false;
+    wire += _control;
+    _control.clear();
+    return true;
+}
+
+// Peer quay về ASCII (vd: khởi động lại với firmware cũ): lần sau nói nhị phân thì cấp chỉ số lại từ đầu
+void FrameCodec::reset()
+{
+    _ids.clear();
+    _peerIds.clear();
+    _control.clear();
+    _fresh = true;
+}
+
+void FrameCodec::appendIndex(std::string &payload, const std::string &id, std::string &wire)
+{
+    auto it = std::find(_ids.begin(), _ids.end(), id);
+    if (it != _ids.end()) {
+        payload += (char)(it - _ids.begin());
+    } else if (_ids.size() <= FRAME_INDEX_MAX) {
+        _ids.push_back(id);
+        bind(_ids.size() - 1, id, wire);
+        payload += (char)(_ids.size() - 1);
+    } else {
+        payload += (char)FRAME_INDEX_INLINE;
+        payload += (char)id.size();
+        payload += id;
+    }
+}
+
+bool FrameCodec::readIndex(const uint8_t *&p, const uint8_t *end, std::string &id)
+{
+    if (p == end) return false;
+    uint8_t index = *p++;
+    if (index == FRAME_INDEX_INLINE) {
+        if (p == end || end - p - 1 < *p) return false;
+        id.assign((const char *)p + 1, *p);
+        p += 1 + *p;
+        return true;
+    }
+    if (index < _peerIds.size() && !_peerIds[index].empty()) {
+        id = _peerIds[index];
+        return true;
+    }
+    // Đã lỡ khung BIND của peer (hoặc mình vừa khởi động lại): yêu cầu peer cấp lại mọi chỉ số
+    if (_control.empty()) {
+        appendFrame(_control, std::string(1, (char)FRAME_TYPE_REBIND));
+    }
+    return false;
+}
+
+void FrameCodec::bind(uint8_t index, const std::string &id, std::string &wire)
+{
+    std::string payload;
+    payload += (char)FRAME_TYPE_BIND;
+    payload += (char)index;
+    payload += id;
+    appendFrame(wire, payload);
+}
+
+// 0x00 | COBS(payload | CRC32) | 0x00
+void FrameCodec::appendFrame(std::string &wire, const std::string &payload)
+{
+    std::string frame = payload;
+    appendU32(frame, esp_rom_crc32_le(0, (const uint8_t *)frame.data(), frame.size()));
+    size_t start = wire.size();
+    wire.resize(start + 2 + frame.size() + frame.size() / 254 + 1);
+    wire[start] = '\0';
+    size_t length = cobsEncode((const uint8_t *)frame.data(), frame.size(), (uint8_t *)&wire[start + 1]);
+    wire.resize(start + 1 + length);
+    wire += '\0';
+}
+
+/**
+ * @name cobsEncode
+ * @brief Consistent Overhead Byte Stuffing: bỏ mọi byte 0, thêm 1 byte mỗi 254 byte
+ *
+ * @param {const uint8_t*} data - Dữ liệu gốc
+ * @param {size_t} length - Số byte
+ * @param {uint8_t*} out - Ít nhất length + length / 254 + 1 byte
+ *
+ * @return {size_t} - Số byte ghi vào out
+ */
+size_t FrameCodec::cobsEncode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t code = 0;
+    size_t written = 1;
+    uint8_t run = 1;
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] != 0) {
+            out[written++] = data[i];
+            ++run;
+        }
+        if (data[i] == 0 || run == 0xFF) {
+            out[code] = run;
+            code = written++;
+            run = 1;
+        }
+    }
+    out[code] = run;
+    return written;
+}
+
+// Trả về số byte giải mã (out cần length byte), 0 nếu dữ liệu không phải COBS hợp lệ
+size_t FrameCodec::cobsDecode(const uint8_t *data, size_t length, uint8_t *out)
+{
+    size_t written = 0;
+    size_t i = 0;
+    while (i < length) {
+        uint8_t code = data[i++];
+        if (code == 0 || (size_t)code - 1 > length - i) return 0;
+        for (uint8_t j = 1; j < code; ++j) {
+            if (data[i] == 0) return 0;
+            out[written++] = data[i++];
+        }
+        if (code < 0xFF && i < length) out[written++] = 0;
+    }
+    return written;
+}
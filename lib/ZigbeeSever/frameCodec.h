@@ -0,0 +1,67 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define FRAME_INDEX_INLINE 0xFF     // Chưa có chỉ số: ID đi kèm ngay sau (1B độ dài + ID)
+#define FRAME_INDEX_MAX 254
+
+// Byte đầu của khung nhị phân, mỗi loại tương ứng một dạng khung ASCII
+enum FrameType : uint8_t {
+    FRAME_TYPE_CMD = 1,         // ID:<id>,CMD:<text>               -> idx | text
+    FRAME_TYPE_KEYED_CMD,       // ID:<id>,SECRECT_KEY:<k>,CMD:<t>  -> idx | len k | k | text
+    FRAME_TYPE_DATA,            // ID:<id>,DATA:<text>              -> idx | text
+    FRAME_TYPE_BROADCAST,       // CMD:<text>                       -> text
+    FRAME_TYPE_GROUP,           // GROUP:<gid>,CMD:<text>           -> len gid | gid | text
+    FRAME_TYPE_BULK,            // ID:<id>,BULK:<text>              -> idx | text
+    FRAME_TYPE_BLOCK,           // ID:<id>,BLK:<tid>:<seq>:<crc>:<base64> -> idx | tid | seq | crc (4B LE) | byte thô
+    FRAME_TYPE_BACK,            // ID:<id>,BACK:<text>              -> idx | text
+    FRAME_TYPE_BIND,            // idx | id: từ nay idx thay cho id; idx FRAME_INDEX_INLINE = quên mọi chỉ số
+    FRAME_TYPE_REBIND,          // Bên nhận không biết một chỉ số: bên gửi cấp lại mọi chỉ số
+    FRAME_TYPE_DATA_SEQ,        // ID:<id>,SEQ:<n>,DATA:<text>      -> idx | n (2B LE) | text
+    FRAME_TYPE_TEXT = 0x7F      // Khung ASCII khác, giữ nguyên
+};
+
+/**
+ * @name FrameCodec
+ * @brief Khung nhị phân dùng song song với giao thức ASCII trên cùng UART:
+ *   0x00 | COBS(type (1B) | thân | CRC32 (4B LE, esp_rom_crc32_le của type + thân)) | 0x00
+ * COBS bỏ mọi byte 0 trong khung nên 0x00 vừa báo bắt đầu khung nhị phân (dòng ASCII không bao giờ có
+ * byte 0) vừa là điểm đồng bộ lại sau nhiễu. Thay tên field và ID chuỗi bằng loại khung và chỉ số thiết bị
+ * một byte, block bulk đi dạng byte thô thay vì base64.
+ *
+ * Mỗi chiều có bảng chỉ số riêng do bên gửi cấp: lần đầu gửi tới một ID, encode() chèn khung BIND trước.
+ * Bên nhận gặp chỉ số chưa BIND (lỡ khung, vừa khởi động lại) thì gửi REBIND, bên gửi cấp lại từ đầu.
+ * Hai phía dùng cùng một lớp, khung REBIND cần gửi lấy ra bằng takeControl().
+ *
+ * Không dùng chung giữa các task: ZigbeeServer chỉ gọi trên task của nó.
+ */
+class FrameCodec
+{
+  public:
+    size_t encode(const std::string &body, std::string &wire);
+    bool decode(const uint8_t *data, size_t length, std::string &body);
+    bool takeControl(std::string &wire);
+    void reset();
+    size_t bound() const { return _ids.size(); }
+
+    static size_t cobsEncode(const uint8_t *data, size_t length, uint8_t *out);
+    static size_t cobsDecode(const uint8_t *data, size_t length, uint8_t *out);
+
+  private:
+    void appendIndex(std::string &payload, const std::string &id, std::string &wire);
+    bool readIndex(const uint8_t *&p, const uint8_t *end, std::string &id);
+    void bind(uint8_t index, const std::string &id, std::string &wire);
+    static void appendFrame(std::string &wire, const std::string &payload);
+
+    std::vector<std::string> _ids;      // Chỉ số mình cấp cho khung gửi đi -> ID
+    std::vector<std::string> _peerIds;  // Chỉ số peer cấp cho khung nhận được -> ID
+    std::string _control;               // Khung REBIND chờ gửi cho peer
+    std::vector<uint8_t> _frame;        // Khung vừa giải COBS
+    bool _fresh = true;                 // Chưa gửi khung nào từ lần reset() hoặc REBIND trước
+};
+
+#endif // FRAMECODEC_H
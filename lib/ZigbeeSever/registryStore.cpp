@@ -0,0 +1,235 @@
+#include <registryStore.h>
+#include "esp_rom_crc.h"
+#include "DeferredLog.h"
+
+DLOG_MODULE(registryLog, "registryStore");
+
+RegistryStore::RegistryStore(const char *ns, const char *key) : _namespace(ns) {
+    snprintf(_slotKeys[0], sizeof(_slotKeys[0]), "%.*s_a", REGISTRY_KEY_SIZE, key);
+    snprintf(_slotKeys[1], sizeof(_slotKeys[1]), "%.*s_b", REGISTRY_KEY_SIZE, key);
+}
+
+// Kích thước snapshot lớn nhất của một bảng có capacity thiết bị
+size_t RegistryStore::maxSize(size_t capacity) {
+    return sizeof(RegistryHeader) + 1 + ZIGBEE_MAX_SCHEMAS * DATA_SCHEMA_SIZE +
+           capacity * (1 + DEVICE_ID_SIZE + 1 + DEVICE_KEY_SIZE + 2);
+}
+
+/**
+ * @name encode
+ * @brief Ghi snapshot (header + bản ghi) vào buffer. Header có sequence = 0, do save() điền
+ *
+ * @param {const DeviceTable&} devices - Danh sách thiết bị
+ * @param {const SchemaTable&} schemas - Schema mà Device::schema trỏ tới
+ * @param {uint8_t*} buffer - Vùng nhớ đích, tối thiểu maxSize(devices.size())
+ * @param {size_t} size - Kích thước buffer
+ *
+ * @return {size_t} - Số byte đã ghi, 0 nếu buffer không đủ
+ */
+size_t RegistryStore::encode(const DeviceTable &devices, const SchemaTable &schemas, uint8_t *buffer, size_t size) {
+    if (size < maxSize(devices.size())) return 0;
+    size_t pos = sizeof(RegistryHeader);
+    buffer[pos++] = schemas.size();
+    for (uint8_t i = 0; i < schemas.size(); ++i) {
+        uint8_t specLen = strlen(schemas.spec(i));
+        buffer[pos++] = specLen;
+        memcpy(buffer + pos, schemas.spec(i), specLen);
+        pos += specLen;
+    }
+    for (const Device &device : devices) {
+        uint8_t idLen = strnlen(device.id, DEVICE_ID_SIZE - 1);
+        uint8_t keyLen = strnlen(device.secret_key, DEVICE_KEY_SIZE - 1);
+        buffer[pos++] = idLen;
+        memcpy(buffer + pos, device.id, idLen);
+        pos += idLen;
+        buffer[pos++] = keyLen;
+        memcpy(buffer + pos, device.secret_key, keyLen);
+        pos += keyLen;
+        buffer[pos++] = device.status;
+        buffer[pos++] = device.schema;
+    }
+    RegistryHeader header = {REGISTRY_STORE_MAGIC, REGISTRY_STORE_VERSION, (uint16_t)devices.size(), 0,
+                             (uint32_t)(pos - sizeof(RegistryHeader)), 0};
+    header.crc = esp_rom_crc32_le(0, buffer + sizeof(header), header.length);
+    memcpy(buffer, &header, sizeof(header));
+    return pos;
+}
+
+/**
+ * @name decode
+ * @brief Nạp snapshot vào bảng thiết bị. Bảng chỉ bị thay khi toàn bộ snapshot hợp lệ
+ *
+ * @param {const uint8_t*} buffer - Snapshot
+ * @param {size_t} length - Số byte
+ * @param {DeviceTable&} devices - Bảng nhận thiết bị, thiết bị vượt capacity bị bỏ
+ * @param {SchemaTable&} schemas - Bảng nhận schema
+ *
+ * @return {bool} - False nếu sai magic, version, độ dài hoặc CRC
+ */
+bool RegistryStore::decode(const uint8_t *buffer, size_t length, DeviceTable &devices, SchemaTable &schemas) {
+    RegistryHeader header;
+    if (length < sizeof(header)) return false;
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != REGISTRY_STORE_MAGIC || header.version < 1 || header.version > REGISTRY_STORE_VERSION ||
+        header.length != length - sizeof(header)) {
+        return false;
+    }
+    if (esp_rom_crc32_le(0, buffer + sizeof(header), header.length) != header.crc) return false;
+
+    // Kiểm tra cấu trúc trước khi động vào bảng
+    bool hasSchemas = header.version >= 2;
+    size_t tail = hasSchemas ? 2 : 1;   // status (+ schema)
+    const uint8_t *end = buffer + length;
+    const uint8_t *p = buffer + sizeof(header);
+    uint8_t schemaCount = 0;
+    if (hasSchemas) {
+        if (p >= end || *p > ZIGBEE_MAX_SCHEMAS) return false;
+        schemaCount = *p++;
+        for (uint8_t i = 0; i < schemaCount; ++i) {
+            if (p >= end || *p >= DATA_SCHEMA_SIZE || end - p < 1 + *p) return false;
+            p += 1 + *p;
+        }
+    }
+    const uint8_t *records = p;
+    for (uint16_t i = 0; i < header.count; ++i) {
+        if (p >= end || *p >= DEVICE_ID_SIZE || end - p < 1 + *p + 1) return false;
+        p += 1 + *p;
+        if (*p >= DEVICE_KEY_SIZE || (size_t)(end - p) < 1 + *p + tail) return false;
+        p += 1 + *p + tail;
+    }
+    if (p != end) return false;
+
+    schemas.clear();
+    p = buffer + sizeof(header) + (hasSchemas ? 1 : 0);
+    char spec[DATA_SCHEMA_SIZE];
+    for (uint8_t i = 0; i < schemaCount; ++i) {
+        memcpy(spec, p + 1, *p);
+        spec[*p] = '\0';
+        p += 1 + *p;
+        if (schemas.intern(spec) != i) {
+            // Spec không hợp lệ hoặc trùng: thiết bị dùng nó sẽ được hỏi lại schema
+            schemas.clear();
+            schemaCount = 0;
+            break;
+        }
+    }
+
+    devices.clear();
+    p = records;
+    char id[DEVICE_ID_SIZE];
+    for (uint16_t i = 0; i < header.count; ++i) {
+        memcpy(id, p + 1, *p);
+        id[*p] = '\0';
+        p += 1 + *p;
+        Device *device = devices.add(id);
+        if (device != nullptr) {
+            memcpy(device->secret_key, p + 1, *p);
+            device->secret_key[*p] = '\0';
+            device->status = (DeviceStatus)(p[1 + *p] & 0x03);
+            device->schema = hasSchemas && p[2 + *p] <= schemaCount ? p[2 + *p] : 0;
+            device->online = false;
+            device->lastest_t = 0;
+        }
+        p += 1 + *p + tail;
+    }
+    return true;
+}
+
+bool RegistryStore::loadSlot(uint8_t slot, std::vector<uint8_t> &buffer, uint32_t &sequence) {
+    if (!_preferences.begin(_namespace, true)) return false;
+    size_t length = _preferences.getBytesLength(_slotKeys[slot]);
+    bool ok = length >= sizeof(RegistryHeader);
+    if (ok) {
+        buffer.resize(length);
+        ok = _preferences.getBytes(_slotKeys[slot], buffer.data(), length) == length;
+    }
+    _preferences.end();
+    if (!ok) return false;
+    RegistryHeader header;
+    memcpy(&header, buffer.data(), sizeof(header));
+    sequence = header.sequence;
+    return true;
+}
+
+/**
+ * @name load
+ * @brief Nạp snapshot hợp lệ mới nhất trong hai slot, dùng lúc khởi động trước khi task Zigbee chạy
+ *
+ * @param {DeviceTable&} devices - Bảng nhận thiết bị
+ * @param {SchemaTable&} schemas - Bảng nhận schema DATA
+ *
+ * @return {bool} - True nếu có snapshot hợp lệ
+ */
+bool RegistryStore::load(DeviceTable &devices, SchemaTable &schemas) {
+    std::vector<uint8_t> slots[2];
+    uint32_t sequences[2] = {0, 0};
+    bool valid[2];
+    for (uint8_t slot = 0; slot < 2; ++slot) {
+        valid[slot] = loadSlot(slot, slots[slot], sequences[slot]);
+    }
+    // Slot mới hơn trước, hỏng thì quay về slot còn lại
+    uint8_t order[2] = {0, 1};
+    if (valid[1] && (!valid[0] || (int32_t)(sequences[1] - sequences[0]) > 0)) {
+        order[0] = 1;
+        order[1] = 0;
+    }
+    for (uint8_t slot : order) {
+        if (!valid[slot]) continue;
+        if (!decode(slots[slot].data(), slots[slot].size(), devices, schemas)) {
+            DLOGE(registryLog, "Slot %s is corrupt", _slotKeys[slot]);
+            continue;
+        }
+        RegistryHeader header;
+        memcpy(&header, slots[slot].data(), sizeof(header));
+        _sequence = header.sequence;
+        _savedCrc = header.crc;
+        _activeSlot = slot;
+        DLOGI(registryLog, "Loaded %u devices from %s, sequence %u", (unsigned)devices.size(), _slotKeys[slot], (unsigned)_sequence);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @name save
+ * @brief Ghi snapshot vào slot không hoạt động trong một lần ghi, bỏ qua nếu nội dung không đổi
+ *
+ * @param {const DeviceTable&} devices - Danh sách thiết bị
+ * @param {const SchemaTable&} schemas - Schema DATA của các thiết bị
+ *
+ * @return {bool} - False nếu ghi flash lỗi
+ */
+bool RegistryStore::save(const DeviceTable &devices, const SchemaTable &schemas) {
+    std::vector<uint8_t> buffer(maxSize(devices.size()));
+    size_t length = encode(devices, schemas, buffer.data(), buffer.size());
+    RegistryHeader header;
+    memcpy(&header, buffer.data(), sizeof(header));
+    if (_sequence != 0 && header.crc == _savedCrc) return true;
+
+    header.sequence = _sequence + 1;
+    memcpy(buffer.data(), &header, sizeof(header));
+    uint8_t slot = _activeSlot ^ 1;
+    bool ok = _preferences.begin(_namespace, false);
+    if (ok) {
+        ok = _preferences.putBytes(_slotKeys[slot], buffer.data(), length) == length;
+        _preferences.end();
+    }
+    if (!ok) {
+        DLOGE(registryLog, "Write %s failed", _slotKeys[slot]);
+        return false;
+    }
+    _sequence = header.sequence;
+    _savedCrc = header.crc;
+    _activeSlot = slot;
+    ++_writes;
+    DLOGI(registryLog, "Saved %u devices (%u B) to %s", (unsigned)devices.size(), (unsigned)length, _slotKeys[slot]);
+    return true;
+}
+
+uint32_t RegistryStore::sequence() const {
+    return _sequence;
+}
+
+uint32_t RegistryStore::writes() const {
+    return _writes;
+}
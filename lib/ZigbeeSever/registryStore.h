@@ -0,0 +1,57 @@
+#ifndef REGISTRYSTORE_H
+#define REGISTRYSTORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <vector>
+#include "deviceTable.h"
+#include "dataSchema.h"
+
+#define REGISTRY_STORE_MAGIC 0x47455250 // "PREG"
+#define REGISTRY_STORE_VERSION 2
+#define REGISTRY_KEY_SIZE 12            // Tiền tố key NVS, cộng "_a"/"_b" vẫn dưới 15 ký tự
+
+// Định dạng snapshot (little-endian): RegistryHeader, bảng schema rồi count bản ghi
+//   schemaCount (1B) | schemaCount x (specLen (1B) | spec)
+//   idLen (1B) | id | keyLen (1B) | secret_key | status (1B) | schema (1B, chỉ số + 1, 0 = chưa có)
+// Bản version 1 (không có bảng schema và byte schema) vẫn nạp được
+// online và lastest_t không được lưu: sau khi khởi động thiết bị coi như chưa kết nối
+struct RegistryHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t sequence;
+    uint32_t length;    // Số byte bản ghi sau header
+    uint32_t crc;       // CRC32 của phần bản ghi, cũng dùng để bỏ qua lần ghi không đổi gì
+};
+
+/**
+ * @name RegistryStore
+ * @brief Lưu danh sách thiết bị đã cấp phép (ID, khoá, trạng thái cuối, schema DATA) vào NVS theo hai slot A/B như ConfigStore
+ */
+class RegistryStore
+{
+  public:
+    RegistryStore(const char *ns, const char *key);
+    bool load(DeviceTable &devices, SchemaTable &schemas);
+    bool save(const DeviceTable &devices, const SchemaTable &schemas);
+    uint32_t sequence() const;
+    uint32_t writes() const;
+
+    static size_t maxSize(size_t capacity);
+    static size_t encode(const DeviceTable &devices, const SchemaTable &schemas, uint8_t *buffer, size_t size);
+    static bool decode(const uint8_t *buffer, size_t length, DeviceTable &devices, SchemaTable &schemas);
+
+  private:
+    bool loadSlot(uint8_t slot, std::vector<uint8_t> &buffer, uint32_t &sequence);
+
+    const char *_namespace;
+    char _slotKeys[2][REGISTRY_KEY_SIZE + 3];
+    Preferences _preferences;
+    uint32_t _sequence = 0;
+    uint32_t _savedCrc = 0;     // CRC bản ghi lần ghi cuối, bỏ qua lần ghi không đổi gì
+    uint32_t _writes = 0;
+    uint8_t _activeSlot = 1;
+};
+
+#endif // REGISTRYSTORE_H
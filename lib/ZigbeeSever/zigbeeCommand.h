@@ -0,0 +1,39 @@
+#ifndef ZIGBEECOMMAND_H
+#define ZIGBEECOMMAND_H
+
+#include <stdint.h>
+#include <string>
+#include <functional>
+
+// FNV-1a 32 bit, constexpr đệ quy (hợp lệ từ C++11): dùng làm nhãn case của bảng lệnh lúc biên dịch
+// và băm tên lệnh nhận được lúc chạy (đệ quy đuôi, trình biên dịch chuyển thành vòng lặp)
+constexpr uint32_t commandHash(const char *name, uint32_t hash = 2166136261u) {
+    return *name ? commandHash(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+// Khung CMD đã tách: "ID:<id>,CMD:<name>[:<args>][,...],CRC:<crc>"
+//   vd: "led_status:1" -> name "led_status", args "1"; "reset_data,DATA:..." -> name "reset_data", args ""
+struct CommandFrame {
+    std::string id;
+    std::string command;    // Toàn bộ phần sau CMD:, như messageCallback nhận
+    std::string name;       // Tới ':' hoặc ',' đầu tiên
+    std::string args;       // Phần sau ':' đầu tiên nếu tên kết thúc bằng ':'
+    uint32_t hash;          // commandHash(name)
+    const std::string& message; // Khung gốc, chỉ hợp lệ trong lúc handler chạy
+
+    explicit CommandFrame(const std::string& frame) : message(frame) {
+        size_t cmd = frame.find("CMD:");
+        id = frame.substr(3, frame.find(",") - frame.find("ID:") - 3);
+        command = frame.substr(cmd + 4, frame.find(",CRC:") - cmd - 4);
+        size_t end = command.find_first_of(":,");
+        name = command.substr(0, end);
+        if (end != std::string::npos && command[end] == ':') {
+            args = command.substr(end + 1);
+        }
+        hash = commandHash(name.c_str());
+    }
+};
+
+typedef std::function<void(const CommandFrame& frame)> CommandHandler;
+
+#endif // ZIGBEECOMMAND_H
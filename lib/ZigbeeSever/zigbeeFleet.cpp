@@ -0,0 +1,485 @@
+#include <zigbeeFleet.h>
+#include <algorithm>
+#include "DeferredLog.h"
+
+DLOG_MODULE(fleetLog, "zigbeeFleet");
+
+ZigbeeFleet::ZigbeeFleet() {
+    _mutex = xSemaphoreCreateMutex();
+    _callbackMutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @name addShard
+ * @brief Thêm một ZigbeeServer vào fleet, phải gọi trước begin(). Callback của shard do fleet đăng ký lại
+ *
+ * @param {ZigbeeServer&} server - Server của một coordinator, sống suốt chương trình
+ *
+ * @return {bool} - False nếu đã đủ ZIGBEE_MAX_SHARDS shard
+ */
+bool ZigbeeFleet::addShard(ZigbeeServer& server) {
+    if (_shardCount >= ZIGBEE_MAX_SHARDS) return false;
+    size_t index = _shardCount++;
+    _shards[index] = &server;
+
+    server.onMessage([this](const char *id, const char *data) {
+        if (!messageCallback || xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+        messageCallback(id, data);
+        xSemaphoreGive(_callbackMutex);
+    });
+    server.onChange([this, index]() {
+        claim(index);
+        if (!onChangeCallback || xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+        onChangeCallback();
+        xSemaphoreGive(_callbackMutex);
+    });
+    server.onDeviceStatus([this](const char *id, bool online) {
+        if (!deviceStatusCallback || xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+        deviceStatusCallback(id, online);
+        xSemaphoreGive(_callbackMutex);
+    });
+    server.updatePendingList([this]() {
+        if (!updateCallback || xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+        updateCallback();
+        xSemaphoreGive(_callbackMutex);
+    });
+    server.onGroupResult([this, index](const GroupResult& result) {
+        mergeGroupResult(index, result);
+    });
+    server.onBulkResult([this](const BulkStatus& status) {
+        if (!bulkResultCallback || xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+        bulkResultCallback(status);
+        xSemaphoreGive(_callbackMutex);
+    });
+    return true;
+}
+
+void ZigbeeFleet::begin() {
+    for (size_t i = 0; i < _shardCount; ++i) {
+        _shards[i]->begin();
+    }
+    // Thiết bị nạp từ flash thuộc shard đã lưu chúng, để lệnh được định tuyến trước khi cloud cấp phép lại
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        for (size_t i = 0; i < _shardCount; ++i) {
+            _shards[i]->forEachDevice([this, i](const Device& device, bool pending) {
+                if (pending || _owner.count(device.id)) return;
+                _owner[device.id] = i;
+                _desired.push_back(device.id);
+            });
+        }
+        xSemaphoreGive(_mutex);
+    }
+    DLOGI(fleetLog, "Started %u shards, %u known devices", (unsigned)_shardCount, (unsigned)_owner.size());
+}
+
+size_t ZigbeeFleet::shardCount() const {
+    return _shardCount;
+}
+
+ZigbeeServer& ZigbeeFleet::shard(size_t index) {
+    return *_shards[index];
+}
+
+// Shard sở hữu thiết bị, -1 nếu chưa biết. Chỉ có một shard thì mọi ID thuộc shard 0
+int ZigbeeFleet::ownerOf(const char *id) {
+    if (_shardCount == 1) return 0;
+    int owner = -1;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        auto it = _owner.find(id);
+        if (it != _owner.end()) {
+            owner = it->second;
+        }
+        xSemaphoreGive(_mutex);
+    }
+    return owner;
+}
+
+ZigbeeServer* ZigbeeFleet::route(const char *id) {
+    int owner = ownerOf(id);
+    if (owner < 0) {
+        DLOGW(fleetLog, "No shard owns %s", id);
+        return nullptr;
+    }
+    return _shards[owner];
+}
+
+/**
+ * @name provisionDevices
+ * @brief Danh sách thiết bị cloud cấp phép cho cả fleet. Mỗi shard chỉ nhận các ID nó sở hữu,
+ *        ID chưa rõ shard được giao khi thiết bị xuất hiện trong danh sách chờ của một shard
+ *
+ * @param {const std::vector<std::string>&} ids - ID các thiết bị được cấp phép
+ *
+ * @return None
+ */
+void ZigbeeFleet::provisionDevices(const std::vector<std::string>& ids) {
+    size_t unassigned = 0;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return;
+    _desired = ids;
+    for (auto it = _owner.begin(); it != _owner.end();) {
+        if (std::find(_desired.begin(), _desired.end(), it->first) == _desired.end()) {
+            it = _owner.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const std::string& id : _desired) {
+        if (_shardCount == 1) {
+            _owner[id] = 0;
+        } else if (!_owner.count(id)) {
+            ++unassigned;
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    for (size_t i = 0; i < _shardCount; ++i) {
+        provisionShard(i);
+    }
+    DLOGI(fleetLog, "Provisioned %u devices, %u waiting for a shard", (unsigned)ids.size(), (unsigned)unassigned);
+}
+
+void ZigbeeFleet::provisionShard(size_t index) {
+    std::vector<std::string> ids;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return;
+    for (const std::string& id : _desired) {
+        auto it = _owner.find(id);
+        if (it != _owner.end() && it->second == index) {
+            ids.push_back(id);
+        }
+    }
+    xSemaphoreGive(_mutex);
+    _shards[index]->provisionDevices(ids);
+}
+
+// Chạy trên task của shard: thiết bị được cấp phép đang chờ ở shard này thì thuộc về shard này
+void ZigbeeFleet::claim(size_t index) {
+    if (_shardCount < 2) return;
+    ZigbeeServer& server = *_shards[index];
+    std::vector<std::string> claimed;
+    std::vector<std::pair<std::string, std::vector<std::string>>> regroup;
+    uint8_t reprovision = 0;
+
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return;
+    for (const Device& device : server.pendingDeviceList) {
+        if (std::find(_desired.begin(), _desired.end(), device.id) == _desired.end()) continue;
+        auto it = _owner.find(device.id);
+        if (it != _owner.end()) {
+            if (it->second == index) continue;
+            // Thiết bị đã chuyển sang coordinator khác
+            reprovision |= 1 << it->second;
+        }
+        _owner[device.id] = index;
+        reprovision |= 1 << index;
+        claimed.push_back(device.id);
+    }
+    for (const auto& group : _groups) {
+        for (const std::string& id : claimed) {
+            if (std::find(group.second.begin(), group.second.end(), id) != group.second.end()) {
+                regroup.push_back(group);
+                break;
+            }
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    if (claimed.empty()) return;
+    DLOGI(fleetLog, "%s claimed %u devices", server.name(), (unsigned)claimed.size());
+    for (size_t i = 0; i < _shardCount; ++i) {
+        if (reprovision & (1 << i)) {
+            provisionShard(i);
+        }
+    }
+    for (const auto& group : regroup) {
+        applyGroup(group.first, group.second);
+    }
+}
+
+bool ZigbeeFleet::sendCommand(const char *id, const char *cmd) {
+    ZigbeeServer *server = route(id);
+    if (server == nullptr) return false;
+    server->sendCommand(id, cmd);
+    return true;
+}
+
+// Mỗi shard một lần truyền bulk, thiết bị ở shard khác nhau nhận song song
+bool ZigbeeFleet::sendBulk(const char *id, uint32_t transfer, uint32_t size, BulkSource source) {
+    ZigbeeServer *server = route(id);
+    return server != nullptr && server->sendBulk(id, transfer, size, source);
+}
+
+bool ZigbeeFleet::resumeBulk(const char *id) {
+    ZigbeeServer *server = route(id);
+    return server != nullptr && server->resumeBulk();
+}
+
+bool ZigbeeFleet::checkDevice(const char *id) {
+    ZigbeeServer *server = route(id);
+    if (server == nullptr) return false;
+    server->checkDevice(id);
+    return true;
+}
+
+bool ZigbeeFleet::setDesired(const char *id, const char *key, const char *value) {
+    ZigbeeServer *server = route(id);
+    return server != nullptr && server->setDesired(id, key, value);
+}
+
+void ZigbeeFleet::broadcastMessage() {
+    for (size_t i = 0; i < _shardCount; ++i) {
+        _shards[i]->broadcastMessage();
+    }
+}
+
+/**
+ * @name defineGroup
+ * @brief Tạo hoặc thay nhóm trên cả fleet, mỗi shard giữ phần thành viên của mình
+ *
+ * @param {const char*} gid - ID nhóm
+ * @param {const std::vector<std::string>&} members - ID các thiết bị trong nhóm, có thể thuộc nhiều shard
+ *
+ * @return {bool} - False nếu ID nhóm không hợp lệ hoặc đã đủ ZIGBEE_MAX_GROUPS nhóm
+ */
+bool ZigbeeFleet::defineGroup(const char *gid, const std::vector<std::string>& members) {
+    std::string group(gid);
+    if (group.empty() || group.find_first_of(",:\n") != std::string::npos) return false;
+
+    std::vector<std::string> current;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return false;
+    if (!_groups.count(group) && _groups.size() >= ZIGBEE_MAX_GROUPS) {
+        xSemaphoreGive(_mutex);
+        return false;
+    }
+    for (const std::string& id : members) {
+        if (id.empty() || std::find(current.begin(), current.end(), id) != current.end()) continue;
+        current.push_back(id);
+    }
+    _groups[group] = current;
+    xSemaphoreGive(_mutex);
+
+    applyGroup(group, current);
+    return true;
+}
+
+// Chia thành viên theo shard; thành viên chưa rõ shard được thêm khi shard nhận thiết bị
+void ZigbeeFleet::applyGroup(const std::string& gid, const std::vector<std::string>& members) {
+    std::vector<std::string> split[ZIGBEE_MAX_SHARDS];
+    for (const std::string& id : members) {
+        int owner = ownerOf(id.c_str());
+        if (owner >= 0) {
+            split[owner].push_back(id);
+        }
+    }
+    for (size_t i = 0; i < _shardCount; ++i) {
+        if (!split[i].empty()) {
+            _shards[i]->defineGroup(gid.c_str(), split[i]);
+        } else {
+            _shards[i]->removeGroup(gid.c_str());
+        }
+    }
+}
+
+bool ZigbeeFleet::removeGroup(const char *gid) {
+    bool removed = false;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return false;
+    removed = _groups.erase(gid) > 0;
+    xSemaphoreGive(_mutex);
+
+    for (size_t i = 0; i < _shardCount; ++i) {
+        _shards[i]->removeGroup(gid);
+    }
+    return removed;
+}
+
+std::map<std::string, std::vector<std::string>> ZigbeeFleet::groups() {
+    std::map<std::string, std::vector<std::string>> copy;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) == pdTRUE) {
+        copy = _groups;
+        xSemaphoreGive(_mutex);
+    }
+    return copy;
+}
+
+/**
+ * @name sendGroupCommand
+ * @brief Gửi lệnh nhóm tới mọi shard có thành viên (mỗi shard một khung GROUP),
+ *        onGroupResult nhận một kết quả gộp khi tất cả shard đã báo
+ *
+ * @param {const char*} gid - ID nhóm
+ * @param {const char*} cmd - Lệnh
+ *
+ * @return {bool} - False nếu nhóm không tồn tại hoặc rỗng
+ */
+bool ZigbeeFleet::sendGroupCommand(const char *gid, const char *cmd) {
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return false;
+    auto it = _groups.find(gid);
+    if (it == _groups.end() || it->second.empty()) {
+        xSemaphoreGive(_mutex);
+        return false;
+    }
+    FleetGroupTransaction transaction;
+    transaction.result.group = gid;
+    transaction.result.command = cmd;
+    transaction.waiting = 0;
+    std::vector<std::string> split[ZIGBEE_MAX_SHARDS];
+    for (const std::string& id : it->second) {
+        auto owner = _owner.find(id);
+        if (_shardCount == 1) {
+            split[0].push_back(id);
+        } else if (owner != _owner.end()) {
+            split[owner->second].push_back(id);
+        } else {
+            transaction.result.missing.push_back(id);
+        }
+    }
+    // Giữ khoá khi gửi để thứ tự giao dịch của fleet khớp thứ tự giao dịch trên từng shard
+    for (size_t i = 0; i < _shardCount; ++i) {
+        if (split[i].empty()) continue;
+        if (_shards[i]->sendGroupCommand(gid, cmd)) {
+            transaction.waiting |= 1 << i;
+        } else {
+            transaction.result.missing.insert(transaction.result.missing.end(), split[i].begin(), split[i].end());
+        }
+    }
+    bool done = transaction.waiting == 0;
+    if (!done) {
+        _groupTransactions.push_back(transaction);
+    }
+    xSemaphoreGive(_mutex);
+
+    if (done && groupResultCallback && xSemaphoreTake(_callbackMutex, portMAX_DELAY) == pdTRUE) {
+        groupResultCallback(transaction.result);
+        xSemaphoreGive(_callbackMutex);
+    }
+    return true;
+}
+
+void ZigbeeFleet::mergeGroupResult(size_t index, const GroupResult& result) {
+    uint8_t bit = 1 << index;
+    bool found = false;
+    GroupResult merged;
+    if (xSemaphoreTake(_mutex, portMAX_DELAY) != pdTRUE) return;
+    for (auto it = _groupTransactions.begin(); it != _groupTransactions.end(); ++it) {
+        if (!(it->waiting & bit) || it->result.group != result.group || it->result.command != result.command) continue;
+        GroupResult& target = it->result;
+        target.confirmed.insert(target.confirmed.end(), result.confirmed.begin(), result.confirmed.end());
+        target.missing.insert(target.missing.end(), result.missing.begin(), result.missing.end());
+        it->waiting &= ~bit;
+        if (it->waiting == 0) {
+            merged = std::move(target);
+            found = true;
+            _groupTransactions.erase(it);
+        }
+        break;
+    }
+    xSemaphoreGive(_mutex);
+
+    if (found && groupResultCallback && xSemaphoreTake(_callbackMutex, portMAX_DELAY) == pdTRUE) {
+        groupResultCallback(merged);
+        xSemaphoreGive(_callbackMutex);
+    }
+}
+
+/**
+ * @name forEachDevice
+ * @brief Duyệt registry gộp của mọi shard, mỗi shard duyệt dưới mutex registry của nó
+ * nên callback phải ngắn và không gọi lại fleet
+ *
+ * @param {std::function} callback - Nhận thiết bị, true nếu đang chờ cấp phép, và chỉ số shard
+ *
+ * @return None
+ */
+void ZigbeeFleet::forEachDevice(std::function<void(const Device& device, bool pending, size_t shard)> callback) {
+    for (size_t i = 0; i < _shardCount; ++i) {
+        _shards[i]->forEachDevice([&callback, i](const Device& device, bool pending) {
+            callback(device, pending, i);
+        });
+    }
+}
+
+// Mốc nhận của khung đang xử lý trên task gọi (dùng trong onMessage)
+uint32_t ZigbeeFleet::rxStamp() const {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < _shardCount; ++i) {
+        if (_shards[i]->taskHandle() == self) {
+            return _shards[i]->rxStamp();
+        }
+    }
+    return 0;
+}
+
+size_t ZigbeeFleet::queueDepth() {
+    size_t depth = 0;
+    for (size_t i = 0; i < _shardCount; ++i) {
+        depth += _shards[i]->queueDepth();
+    }
+    return depth;
+}
+
+uint32_t ZigbeeFleet::shadowSuppressed() {
+    uint32_t suppressed = 0;
+    for (size_t i = 0; i < _shardCount; ++i) {
+        suppressed += _shards[i]->shadowSuppressed();
+    }
+    return suppressed;
+}
+
+uint32_t ZigbeeFleet::wakeups() const {
+    uint32_t wakeups = 0;
+    for (size_t i = 0; i < _shardCount; ++i) {
+        wakeups += _shards[i]->reactor().wakeups();
+    }
+    return wakeups;
+}
+
+uint32_t ZigbeeFleet::captureDropped() {
+    uint32_t dropped = 0;
+    for (size_t i = 0; i < _shardCount; ++i) {
+        dropped += _shards[i]->capture().dropped();
+    }
+    return dropped;
+}
+
+/**
+ * @name onCommand
+ * @brief Đăng ký lệnh ứng dụng trên mọi shard đã thêm, gọi sau addShard() và trước begin()
+ *
+ * @param {const char*} name - Tên lệnh
+ * @param {CommandHandler} handler - Chạy tuần tự với các callback khác của fleet
+ *
+ * @return {bool} - False nếu shard nào từ chối tên lệnh
+ */
+bool ZigbeeFleet::onCommand(const char *name, CommandHandler handler) {
+    bool ok = _shardCount > 0;
+    for (size_t i = 0; i < _shardCount; ++i) {
+        ok = _shards[i]->onCommand(name, [this, handler](const CommandFrame& frame) {
+            if (xSemaphoreTake(_callbackMutex, portMAX_DELAY) != pdTRUE) return;
+            handler(frame);
+            xSemaphoreGive(_callbackMutex);
+        }) && ok;
+    }
+    return ok;
+}
+
+void ZigbeeFleet::onMessage(std::function<void(const char *id, const char *data)> callback) {
+    messageCallback = callback;
+}
+
+void ZigbeeFleet::onChange(std::function<void()> callback) {
+    onChangeCallback = callback;
+}
+
+void ZigbeeFleet::onDeviceStatus(std::function<void(const char *id, bool online)> callback) {
+    deviceStatusCallback = callback;
+}
+
+void ZigbeeFleet::updatePendingList(std::function<void()> callback) {
+    updateCallback = callback;
+}
+
+void ZigbeeFleet::onGroupResult(std::function<void(const GroupResult& result)> callback) {
+    groupResultCallback = callback;
+}
+
+void ZigbeeFleet::onBulkResult(std::function<void(const BulkStatus& status)> callback) {
+    bulkResultCallback = callback;
+}
@@ -0,0 +1,89 @@
+#ifndef ZIGBEEFLEET_H
+#define ZIGBEEFLEET_H
+
+#include <vector>
+#include <string>
+#include <list>
+#include <map>
+#include <functional>
+#include "zigbeeServer.h"
+
+#define ZIGBEE_MAX_SHARDS 4
+
+// Lệnh nhóm đã chia cho nhiều shard, gộp kết quả khi mọi shard đã báo
+struct FleetGroupTransaction {
+    GroupResult result;
+    uint8_t waiting;    // Bit i: còn chờ kết quả từ shard i
+};
+
+/**
+ * @name ZigbeeFleet
+ * @brief Gom nhiều ZigbeeServer (mỗi coordinator một UART) thành một registry chung,
+ * lệnh theo ID được chuyển tới shard đang sở hữu thiết bị
+ *
+ * Shard sở hữu một thiết bị là shard mà thiết bị xuất hiện (danh sách chính hoặc chờ).
+ * Với một shard duy nhất mọi ID thuộc shard 0 ngay từ đầu, giống ZigbeeServer dùng riêng.
+ */
+class ZigbeeFleet{
+
+    public:
+        ZigbeeFleet();
+        bool addShard(ZigbeeServer& server);
+        void begin();
+        size_t shardCount() const;
+        ZigbeeServer& shard(size_t index);
+        int ownerOf(const char *id);
+
+        void provisionDevices(const std::vector<std::string>& ids);
+        bool sendCommand(const char *id, const char *cmd);
+        bool checkDevice(const char *id);
+        bool sendBulk(const char *id, uint32_t transfer, uint32_t size, BulkSource source);
+        bool resumeBulk(const char *id);
+        bool setDesired(const char *id, const char *key, const char *value);
+        void broadcastMessage();
+
+        bool defineGroup(const char *gid, const std::vector<std::string>& members);
+        bool removeGroup(const char *gid);
+        std::map<std::string, std::vector<std::string>> groups();
+        bool sendGroupCommand(const char *gid, const char *cmd);
+
+        void forEachDevice(std::function<void(const Device& device, bool pending, size_t shard)> callback);
+        uint32_t rxStamp() const;
+        size_t queueDepth();
+        uint32_t shadowSuppressed();
+        uint32_t wakeups() const;
+        uint32_t captureDropped();
+
+        void onMessage(std::function<void(const char *id, const char *data)> callback);
+        void onChange(std::function<void()> callback);
+        void onDeviceStatus(std::function<void(const char *id, bool online)> callback);
+        void updatePendingList(std::function<void()> callback);
+        void onGroupResult(std::function<void(const GroupResult& result)> callback);
+        void onBulkResult(std::function<void(const BulkStatus& status)> callback);
+        bool onCommand(const char *name, CommandHandler handler);
+
+    private:
+        void claim(size_t index);
+        void provisionShard(size_t index);
+        void applyGroup(const std::string& gid, const std::vector<std::string>& members);
+        void mergeGroupResult(size_t index, const GroupResult& result);
+        ZigbeeServer* route(const char *id);
+
+        ZigbeeServer *_shards[ZIGBEE_MAX_SHARDS];
+        size_t _shardCount = 0;
+        SemaphoreHandle_t _mutex = NULL;            // Bảo vệ _desired, _owner, _groups, _groupTransactions
+        SemaphoreHandle_t _callbackMutex = NULL;    // Callback của các shard chạy tuần tự như với một ZigbeeServer
+        std::vector<std::string> _desired;
+        std::map<std::string, uint8_t> _owner;
+        std::map<std::string, std::vector<std::string>> _groups;
+        std::list<FleetGroupTransaction> _groupTransactions;
+
+        std::function<void(const char *id, const char *data)> messageCallback;
+        std::function<void()> onChangeCallback;
+        std::function<void()> updateCallback;
+        std::function<void(const char *id, bool online)> deviceStatusCallback;
+        std::function<void(const GroupResult& result)> groupResultCallback;
+        std::function<void(const BulkStatus& status)> bulkResultCallback;
+};
+
+#endif // ZIGBEEFLEET_H
@@ -1,113 +1,228 @@
 #include <zigbeeServer.h>
 #include <algorithm>
-unsigned long timeCheck = millis();
+#include "DeferredLog.h"
 
-uint32_t calculateCRC32(const char* data, size_t length);
+DLOG_MODULE(zigbeeLog, "zigbeeServer");
 
-ZigbeeServer* ZigbeeServer::_instance = nullptr;
-
-ZigbeeServer::ZigbeeServer() : _zigbeeSerial(&Serial1)
+ZigbeeServer::ZigbeeServer(const ZigbeeTransport& transport, size_t maxDevices, size_t maxPending)
+    : deviceList(maxDevices), pendingDeviceList(maxPending), _transport(transport), _zigbeeSerial(transport.serial),
+      _reactor(transport.name), _baud(transport.baud), _shadow(ZIGBEE_SHADOW_SIZE)
 {
+    _inputMutex = xSemaphoreCreateMutex();
+    _registryMutex = xSemaphoreCreateMutex();
+    _rxEvent = _reactor.on([this]() { processIncoming(); });
+    _commandEvent = _reactor.on([this]() {
+        // Mỗi lần một lệnh để khung RX tới giữa các lệnh vẫn được xử lý kịp
+        if (processCommand() && queueDepth() > 0) {
+            _reactor.notify(_commandEvent);
+        }
+    });
+    _provisionEvent = _reactor.on([this]() { applyProvisioning(); });
+    _shadowEvent = _reactor.on([this]() { reconcile(); });
+    _reactor.every(ZIGBEE_PENDING_CHECK_INTERVAL, [this]() { checkPendingDevices(); });
+    _groupTimer = _reactor.after(ZIGBEE_GROUP_TIMEOUT, [this]() { expireGroups(); });
+    _reactor.disarm(_groupTimer);
+    _registryTimer = _reactor.after(ZIGBEE_REGISTRY_SAVE_DELAY, [this]() { saveRegistry(); });
+    _reactor.disarm(_registryTimer);
+    _bulkEvent = _reactor.on([this]() { pumpBulk(); });
+    _bulkTimer = _reactor.after(ZIGBEE_BULK_TIMEOUT, [this]() { pumpBulk(); });
+    _reactor.disarm(_bulkTimer);
+    _baudEvent = _reactor.on([this]() { negotiateBaud(); });
+    _baudTimer = _reactor.after(ZIGBEE_BAUD_RETRY, [this]() {
+        _baudDue = true;
+        negotiateBaud();
+    });
+    _reactor.disarm(_baudTimer);
 }
 
 void ZigbeeServer::begin() {
-    ESP_LOGI("ZigbeeServer", "Starting...");
+    DLOGI(zigbeeLog, "Starting %s... devices: %u bytes (%u x %u B)", _transport.name,
+          (unsigned)(deviceList.bytes() + pendingDeviceList.bytes()),
+          (unsigned)(deviceList.capacity() + pendingDeviceList.capacity()), (unsigned)sizeof(Device));
+    // Nạp danh sách thiết bị đã lưu trước khi nhận khung đầu tiên, không cần chờ cloud gửi lại
+    if (_registryStore != nullptr && xSemaphoreTake(_registryMutex, portMAX_DELAY) == pdTRUE) {
+        uint32_t start = micros();
+        bool loaded = _registryStore->load(deviceList, _schemas);
+        xSemaphoreGive(_registryMutex);
+        if (loaded) {
+            DLOGI(zigbeeLog, "Warm start: %u devices in %u us", (unsigned)deviceList.size(), (unsigned)(micros() - start));
+        }
+    }
     initZigbee();
     // broadcastMessage();
-    xTaskCreatePinnedToCore(
-        [](void *pvParameters)
-        {
-            ZigbeeServer *zigbeeServer = static_cast<ZigbeeServer *>(pvParameters);
-            for (;;)
-            {
-                zigbeeServer->loop();
-                vTaskDelay(10 / portTICK_PERIOD_MS); // Giảm tần suất kiểm tra
-            }
-        },
-        "ZigbeeServerTask",
-        10000,
-        this,
-        1,
-        NULL,
-        0 // Chạy trên core 0
-    );
+    // Task chỉ thức dậy khi UART có dữ liệu, có lệnh mới, có danh sách cấp phép mới hoặc tới hạn kiểm tra thiết bị chờ
+    _reactor.start(10000, 1, 0); // Chạy trên core 0
 }
 
+// Xử lý mọi việc đang chờ một lần, dùng khi không chạy task (vd: bản build native)
 void ZigbeeServer::loop() {
+    applyProvisioning();
     checkPendingDevices();
-    static std::string incomingMessage; // Thêm static để lưu trữ tạm thời dữ liệu nhận được
+    processIncoming();
+    reconcile();
+    processCommand();
+    expireGroups();
+    pumpBulk();
+    negotiateBaud();
+    _reactor.runTimers(); // Timer tới hạn, vd: thương lượng lại baud sau ZIGBEE_BAUD_RETRY
+}
+
+void ZigbeeServer::processIncoming() {
+    std::string& incomingMessage = _incomingMessage;
+    while (readFrame(incomingMessage)) {
+#ifdef LATENCY_TRACE
+        _rxStamp = micros();
+#endif
+        _capture.record(FRAME_RX, incomingMessage.c_str(), incomingMessage.length());
+        handleIncomingMessage(incomingMessage);
+        DLOGI(zigbeeLog, "Received: %s", incomingMessage.c_str());
+    }
+}
+
+/**
+ * @name readFrame
+ * @brief Đọc UART tới khi đủ một khung: dòng ASCII kết thúc bằng '\n' hoặc khung nhị phân 0x00 <COBS> 0x00.
+ * Khung nhị phân được dịch về dạng ASCII kèm ",CRC:" để mọi handler và capture dùng chung một dạng.
+ * Peer gửi khung nhị phân hợp lệ thì server trả lời bằng nhị phân, gửi lại khung ASCII hợp lệ thì quay về ASCII.
+ *
+ * @param {std::string&} frame - Nhận khung, không có '\r' '\n'
+ *
+ * @return {bool} - False nếu chưa đủ một khung
+ */
+bool ZigbeeServer::readFrame(std::string& frame) {
     while (_zigbeeSerial->available()) {
-        Serial.println(".");
         char c = _zigbeeSerial->read();
-        incomingMessage += c;
-        if (c == '\n') {
-            if (!incomingMessage.empty()) {
-                handleIncomingMessage(incomingMessage);
-                ESP_LOGI("zigbeeServer", "Received: %s", incomingMessage.c_str());
-                incomingMessage.clear();
+        if (c == '\0') {
+            if (!_rxBinary) {
+                // Mở khung nhị phân, phần ASCII dở dang trước đó là nhiễu
+                _rxBinary = true;
+                _rxBuffer.clear();
+                continue;
+            }
+            if (_rxBuffer.empty()) continue;  // Dấu đóng khung trước liền dấu mở khung sau
+            _rxBinary = false;
+            bool decoded = _codec.decode((const uint8_t*)_rxBuffer.data(), _rxBuffer.size(), frame);
+            _rxBuffer.clear();
+            std::string control;
+            if (_codec.takeControl(control)) {
+                _zigbeeSerial->write((const uint8_t*)control.data(), control.size());
+            }
+            if (!decoded) {
+                sampleLink(true);
+                continue;
+            }
+            if (!_binaryPeer) {
+                DLOGI(zigbeeLog, "Coordinator speaks binary framing");
+                _binaryPeer = true;
+            }
+            if (frame.empty()) continue;  // BIND/REBIND, codec đã xử lý
+            char crcString[9];
+            snprintf(crcString, sizeof(crcString), "%08X", calculateCRC32(frame.c_str(), frame.length()));
+            frame += ",CRC:";
+            frame += crcString;
+            return true;
+        }
+        if (c == '\n' && !_rxBinary) {
+            frame.swap(_rxBuffer);
+            _rxBuffer.clear();
+            while (!frame.empty() && (frame.back() == '\r' || frame.back() == ' ')) frame.pop_back();
+            if (frame.empty()) continue;
+            if (_binaryPeer && checkCRC32(frame)) {
+                DLOGI(zigbeeLog, "Coordinator back to ASCII framing");
+                _binaryPeer = false;
+                _codec.reset();
             }
+            return true;
+        }
+        _rxBuffer += c;
+        if (_rxBuffer.size() > ZIGBEE_MAX_FRAME) {
+            // Không có '\n' hay 0x00 sau cả một khung dài: nhiễu, thường do hai phía lệch baud
+            _rxBuffer.clear();
+            _rxBinary = false;
+            sampleLink(true);
         }
     }
-    if (!messageQueue.empty()) {
-        std::string command = messageQueue.front();
-        messageQueue.pop();
-        ESP_LOGI("zigbeeServer", "Get command: %s", command.c_str());
-        
-        //calculate CRC
-        uint32_t calculated_crc = calculateCRC32(command.c_str(), command.length());
-        char crcString[9];
-        snprintf(crcString, sizeof(crcString), "%08X", calculated_crc);
-        ESP_LOGI("zigbeeServer", "CRC: %s", crcString);
-        // end calculate CRC
+    return false;
+}
+
+bool ZigbeeServer::processCommand() {
+    QueuedCommand queued;
+    if (dequeue(queued)) {
+        const std::string& command = queued.message;
+        DLOGI(zigbeeLog, "Get command: %s", command.c_str());
+
+        TRACE_SINCE(TRACE_CMD_QUEUE, queued.enqueued);
+        if (command.compare(0, 6, "GROUP:") == 0) {
+            // Lệnh nhóm: gửi một lần, ACK của các thành viên được thu thập bất đồng bộ tới hạn chót
+            transmit(command);
+            DLOGI(zigbeeLog, "Send: %s", command.c_str());
+            startGroupTransaction(command);
+            return true;
+        }
+        TRACE_STAMP(transmitted);
         int retry = 0;
         while (retry < ZIGBEE_CONNECT_RETRY)
         {
             unsigned long start_time = millis();
             bool is_sent = false;
 
-            std::string message = command + ",CRC:" + crcString + "\n";
-            _zigbeeSerial->printf(message.c_str());
-            ESP_LOGI("zigbeeServer", "Send: %s", message.c_str());
+            transmit(command);
+            DLOGI(zigbeeLog, "Send: %s", command.c_str());
     
             while (millis() - start_time < ZIGBEE_CONNECT_TIMEOUT) {
-                if (_zigbeeSerial->available()) {
-                    String data = _zigbeeSerial->readStringUntil('\n');
-                    data.trim();
-                    std::string Data = std::string(data.c_str());
-                    ESP_LOGI("zigbeeServer", "Data %s", Data.c_str());
-
-                    if (data.length() > 0) {
-                        if (command.find("ID:") ==  std::string::npos) {
-                            if (handleIncomingMessage(Data)) {
-                                ESP_LOGI("zigbeeServer", "Incoming Message in free time!");
-                            }
-                        } else {
-                            std::string id = command.substr(3,command.find(",")-command.find("ID:")-3);
-                            std::string cmd = command.substr(command.find("CMD:") + 4);
-                            ESP_LOGI("zigbeeServer","ID: %s, CMD: %s",id.c_str(),cmd.c_str());
-
-                            if (handleIncomingMessage(Data, cmd, id, true)) {
-                                ESP_LOGI("zigbeeServer","Device %s status changed to active.",id.c_str());
-                                is_sent = true;
-                                break;
-                            }
+                std::string& Data = _incomingMessage;
+                if (readFrame(Data)) {
+                    DLOGI(zigbeeLog, "Data %s", Data.c_str());
+
+#ifdef LATENCY_TRACE
+                    _rxStamp = micros();
+#endif
+                    _capture.record(FRAME_RX, Data.c_str(), Data.length());
+                    if (command.find("ID:") ==  std::string::npos) {
+                        if (handleIncomingMessage(Data)) {
+                            DLOGI(zigbeeLog, "Incoming Message in free time!");
+                        }
+                    } else {
+                        std::string id = command.substr(3,command.find(",")-command.find("ID:")-3);
+                        std::string cmd = command.substr(command.find("CMD:") + 4);
+                        DLOGI(zigbeeLog, "ID: %s, CMD: %s",id.c_str(),cmd.c_str());
+
+                        if (handleIncomingMessage(Data, cmd, id, true)) {
+                            DLOGI(zigbeeLog, "Device %s status changed to active.",id.c_str());
+                            TRACE_SINCE(TRACE_CMD_ACK, transmitted);
+                            is_sent = true;
+                            break;
                         }
                     }
-                    data.clear();
-                    Data.clear();
+                } else {
+                    // Ngủ tới khi UART báo có dữ liệu thay vì quay vòng kiểm tra available()
+                    unsigned long elapsed = millis() - start_time;
+                    if (elapsed < ZIGBEE_CONNECT_TIMEOUT) {
+                        _reactor.waitFor(_rxEvent, ZIGBEE_CONNECT_TIMEOUT - elapsed);
+                    }
                 }
             }
             
             if (is_sent) break;
             ++retry;
-            Serial.print("Retry: ");
-            Serial.println(retry);
+            if (retry < ZIGBEE_CONNECT_RETRY) {
+                health.count(HEALTH_CMD_RETRIES);
+            }
+            DLOGW(zigbeeLog, "Retry: %d", retry);
         }
         
         if (retry == ZIGBEE_CONNECT_RETRY) {
-            Serial.print("Failed to send command: ");
-            Serial.println(command.c_str());
-            Serial.println("Error logged: Send command failed");
+            health.count(HEALTH_CMD_TIMEOUTS);
+            DLOGE(zigbeeLog, "Failed to send command: %s", command);
+            if (command.find("ID:") == 0) {
+                std::string id = command.substr(3, command.find(",") - 3);
+                std::string cmd = command.substr(command.find("CMD:") + 4);
+                if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+                    _shadow.commandFailed(id.c_str(), cmd.substr(0, cmd.find(':')).c_str());
+                    xSemaphoreGive(_inputMutex);
+                }
+                setDeviceOnline(id, false);
+            }
             // if (command.find("ID:") != std::string::npos){
             //     std::string id = command.substr(3, command.find(",")-command.find("ID:")-3);
 
@@ -118,21 +233,114 @@ void ZigbeeServer::loop() {
             //     device->status = false;
             // }
         }   
+        return true;
     }
+    return false;
 }
 
 void ZigbeeServer::addDevice(const char *id) {
-    Device device;
-    device.id = id;
-    deviceList.push_back(device);
-    ESP_LOGI("Get Device", "Push back done!");
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    bool added = deviceList.find(id) == nullptr && deviceList.add(id) != nullptr;
+    xSemaphoreGive(_registryMutex);
+
+    if (added) {
+        DLOGI(zigbeeLog, "Push back done!");
+    }
 }
 void ZigbeeServer::addPenddingDevice(const char *id){
-    Device device;
-    device.id = id;
-    device.lastest_t = millis();
-    pendingDeviceList.push_back(device);
-    ESP_LOGI("zigbeeServer", "Completed add pending device - id: %s", id);
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    Device *device = pendingDeviceList.add(id);
+    if (device != nullptr) {
+        device->lastest_t = millis();
+    }
+    xSemaphoreGive(_registryMutex);
+    if (device == nullptr) return;
+    DLOGI(zigbeeLog, "Completed add pending device - id: %s", id);
+}
+
+// Lưu danh sách mong muốn, task ZigbeeServer sẽ áp dụng ở vòng loop kế tiếp
+void ZigbeeServer::provisionDevices(const std::vector<std::string>& ids) {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        _desiredDevices = ids;
+        _provisionPending = true;
+        xSemaphoreGive(_inputMutex);
+    }
+    _reactor.notify(_provisionEvent);
+}
+
+void ZigbeeServer::applyProvisioning() {
+    if (!_provisionPending) return;
+
+    std::vector<std::string> desired;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    desired.swap(_desiredDevices);
+    _provisionPending = false;
+    xSemaphoreGive(_inputMutex);
+
+    std::unordered_set<std::string> remaining(desired.begin(), desired.end());
+    std::vector<std::string> removed;
+    std::vector<std::string> erased;
+    size_t kept = 0, added = 0, promoted = 0;
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    size_t before = deviceList.size();
+
+    // Giữ lại thiết bị đã có (kể cả trạng thái), bỏ những thiết bị cloud đã xoá - dồn tại chỗ
+    for (Device *device = deviceList.begin(); device != deviceList.end();) {
+        if (remaining.erase(device->id)) {
+            ++device;
+            ++kept;
+        } else {
+            if (device->online) {
+                removed.push_back(device->id);
+            }
+            erased.push_back(device->id);
+            deviceList.erase(device);
+        }
+    }
+    // Thiết bị đang chờ mà cloud đã cấp phép thì chuyển sang danh sách chính
+    for (Device *device = pendingDeviceList.begin(); device != pendingDeviceList.end();) {
+        if (remaining.count(device->id) && deviceList.size() < deviceList.capacity()) {
+            remaining.erase(device->id);
+            Device *promotedDevice = deviceList.add(device->id);
+            if (promotedDevice != nullptr) {
+                *promotedDevice = *device;
+                ++promoted;
+            }
+            pendingDeviceList.erase(device);
+        } else {
+            ++device;
+        }
+    }
+    for (const std::string& id : desired) {
+        if (id.empty() || !remaining.erase(id)) continue;
+        if (deviceList.add(id.c_str()) != nullptr) {
+            ++added;
+        }
+    }
+    xSemaphoreGive(_registryMutex);
+
+    if (!erased.empty() && xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        for (const std::string& id : erased) {
+            _shadow.remove(id.c_str());
+        }
+        xSemaphoreGive(_inputMutex);
+    }
+
+    size_t dropped = before - kept;
+    DLOGI(zigbeeLog, "Provisioned %u devices: +%u, promoted %u, -%u",
+             (unsigned)deviceList.size(), (unsigned)added, (unsigned)promoted, (unsigned)dropped);
+
+    for (const std::string& id : removed) {
+        if (deviceStatusCallback) {
+            deviceStatusCallback(id.c_str(), false);
+        }
+    }
+    if (added || promoted || dropped) {
+        registryChanged();
+        if (onChangeCallback) {
+            onChangeCallback();
+        }
+    }
 }
 
 void ZigbeeServer::updatePendingList(std::function<void()> callback){
@@ -147,11 +355,56 @@ void ZigbeeServer::onChange(std::function<void()> callback) {
     onChangeCallback = callback;
 }
 
-ZigbeeServer* ZigbeeServer::getInstance() {
-    if (_instance == nullptr) {
-        _instance = new ZigbeeServer();
+void ZigbeeServer::onDeviceStatus(std::function<void(const char *id, bool online)> callback) {
+    deviceStatusCallback = callback;
+}
+
+// Chỉ báo khi trạng thái kết nối thực sự thay đổi
+void ZigbeeServer::setDeviceOnline(const std::string& id, bool online) {
+    Device *it = deviceList.find(id);
+    if (it == nullptr || it->online == online) return;
+
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    it->online = online;
+    xSemaphoreGive(_registryMutex);
+    DLOGI(zigbeeLog, "Device %s is %s", id.c_str(), online ? "online" : "offline");
+    if (online && xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        _shadow.retry(id.c_str());
+        xSemaphoreGive(_inputMutex);
+        _reactor.notify(_shadowEvent);
     }
-    return _instance;
+    if (deviceStatusCallback) {
+        deviceStatusCallback(id.c_str(), online);
+    }
+}
+
+/**
+ * @name persistRegistry
+ * @brief Lưu danh sách thiết bị vào flash và nạp lại trong begin(), phải gọi trước begin()
+ *
+ * @param {RegistryStore&} store - Nơi lưu, sống suốt chương trình
+ *
+ * @return None
+ */
+void ZigbeeServer::persistRegistry(RegistryStore& store) {
+    _registryStore = &store;
+}
+
+// Gom các thay đổi trong ZIGBEE_REGISTRY_SAVE_DELAY thành một lần ghi flash
+void ZigbeeServer::registryChanged() {
+    if (_registryStore == nullptr || _registryDirty) return;
+    _registryDirty = true;
+    _reactor.arm(_registryTimer, ZIGBEE_REGISTRY_SAVE_DELAY);
+}
+
+bool ZigbeeServer::saveRegistry() {
+    if (_registryStore == nullptr) return false;
+    _registryDirty = false;
+    return _registryStore->save(deviceList, _schemas);
+}
+
+const char* ZigbeeServer::name() const {
+    return _transport.name;
 }
 
 void ZigbeeServer::checkDevice(const char *id) {
@@ -160,21 +413,692 @@ void ZigbeeServer::checkDevice(const char *id) {
 
 void ZigbeeServer::sendCommand(const char *id, const char *cmd) {
     std::string message = std::string("ID:") + id + ",SECRECT_KEY:123"+",CMD:" + cmd;
-    messageQueue.push(message);
+    enqueue(message);
 }
 
 void ZigbeeServer::sendCommand(const char *id, const char *secrect_key, const char *cmd) {
     std::string message = std::string("ID:") + id +",SECRECT_KEY:"+ secrect_key +",CMD:" + cmd;
-    messageQueue.push(message);
+    enqueue(message);
 }
 
 void ZigbeeServer::broadcastMessage() {
-    messageQueue.push("CMD:BRD:DISC");
+    enqueue("CMD:BRD:DISC");
     // _zigbeeSerial->println("CMD:BRD:DISC");
 }
 
+/**
+ * @name defineGroup
+ * @brief Tạo hoặc thay nhóm thiết bị, thành viên mới nhận lệnh join_group:<gid>, thành viên bị bỏ nhận leave_group:<gid>
+ *
+ * @param {const char*} gid - ID nhóm
+ * @param {const std::vector<std::string>&} members - ID các thiết bị trong nhóm
+ *
+ * @return {bool} - False nếu ID nhóm không hợp lệ hoặc đã đủ ZIGBEE_MAX_GROUPS nhóm
+ */
+bool ZigbeeServer::defineGroup(const char *gid, const std::vector<std::string>& members) {
+    std::string group(gid);
+    if (group.empty() || group.find_first_of(",:\n") != std::string::npos) return false;
+
+    std::vector<std::string> joined, left;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return false;
+    auto it = _groups.find(group);
+    if (it == _groups.end() && _groups.size() >= ZIGBEE_MAX_GROUPS) {
+        xSemaphoreGive(_inputMutex);
+        return false;
+    }
+    std::vector<std::string> previous;
+    if (it != _groups.end()) {
+        previous.swap(it->second);
+    }
+    std::vector<std::string>& current = _groups[group];
+    for (const std::string& id : members) {
+        if (id.empty() || std::find(current.begin(), current.end(), id) != current.end()) continue;
+        current.push_back(id);
+        if (std::find(previous.begin(), previous.end(), id) == previous.end()) {
+            joined.push_back(id);
+        }
+    }
+    for (const std::string& id : previous) {
+        if (std::find(current.begin(), current.end(), id) == current.end()) {
+            left.push_back(id);
+        }
+    }
+    xSemaphoreGive(_inputMutex);
+
+    for (const std::string& id : joined) {
+        sendCommand(id.c_str(), ("join_group:" + group).c_str());
+    }
+    for (const std::string& id : left) {
+        sendCommand(id.c_str(), ("leave_group:" + group).c_str());
+    }
+    DLOGI(zigbeeLog, "Group %s: %u members, +%u -%u", gid, (unsigned)members.size(), (unsigned)joined.size(), (unsigned)left.size());
+    return true;
+}
+
+bool ZigbeeServer::removeGroup(const char *gid) {
+    std::vector<std::string> members;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return false;
+    auto it = _groups.find(gid);
+    if (it != _groups.end()) {
+        members.swap(it->second);
+        _groups.erase(it);
+    }
+    xSemaphoreGive(_inputMutex);
+
+    for (const std::string& id : members) {
+        sendCommand(id.c_str(), (std::string("leave_group:") + gid).c_str());
+    }
+    return !members.empty();
+}
+
+std::map<std::string, std::vector<std::string>> ZigbeeServer::groups() {
+    std::map<std::string, std::vector<std::string>> copy;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        copy = _groups;
+        xSemaphoreGive(_inputMutex);
+    }
+    return copy;
+}
+
+/**
+ * @name sendGroupCommand
+ * @brief Gửi một lệnh tới cả nhóm bằng một khung GROUP:<gid>,CMD:<cmd>, kết quả báo qua onGroupResult
+ *
+ * @param {const char*} gid - ID nhóm
+ * @param {const char*} cmd - Lệnh
+ *
+ * @return {bool} - False nếu nhóm không tồn tại hoặc rỗng
+ */
+bool ZigbeeServer::sendGroupCommand(const char *gid, const char *cmd) {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return false;
+    auto it = _groups.find(gid);
+    if (it == _groups.end() || it->second.empty()) {
+        xSemaphoreGive(_inputMutex);
+        return false;
+    }
+    GroupTransaction transaction;
+    transaction.result.group = gid;
+    transaction.result.command = cmd;
+    transaction.result.missing = it->second;
+    transaction.deadline = 0;
+    transaction.sent = false;
+    _groupTransactions.push_back(std::move(transaction));
+    // Đưa vào hàng đợi trong cùng lần giữ khoá để thứ tự khung GROUP khớp thứ tự giao dịch
+    QueuedCommand command;
+    command.message = std::string("GROUP:") + gid + ",CMD:" + cmd;
+#ifdef LATENCY_TRACE
+    command.enqueued = micros();
+#endif
+    messageQueue.push(std::move(command));
+    xSemaphoreGive(_inputMutex);
+
+    _reactor.notify(_commandEvent);
+    return true;
+}
+
+void ZigbeeServer::onGroupResult(std::function<void(const GroupResult& result)> callback) {
+    groupResultCallback = callback;
+}
+
+/**
+ * @name sendBulk
+ * @brief Truyền một ảnh lớn (firmware, cấu hình) tới thiết bị theo block, song song với lệnh thường.
+ * Kết quả (done, failed hoặc paused khi hết retry) báo qua onBulkResult
+ *
+ * @param {const char*} id - ID thiết bị
+ * @param {uint32_t} transfer - ID lần truyền, giữ nguyên khi gửi lại cùng ảnh để thiết bị tiếp tục từ chỗ dừng
+ * @param {uint32_t} size - Số byte
+ * @param {BulkSource} source - Đọc ảnh từ flash hoặc stream, gọi trên task của server
+ *
+ * @return {bool} - False nếu đang có lần truyền khác chưa xong
+ */
+bool ZigbeeServer::sendBulk(const char *id, uint32_t transfer, uint32_t size, BulkSource source) {
+    if (size == 0 || !source || xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return false;
+    bool accepted = !_bulkBusy;
+    if (accepted) {
+        _bulkBusy = true;
+        _bulkRequest.clear();
+        _bulkRequest.push_back({id, transfer, size, source});
+    }
+    xSemaphoreGive(_inputMutex);
+    if (accepted) {
+        _reactor.notify(_bulkEvent);
+    }
+    return accepted;
+}
+
+// Mở lại lần truyền đang tạm dừng (vd: thiết bị vừa kết nối lại)
+bool ZigbeeServer::resumeBulk() {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return false;
+    bool paused = _bulkStatus.state == BULK_PAUSED;
+    _bulkResume |= paused;
+    xSemaphoreGive(_inputMutex);
+    if (paused) {
+        _reactor.notify(_bulkEvent);
+    }
+    return paused;
+}
+
+void ZigbeeServer::cancelBulk() {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    _bulkCancel = true;
+    _bulkRequest.clear();
+    xSemaphoreGive(_inputMutex);
+    _reactor.notify(_bulkEvent);
+}
+
+BulkStatus ZigbeeServer::bulkStatus() {
+    BulkStatus status;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        status = _bulkStatus;
+        xSemaphoreGive(_inputMutex);
+    }
+    return status;
+}
+
+void ZigbeeServer::onBulkResult(std::function<void(const BulkStatus& status)> callback) {
+    bulkResultCallback = callback;
+}
+
+// Nhận yêu cầu từ task khác, gửi khối tới hạn và hẹn giờ cho hạn chót ACK gần nhất
+void ZigbeeServer::pumpBulk() {
+    std::vector<BulkRequest> request;
+    bool resume, cancel;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    request.swap(_bulkRequest);
+    resume = _bulkResume;
+    cancel = _bulkCancel;
+    _bulkResume = _bulkCancel = false;
+    xSemaphoreGive(_inputMutex);
+
+    if (cancel) {
+        _bulk.cancel();
+    }
+    for (const BulkRequest& r : request) {
+        _bulk.cancel();
+        _bulk.start(r.id.c_str(), r.transfer, r.size, r.source);
+        DLOGI(zigbeeLog, "Bulk %08X to %s: %u B", (unsigned)r.transfer, r.id.c_str(), (unsigned)r.size);
+    }
+    if (resume) {
+        _bulk.resume();
+    }
+
+    uint32_t wait = _bulk.poll(millis(), [this](const std::string& frame) {
+        transmit(frame);
+        return (uint32_t)millis();
+    });
+    if (wait > 0) {
+        _reactor.arm(_bulkTimer, wait);
+    } else {
+        _reactor.disarm(_bulkTimer);
+    }
+
+    const BulkStatus& status = _bulk.status();
+    bool finished = status.state == BULK_DONE || status.state == BULK_FAILED || status.state == BULK_PAUSED;
+    bool report = finished && status.state != _bulkReported;
+    _bulkReported = status.state;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        _bulkStatus = status;
+        if (cancel || (report && status.state != BULK_PAUSED)) {
+            _bulkBusy = !_bulkRequest.empty();
+        }
+        xSemaphoreGive(_inputMutex);
+    }
+    if (report) {
+        DLOGI(zigbeeLog, "Bulk %08X to %s %s: %u/%u blocks, %u retransmits", (unsigned)status.transfer, status.id,
+              BulkStatus::stateName(status.state), (unsigned)status.acked, (unsigned)status.blocks,
+              (unsigned)status.retransmits);
+        if (bulkResultCallback) {
+            bulkResultCallback(status);
+        }
+    }
+}
+
+// Gửi một khung (chưa có ",CRC:") theo chế độ khung peer đang dùng
+void ZigbeeServer::transmit(const std::string& frame) {
+    char crcString[9];
+    snprintf(crcString, sizeof(crcString), "%08X", calculateCRC32(frame.c_str(), frame.length()));
+    std::string message = frame + ",CRC:" + crcString + "\n";
+    // Capture luôn ghi dạng ASCII để replay không phụ thuộc chế độ khung
+    _capture.record(FRAME_TX, message.c_str(), message.length() - 1);
+    if (_binaryPeer) {
+        std::string wire;
+        _codec.encode(frame, wire);
+        _zigbeeSerial->write((const uint8_t*)wire.data(), wire.size());
+    } else {
+        _zigbeeSerial->print(message.c_str());
+    }
+}
+
+// Khung GROUP vừa được truyền: bắt đầu tính hạn chót cho giao dịch tương ứng
+void ZigbeeServer::startGroupTransaction(const std::string& command) {
+    bool waiting = false;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    for (GroupTransaction& transaction : _groupTransactions) {
+        if (transaction.sent) {
+            waiting = true;
+        } else if (command == "GROUP:" + transaction.result.group + ",CMD:" + transaction.result.command) {
+            transaction.sent = true;
+            transaction.deadline = millis() + ZIGBEE_GROUP_TIMEOUT;
+            break;
+        }
+    }
+    xSemaphoreGive(_inputMutex);
+    // Giao dịch gửi trước có hạn chót sớm hơn, timer đã được hẹn cho nó
+    if (!waiting) {
+        _reactor.arm(_groupTimer, ZIGBEE_GROUP_TIMEOUT);
+    }
+}
+
+void ZigbeeServer::confirmGroupMember(const std::string& id, const std::string& cmd) {
+    std::vector<GroupResult> finished;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    for (auto it = _groupTransactions.begin(); it != _groupTransactions.end();) {
+        GroupResult& result = it->result;
+        auto member = std::find(result.missing.begin(), result.missing.end(), id);
+        if (!it->sent || result.command != cmd || member == result.missing.end()) {
+            ++it;
+            continue;
+        }
+        result.confirmed.push_back(id);
+        result.missing.erase(member);
+        if (result.missing.empty()) {
+            finished.push_back(std::move(result));
+            it = _groupTransactions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    xSemaphoreGive(_inputMutex);
+    finishGroups(finished);
+}
+
+void ZigbeeServer::expireGroups() {
+    std::vector<GroupResult> finished;
+    uint32_t now = millis();
+    int32_t next = -1;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    for (auto it = _groupTransactions.begin(); it != _groupTransactions.end();) {
+        int32_t remaining = (int32_t)(it->deadline - now);
+        if (it->sent && remaining <= 0) {
+            finished.push_back(std::move(it->result));
+            it = _groupTransactions.erase(it);
+            continue;
+        }
+        if (it->sent && next < 0) {
+            next = remaining;
+        }
+        ++it;
+    }
+    xSemaphoreGive(_inputMutex);
+    if (next >= 0) {
+        _reactor.arm(_groupTimer, next);
+    }
+    finishGroups(finished);
+}
+
+void ZigbeeServer::finishGroups(std::vector<GroupResult>& finished) {
+    for (const GroupResult& result : finished) {
+        DLOGI(zigbeeLog, "Group %s %s: %u confirmed, %u missing", result.group.c_str(), result.command.c_str(),
+              (unsigned)result.confirmed.size(), (unsigned)result.missing.size());
+        // Giống lệnh đơn lẻ: thành viên không ACK được coi là mất kết nối
+        for (const std::string& id : result.missing) {
+            setDeviceOnline(id, false);
+        }
+        if (groupResultCallback) {
+            groupResultCallback(result);
+        }
+    }
+}
+
+/**
+ * @name setDesired
+ * @brief Đặt trạng thái mong muốn của thiết bị, lệnh chỉ được gửi khi khác trạng thái thiết bị đã báo.
+ *        Nhiều lần đặt trước khi gửi được gộp thành giá trị cuối cùng.
+ *
+ * @param {const char*} id - ID của thiết bị
+ * @param {const char*} key - Thuộc tính, vd: led_status
+ * @param {const char*} value - Giá trị, vd: 1
+ *
+ * @return {bool} - True nếu sẽ gửi lệnh, False nếu thiết bị đã ở trạng thái này
+ */
+bool ZigbeeServer::setDesired(const char *id, const char *key, const char *value) {
+    bool changed = false;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        changed = _shadow.setDesired(id, key, value);
+        xSemaphoreGive(_inputMutex);
+    }
+    if (changed) {
+        _reactor.notify(_shadowEvent);
+    } else {
+        DLOGD(zigbeeLog, "Shadow %s %s:%s already in sync", id, key, value);
+    }
+    return changed;
+}
+
+uint32_t ZigbeeServer::shadowSuppressed() {
+    uint32_t suppressed = 0;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        suppressed = _shadow.suppressed();
+        xSemaphoreGive(_inputMutex);
+    }
+    return suppressed;
+}
+
+// Gửi lệnh cho các thuộc tính đang lệch, mỗi thuộc tính tối đa một lệnh đang chờ
+void ZigbeeServer::reconcile() {
+    std::vector<std::pair<std::string, std::string>> commands;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    _shadow.pending([&commands](ShadowEntry& entry) {
+        commands.emplace_back(entry.id, std::string(entry.key) + ":" + entry.desired);
+        entry.inflight = true;
+    });
+    xSemaphoreGive(_inputMutex);
+
+    for (const auto& command : commands) {
+        DLOGI(zigbeeLog, "Shadow sync %s %s", command.first.c_str(), command.second.c_str());
+        sendCommand(command.first.c_str(), command.second.c_str());
+    }
+}
+
+// Cập nhật giá trị thiết bị báo về từ danh sách key:value (ACK lệnh hoặc DATA)
+void ZigbeeServer::reportShadow(const std::string& id, const std::string& pairs, char separator) {
+    bool tracked = false;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) != pdTRUE) return;
+    if (_shadow.size() > 0) {
+        size_t start = 0;
+        while (start < pairs.size()) {
+            size_t end = pairs.find(separator, start);
+            if (end == std::string::npos) end = pairs.size();
+            size_t colon = pairs.find(':', start);
+            if (colon != std::string::npos && colon < end) {
+                std::string key = pairs.substr(start, colon - start);
+                std::string value = pairs.substr(colon + 1, end - colon - 1);
+                tracked |= _shadow.setReported(id.c_str(), key.c_str(), value.c_str());
+            }
+            start = end + 1;
+        }
+    }
+    xSemaphoreGive(_inputMutex);
+    // Giá trị mong muốn có thể đã đổi trong lúc chờ thiết bị báo lại
+    if (tracked) {
+        _reactor.notify(_shadowEvent);
+    }
+}
+
+void ZigbeeServer::enqueue(const std::string& message) {
+    QueuedCommand command;
+    command.message = message;
+#ifdef LATENCY_TRACE
+    command.enqueued = micros();
+#endif
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        messageQueue.push(std::move(command));
+        xSemaphoreGive(_inputMutex);
+    }
+    _reactor.notify(_commandEvent);
+}
+
+bool ZigbeeServer::dequeue(QueuedCommand& command) {
+    bool found = false;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        if (!messageQueue.empty()) {
+            command = std::move(messageQueue.front());
+            messageQueue.pop();
+            found = true;
+        }
+        xSemaphoreGive(_inputMutex);
+    }
+    return found;
+}
+
+// Ghi lại mọi khung RX/TX vào vòng đệm capture (bytes = 0 để tắt)
+bool ZigbeeServer::enableCapture(size_t bytes) {
+    if (bytes == 0) {
+        _capture.end();
+        return true;
+    }
+    return _capture.begin(bytes);
+}
+
+void ZigbeeServer::disableCapture() {
+    _capture.end();
+}
+
+FrameCapture& ZigbeeServer::capture() {
+    return _capture;
+}
+
+TaskHandle_t ZigbeeServer::taskHandle() const {
+    return _reactor.taskHandle();
+}
+
+const Reactor& ZigbeeServer::reactor() const {
+    return _reactor;
+}
+
+size_t ZigbeeServer::queueDepth() {
+    size_t depth = 0;
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        depth = messageQueue.size();
+        xSemaphoreGive(_inputMutex);
+    }
+    return depth;
+}
+
+/**
+ * @name forEachDevice
+ * @brief Duyệt danh sách chính rồi danh sách chờ, gọi được từ task khác. Giữ _registryMutex suốt lúc duyệt
+ * nên callback phải ngắn và không gọi lại ZigbeeServer
+ *
+ * @param {std::function} callback - Nhận thiết bị và true nếu đang chờ cấp phép
+ *
+ * @return None
+ */
+void ZigbeeServer::forEachDevice(std::function<void(const Device& device, bool pending)> callback) {
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    for (const Device& device : deviceList) {
+        callback(device, false);
+    }
+    for (const Device& device : pendingDeviceList) {
+        callback(device, true);
+    }
+    xSemaphoreGive(_registryMutex);
+}
+
+// Các baud thử khi thương lượng, từ cao xuống thấp
+static const uint32_t baudRates[] = {921600, 460800, 230400, 115200, 57600, 38400, 19200};
+
+/**
+ * @name renegotiateBaud
+ * @brief Thương lượng lại baud với coordinator, tới ZigbeeTransport::maxBaud (vd: sau khi cập nhật firmware
+ * coordinator). begin() tự gọi khi maxBaud lớn hơn baud ban đầu. Gọi được từ task khác.
+ *
+ * Bắt tay (khung ASCII hoặc nhị phân như mọi khung khác):
+ *   -> CMD:BAUD:<rate>           ở baud hiện tại
+ *   <- CMD:BAUD:<rate>:OK|NO     coordinator chuyển sang rate ngay sau khi gửi OK
+ *   -> CMD:BAUD:<rate>:CHECK     ở baud mới
+ *   <- CMD:BAUD:<rate>:CHECK     server gửi lại CHECK tới ZIGBEE_CONNECT_RETRY lần rồi mới về baud cũ;
+ *                                coordinator về baud cũ nếu không nhận được CHECK trong
+ *                                ZIGBEE_BAUD_TIMEOUT * ZIGBEE_CONNECT_RETRY sau khi gửi OK
+ * Coordinator không nghe được khung hợp lệ nào trong ZIGBEE_BAUD_RETRY / 2 thì về baud ban đầu.
+ */
+void ZigbeeServer::renegotiateBaud() {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        _baudRequest = true;
+        xSemaphoreGive(_inputMutex);
+    }
+    _reactor.notify(_baudEvent);
+}
+
+uint32_t ZigbeeServer::linkBaud() const {
+    return _baud;
+}
+
+// Bỏ khung DATA trùng (trả lời muộn của lần get_data trước, coordinator gửi lại) trước khi phân tích
+bool ZigbeeServer::acceptSeq(Device& device, uint16_t seq) {
+    switch (device.acceptSeq(seq)) {
+        case SEQ_DUPLICATE:
+        case SEQ_STALE:
+            health.count(HEALTH_DATA_DUPLICATES);
+            DLOGD(zigbeeLog, "Drop duplicate DATA %s seq %u", device.id, (unsigned)seq);
+            return false;
+        case SEQ_RESTART:
+            DLOGI(zigbeeLog, "%s restarted sequence at %u", device.id, (unsigned)seq);
+            return true;
+        default:
+            return true;
+    }
+}
+
+// Chạy trên task của server: thương lượng khi được yêu cầu, hạ baud khi tỉ lệ lỗi cao, thử lại khi tới hạn
+void ZigbeeServer::negotiateBaud() {
+    if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        if (_baudRequest) {
+            _baudRequest = false;
+            _baudCeiling = _transport.maxBaud;
+            _baudAttempts = 0;
+            _baudDue = true;
+        }
+        xSemaphoreGive(_inputMutex);
+    }
+    if (!_baudDue) return;
+    _baudDue = false;
+    _reactor.disarm(_baudTimer);
+
+    if (_baudFallback) {
+        _baudFallback = false;
+        uint32_t lower = _transport.baud;
+        for (uint32_t rate : baudRates) {
+            if (rate < _baud && rate > lower) {
+                lower = rate;
+                break;
+            }
+        }
+        DLOGW(zigbeeLog, "%s: link errors at %u baud, falling back to %u", _transport.name, (unsigned)_baud,
+              (unsigned)lower);
+        _baudCeiling = lower;
+        ++_baudFallbacks;
+        if (switchBaud(lower) != BAUD_SWITCHED) {
+            // Coordinator không nghe được: về baud ban đầu, coordinator cũng tự về khi không còn khung hợp lệ
+            setBaud(_transport.baud);
+            _reactor.arm(_baudTimer, ZIGBEE_BAUD_RETRY);
+        }
+        return;
+    }
+
+    for (uint32_t rate : baudRates) {
+        if (rate > _baudCeiling || rate <= _baud) continue;
+        BaudResult result = switchBaud(rate);
+        if (result == BAUD_SWITCHED) return;
+        if (result == BAUD_NO_REPLY) {
+            // Coordinator cũ không biết bắt tay, hoặc vẫn ở baud cao từ trước khi server khởi động lại
+            if (++_baudAttempts < ZIGBEE_CONNECT_RETRY) _reactor.arm(_baudTimer, ZIGBEE_BAUD_RETRY);
+            DLOGW(zigbeeLog, "%s: no baud handshake reply, staying at %u", _transport.name, (unsigned)_baud);
+            return;
+        }
+    }
+}
+
+ZigbeeServer::BaudResult ZigbeeServer::switchBaud(uint32_t rate) {
+    std::string request = "CMD:BAUD:" + std::to_string(rate);
+    std::string reply;
+    if (exchange(request, request + ":", reply)) {
+        _baudCapable = true;
+        if (reply.compare(request.size() + 1, std::string::npos, "OK") != 0) return BAUD_REFUSED;
+    } else if (!_baudCapable) {
+        return BAUD_NO_REPLY;
+    }
+    // Mất OK thì coordinator có thể đã chuyển rồi: vẫn thử CHECK ở baud mới. Gửi lại CHECK vì coordinator
+    // nhận được CHECK là đã chốt baud mới, mất câu trả lời mà bỏ cuộc thì hai phía lệch nhau
+    uint32_t previous = _baud;
+    setBaud(rate);
+    for (int attempt = 0; attempt < ZIGBEE_CONNECT_RETRY; ++attempt) {
+        if (exchange(request + ":CHECK", request + ":CHECK", reply)) {
+            DLOGI(zigbeeLog, "%s: link at %u baud", _transport.name, (unsigned)rate);
+            return BAUD_SWITCHED;
+        }
+    }
+    DLOGW(zigbeeLog, "%s: %u baud check failed, back to %u", _transport.name, (unsigned)rate, (unsigned)previous);
+    setBaud(previous);
+    return BAUD_CHECK_FAILED;
+}
+
+void ZigbeeServer::setBaud(uint32_t rate) {
+    _zigbeeSerial->flush();
+    _zigbeeSerial->updateBaudRate(rate);
+    _baud = rate;
+    _rxBuffer.clear();
+    _rxBinary = false;
+    _linkFrames = 0;
+    _linkErrors = 0;
+}
+
+// Gửi một khung và chờ khung bắt đầu bằng expect; khung khác tới trong lúc chờ được xử lý như thường
+bool ZigbeeServer::exchange(const std::string& frame, const std::string& expect, std::string& reply) {
+    transmit(frame);
+    unsigned long start = millis();
+    while (millis() - start < ZIGBEE_BAUD_TIMEOUT) {
+        std::string& received = _incomingMessage;
+        if (readFrame(received)) {
+            _capture.record(FRAME_RX, received.c_str(), received.length());
+            if (received.compare(0, expect.size(), expect) == 0 && checkCRC32(received)) {
+                reply = received.substr(0, received.rfind(",CRC:"));
+                return true;
+            }
+            handleIncomingMessage(received);
+        } else {
+            unsigned long elapsed = millis() - start;
+            if (elapsed < ZIGBEE_BAUD_TIMEOUT) {
+                _reactor.waitFor(_rxEvent, ZIGBEE_BAUD_TIMEOUT - elapsed);
+            }
+        }
+    }
+    return false;
+}
+
+// Đếm khung đúng/sai theo cửa sổ ZIGBEE_LINK_WINDOW khung, quá ZIGBEE_LINK_MAX_ERRORS lỗi thì hạ baud
+void ZigbeeServer::sampleLink(bool error) {
+    if (error) {
+        health.count(HEALTH_CRC_ERRORS);
+        ++_linkErrors;
+    } else {
+        ++_linkFrames;
+    }
+    if (_linkFrames + _linkErrors < ZIGBEE_LINK_WINDOW) return;
+    if (_linkErrors > ZIGBEE_LINK_MAX_ERRORS && _baud > _transport.baud && !_baudFallback) {
+        _baudFallback = true;
+        _baudDue = true;
+        _reactor.notify(_baudEvent);
+    }
+    _linkFrames = 0;
+    _linkErrors = 0;
+}
+
+// Thời điểm nhận khung đang được xử lý, dùng trong callback onMessage (0 khi tắt LATENCY_TRACE)
+uint32_t ZigbeeServer::rxStamp() const {
+#ifdef LATENCY_TRACE
+    return _rxStamp;
+#else
+    return 0;
+#endif
+}
+
 void ZigbeeServer::initZigbee() {
-    _zigbeeSerial->begin(9600, SERIAL_8N1, 16, 17); // Thay đổi RX_PIN và TX_PIN theo cấu hình của bạn
+    _zigbeeSerial->onReceive([this]() { _reactor.notify(_rxEvent); });
+    // Buffer của driver phải đặt trước begin()
+    if (_transport.rxBuffer > 0) _zigbeeSerial->setRxBufferSize(_transport.rxBuffer);
+    if (_transport.txBuffer > 0) _zigbeeSerial->setTxBufferSize(_transport.txBuffer);
+    _zigbeeSerial->begin(_transport.baud, SERIAL_8N1, _transport.rxPin, _transport.txPin);
+    if (_transport.ctsPin >= 0 || _transport.rtsPin >= 0) {
+        _zigbeeSerial->setPins(_transport.rxPin, _transport.txPin, _transport.ctsPin, _transport.rtsPin);
+        _zigbeeSerial->setHwFlowCtrlMode(_transport.ctsPin < 0 ? UART_HW_FLOWCTRL_RTS :
+                                         _transport.rtsPin < 0 ? UART_HW_FLOWCTRL_CTS : UART_HW_FLOWCTRL_CTS_RTS);
+    }
+    _baud = _transport.baud;
+    if (_transport.maxBaud > _transport.baud) {
+        renegotiateBaud();
+    }
     // _zigbeeSerial->println("AT+ZSET:ROLE=COORD");
     // delay(1000);
     // _zigbeeSerial->println("AT+PANID=1234");
@@ -182,7 +1106,7 @@ void ZigbeeServer::initZigbee() {
     // _zigbeeSerial->println("AT+START");  
 }
 
-uint32_t calculateCRC32(const char* data, size_t length) {
+uint32_t ZigbeeServer::calculateCRC32(const char* data, size_t length) {
     uint32_t crc = 0xffffffff;
     while (length--) {
         uint8_t c = *data++;
@@ -200,7 +1124,7 @@ uint32_t calculateCRC32(const char* data, size_t length) {
     return ~crc;
 }
 
-bool checkCRC32(const std::string& data_with_crc) {
+bool ZigbeeServer::checkCRC32(const std::string& data_with_crc) {
     size_t pos = data_with_crc.rfind(",CRC:");
     if (pos == std::string::npos) {
         return false;
@@ -226,12 +1150,20 @@ bool checkCRC32(const std::string& data_with_crc) {
 }
 
 bool ZigbeeServer::handleIncomingMessage(const std::string& message){
-    ESP_LOGE("handleIncomingMessage", "Free time!");
+    DLOGV(zigbeeLog, "Free time!");
     if (!checkCRC32(message)) {
-        ESP_LOGE("handleIncomingMessage", "Invalid CRC");
+        DLOGE(zigbeeLog, "Invalid CRC");
+        sampleLink(true);
         return false;
     }
+    sampleLink(false);
+    // Trả lời bắt tay baud tới sau khi đã hết hạn chờ
+    if (message.compare(0, 9, "CMD:BAUD:") == 0) return true;
 
+    if(message.find(",BACK:") != std::string::npos) {
+        if (_bulk.handleAck(message)) _reactor.notify(_bulkEvent);
+        return true;
+    }
     if(message.find("CMD:") != std::string::npos) handleCommand(message);
     if(message.find("DATA:") != std::string::npos) handleData(message);
 
@@ -239,20 +1171,28 @@ bool ZigbeeServer::handleIncomingMessage(const std::string& message){
 }
 
 bool ZigbeeServer::handleIncomingMessage(const std::string& message, const std::string& cmd, const std::string& id, bool check_id) {
-    ESP_LOGE("handleIncomingMessage", "Queue!");
+    DLOGV(zigbeeLog, "Queue!");
     if (!checkCRC32(message)) {
-        ESP_LOGE("handleIncomingMessage", "Invalid CRC");
+        DLOGE(zigbeeLog, "Invalid CRC");
+        sampleLink(true);
         return false;
     }
+    sampleLink(false);
 
-    if(message.find("CMD:") != std::string::npos) {
+    if(message.find(",BACK:") != std::string::npos) {
+        // ACK khối bulk tới trong lúc chờ ACK lệnh: không phải câu trả lời đang chờ
+        if (_bulk.handleAck(message)) _reactor.notify(_bulkEvent);
+        return false;
+    } else if(message.find("CMD:") != std::string::npos) {
         handleCommand(message);
         std::string incoming_command = message.substr(message.find("CMD:")+4, message.find(",CRC:") - message.find("CMD:") -4);
+        // get_schema được trả lời bằng CMD:schema:<spec>
+        bool reply = incoming_command == cmd || (cmd == "get_schema" && incoming_command.compare(0, 7, "schema:") == 0);
         if(check_id){
-            ESP_LOGI("handleMessage", "CMD: %s, Coming CMD: %s", cmd.c_str(), incoming_command.c_str());
-            return (incoming_command == cmd && id == message.substr(3, message.find(",")-message.find("ID:")-3));
+            DLOGI(zigbeeLog, "CMD: %s, Coming CMD: %s", cmd.c_str(), incoming_command.c_str());
+            return (reply && id == message.substr(3, message.find(",")-message.find("ID:")-3));
         }
-        else return incoming_command == cmd;
+        else return reply;
     } else if(message.find("DATA:") != std::string::npos) {
         handleData(message);
         
@@ -262,160 +1202,254 @@ bool ZigbeeServer::handleIncomingMessage(const std::string& message, const std::
         else return (cmd == "get_data" || cmd == "reset_data");
 
     } else {
-        ESP_LOGE("handleIncomingMessage", "Invalid message: %s", message.c_str());
+        DLOGE(zigbeeLog, "Invalid message: %s", message.c_str());
     }
 }
 
 void ZigbeeServer::handleCommand(const std::string& message) {
-    std::string id = message.substr(3, message.find(",") - message.find("ID:") - 3);
-    std::string command = message.substr(message.find("CMD:") + 4, message.find(",CRC:") - message.find("CMD:") - 4);
-    ESP_LOGI("zigbeeServer", "In handleCommand - ID: %s, Command: %s", id.c_str(), command.c_str());
-    
-    if (command == "BRD:DISC") {
-        auto it = std::find_if(deviceList.begin(), deviceList.end(), [&id](const Device& device) {
-            return device.id == id;
-        });
-
-        if (it == deviceList.end()) {
-            auto pendingIt = std::find_if(pendingDeviceList.begin(), pendingDeviceList.end(), [&id](const Device& device) {
-                return device.id == id;
-            });
-            if(pendingIt == pendingDeviceList.end()){
-                addPenddingDevice(id.c_str());
-                if (onChangeCallback) {
-                    onChangeCallback();
-                }
-            }
+    CommandFrame frame(message);
+    DLOGI(zigbeeLog, "In handleCommand - ID: %s, Command: %s", frame.id.c_str(), frame.command.c_str());
+    confirmGroupMember(frame.id, frame.command);
+    reportShadow(frame.id, frame.command, '\0');
 
-            ESP_LOGI("handleCommand", "Pending devices:");
-            for (const auto& device : pendingDeviceList) {
-                ESP_LOGI("handleCommand", "  ID: %s", device.id.c_str());
-            }            
-        }
-    } else if(command.find("led_status:") != std::string::npos){
-        std::string status = command.substr(command.find(":") + 1);
-        ESP_LOGI("zigbeeServer", "LED Status for device %s: %s", id.c_str(), status.c_str());
-        
-        auto it = std::find_if(deviceList.begin(), deviceList.end(), 
-            [&id](const Device& device) { return device.id == id; });
-        if (it != deviceList.end()) {
-            it->status = status;
-            ESP_LOGI("zigbeeServer","Status change to %s", it->status);
-            if (onChangeCallback) {
-                onChangeCallback();
-            }
-        }
-        else{
-            auto pendingIt = std::find_if(pendingDeviceList.begin(), pendingDeviceList.end(), [&id](const Device& device) {
-                return device.id == id;
-            });
-            if(pendingIt == pendingDeviceList.end()){
-                addPenddingDevice(id.c_str());
-                if (onChangeCallback) {
-                    ESP_LOGI("zigbeeServer", "OnChangeCallback!");
-                    onChangeCallback();
-                    ESP_LOGI("zigbeeServer", "End Callback!");
-                }
-            }
+    const BuiltinCommand *builtin = builtinCommand(frame.hash);
+    if (builtin != nullptr && frame.name == builtin->name && (this->*builtin->handler)(frame)) return;
 
-            ESP_LOGI("handleCommand", "Pending devices:");
-            for (const auto& device : pendingDeviceList) {
-                ESP_LOGI("handleCommand", "  ID: %s", device.id.c_str());
-            }       
-        }
-    } else if(command.find("reset_data") != std::string::npos){
-        addDevice(id.c_str()); //check get_data
-        auto it = std::find_if(deviceList.begin(), deviceList.end(), [&id](const Device& device) { 
-                return device.id == id; 
-            });
-        if (it != deviceList.end()) {
-            handleData(message);
-            ESP_LOGI("zigbeeServer", "Resetting data for device %s", id.c_str());
-            if (onChangeCallback) {
-                onChangeCallback();
-            }
-        }
-        else{
-            auto pendingIt = std::find_if(pendingDeviceList.begin(), pendingDeviceList.end(), [&id](const Device& device) {
-                return device.id == id;
-            });
-            if(pendingIt == pendingDeviceList.end()){
-                addPenddingDevice(id.c_str());
-                if (onChangeCallback) {
-                    onChangeCallback();
-                }
-            }
+    auto registered = _commands.find(frame.hash);
+    if (registered != _commands.end() && registered->second.name == frame.name) {
+        registered->second.handler(frame);
+        return;
+    }
 
-            ESP_LOGI("handleCommand", "Pending devices:");
-            for (const auto& device : pendingDeviceList) {
-                ESP_LOGI("handleCommand", "  ID: %s", device.id.c_str());
-            } 
-        }
-    }    else if(command.find("set_secret_key") != std::string::npos){
-        addDevice(id.c_str()); //check get_data
-        std::string secret_key = command.substr(command.find(":") + 1);
-        auto it = std::find_if(deviceList.begin(), deviceList.end(), [&id](const Device& device) { 
-                return device.id == id; 
-            });
-        if (it != deviceList.end()) {
-            ESP_LOGI("zigbeeServer", "Set secret key for device %s : %s", id.c_str(), secret_key.c_str());
-            if (onChangeCallback) {
-                onChangeCallback();
-            }
-        }
-        else{
-            auto pendingIt = std::find_if(pendingDeviceList.begin(), pendingDeviceList.end(), [&id](const Device& device) {
-                return device.id == id;
-            });
-            if(pendingIt == pendingDeviceList.end()){
-                addPenddingDevice(id.c_str());
-                if (onChangeCallback) {
-                    onChangeCallback();
-                }
-            }
+    if (messageCallback) {
+        messageCallback(frame.id.c_str(), frame.command.c_str());
+    }
+}
+
+// Bảng lệnh có sẵn, nhãn case là hash tính lúc biên dịch: hai tên trùng hash sẽ báo lỗi "duplicate case value"
+const ZigbeeServer::BuiltinCommand* ZigbeeServer::builtinCommand(uint32_t hash) {
+    static const BuiltinCommand commands[] = {
+        {"BRD", &ZigbeeServer::handleDiscover},
+        {"led_status", &ZigbeeServer::handleLedStatus},
+        {"reset_data", &ZigbeeServer::handleResetData},
+        {"set_secret_key", &ZigbeeServer::handleSecretKey},
+        {"get_data", &ZigbeeServer::handleGetData},
+        {"schema", &ZigbeeServer::handleSchema},
+    };
+    switch (hash) {
+        case commandHash("BRD"): return &commands[0];
+        case commandHash("led_status"): return &commands[1];
+        case commandHash("reset_data"): return &commands[2];
+        case commandHash("set_secret_key"): return &commands[3];
+        case commandHash("get_data"): return &commands[4];
+        case commandHash("schema"): return &commands[5];
+        default: return nullptr;
+    }
+}
+
+/**
+ * @name onCommand
+ * @brief Đăng ký handler cho lệnh riêng của ứng dụng, gọi trước begin().
+ * Lệnh không có trong bảng có sẵn lẫn danh sách đăng ký được chuyển cho onMessage như trước
+ *
+ * @param {const char*} name - Tên lệnh, phần sau CMD: tới ':' hoặc ',' đầu tiên
+ * @param {CommandHandler} handler - Chạy trên task của server với khung đã tách
+ *
+ * @return {bool} - False nếu tên (hoặc hash của nó) trùng lệnh có sẵn hay lệnh đã đăng ký khác tên
+ */
+bool ZigbeeServer::onCommand(const char *name, CommandHandler handler) {
+    uint32_t hash = commandHash(name);
+    if (builtinCommand(hash) != nullptr) {
+        DLOGE(zigbeeLog, "Command %s is built in", name);
+        return false;
+    }
+    auto it = _commands.find(hash);
+    if (it != _commands.end() && it->second.name != name) {
+        DLOGE(zigbeeLog, "Command %s collides with %s", name, it->second.name.c_str());
+        return false;
+    }
+    RegisteredCommand& command = _commands[hash];
+    command.name = name;
+    command.handler = handler;
+    return true;
+}
 
-            ESP_LOGI("handleCommand", "Pending devices:");
-            for (const auto& device : pendingDeviceList) {
-                ESP_LOGI("handleCommand", "  ID: %s", device.id.c_str());
-            }       
+// Thiết bị lạ gửi lệnh: đưa vào danh sách chờ cấp phép
+void ZigbeeServer::notePending(const std::string& id) {
+    Device *pendingIt = pendingDeviceList.find(id);
+    if(pendingIt == nullptr){
+        addPenddingDevice(id.c_str());
+        if (onChangeCallback) {
+            onChangeCallback();
         }
-    } else if(command.find("get_data") != std::string::npos) handleData(message);
+    }
 
-    else {
-        if (messageCallback) {
-            messageCallback(id.c_str(), command.c_str());
+    DLOGI(zigbeeLog, "Pending devices:");
+    for (const auto& device : pendingDeviceList) {
+        DLOGI(zigbeeLog, "  ID: %s", device.id);
+    }
+}
+
+bool ZigbeeServer::handleDiscover(const CommandFrame& frame) {
+    if (frame.args != "DISC") return false;
+
+    if (deviceList.find(frame.id) == nullptr) {
+        notePending(frame.id);
+    } else if (xSemaphoreTake(_inputMutex, portMAX_DELAY) == pdTRUE) {
+        // Thiết bị đã cấp phép tham gia lại mạng (vd: sau khi mất điện): đồng bộ lại trạng thái mong muốn
+        _shadow.rejoined(frame.id.c_str());
+        xSemaphoreGive(_inputMutex);
+        _reactor.notify(_shadowEvent);
+    }
+    return true;
+}
+
+bool ZigbeeServer::handleLedStatus(const CommandFrame& frame) {
+    if (frame.command.find(':') != frame.name.size()) return false;   // Thiếu ":<trạng thái>"
+    DLOGI(zigbeeLog, "LED Status for device %s: %s", frame.id.c_str(), frame.args.c_str());
+
+    Device *it = deviceList.find(frame.id);
+    if (it == nullptr) {
+        notePending(frame.id);
+        return true;
+    }
+    DeviceStatus previous = it->status;
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return true;
+    it->status = Device::parseStatus(frame.args);
+    xSemaphoreGive(_registryMutex);
+    DLOGI(zigbeeLog, "Status change to %s", Device::statusName(it->status));
+    if (it->status != previous) {
+        registryChanged();
+    }
+    if (onChangeCallback) {
+        onChangeCallback();
+    }
+    return true;
+}
+
+bool ZigbeeServer::handleResetData(const CommandFrame& frame) {
+    if (deviceList.find(frame.id) == nullptr) {
+        notePending(frame.id);
+        return true;
+    }
+    handleData(frame.message);
+    DLOGI(zigbeeLog, "Resetting data for device %s", frame.id.c_str());
+    if (onChangeCallback) {
+        onChangeCallback();
+    }
+    return true;
+}
+
+bool ZigbeeServer::handleSecretKey(const CommandFrame& frame) {
+    Device *it = deviceList.find(frame.id);
+    if (it == nullptr) {
+        notePending(frame.id);
+        return true;
+    }
+    DLOGI(zigbeeLog, "Set secret key for device %s : %s", frame.id.c_str(), frame.args.c_str());
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return true;
+    snprintf(it->secret_key, sizeof(it->secret_key), "%s", frame.args.c_str());
+    xSemaphoreGive(_registryMutex);
+    registryChanged();
+    if (onChangeCallback) {
+        onChangeCallback();
+    }
+    return true;
+}
+
+bool ZigbeeServer::handleGetData(const CommandFrame& frame) {
+    handleData(frame.message);
+    return true;
+}
+
+// Thiết bị báo danh sách field (CMD:schema:<spec>), lưu cùng registry để khung DATA sau chỉ cần giá trị
+bool ZigbeeServer::handleSchema(const CommandFrame& frame) {
+    Device *it = deviceList.find(frame.id);
+    if (it == nullptr) {
+        notePending(frame.id);
+        it = pendingDeviceList.find(frame.id);
+        if (it == nullptr) return true;
+    }
+    int index = _schemas.intern(frame.args.c_str());
+    if (index < 0 && SchemaTable::valid(frame.args.c_str()) && xSemaphoreTake(_registryMutex, portMAX_DELAY) == pdTRUE) {
+        _schemas.compact(deviceList, pendingDeviceList);
+        xSemaphoreGive(_registryMutex);
+        index = _schemas.intern(frame.args.c_str());
+    }
+    if (index < 0) {
+        DLOGE(zigbeeLog, "Cannot store schema of %s: %s", frame.id.c_str(), frame.args.c_str());
+        return true;
+    }
+    if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return true;
+    it->schemaRequested = false;
+    bool changed = it->schema != index + 1;
+    it->schema = index + 1;
+    xSemaphoreGive(_registryMutex);
+    if (changed) {
+        DLOGI(zigbeeLog, "Schema of %s: %s", frame.id.c_str(), frame.args.c_str());
+        if (deviceList.find(frame.id) == it) {
+            registryChanged();
         }
     }
+    return true;
+}
+
+// Khung DATA theo vị trí mà chưa có (hoặc sai) schema: hỏi lại thiết bị một lần, bỏ các khung tới khi có
+void ZigbeeServer::requestSchema(Device *device) {
+    if (device->schemaRequested || xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+    device->schemaRequested = true;
+    xSemaphoreGive(_registryMutex);
+    DLOGW(zigbeeLog, "Request schema of %s", device->id);
+    sendCommand(device->id, "get_schema");
 }
 
 void ZigbeeServer::handleData(const std::string& message) {
-    ESP_LOGI("zigbeeServer", "In handle data.");
+    DLOGI(zigbeeLog, "In handle data.");
     size_t pos = message.find(",DATA:");
-    std::string id = message.substr(3, pos - 3); // Skip "ID:"
-    std::string data = message.substr(pos + 6, message.find(",CRC:") - pos - 6);
+    // SEQ tuỳ chọn: ID:<id>,SEQ:<n>,DATA:...
+    size_t seqPos = message.rfind(",SEQ:", pos);
+    uint16_t seq = 0;
+    if (seqPos != std::string::npos) {
+        seq = strtoul(message.c_str() + seqPos + 5, nullptr, 10);
+    }
+    std::string id = message.substr(3, std::min(pos, seqPos) - 3); // Skip "ID:"
 
-    addDevice(id.c_str()); //check get_data
-    auto it = std::find_if(deviceList.begin(), deviceList.end(), [&id](const Device& device) {
-            return device.id == id;
-        });
+    Device *it = deviceList.find(id);
     
-    if( it != deviceList.end()){
-        it->status = true;
-        ESP_LOGI("zigbeeServer", "Change device status %s", it->status.c_str());
+    if( it != nullptr){
+        if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
+        bool accepted = seqPos == std::string::npos || acceptSeq(*it, seq);
+        if (accepted) {
+            ++it->received;
+        }
+        xSemaphoreGive(_registryMutex);
+        if (!accepted) return;
+        std::string data = message.substr(pos + 6, message.find(",CRC:") - pos - 6);
+        // Không có ':' là khung theo vị trí, dạng key:value cũ đi thẳng
+        if (!data.empty() && data.find(':') == std::string::npos) {
+            const char *spec = it->schema ? _schemas.spec(it->schema - 1) : nullptr;
+            if (spec == nullptr || !SchemaTable::expand(spec, data, _expanded)) {
+                DLOGW(zigbeeLog, "Positional DATA from %s does not match schema: %s", id.c_str(), data.c_str());
+                requestSchema(it);
+                return;
+            }
+            data.swap(_expanded);
+        }
+        setDeviceOnline(id, true);
+        reportShadow(id, data, ',');
+        TRACE_SINCE(TRACE_SAMPLE_PARSE, _rxStamp);
         if (messageCallback) {
                 messageCallback(id.c_str(), data.c_str());
             }
     } else {
-        auto pendingIt = std::find_if(pendingDeviceList.begin(), pendingDeviceList.end(), [&id](const Device& device) {
-            return device.id == id;
-        });
-        if (pendingIt == pendingDeviceList.end())
+        Device *pendingIt = pendingDeviceList.find(id);
+        if (pendingIt == nullptr)
         {
             addPenddingDevice(id.c_str());
             if (onChangeCallback) {
-                ESP_LOGE("zigbeeServer", "onChange Callback!");
+                DLOGD(zigbeeLog, "onChange Callback!");
                 onChangeCallback();
-                ESP_LOGE("zigbeeServer", "End Callback!");
+                DLOGD(zigbeeLog, "End Callback!");
             }
         } 
     }   
@@ -423,32 +1457,34 @@ void ZigbeeServer::handleData(const std::string& message) {
 
 void ZigbeeServer::checkPendingDevices() {
     try {
-        if (millis() - timeCheck > 5000) {
-            timeCheck = millis();
-            ESP_LOGI("Check pending device","Check time: %d",timeCheck);
+        if (millis() - _pendingCheck >= ZIGBEE_PENDING_CHECK_INTERVAL) {
+            _pendingCheck = millis();
+            DLOGI(zigbeeLog, "Check time: %d",_pendingCheck);
             if (!pendingDeviceList.empty()) {
                 std::vector<std::string> keysToDelete;
+                keysToDelete.reserve(pendingDeviceList.size());
                 for (const auto& device : pendingDeviceList) {
                     if (millis() - device.lastest_t > 15000) {
-                        ESP_LOGI("zigbeeServer","Device time out %s", device.id.c_str());
+                        DLOGI(zigbeeLog, "Device time out %s", device.id);
                         keysToDelete.push_back(device.id);
                     }
                 }
+                if (xSemaphoreTake(_registryMutex, portMAX_DELAY) != pdTRUE) return;
                 for (const auto& key : keysToDelete) {
-                    pendingDeviceList.erase(
-                        std::remove_if(pendingDeviceList.begin(), pendingDeviceList.end(),
-                            [&key](const Device& d) { return d.id == key; }),
-                        pendingDeviceList.end());
-                    ESP_LOGI("zigbeeServer","Deleted!");
+                    pendingDeviceList.erase(pendingDeviceList.find(key));
+                }
+                xSemaphoreGive(_registryMutex);
+                for (size_t i = 0; i < keysToDelete.size(); ++i) {
+                    DLOGI(zigbeeLog, "Deleted!");
                     if (updateCallback) {
-                        ESP_LOGE("zigbeeServer", "updatePendingList Callback!");
+                        DLOGD(zigbeeLog, "updatePendingList Callback!");
                         updateCallback();
-                        ESP_LOGE("zigbeeServer", "End Callback!");
+                        DLOGD(zigbeeLog, "End Callback!");
                     }
                 }
             }
         }
     } catch (const std::exception& e) {
-        ESP_LOGE("ZigbeeServer", "Error checking pending devices: %s", e.what());
+        DLOGE(zigbeeLog, "Error checking pending devices: %s", e.what());
     }
 }
\ No newline at end of file
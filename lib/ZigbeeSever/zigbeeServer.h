@@ -4,59 +4,277 @@
 #include <vector>
 #include <string>
 #include <queue>
+#include <list>
 #include <functional>
 #include <map>
+#include <unordered_set>
+#include <unordered_map>
 #include <ArduinoJson.h>
 #include "HardwareSerial.h"
+#include "frameCapture.h"
+#include "LatencyTrace.h"
+#include "Health.h"
+#include "deviceTable.h"
+#include "deviceShadow.h"
+#include "registryStore.h"
+#include "dataSchema.h"
+#include "zigbeeCommand.h"
+#include "bulkTransfer.h"
+#include "frameCodec.h"
+#include "Reactor.h"
 #include <algorithm>
 #include <sstream>
 
+#ifndef ZIGBEE_CONNECT_RETRY
 #define ZIGBEE_CONNECT_RETRY 3
+#endif
+#ifndef ZIGBEE_CONNECT_TIMEOUT
 #define ZIGBEE_CONNECT_TIMEOUT 1000
+#endif
+#define ZIGBEE_PENDING_CHECK_INTERVAL 5000
+#ifndef ZIGBEE_GROUP_TIMEOUT
+#define ZIGBEE_GROUP_TIMEOUT 3000   // ms chờ ACK của các thành viên sau khi gửi một khung GROUP
+#endif
+#define ZIGBEE_MAX_GROUPS 16
+#ifndef ZIGBEE_REGISTRY_SAVE_DELAY
+#define ZIGBEE_REGISTRY_SAVE_DELAY 5000 // ms gom thay đổi danh sách thiết bị trước khi ghi flash
+#endif
 
-struct Device {
-    std::string id;
-    std::string zb_id;
-    std::string secret_key;
-    std::string status;
-    unsigned long lastest_t = 0;
+#ifndef ZIGBEE_MAX_BAUD
+#define ZIGBEE_MAX_BAUD 460800      // Baud cao nhất thử thương lượng với coordinator, 0 = giữ baud ban đầu
+#endif
+#ifndef ZIGBEE_RX_BUFFER
+#define ZIGBEE_RX_BUFFER 1024       // Byte buffer RX của driver UART, 0 = mặc định của core
+#endif
+#ifndef ZIGBEE_TX_BUFFER
+#define ZIGBEE_TX_BUFFER 512        // Byte buffer TX, 0 = ghi chặn tới khi byte vào FIFO
+#endif
+#define ZIGBEE_BAUD_TIMEOUT 300     // ms chờ trả lời mỗi bước bắt tay baud
+#define ZIGBEE_BAUD_RETRY 30000     // ms trước khi thương lượng lại sau khi mất liên lạc ở baud cao
+#define ZIGBEE_LINK_WINDOW 64       // Khung (kể cả lỗi) mỗi lần đánh giá tỉ lệ lỗi
+#define ZIGBEE_LINK_MAX_ERRORS 6    // Lỗi tối đa trong một cửa sổ (~10%) trước khi hạ baud
+#define ZIGBEE_MAX_FRAME 512        // Byte RX không có dấu kết thúc khung dài hơn thế là nhiễu
+
+// Cổng UART nối với một coordinator Zigbee
+struct ZigbeeTransport {
+    ZigbeeTransport(HardwareSerial *serial = &Serial1, int8_t rxPin = 16, int8_t txPin = 17,
+                    unsigned long baud = 9600, const char *name = "ZigbeeServerTask",
+                    unsigned long maxBaud = ZIGBEE_MAX_BAUD, size_t rxBuffer = ZIGBEE_RX_BUFFER,
+                    size_t txBuffer = ZIGBEE_TX_BUFFER, int8_t ctsPin = -1, int8_t rtsPin = -1)
+        : serial(serial), rxPin(rxPin), txPin(txPin), baud(baud), name(name), maxBaud(maxBaud),
+          rxBuffer(rxBuffer), txBuffer(txBuffer), ctsPin(ctsPin), rtsPin(rtsPin) {}
+    HardwareSerial *serial;
+    int8_t rxPin;
+    int8_t txPin;
+    unsigned long baud;     // Baud lúc khởi động, cũng là baud dự phòng cuối cùng
+    const char *name;       // Tên task, cũng dùng trong log
+    unsigned long maxBaud;
+    size_t rxBuffer;
+    size_t txBuffer;
+    int8_t ctsPin;          // -1 cả hai = không dùng RTS/CTS
+    int8_t rtsPin;
+};
+
+// Kết quả một lệnh nhóm: thành viên đã ACK và thành viên chưa ACK khi hết hạn
+struct GroupResult {
+    std::string group;
+    std::string command;
+    std::vector<std::string> confirmed;
+    std::vector<std::string> missing;
+};
+
+struct GroupTransaction {
+    GroupResult result;
+    uint32_t deadline;  // millis(), chỉ có nghĩa khi sent
+    bool sent;
+};
+
+struct QueuedCommand {
+    std::string message;
+#ifdef LATENCY_TRACE
+    uint32_t enqueued;  // micros() lúc vào hàng đợi
+#endif
 };
 
 class ZigbeeServer{
 
     public:
-        ZigbeeServer();
+        explicit ZigbeeServer(const ZigbeeTransport& transport = ZigbeeTransport(),
+                              size_t maxDevices = ZIGBEE_MAX_DEVICES, size_t maxPending = ZIGBEE_MAX_PENDING);
         void begin();
         void loop();
         void addDevice(const char *id);
         void addPenddingDevice(const char *id);
+        void provisionDevices(const std::vector<std::string>& ids);
         void updatePendingList(std::function<void()> callback);
         void onMessage(std::function<void(const char *id, const char *data)> callback);
         void onChange(std::function<void()> callback);
-        static ZigbeeServer* getInstance();
+        void onDeviceStatus(std::function<void(const char *id, bool online)> callback);
+        bool onCommand(const char *name, CommandHandler handler);
+        static uint32_t calculateCRC32(const char* data, size_t length);
+        static bool checkCRC32(const std::string& data_with_crc);
+        const char* name() const;
+        void persistRegistry(RegistryStore& store);
+        bool saveRegistry();
         void checkDevice(const char *id);
         void sendCommand(const char *id, const char *cmd);
         void sendCommand(const char *id, const char *secrect_key, const char *cmd);
         void broadcastMessage();
+        bool setDesired(const char *id, const char *key, const char *value);
+        uint32_t shadowSuppressed();
+
+        bool defineGroup(const char *gid, const std::vector<std::string>& members);
+        bool removeGroup(const char *gid);
+        std::map<std::string, std::vector<std::string>> groups();
+        bool sendGroupCommand(const char *gid, const char *cmd);
+        void onGroupResult(std::function<void(const GroupResult& result)> callback);
+
+        bool sendBulk(const char *id, uint32_t transfer, uint32_t size, BulkSource source);
+        bool resumeBulk();
+        void cancelBulk();
+        BulkStatus bulkStatus();
+        void onBulkResult(std::function<void(const BulkStatus& status)> callback);
 
-        std::vector<Device> deviceList;
-        std::vector<Device> pendingDeviceList;
+        bool enableCapture(size_t bytes);
+        void disableCapture();
+        FrameCapture& capture();
+        uint32_t rxStamp() const;
+        bool binaryFraming() const { return _binaryPeer; }
+        void renegotiateBaud();
+        uint32_t linkBaud() const;
+        uint32_t baudFallbacks() const { return _baudFallbacks; }
+        TaskHandle_t taskHandle() const;
+        const Reactor& reactor() const;
+        size_t queueDepth();
+        void forEachDevice(std::function<void(const Device& device, bool pending)> callback);
+
+        // Chỉ task của server ghi, luôn giữ _registryMutex khi ghi. Task khác đọc qua forEachDevice
+        DeviceTable deviceList;
+        DeviceTable pendingDeviceList;
 
     private:
+        // Lệnh có sẵn, handler trả false để lệnh rơi xuống lệnh ứng dụng / messageCallback
+        struct BuiltinCommand {
+            const char *name;
+            bool (ZigbeeServer::*handler)(const CommandFrame& frame);
+        };
+        struct RegisteredCommand {
+            std::string name;
+            CommandHandler handler;
+        };
+
         void initZigbee();
         bool handleIncomingMessage(const std::string& message, const std::string& cmd, const std::string& id,bool check_id = true);
         bool handleIncomingMessage(const std::string& message);
         void handleCommand(const std::string& message);
         void handleData(const std::string& message);
+        bool acceptSeq(Device& device, uint16_t seq);
+        static const BuiltinCommand* builtinCommand(uint32_t hash);
+        bool handleDiscover(const CommandFrame& frame);
+        bool handleLedStatus(const CommandFrame& frame);
+        bool handleResetData(const CommandFrame& frame);
+        bool handleSecretKey(const CommandFrame& frame);
+        bool handleGetData(const CommandFrame& frame);
+        bool handleSchema(const CommandFrame& frame);
+        void requestSchema(Device *device);
+        void notePending(const std::string& id);
         //void change_device_stt_by_ID(const std::string& id, bool status);
         void checkPendingDevices();
+        void setDeviceOnline(const std::string& id, bool online);
+        void applyProvisioning();
+        void processIncoming();
+        bool readFrame(std::string& frame);
+        enum BaudResult : uint8_t {
+            BAUD_SWITCHED,
+            BAUD_REFUSED,       // Coordinator không hỗ trợ rate này
+            BAUD_NO_REPLY,
+            BAUD_CHECK_FAILED   // Coordinator đồng ý nhưng đường truyền không chạy được ở rate này
+        };
+        void negotiateBaud();
+        BaudResult switchBaud(uint32_t rate);
+        void setBaud(uint32_t rate);
+        bool exchange(const std::string& frame, const std::string& expect, std::string& reply);
+        void sampleLink(bool error);
+        bool processCommand();
+        void enqueue(const std::string& message);
+        void reconcile();
+        void reportShadow(const std::string& id, const std::string& pairs, char separator);
+        void startGroupTransaction(const std::string& command);
+        void confirmGroupMember(const std::string& id, const std::string& cmd);
+        void expireGroups();
+        void finishGroups(std::vector<GroupResult>& finished);
+        bool dequeue(QueuedCommand& command);
+        void pumpBulk();
+        void transmit(const std::string& frame);
+        void registryChanged();
+        ZigbeeTransport _transport;
         HardwareSerial *_zigbeeSerial;
+        FrameCapture _capture;
+        Reactor _reactor;
+        uint32_t _rxEvent;
+        uint32_t _commandEvent;
+        uint32_t _provisionEvent;
 
-        static ZigbeeServer *_instance;
-        std::queue<std::string> messageQueue;
+        std::string _incomingMessage;   // Khung RX đang xử lý
+        std::string _rxBuffer;          // Khung RX đang nhận dở
+        bool _rxBinary = false;         // _rxBuffer là khung nhị phân (đã gặp 0x00 mở khung)
+        bool _binaryPeer = false;       // Coordinator nói khung nhị phân, TX dùng _codec
+        FrameCodec _codec;
+        // Baud của UART, chỉ dùng trên task của server
+        uint32_t _baud;
+        uint32_t _baudCeiling = 0;      // Không thử cao hơn, hạ xuống sau mỗi lần phải giảm baud vì lỗi
+        uint32_t _baudEvent;
+        int _baudTimer = -1;
+        uint8_t _baudAttempts = 0;
+        bool _baudDue = false;
+        bool _baudFallback = false;
+        bool _baudCapable = false;      // Coordinator đã từng trả lời bắt tay
+        bool _baudRequest = false;      // Bảo vệ bởi _inputMutex
+        uint32_t _baudFallbacks = 0;
+        uint16_t _linkFrames = 0;       // Cửa sổ đánh giá tỉ lệ lỗi hiện tại
+        uint16_t _linkErrors = 0;
+        unsigned long _pendingCheck = 0;   // millis() lần kiểm tra thiết bị chờ gần nhất
+        std::queue<QueuedCommand> messageQueue;
+        SemaphoreHandle_t _inputMutex = NULL; // Bảo vệ messageQueue và danh sách cấp phép khi gọi từ task khác
+        SemaphoreHandle_t _registryMutex = NULL; // Bảo vệ deviceList và pendingDeviceList, không gọi callback khi giữ
+        std::vector<std::string> _desiredDevices;
+        bool _provisionPending = false;
+        std::map<std::string, std::vector<std::string>> _groups;
+        std::list<GroupTransaction> _groupTransactions;  // Theo thứ tự gửi, cùng thứ tự với messageQueue
+        int _groupTimer = -1;
+        DeviceShadow _shadow;   // Bảo vệ bởi _inputMutex
+        uint32_t _shadowEvent;
+        SchemaTable _schemas;           // Schema DATA mà Device::schema trỏ tới, chỉ dùng trên task của server
+        std::string _expanded;          // Khung DATA theo vị trí sau khi ghép tên field
+        std::unordered_map<uint32_t, RegisteredCommand> _commands; // Lệnh ứng dụng theo commandHash(name), chỉ ghi trước begin()
+        BulkTransfer _bulk;             // Chỉ dùng trên task của server
+        uint32_t _bulkEvent;
+        int _bulkTimer = -1;
+        BulkState _bulkReported = BULK_IDLE;
+        // Yêu cầu từ task khác, bảo vệ bởi _inputMutex
+        struct BulkRequest {
+            std::string id;
+            uint32_t transfer;
+            uint32_t size;
+            BulkSource source;
+        };
+        std::vector<BulkRequest> _bulkRequest;  // Tối đa một yêu cầu chờ task server nhận
+        bool _bulkBusy = false;         // Có lần truyền chưa xong (kể cả tạm dừng)
+        bool _bulkResume = false;
+        bool _bulkCancel = false;
+        BulkStatus _bulkStatus;         // Bản sao cho task khác đọc
+        RegistryStore *_registryStore = nullptr;
+        int _registryTimer = -1;
+        bool _registryDirty = false;
+#ifdef LATENCY_TRACE
+        uint32_t _rxStamp = 0; // micros() khi nhận ký tự xuống dòng của khung đang xử lý
+#endif
         std::function<void(const char *id, const char *data)> messageCallback;
         std::function<void()> onChangeCallback;
         std::function<void()> updateCallback;
+        std::function<void(const char *id, bool online)> deviceStatusCallback;
+        std::function<void(const GroupResult& result)> groupResultCallback;
+        std::function<void(const BulkStatus& status)> bulkResultCallback;
 };
 
 #endif // ZIGBEESERVER_H
\ No newline at end of file
@@ -1,98 +1,133 @@
+// Sinh tự động bởi tools/build_page.py - không sửa tay,
+// sửa lib/web/index.html hoặc lib/web/static/ rồi build lại.
 #ifndef _index_page_h
 #define _index_page_h
 
 #include <pgmspace.h>
+#include "pageRenderer.h"
 
-const char index_html[] PROGMEM = R"rawliteral(
-<!DOCTYPE html>
-<html lang="en">
-  <head>
-    <meta charset="UTF-8" />
-    <meta name="viewport" content="width=device-width, initial-scale=1.0" />
-    <title>Document</title>
-    <style>
-      body {
-        font-family: Arial, Helvetica, sans-serif;
-      }
-      * {
-        box-sizing: border-box;
-      }
-      .container {
-        width: 100%;
-        max-width: 640px;
-        display: flex;
-        flex-direction: column;
-        margin: auto;
-        align-items: center;
-      }
-      .form {
-        border-radius: 5px;
-        background-color: #f2f2f2;
-        padding: 50px;
-      }
-      form {
-        display: flex;
-        flex-direction: column;
-        justify-content: center;
-        min-width: 320px;
-      }
-      input[type="text"],
-      select,
-      textarea {
-        width: 100%;
-        padding: 12px;
-        border: 1px solid #ccc;
-        border-radius: 4px;
-        box-sizing: border-box;
-        margin-top: 6px;
-        margin-bottom: 16px;
-        resize: vertical;
-      }
-      input[type="submit"] {
-        background-color: #04aa6d;
-        color: white;
-        padding: 12px 20px;
-        border: none;
-        border-radius: 4px;
-        cursor: pointer;
-        margin: 30px 0 0 0;
-      }
-      input[type="submit"]:hover {
-        background-color: #5bad5f;
-      }
-    </style>
-  </head>
-  <body>
-    <div class="container">
-      <h2>Setup ESP32</h2>
-      <div class="form">
-        <form action="/submit" method="POST">
-          <label for="ssid">Wifi SSID</label>
-          <input type="text" id="ssid" name="ssid" placeholder="$ssid" />
-          <label for="password">Wifi password</label>
-          <input type="text" id="password" name="password" placeholder="$password" />
-          <label for="lname">Device id</label>
-          <input type="text" id="device_id" name="device_id" placeholder="$device_id" />
-          <label for="lname">Client ID</label>
-          <input type="text" id="client_id" name="client_id" placeholder="$client_id" />
-          <label for="lname">MQTT Username</label>
-          <input type="text" id="mqtt_username" name="mqtt_username" placeholder="$mqtt_username" />
-          <label for="lname">mqtt_password</label>
-          <input type="text" id="mqtt_password" name="mqtt_password" placeholder="$mqtt_password" />
-          <input type="submit" value="Submit" />
-        </form>
-      </div>
-    </div>
-    <script>
-      window.onload = function() {
-        document.getElementById("ssid").value = "$ssid";
-        document.getElementById("password").value = "$password";
-        document.getElementById("device_id").value = "$device_id";
-        document.getElementById("name").value = "$name";
-      };
-    </script>
-  </body>
-</html>
-)rawliteral";
+enum PageVar : int8_t {
+  PAGE_VAR_NONE = -1,
+  PAGE_VAR_SSID,
+  PAGE_VAR_PASSWORD,
+  PAGE_VAR_DEVICE_ID,
+  PAGE_VAR_CLIENT_ID,
+  PAGE_VAR_MQTT_USERNAME,
+  PAGE_VAR_MQTT_PASSWORD,
+  PAGE_VAR_ACCESS_TOKEN,
+  PAGE_VAR_POLL_INTERVAL,
+};
 
-#endif
\ No newline at end of file
+const char index_chunk_0[] PROGMEM =
+  "<!DOCTYPE html>\n"
+  "<html lang=\"en\">\n"
+  "  <head>\n"
+  "    <meta charset=\"UTF-8\" />\n"
+  "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\" />\n"
+  "    <title>Document</title>\n"
+  "    <link rel=\"stylesheet\" href=\"/style.css\" />\n"
+  "  </head>\n"
+  "  <body>\n"
+  "    <div class=\"container\">\n"
+  "      <h2>Setup ESP32</h2>\n"
+  "      <div class=\"form\">\n"
+  "        <form action=\"/submit\" method=\"POST\">\n"
+  "          <label for=\"ssid\">Wifi SSID</label>\n"
+  "          <input type=\"text\" id=\"ssid\" name=\"ssid\" placeholder=\"";
+const char index_chunk_1[] PROGMEM =
+  "\" value=\"";
+const char index_chunk_2[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"password\">Wifi password</label>\n"
+  "          <input type=\"text\" id=\"password\" name=\"password\" placeholder=\"";
+const char index_chunk_3[] PROGMEM =
+  "\" value=\"";
+const char index_chunk_4[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"lname\">Device id</label>\n"
+  "          <input type=\"text\" id=\"device_id\" name=\"device_id\" placeholder=\"";
+const char index_chunk_5[] PROGMEM =
+  "\" value=\"";
+const char index_chunk_6[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"lname\">Client ID</label>\n"
+  "          <input type=\"text\" id=\"client_id\" name=\"client_id\" placeholder=\"";
+const char index_chunk_7[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"lname\">MQTT Username</label>\n"
+  "          <input type=\"text\" id=\"mqtt_username\" name=\"mqtt_username\" placeholder=\"";
+const char index_chunk_8[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"lname\">mqtt_password</label>\n"
+  "          <input type=\"text\" id=\"mqtt_password\" name=\"mqtt_password\" placeholder=\"";
+const char index_chunk_9[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"access_token\">Access token</label>\n"
+  "          <input type=\"text\" id=\"access_token\" name=\"access_token\" placeholder=\"";
+const char index_chunk_10[] PROGMEM =
+  "\" />\n"
+  "          <label for=\"poll_interval\">Poll interval (s)</label>\n"
+  "          <input type=\"text\" id=\"poll_interval\" name=\"poll_interval\" placeholder=\"";
+const char index_chunk_11[] PROGMEM =
+  "\" value=\"";
+const char index_chunk_12[] PROGMEM =
+  "\" />\n"
+  "          <input type=\"submit\" value=\"Submit\" />\n"
+  "        </form>\n"
+  "      </div>\n"
+  "    </div>\n"
+  "  </body>\n"
+  "</html>\n";
+
+const PageChunk index_chunks[] = {
+  {index_chunk_0, 479, PAGE_VAR_SSID},
+  {index_chunk_1, 9, PAGE_VAR_SSID},
+  {index_chunk_2, 131, PAGE_VAR_PASSWORD},
+  {index_chunk_3, 9, PAGE_VAR_PASSWORD},
+  {index_chunk_4, 126, PAGE_VAR_DEVICE_ID},
+  {index_chunk_5, 9, PAGE_VAR_DEVICE_ID},
+  {index_chunk_6, 126, PAGE_VAR_CLIENT_ID},
+  {index_chunk_7, 138, PAGE_VAR_MQTT_USERNAME},
+  {index_chunk_8, 138, PAGE_VAR_MQTT_PASSWORD},
+  {index_chunk_9, 142, PAGE_VAR_ACCESS_TOKEN},
+  {index_chunk_10, 150, PAGE_VAR_POLL_INTERVAL},
+  {index_chunk_11, 9, PAGE_VAR_POLL_INTERVAL},
+  {index_chunk_12, 112, PAGE_VAR_NONE},
+};
+#define INDEX_CHUNK_COUNT 13
+
+const uint8_t style_css_gz[] PROGMEM = {
+  0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x95, 0x53, 0xc1, 0x4e, 0xe3, 0x30,
+  0x10, 0xbd, 0xe7, 0x2b, 0x2c, 0x10, 0x17, 0x54, 0xa3, 0x50, 0x5a, 0x0e, 0xa9, 0x38, 0x70, 0xe3,
+  0x1f, 0x10, 0x87, 0x89, 0x3d, 0x69, 0x67, 0x71, 0x6c, 0xcb, 0x76, 0x4a, 0x0a, 0xe2, 0xdf, 0x19,
+  0xbb, 0x69, 0x61, 0xb7, 0xe5, 0xb0, 0xf2, 0x21, 0x99, 0xe7, 0xf1, 0x9b, 0xf7, 0x66, 0xec, 0xd6,
+  0xe9, 0x9d, 0xf8, 0xa8, 0x84, 0xe8, 0x9c, 0x4d, 0xb2, 0x83, 0x9e, 0xcc, 0xae, 0x11, 0x8f, 0x81,
+  0xc0, 0xcc, 0xc4, 0x13, 0x9a, 0x2d, 0x26, 0x52, 0x30, 0x13, 0x11, 0x6c, 0x94, 0x11, 0x03, 0x75,
+  0xab, 0xea, 0xb3, 0xba, 0x2e, 0x47, 0x5a, 0x37, 0xca, 0x48, 0xef, 0x64, 0xd7, 0x0d, 0xff, 0x07,
+  0x8d, 0x41, 0x32, 0x94, 0xf7, 0x6f, 0x14, 0xb3, 0x01, 0x59, 0x0c, 0x25, 0xf1, 0x8d, 0x74, 0xda,
+  0x34, 0xe2, 0xb6, 0xae, 0xaf, 0x56, 0x1c, 0xf6, 0x30, 0xca, 0x09, 0xba, 0x5f, 0xd4, 0x7e, 0xcc,
+  0x98, 0xa6, 0xe8, 0x0d, 0x70, 0xe9, 0xce, 0x60, 0x01, 0xf2, 0x57, 0x6a, 0x0a, 0xa8, 0x12, 0x39,
+  0xdb, 0x08, 0xe5, 0xcc, 0xd0, 0xdb, 0xfd, 0xf1, 0xb0, 0x26, 0x46, 0x60, 0x48, 0x2e, 0xc7, 0x60,
+  0x68, 0x6d, 0x25, 0x25, 0xec, 0x23, 0xa7, 0xa1, 0x4d, 0x18, 0x8a, 0x86, 0xce, 0x85, 0x7e, 0xd2,
+  0x59, 0xb4, 0x05, 0xd0, 0x34, 0x70, 0xca, 0x72, 0x5f, 0xb1, 0x05, 0xf5, 0xba, 0x0e, 0x6e, 0xb0,
+  0x5a, 0x32, 0xb7, 0x0b, 0x8d, 0xb8, 0xec, 0xe6, 0x79, 0xe5, 0x4d, 0x0f, 0x5a, 0x17, 0x5f, 0xcb,
+  0xa2, 0xef, 0xb3, 0x3a, 0x92, 0xfd, 0x87, 0xd0, 0x3f, 0x43, 0x4c, 0xd4, 0xed, 0x64, 0x6e, 0x06,
+  0xcb, 0xfa, 0x16, 0xc7, 0x1e, 0xc8, 0x1e, 0x5a, 0x70, 0x37, 0x9f, 0x4a, 0x90, 0xf5, 0x43, 0x7a,
+  0x4e, 0x3b, 0x8f, 0x0f, 0x17, 0x09, 0xc7, 0x74, 0xf1, 0x32, 0xab, 0x22, 0x1a, 0xe6, 0x9d, 0x55,
+  0x39, 0x86, 0x80, 0x70, 0xae, 0x9d, 0x47, 0xad, 0xb7, 0xf3, 0xc9, 0x59, 0xf1, 0xcb, 0xb1, 0x1f,
+  0x45, 0x74, 0x86, 0xb4, 0xb8, 0x54, 0x4a, 0xad, 0x4e, 0x3b, 0xb1, 0x38, 0xe4, 0x9f, 0x9f, 0xe3,
+  0xa1, 0xd5, 0x32, 0x39, 0xcf, 0xa3, 0xf2, 0x3f, 0xa1, 0xd6, 0xa5, 0xe4, 0x7a, 0xae, 0x31, 0xc1,
+  0x01, 0x99, 0x01, 0x1b, 0xb1, 0xc5, 0x90, 0x2f, 0x8c, 0xf9, 0xd7, 0x50, 0x1c, 0xda, 0x9e, 0xd8,
+  0xd2, 0x7e, 0x20, 0xa7, 0xad, 0xaf, 0x17, 0x00, 0xf7, 0x3a, 0x33, 0x4d, 0xc8, 0xdb, 0x86, 0x27,
+  0x7a, 0x62, 0x4f, 0xcc, 0xeb, 0xbf, 0x3d, 0x5a, 0x67, 0xf1, 0x77, 0x67, 0x6a, 0x08, 0x31, 0x93,
+  0x79, 0x47, 0xc7, 0xce, 0x4f, 0xb7, 0xe7, 0x8e, 0x89, 0x44, 0x9d, 0xd7, 0x6f, 0x52, 0x9b, 0x8d,
+  0xdb, 0x4e, 0x17, 0xf8, 0x8c, 0xe0, 0x65, 0x0b, 0x7a, 0x59, 0x1e, 0xc3, 0x17, 0x8f, 0x40, 0xd0,
+  0x05, 0x43, 0x03, 0x00, 0x00,
+};
+
+const StaticAsset static_assets[] = {
+  {"/style.css", "text/css", style_css_gz, 405, "\"05d0408f\""},
+};
+#define STATIC_ASSET_COUNT 1
+
+#endif
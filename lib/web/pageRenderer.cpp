@@ -0,0 +1,79 @@
+#include "pageRenderer.h"
+
+PageRenderer::PageRenderer(const PageChunk *chunks, size_t count, std::function<String(int8_t var)> resolve)
+    : _chunks(chunks), _count(count), _resolve(resolve)
+{
+}
+
+/**
+ * @name fill
+ * @brief Ghi phần tiếp theo của trang vào buffer
+ *
+ * @param {uint8_t*} buffer - Buffer của response
+ * @param {size_t} maxLen - Kích thước tối đa có thể ghi
+ *
+ * @return {size_t} - Số byte đã ghi, 0 khi đã hết trang
+ */
+size_t PageRenderer::fill(uint8_t *buffer, size_t maxLen)
+{
+  size_t written = 0;
+  while (written < maxLen && _chunk < _count)
+  {
+    const PageChunk &chunk = _chunks[_chunk];
+    const char *src;
+    size_t remaining;
+    if (_inValue)
+    {
+      src = _value.c_str() + _offset;
+      remaining = _value.length() - _offset;
+    }
+    else
+    {
+      src = chunk.text + _offset;
+      remaining = chunk.length - _offset;
+    }
+
+    size_t n = std::min(remaining, maxLen - written);
+    memcpy_P(buffer + written, src, n);
+    written += n;
+    _offset += n;
+    if (_offset < (_inValue ? _value.length() : chunk.length))
+    {
+      continue;
+    }
+
+    _offset = 0;
+    if (!_inValue && chunk.var >= 0)
+    {
+      _value = escape(_resolve(chunk.var));
+      _inValue = true;
+    }
+    else
+    {
+      _value = String();
+      _inValue = false;
+      ++_chunk;
+    }
+  }
+  return written;
+}
+
+String PageRenderer::escape(const String &value)
+{
+  String out;
+  out.reserve(value.length());
+  for (unsigned int i = 0; i < value.length(); ++i)
+  {
+    char c = value[i];
+    switch (c)
+    {
+    case '&': out += "&amp;"; break;
+    case '<': out += "&lt;"; break;
+    case '>': out += "&gt;"; break;
+    case '"': out += "&quot;"; break;
+    case '\'': out += "&#39;"; break;
+    default: out += c;
+    }
+  }
+  return out;
+}
@@ -0,0 +1,47 @@
+#ifndef _page_renderer_h
+#define _page_renderer_h
+
+#include <Arduino.h>
+#include <functional>
+
+struct PageChunk {
+  const char *text;   // Đoạn tĩnh trong flash
+  uint16_t length;
+  int8_t var;         // Placeholder nối sau đoạn tĩnh, -1 nếu không có
+};
+
+struct StaticAsset {
+  const char *url;
+  const char *contentType;
+  const uint8_t *gzip;
+  size_t length;
+  const char *etag;
+};
+
+/**
+ * @name PageRenderer
+ * @brief Stream trang template theo từng đoạn vào buffer của chunked response
+ *
+ * Mỗi placeholder chỉ được resolve khi tới lượt và được escape HTML,
+ * không có bản copy toàn trang nào trên heap.
+ */
+class PageRenderer
+{
+  public:
+    PageRenderer(const PageChunk *chunks, size_t count, std::function<String(int8_t var)> resolve);
+    size_t fill(uint8_t *buffer, size_t maxLen);
+
+  private:
+    static String escape(const String &value);
+
+    const PageChunk *_chunks;
+    size_t _count;
+    std::function<String(int8_t var)> _resolve;
+
+    size_t _chunk = 0;
+    size_t _offset = 0;
+    bool _inValue = false;
+    String _value;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "native_alloc.h"
+
+struct BenchCase {
+    const char *name;
+    std::function<void()> setup;
+    std::function<void()> run;     // Một lần chạy = một op
+};
+
+std::vector<BenchCase> &benchRegistry();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char *name, std::function<void()> setup, std::function<void()> run)
+    {
+        benchRegistry().push_back({name, setup, run});
+    }
+};
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+// BENCHMARK("tên", setup, run) - đăng ký một case khi khởi động chương trình
+#define BENCHMARK(name, setup, run) \
+    static BenchRegistrar BENCH_CONCAT(benchRegistrar_, __LINE__)(name, setup, run)
+
+// Ghi thêm một chỉ số riêng (vd: samples/s) cho case đang chạy
+void benchReport(const char *key, double value);
+
+// Hàm cho phép case tự khai báo số "đơn vị" xử lý trong một op (vd: số sample)
+void benchSetItemsPerOp(double items);
+
+template <typename T>
+inline void benchDoNotOptimize(T const &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif
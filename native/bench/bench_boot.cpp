@@ -0,0 +1,66 @@
+// Benchmark trình tự khởi động: setup() tuần tự cũ so với Boot chạy song song theo phụ thuộc.
+// Thời gian từng bước được mô phỏng bằng delay() (thu nhỏ ~100 lần so với thiết bị thật).
+#include "bench.h"
+#include "Boot.h"
+
+namespace {
+
+const uint32_t ingestMs = 1;
+const uint32_t zigbeeMs = 2;
+const uint32_t configMs = 1;
+const uint32_t wifiMs = 40;
+const uint32_t localApiMs = 2;
+const uint32_t ntpMs = 15;
+const uint32_t healthMs = 1;
+const uint32_t mqttMs = 20;
+const uint32_t reportMs = 1;
+
+void report(uint32_t start, uint32_t ingestReady, uint32_t apiReady)
+{
+    benchReport("boot_ms", millis() - start);
+    benchReport("ingest_ready_ms", ingestReady - start);
+    benchReport("local_api_ready_ms", apiReady - start);
+}
+
+// Thứ tự của setup() trước đây: callback Zigbee và hàng đợi metric có sau khi MQTT đã kết nối
+void runSequential()
+{
+    uint32_t start = millis();
+    delay(zigbeeMs);
+    delay(configMs);
+    delay(wifiMs);
+    delay(localApiMs);
+    uint32_t apiReady = millis();
+    delay(mqttMs);
+    delay(reportMs);
+    delay(ntpMs);
+    delay(healthMs);
+    delay(ingestMs);
+    report(start, millis(), apiReady);
+}
+
+void runStaged()
+{
+    uint32_t start = millis();
+    Boot staged;
+    int ingest = staged.inlineStage("ingest", [] { delay(ingestMs); });
+    staged.inlineStage("zigbee", [] { delay(zigbeeMs); }, {ingest});
+    int config = staged.inlineStage("config", [] { delay(configMs); });
+    int network = staged.stage("network", [] { delay(wifiMs); }, {config});
+    int api = staged.stage("local_api", [] { delay(localApiMs); }, {network});
+    staged.stage("ntp", [] { delay(ntpMs); }, {network});
+    staged.stage("health", [] { delay(healthMs); }, {network});
+    int mqtt = staged.stage("mqtt", [] { delay(mqttMs); }, {network});
+    staged.stage("report", [] { delay(reportMs); }, {mqtt});
+    staged.start();
+    while (!staged.done())
+    {
+        delay(1);
+    }
+    report(start, staged.readyAt(ingest), staged.readyAt(api));
+}
+
+}
+
+BENCHMARK("boot/sequential", nullptr, runSequential);
+BENCHMARK("boot/staged", nullptr, runStaged);
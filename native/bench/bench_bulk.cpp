@@ -0,0 +1,102 @@
+// Benchmark kênh bulk: thông lượng trên đường truyền giả lập có mất khung (native/sim/simBulk.h).
+// BulkTransfer chạy với đồng hồ ảo, thời gian truyền tính theo baud của UART nên goodput là số thật
+// của đường 9600 baud chứ không phải tốc độ CPU máy chạy benchmark. Ảnh nhận đủ và resume được kiểm tra
+// trong test/test_bulk.
+#include "bench.h"
+#include "simBulk.h"
+#include "zigbeeServer.h"
+
+namespace {
+
+const uint32_t imageSize = 16 * 1024;
+
+std::vector<uint8_t> image;
+
+void report(const SimBulkRun &run)
+{
+    benchReport("virtual_ms", run.elapsedMs);
+    benchReport("goodput_Bps", image.size() * 1000.0 / std::max<uint32_t>(run.elapsedMs, 1));
+    benchReport("wire_efficiency", (double)image.size() / run.wireBytes);
+    benchReport("blocks_sent", run.status.sent);
+    benchReport("retransmits", run.status.retransmits);
+}
+
+void setupImage()
+{
+    if (image.empty())
+    {
+        image = simBulkImage(imageSize);
+    }
+}
+
+}
+
+// Mốc so sánh: cửa sổ 1 block, mỗi block chờ ACK như lệnh thường
+BENCHMARK("bulk/16k_stop_and_wait", setupImage, [] {
+    report(simRunBulk(image, 0, 1));
+});
+
+// 16 KB, không mất khung: cửa sổ giữ đường truyền luôn bận, không chờ ACK từng block
+BENCHMARK("bulk/16k_lossless", setupImage, [] {
+    report(simRunBulk(image, 0));
+});
+
+// Mất 10% khung mỗi chiều: block mất được gửi lại ngay khi ACK của block sau báo thiếu
+BENCHMARK("bulk/16k_loss10", setupImage, [] {
+    report(simRunBulk(image, 10));
+});
+
+// Thiết bị mất kết nối ở block 100 lâu hơn số lần retry, lần truyền tạm dừng rồi tiếp tục từ block thiết bị cần
+BENCHMARK("bulk/16k_resume", setupImage, [] {
+    report(simRunBulk(image, 5, ZIGBEE_BULK_WINDOW, 100, 10000));
+});
+
+namespace {
+
+ZigbeeServer *bulkServer = nullptr;
+SimBulkDevice serverDevice;
+BulkStatus serverResult;
+
+void setupServerBulk()
+{
+    setupImage();
+    if (!bulkServer)
+    {
+        bulkServer = new ZigbeeServer();
+        bulkServer->provisionDevices({serverDevice.id});
+        bulkServer->onBulkResult([](const BulkStatus &status) { serverResult = status; });
+        bulkServer->loop();
+    }
+}
+
+size_t readImage(uint32_t offset, uint8_t *buffer, size_t length)
+{
+    memcpy(buffer, image.data() + offset, length);
+    return length;
+}
+
+}
+
+// Qua ZigbeeServer và Serial1 giả (không mất khung): chi phí CPU của một lần truyền 16 KB
+BENCHMARK("bulk/server_16k", setupServerBulk, [] {
+    serverResult = BulkStatus();
+    serverDevice = SimBulkDevice();
+    Serial1.onTransmit = [](const uint8_t *data, size_t length) {
+        std::string frame((const char *)data, length - 1);
+        std::string reply = serverDevice.handle(frame.substr(0, frame.rfind(",CRC:")));
+        if (!reply.empty())
+        {
+            char crc[9];
+            snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(reply.c_str(), reply.length()));
+            Serial1.inject(reply + ",CRC:" + crc + "\n");
+        }
+    };
+    bulkServer->sendBulk(serverDevice.id.c_str(), SIM_BULK_TRANSFER, image.size(), readImage);
+    while (serverResult.state == BULK_IDLE)
+    {
+        bulkServer->loop();
+    }
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+    benchReport("blocks_sent", serverResult.sent);
+});
@@ -0,0 +1,251 @@
+// Benchmark khung nhị phân (FrameCodec) so với khung ASCII: số byte trên dây mỗi loại khung, chi phí
+// mã hoá/giải mã, và một phiên lệnh + ACK + DATA qua ZigbeeServer với coordinator giả ở mỗi chế độ.
+#include "bench.h"
+#include "zigbeeServer.h"
+
+namespace {
+
+const char linkId[] = "TBE0123456789ZB";
+
+std::string asciiFrame(const std::string &body)
+{
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(body.c_str(), body.length()));
+    return body + ",CRC:" + crc + "\n";
+}
+
+std::string blockBody()
+{
+    uint8_t block[ZIGBEE_BULK_BLOCK_SIZE];
+    for (size_t i = 0; i < sizeof(block); ++i)
+    {
+        block[i] = i * 37 + 11;
+    }
+    std::string body = std::string("ID:") + linkId + ",BLK:F1A5C0DE:41:9C3E02B7:";
+    BulkTransfer::appendBase64(body, block, sizeof(block));
+    return body;
+}
+
+struct Sample
+{
+    const char *name;
+    std::string body;
+};
+
+std::vector<Sample> samples;
+
+void setupSamples()
+{
+    if (samples.empty())
+    {
+        std::string id = linkId;
+        samples = {
+            {"command", "ID:" + id + ",SECRECT_KEY:123,CMD:led_status:1"},
+            {"ack", "ID:" + id + ",CMD:led_status:1"},
+            {"data", "ID:" + id + ",DATA:voltage:230.1,current:1.25,power:287.6"},
+            {"data_positional", "ID:" + id + ",DATA:2301,125,2876"},
+            {"data_seq", "ID:" + id + ",SEQ:4711,DATA:voltage:230.1,current:1.25,power:287.6"},
+            {"discover", "CMD:BRD:DISC"},
+            {"bulk_block", blockBody()},
+            {"bulk_ack", "ID:" + id + ",BACK:F1A5C0DE:42:00000003"},
+        };
+    }
+}
+
+}
+
+// Byte trên dây mỗi khung ở trạng thái ổn định (ID đã BIND), kiểm tra giải mã trả lại đúng khung ASCII
+BENCHMARK("framing/bytes_per_frame", setupSamples, [] {
+    FrameCodec sender;
+    FrameCodec receiver;
+    size_t asciiTotal = 0;
+    size_t binaryTotal = 0;
+    bool roundTrip = true;
+    for (const Sample &sample : samples)
+    {
+        std::string wire;
+        sender.encode(sample.body, wire);
+        wire.clear();
+        size_t binary = sender.encode(sample.body, wire);
+        size_t ascii = asciiFrame(sample.body).size();
+
+        // Khung đầu tiên mang cả BIND, giải mã lại từ lần gửi đầu để bảng chỉ số của bên nhận đầy đủ
+        std::string first;
+        FrameCodec replay;
+        replay.encode(sample.body, first);
+        std::string body;
+        size_t start = 0;
+        while ((start = first.find('\0', start)) != std::string::npos)
+        {
+            size_t end = first.find('\0', start + 1);
+            std::string decoded;
+            if (receiver.decode((const uint8_t *)first.data() + start + 1, end - start - 1, decoded) &&
+                !decoded.empty())
+            {
+                body = decoded;
+            }
+            start = end + 1;
+        }
+        roundTrip = roundTrip && body == sample.body;
+
+        std::string key = std::string(sample.name) + "_ascii";
+        benchReport(key.c_str(), ascii);
+        key = std::string(sample.name) + "_binary";
+        benchReport(key.c_str(), binary);
+        asciiTotal += ascii;
+        binaryTotal += binary;
+    }
+    benchReport("binary_over_ascii", (double)binaryTotal / asciiTotal);
+    benchReport("round_trip_ok", roundTrip);
+});
+
+namespace {
+
+FrameCodec encodeCodec;
+FrameCodec decodeCodec;
+std::string encodedCommand;
+std::string decodedCommand;
+
+void setupCodec()
+{
+    setupSamples();
+    std::string wire;
+    encodeCodec.encode(samples[0].body, wire);
+    // Bên nhận học BIND từ lần gửi đầu, khung đo là khung thứ hai (chỉ số một byte)
+    size_t start = 0;
+    while ((start = wire.find('\0', start)) != std::string::npos)
+    {
+        size_t end = wire.find('\0', start + 1);
+        decodeCodec.decode((const uint8_t *)wire.data() + start + 1, end - start - 1, decodedCommand);
+        start = end + 1;
+    }
+    encodedCommand.clear();
+    encodeCodec.encode(samples[0].body, encodedCommand);
+}
+
+}
+
+BENCHMARK("framing/encode_command", setupCodec, [] {
+    std::string wire;
+    encodeCodec.encode(samples[0].body, wire);
+    benchDoNotOptimize(wire);
+});
+
+BENCHMARK("framing/decode_command", setupCodec, [] {
+    decodeCodec.decode((const uint8_t *)encodedCommand.data() + 1, encodedCommand.size() - 2, decodedCommand);
+    benchDoNotOptimize(decodedCommand);
+});
+
+namespace {
+
+// Coordinator giả: ACK mọi lệnh tới thiết bị, nói ASCII hoặc nhị phân
+struct Coordinator
+{
+    bool binary = false;
+    FrameCodec codec;
+    std::string pending;    // Byte nhị phân đang gom tới dấu 0x00
+    bool opened = false;
+    uint64_t wireBytes = 0; // Cả hai chiều
+
+    void send(const std::string &body)
+    {
+        std::string wire;
+        if (binary)
+        {
+            codec.encode(body, wire);
+        }
+        else
+        {
+            wire = asciiFrame(body);
+        }
+        wireBytes += wire.size();
+        Serial1.inject(wire);
+    }
+
+    void handle(const std::string &body)
+    {
+        size_t cmd = body.find(",CMD:");
+        if (body.compare(0, 3, "ID:") == 0 && cmd != std::string::npos)
+        {
+            send(body.substr(0, body.find(',')) + body.substr(cmd));
+        }
+    }
+
+    void receive(const uint8_t *data, size_t length)
+    {
+        wireBytes += length;
+        if (!binary)
+        {
+            std::string frame((const char *)data, length);
+            handle(frame.substr(0, frame.rfind(",CRC:")));
+            return;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (data[i] != 0)
+            {
+                pending += (char)data[i];
+                continue;
+            }
+            if (opened && !pending.empty())
+            {
+                std::string body;
+                if (codec.decode((const uint8_t *)pending.data(), pending.size(), body) && !body.empty())
+                {
+                    handle(body);
+                }
+                opened = false;
+            }
+            else
+            {
+                opened = true;
+            }
+            pending.clear();
+        }
+        std::string control;
+        if (codec.takeControl(control))
+        {
+            wireBytes += control.size();
+            Serial1.inject(control);
+        }
+    }
+};
+
+ZigbeeServer *linkServer[2] = {nullptr, nullptr};
+Coordinator coordinator[2];
+uint64_t sessions[2] = {0, 0};
+size_t sessionAcked = 0;
+
+void setupLink(int mode)
+{
+    if (!linkServer[mode])
+    {
+        linkServer[mode] = new ZigbeeServer();
+        linkServer[mode]->provisionDevices({linkId});
+        linkServer[mode]->onDeviceStatus([](const char *id, bool online) { sessionAcked += online; });
+        linkServer[mode]->loop();
+        coordinator[mode].binary = mode == 1;
+    }
+}
+
+// Một phiên: lệnh có khoá tới thiết bị, thiết bị ACK, rồi gửi một khung DATA
+void runSession(int mode)
+{
+    Coordinator &peer = coordinator[mode];
+    Serial1.onTransmit = [&peer](const uint8_t *data, size_t length) { peer.receive(data, length); };
+    peer.send(std::string("ID:") + linkId + ",DATA:voltage:230.1,current:1.25,power:287.6");
+    linkServer[mode]->sendCommand(linkId, "123", "led_status:1");
+    linkServer[mode]->loop();
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+    ++sessions[mode];
+    benchReport("wire_bytes_per_session", (double)peer.wireBytes / sessions[mode]);
+    benchReport("binary_framing", linkServer[mode]->binaryFraming());
+}
+
+}
+
+BENCHMARK("framing/session_ascii", [] { setupLink(0); }, [] { runSession(0); });
+
+// Coordinator mở đầu bằng khung nhị phân, server nhận ra và trả lời cùng chế độ
+BENCHMARK("framing/session_binary", [] { setupLink(1); }, [] { runSession(1); });
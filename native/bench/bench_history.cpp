@@ -0,0 +1,155 @@
+// Benchmark bộ nhớ chuỗi thời gian metricHistory: số mẫu mỗi KB với dữ liệu công tơ 24 giờ (mẫu 10 s),
+// thời gian đọc cả 24 giờ (mẫu gốc và gộp), số giờ giữ được với ngân sách RAM mặc định.
+#include "bench.h"
+#include "TimeSeries.h"
+#include <cmath>
+
+namespace {
+
+const uint64_t startMs = 1700000000000ULL;
+const uint64_t dayMs = 24ULL * 3600 * 1000;
+const uint32_t periodMs = 10000;
+const char *metricNames[3] = {"voltage", "current", "power"};
+
+struct Sample
+{
+    uint64_t ts;
+    double values[3];
+};
+
+// Công tơ giả: điện áp/dòng đi ngẫu nhiên quanh giá trị danh định, làm tròn như thiết bị gửi
+// (1 và 2 chữ số thập phân), timestamp NTP theo giây, lệch ±1 s thỉnh thoảng
+std::vector<Sample> meterDay(uint32_t seed)
+{
+    std::vector<Sample> samples;
+    double voltage = 230.0;
+    double current = 1.25;
+    uint64_t ts = startMs;
+    auto next = [&seed]() {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) % 1000;
+    };
+    while (ts < startMs + dayMs)
+    {
+        voltage = std::round((voltage + ((int)next() - 500) / 2500.0) * 10) / 10;
+        current = std::max(0.0, std::round((current + ((int)next() - 500) / 25000.0) * 100) / 100);
+        Sample sample = {ts, {voltage, current, std::round(voltage * current * 10) / 10}};
+        samples.push_back(sample);
+        uint32_t jitter = next();
+        ts += periodMs + (jitter < 50 ? 1000 : 0) - (jitter > 950 ? 1000 : 0);
+    }
+    return samples;
+}
+
+TimeSeries *dayStore = nullptr;
+std::vector<Sample> day;
+bool exact = true;
+
+void setupDay()
+{
+    if (dayStore)
+    {
+        return;
+    }
+    day = meterDay(3);
+    dayStore = new TimeSeries(1024 * 1024);
+    for (const Sample &sample : day)
+    {
+        for (int m = 0; m < 3; ++m)
+        {
+            dayStore->append("TBE0123456789ZB", metricNames[m], sample.ts, sample.values[m]);
+        }
+    }
+    // Giải nén phải trả lại đúng từng mẫu
+    for (int m = 0; m < 3; ++m)
+    {
+        size_t i = 0;
+        dayStore->query("TBE0123456789ZB", metricNames[m], 0, UINT64_MAX, 0, [&](const SeriesPoint &point) {
+            exact = exact && i < day.size() && point.ts == day[i].ts && point.value == day[i].values[m];
+            ++i;
+        });
+        exact = exact && i == day.size();
+    }
+}
+
+void reportDensity()
+{
+    for (int m = 0; m < 3; ++m)
+    {
+        SeriesInfo info;
+        dayStore->info("TBE0123456789ZB", metricNames[m], info);
+        std::string key = std::string(metricNames[m]) + "_samples_per_kb";
+        benchReport(key.c_str(), info.samples * 1024.0 / info.bytes);
+    }
+    benchReport("samples_per_kb", dayStore->samples() * 1024.0 / dayStore->bytesUsed());
+    benchReport("bytes_per_sample", (double)dayStore->bytesUsed() / dayStore->samples());
+    benchReport("uncompressed_samples_per_kb", 1024.0 / (sizeof(uint64_t) + sizeof(double)));
+    benchReport("exact", exact);
+}
+
+}
+
+// Đọc nguyên 24 giờ một chuỗi (8640 mẫu gốc)
+BENCHMARK("history/query_24h_raw", setupDay, [] {
+    size_t points = dayStore->query("TBE0123456789ZB", "voltage", startMs, startMs + dayMs, 0,
+                                    [](const SeriesPoint &point) { benchDoNotOptimize(point); });
+    benchSetItemsPerOp(points);
+    benchReport("points", points);
+    reportDensity();
+});
+
+// 24 giờ gộp thành TIMESERIES_MAX_POINTS khoảng, như GET /api/history mặc định
+BENCHMARK("history/query_24h_step", setupDay, [] {
+    size_t points = dayStore->query("TBE0123456789ZB", "voltage", startMs, startMs + dayMs,
+                                    dayMs / TIMESERIES_MAX_POINTS,
+                                    [](const SeriesPoint &point) { benchDoNotOptimize(point); });
+    benchReport("points", points);
+});
+
+namespace {
+
+const int fleetDevices = 10;
+TimeSeries *fleetStore = nullptr;
+std::vector<std::string> fleetIds;
+std::vector<std::vector<Sample>> fleetDays;
+size_t fleetNext = 0;
+
+void setupFleet()
+{
+    if (fleetStore)
+    {
+        return;
+    }
+    fleetStore = new TimeSeries();
+    for (int d = 0; d < fleetDevices; ++d)
+    {
+        fleetIds.push_back("TBE" + std::to_string(1000000 + d) + "ZB");
+        fleetDays.push_back(meterDay(100 + d));
+    }
+}
+
+}
+
+// Ngân sách mặc định, 10 công tơ x 3 metric: mỗi op thêm một mẫu (10 s) cho cả đội, khi đầy thì block cũ
+// nhất bị lấy lại; báo số giờ gần nhất còn giữ được
+BENCHMARK("history/fleet_default_budget", setupFleet, [] {
+    size_t n = fleetNext++;
+    size_t i = n % fleetDays[0].size();
+    uint64_t offset = n / fleetDays[0].size() * dayMs;
+    for (int d = 0; d < fleetDevices; ++d)
+    {
+        const Sample &sample = fleetDays[d][i];
+        for (int m = 0; m < 3; ++m)
+        {
+            fleetStore->append(fleetIds[d].c_str(), metricNames[m], sample.ts + offset, sample.values[m]);
+        }
+    }
+    benchSetItemsPerOp(fleetDevices * 3);
+    double hours = 1e9;
+    fleetStore->forEachSeries([&hours](const SeriesInfo &info) {
+        hours = std::min(hours, (info.last - info.first) / 3600000.0);
+    });
+    benchReport("retained_hours", hours);
+    benchReport("samples", fleetStore->samples());
+    benchReport("budget_bytes", fleetStore->capacity());
+});
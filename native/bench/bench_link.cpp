@@ -0,0 +1,62 @@
+// Benchmark thương lượng baud với coordinator giả: số khung/giây ở mỗi baud (thời gian ảo tính theo byte trên
+// dây cộng thời gian coordinator xử lý mỗi khung). Đường hạ baud và thương lượng lại được kiểm tra trong test/test_link.
+#include "bench.h"
+#include "simLink.h"
+
+namespace {
+
+const char linkId[] = "TBE0123456789ZB";
+
+SimLink *openLink(SimLink *&link, uint32_t maxBaud, const SimCoordinator &coordinator)
+{
+    if (!link)
+    {
+        link = new SimLink(maxBaud, coordinator, linkId);
+    }
+    return link;
+}
+
+SimLink *rateLinks[5] = {nullptr};
+const uint32_t rates[5] = {9600, 57600, 115200, 460800, 921600};
+
+void runRate(int index)
+{
+    SimCoordinator coordinator;
+    SimLink *link = openLink(rateLinks[index], rates[index], coordinator);
+    link->exchange();
+    benchReport("baud", link->server.linkBaud());
+    benchReport("frames_per_sec", link->coordinator.frames * 1e6 / link->coordinator.virtualUs);
+}
+
+}
+
+BENCHMARK("link/9600", nullptr, [] { runRate(0); });
+BENCHMARK("link/57600", nullptr, [] { runRate(1); });
+BENCHMARK("link/115200", nullptr, [] { runRate(2); });
+BENCHMARK("link/460800", nullptr, [] { runRate(3); });
+BENCHMARK("link/921600", nullptr, [] { runRate(4); });
+
+namespace {
+
+SimLink *refusedLink = nullptr;
+SimLink *lineLink = nullptr;
+
+}
+
+// Coordinator chỉ hỗ trợ tới 115200: 921600, 460800, 230400 bị từ chối, dừng ở 115200
+BENCHMARK("link/negotiate_refused", nullptr, [] {
+    SimCoordinator coordinator;
+    coordinator.maxRate = 115200;
+    SimLink *link = openLink(refusedLink, 921600, coordinator);
+    link->exchange();
+    benchReport("baud", link->server.linkBaud());
+});
+
+// Cả hai phía chạy được 921600 nhưng dây thì không: CHECK mất, hai phía cùng về baud cũ rồi thử thấp hơn
+BENCHMARK("link/negotiate_line_limit", nullptr, [] {
+    SimCoordinator coordinator;
+    coordinator.lineLimit = 230400;
+    SimLink *link = openLink(lineLink, 921600, coordinator);
+    link->exchange();
+    benchReport("baud", link->server.linkBaud());
+});
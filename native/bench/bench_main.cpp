@@ -0,0 +1,93 @@
+// Chạy toàn bộ benchmark, in mỗi case một dòng JSON:
+// {"bench":..., "iterations":..., "ns_per_op":..., "allocs_per_op":..., "bytes_per_op":...}
+//
+//   pio run -e native && .pio/build/native/program [--filter chuỗi] [--min-time ms]
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+
+std::vector<BenchCase> &benchRegistry()
+{
+    static std::vector<BenchCase> registry;
+    return registry;
+}
+
+static std::map<std::string, double> extraMetrics;
+static double itemsPerOp = 0;
+
+void benchReport(const char *key, double value)
+{
+    extraMetrics[key] = value;
+}
+
+void benchSetItemsPerOp(double items)
+{
+    itemsPerOp = items;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = nullptr;
+    double minTimeMs = 200;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+        {
+            minTimeMs = atof(argv[++i]);
+        }
+    }
+
+    for (BenchCase &bench : benchRegistry())
+    {
+        if (filter && !strstr(bench.name, filter))
+        {
+            continue;
+        }
+        extraMetrics.clear();
+        itemsPerOp = 0;
+        if (bench.setup)
+        {
+            bench.setup();
+        }
+        bench.run(); // làm nóng
+
+        uint64_t iterations = 0;
+        uint64_t batch = 1;
+        uint64_t allocs0 = nativeAllocCount.load();
+        uint64_t bytes0 = nativeAllocBytes.load();
+        auto start = std::chrono::steady_clock::now();
+        double elapsedNs = 0;
+        while (elapsedNs < minTimeMs * 1e6)
+        {
+            for (uint64_t i = 0; i < batch; ++i)
+            {
+                bench.run();
+            }
+            iterations += batch;
+            batch *= 2;
+            elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }
+        double allocs = (double)(nativeAllocCount.load() - allocs0);
+        double bytes = (double)(nativeAllocBytes.load() - bytes0);
+
+        printf("{\"bench\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.1f,\"allocs_per_op\":%.2f,\"bytes_per_op\":%.1f",
+               bench.name, (unsigned long long)iterations, elapsedNs / iterations, allocs / iterations, bytes / iterations);
+        if (itemsPerOp > 0)
+        {
+            printf(",\"items_per_sec\":%.0f", itemsPerOp * iterations / (elapsedNs / 1e9));
+        }
+        for (const auto &metric : extraMetrics)
+        {
+            printf(",\"%s\":%.3f", metric.first.c_str(), metric.second);
+        }
+        printf("}\n");
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Benchmark đường metric: onCollectData (collectMetrics) và batch gateway của PEClient.
+#include "bench.h"
+#include "metrics.h"
+#include "PEClient.h"
+
+namespace {
+
+const char *sample = "voltage:230.1,current:1.25,power:287.6";
+const int childDevices = 200;
+
+PEClient *client = nullptr;
+std::vector<std::string> deviceIds;
+uint64_t timestamp = 1700000000000ULL;
+
+void setupMetrics()
+{
+    if (!metricQueueMutex)
+    {
+        initMetrics();
+    }
+}
+
+void setupGateway()
+{
+    setupMetrics();
+    if (!client)
+    {
+        client = new PEClient("ssid", "password", "localhost", 1883, "gateway", "user", "pass");
+    }
+    deviceIds.clear();
+    for (int i = 0; i < childDevices; ++i)
+    {
+        deviceIds.push_back("TBE" + std::to_string(1000000 + i) + "ZB");
+    }
+    benchSetItemsPerOp(childDevices);
+}
+
+}
+
+BENCHMARK("onCollectData/3fields", setupMetrics, [] {
+    collectMetrics("TBE0123456789ZB", sample, timestamp);
+});
+
+// Mỗi op: 200 thiết bị con, mỗi thiết bị một sample 3 giá trị, đi qua hàng đợi metric
+// rồi được gộp và publish theo batch gateway
+BENCHMARK("gateway/200devices", setupGateway, [] {
+    uint32_t before = PubSubClient::publishCount;
+    uint64_t bytesBefore = PubSubClient::publishBytes;
+    timestamp += 1000;
+    for (const std::string &id : deviceIds)
+    {
+        collectMetrics(id.c_str(), sample, timestamp);
+        if (metricQueue.size() >= METRIC_QUEUE_LIMIT - 3)
+        {
+            publishMetrics(*client);
+        }
+    }
+    publishMetrics(*client);
+    benchReport("publishes_per_op", PubSubClient::publishCount - before);
+    benchReport("publish_bytes_per_op", (double)(PubSubClient::publishBytes - bytesBefore));
+});
+
+// Mỗi thiết bị con chỉ một giá trị: GATEWAY_BATCH_SIZE giá trị từ các thiết bị khác nhau không vừa
+// GATEWAY_BUFFER_SIZE, batch phải tự gửi sớm theo số byte và không metric nào bị mất
+BENCHMARK("gateway/200devices_1value", setupGateway, [] {
+    uint32_t tooLargeBefore = PubSubClient::publishTooLarge;
+    uint32_t before = PubSubClient::publishCount;
+    size_t accepted = 0;
+    timestamp += 1000;
+    for (const std::string &id : deviceIds)
+    {
+        collectMetrics(id.c_str(), "power:287.6", timestamp);
+        if (metricQueue.size() >= METRIC_QUEUE_LIMIT - 1)
+        {
+            accepted += publishMetrics(*client);
+        }
+    }
+    accepted += publishMetrics(*client);
+    benchReport("publishes_per_op", PubSubClient::publishCount - before);
+    benchReport("rejected_publishes", PubSubClient::publishTooLarge - tooLargeBefore);
+    benchReport("values_left", childDevices - accepted + client->gatewayPending());
+});
@@ -0,0 +1,115 @@
+// Benchmark Reactor so với vòng polling 10 ms cũ: độ trễ một chặng (notify -> handler chạy)
+// và số lần task thức dậy mỗi giây khi không có việc.
+#include "bench.h"
+#include "Reactor.h"
+
+namespace {
+
+const uint32_t pollPeriodMs = 10;
+const uint32_t idleOpMs = 100;
+
+struct HopStats {
+    double totalUs = 0;
+    double maxUs = 0;
+    uint64_t hops = 0;
+
+    void add(uint32_t us)
+    {
+        totalUs += us;
+        maxUs = us > maxUs ? us : maxUs;
+        ++hops;
+        benchReport("hop_us_mean", totalUs / hops);
+        benchReport("hop_us_max", maxUs);
+    }
+};
+
+// ---------------------------------------------------------------- Reactor
+
+Reactor *reactor = nullptr;
+uint32_t hopEvent = 0;
+std::atomic<uint32_t> hopSent(0);
+std::atomic<uint32_t> hopLatency(0);
+std::atomic<bool> hopDone(false);
+HopStats reactorStats;
+
+void setupReactor()
+{
+    if (!reactor)
+    {
+        reactor = new Reactor("BenchReactor");
+        hopEvent = reactor->on([] {
+            hopLatency = micros() - hopSent;
+            hopDone = true;
+        });
+        // Giống ZigbeeServer: một timer kiểm tra định kỳ
+        reactor->every(5000, [] {});
+        reactor->start(4096, 1, 0);
+    }
+    reactorStats = HopStats();
+}
+
+// ---------------------------------------------------------------- Polling 10 ms
+
+std::atomic<bool> pollStarted(false);
+std::atomic<bool> pollPending(false);
+std::atomic<uint32_t> pollWakeups(0);
+HopStats pollStats;
+
+void pollTask(void *)
+{
+    for (;;)
+    {
+        ++pollWakeups;
+        if (pollPending)
+        {
+            hopLatency = micros() - hopSent;
+            pollPending = false;
+            hopDone = true;
+        }
+        vTaskDelay(pollPeriodMs / portTICK_PERIOD_MS);
+    }
+}
+
+void setupPoll()
+{
+    if (!pollStarted.exchange(true))
+    {
+        xTaskCreatePinnedToCore(pollTask, "BenchPoll", 4096, nullptr, 1, nullptr, 0);
+    }
+    pollStats = HopStats();
+}
+
+void waitHop(HopStats &stats)
+{
+    while (!hopDone)
+    {
+    }
+    hopDone = false;
+    stats.add(hopLatency);
+}
+
+}
+
+BENCHMARK("reactor/hop", setupReactor, [] {
+    hopSent = micros();
+    reactor->notify(hopEvent);
+    waitHop(reactorStats);
+});
+
+BENCHMARK("poll10ms/hop", setupPoll, [] {
+    hopSent = micros();
+    pollPending = true;
+    waitHop(pollStats);
+});
+
+BENCHMARK("reactor/idle", setupReactor, [] {
+    uint32_t wakeups = reactor->wakeups();
+    delay(idleOpMs);
+    benchReport("wakeups_per_sec", (reactor->wakeups() - wakeups) * 1000.0 / idleOpMs);
+});
+
+BENCHMARK("poll10ms/idle", setupPoll, [] {
+    uint32_t wakeups = pollWakeups;
+    delay(idleOpMs);
+    benchReport("wakeups_per_sec", (pollWakeups - wakeups) * 1000.0 / idleOpMs);
+});
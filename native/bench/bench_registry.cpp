@@ -0,0 +1,62 @@
+// Benchmark snapshot danh sách thiết bị: nạp lúc khởi động (warm start) và ghi khi danh sách đổi.
+#include "bench.h"
+#include "registryStore.h"
+
+namespace {
+
+const size_t fleetSize = ZIGBEE_MAX_DEVICES;
+RegistryStore *store = nullptr;
+DeviceTable *saved = nullptr;
+DeviceTable *loaded = nullptr;
+SchemaTable savedSchemas;
+SchemaTable loadedSchemas;
+size_t saveRound = 0;
+size_t snapshotBytes = 0;
+
+void setupRegistry()
+{
+    if (!store)
+    {
+        store = new RegistryStore("bench", "zb0");
+        saved = new DeviceTable(fleetSize);
+        loaded = new DeviceTable(fleetSize);
+        savedSchemas.intern("voltage@1,current@2,power");
+        savedSchemas.intern("temperature@1,humidity");
+        char id[DEVICE_ID_SIZE];
+        for (size_t i = 0; i < fleetSize; ++i)
+        {
+            snprintf(id, sizeof(id), "TBE%012u", (unsigned)i);
+            Device *device = saved->add(id);
+            snprintf(device->secret_key, sizeof(device->secret_key), "key%u", (unsigned)i);
+            device->status = i % 2 ? DEVICE_STATUS_ON : DEVICE_STATUS_OFF;
+            device->schema = 1 + i % 2;
+        }
+        store->save(*saved, savedSchemas);
+        std::vector<uint8_t> buffer(RegistryStore::maxSize(fleetSize));
+        snapshotBytes = RegistryStore::encode(*saved, savedSchemas, buffer.data(), buffer.size());
+    }
+}
+
+}
+
+// Toàn bộ fleet sẵn sàng ngay trong begin(), trước khi có WiFi/MQTT
+BENCHMARK("registry/warm_start_64", setupRegistry, [] {
+    store->load(*loaded, loadedSchemas);
+    benchReport("devices", loaded->size());
+    benchReport("schemas", loadedSchemas.size());
+    benchReport("snapshot_bytes", snapshotBytes);
+});
+
+// Trạng thái đèn đổi: một lần ghi vào slot không hoạt động
+BENCHMARK("registry/save_changed", setupRegistry, [] {
+    (*saved)[0].status = ++saveRound % 2 ? DEVICE_STATUS_ON : DEVICE_STATUS_OFF;
+    store->save(*saved, savedSchemas);
+    benchReport("writes_per_op", (double)store->writes() / saveRound);
+});
+
+// Thay đổi không làm đổi nội dung (vd: cloud gửi lại cùng danh sách): không ghi flash
+BENCHMARK("registry/save_unchanged", setupRegistry, [] {
+    uint32_t writes = store->writes();
+    store->save(*saved, savedSchemas);
+    benchReport("writes_per_op", store->writes() - writes);
+});
@@ -0,0 +1,155 @@
+// Benchmark luật trên gateway: số luật tính được mỗi giây khi mỗi khung DATA chỉ chạy các luật đọc metric của nó,
+// thời gian biên dịch một bộ luật đầy, và đường đầy đủ khung DATA -> luật -> lệnh Zigbee qua ZigbeeServer.
+#include "bench.h"
+#include "RuleEngine.h"
+#include "zigbeeServer.h"
+
+namespace {
+
+const int meters = 50;
+std::vector<std::string> meterIds;
+std::vector<RuleSpec> specs;
+
+// Mỗi công tơ một luật quá dòng cắt relay của chính nó, phần còn lại là luật tổng công suất của ba công tơ
+void setupSpecs()
+{
+    if (!specs.empty())
+    {
+        return;
+    }
+    for (int i = 0; i < meters; ++i)
+    {
+        meterIds.push_back("TBE" + std::to_string(1000000 + i) + "ZB");
+    }
+    for (int i = 0; i < meters; ++i)
+    {
+        RuleSpec spec;
+        spec.name = "overcurrent_" + std::to_string(i);
+        spec.device = meterIds[i];
+        spec.when = "current > 8 && voltage > 200";
+        spec.then = {meterIds[i], "relay:0"};
+        spec.otherwise = {meterIds[i], "relay:1"};
+        specs.push_back(spec);
+    }
+    for (int i = 0; specs.size() < RULE_MAX_RULES; i += 3)
+    {
+        RuleSpec spec;
+        spec.name = "feeder_" + std::to_string(i / 3);
+        spec.when = meterIds[i] + ".power + " + meterIds[i + 1] + ".power + " + meterIds[i + 2] + ".power > 5000";
+        spec.then = {meterIds[i], "shed:1"};
+        spec.cooldown = 60000;
+        specs.push_back(spec);
+    }
+}
+
+RuleEngine *engine = nullptr;
+std::vector<std::string> frames;
+uint32_t actions = 0;
+
+void setupEngine()
+{
+    setupSpecs();
+    if (!engine)
+    {
+        engine = new RuleEngine();
+        engine->onAction([](const char *id, const char *cmd) { ++actions; });
+        std::string error;
+        engine->load(specs, error);
+        // Hai khung mỗi công tơ: dòng qua lại quanh ngưỡng để luật đổi trạng thái và sinh lệnh
+        for (int round = 0; round < 2; ++round)
+        {
+            for (int i = 0; i < meters; ++i)
+            {
+                double current = round == 0 || i % 5 ? 1.25 + i % 7 : 9.5;
+                char data[96];
+                snprintf(data, sizeof(data), "voltage:230.1,current:%.2f,power:%.1f", current, 230.1 * current);
+                frames.push_back(data);
+            }
+        }
+    }
+}
+
+}
+
+// Một op = mỗi công tơ gửi một khung (luân phiên hai bộ giá trị)
+BENCHMARK("rules/ingest_50_meters", setupEngine, [] {
+    static size_t round = 0;
+    uint32_t before = engine->evaluations();
+    uint32_t actionsBefore = actions;
+    size_t offset = (round++ % 2) * meters;
+    for (int i = 0; i < meters; ++i)
+    {
+        engine->ingest(meterIds[i].c_str(), frames[offset + i].c_str());
+    }
+    uint32_t evaluated = engine->evaluations() - before;
+    benchSetItemsPerOp(evaluated);
+    benchReport("rules_total", engine->size());
+    benchReport("rules_per_frame", (double)evaluated / meters);
+    benchReport("actions_per_op", actions - actionsBefore);
+});
+
+// Khung của thiết bị không có luật nào: chỉ tra bảng băm rồi bỏ
+BENCHMARK("rules/ingest_unrelated", setupEngine, [] {
+    engine->ingest("TBE9999999ZB", "voltage:230.1,current:1.25,power:287.6");
+});
+
+BENCHMARK("rules/compile_64", setupSpecs, [] {
+    RuleEngine fresh;
+    std::string error;
+    benchDoNotOptimize(fresh.load(specs, error));
+});
+
+namespace {
+
+ZigbeeServer *ruleServer = nullptr;
+RuleEngine *serverRules = nullptr;
+std::string lastCommand;
+
+std::string ruleFrame(const std::string &body)
+{
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(body.c_str(), body.length()));
+    return body + ",CRC:" + crc + "\n";
+}
+
+void setupServerRules()
+{
+    setupSpecs();
+    if (!ruleServer)
+    {
+        ruleServer = new ZigbeeServer();
+        ruleServer->provisionDevices({meterIds[0]});
+        serverRules = new RuleEngine();
+        std::string error;
+        serverRules->load(specs, error);
+        ruleServer->onMessage([](const char *id, const char *data) { serverRules->ingest(id, data); });
+        serverRules->onAction([](const char *id, const char *cmd) { ruleServer->sendCommand(id, cmd); });
+        ruleServer->loop();
+    }
+}
+
+}
+
+// Qua ZigbeeServer và Serial1 giả: khung DATA quá dòng rồi bình thường, mỗi khung sinh một lệnh relay tới
+// thiết bị ngay trên gateway; coordinator giả ACK lệnh
+BENCHMARK("rules/server_data_to_command", setupServerRules, [] {
+    static bool over = false;
+    over = !over;
+    Serial1.onTransmit = [](const uint8_t *data, size_t length) {
+        std::string frame((const char *)data, length);
+        std::string body = frame.substr(0, frame.rfind(",CRC:"));
+        size_t cmd = body.find(",CMD:");
+        if (cmd != std::string::npos)
+        {
+            lastCommand = body.substr(cmd + 5);
+            Serial1.inject(ruleFrame(body.substr(0, body.find(',')) + body.substr(cmd)));
+        }
+    };
+    Serial1.inject(ruleFrame("ID:" + meterIds[0] + (over ? ",DATA:voltage:230.1,current:9.50,power:2186.0"
+                                                        : ",DATA:voltage:230.1,current:1.25,power:287.6")));
+    ruleServer->loop();
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+    benchReport("command_ok", lastCommand == (over ? "relay:0" : "relay:1"));
+    benchReport("actions", serverRules->actions());
+});
@@ -0,0 +1,122 @@
+// Benchmark chống trùng DATA theo SEQ: dòng DATA qua coordinator giả có lặp khung (trả lời muộn của lần
+// get_data trước), đảo thứ tự và mất khung. So số mẫu tới messageCallback khi có và không có SEQ, và số
+// mất mà server đếm được so với số mất thật.
+#include "bench.h"
+#include "zigbeeServer.h"
+#include "Health.h"
+
+namespace {
+
+const char seqId[] = "TBE0123456789ZB";
+const int streamLength = 1000;
+const uint32_t duplicatePercent = 10;
+const uint32_t reorderPercent = 5;
+const uint32_t lossPercent = 3;
+
+std::string seqFrame(const std::string &body)
+{
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(body.c_str(), body.length()));
+    return body + ",CRC:" + crc + "\n";
+}
+
+struct Stream
+{
+    std::vector<int> order;     // SEQ theo thứ tự tới server, có lặp
+    int lost = 0;
+};
+
+// Dòng cố định (seed cố định) để mọi lần chạy so cùng một đầu vào
+Stream makeStream()
+{
+    Stream stream;
+    uint32_t seed = 11;
+    auto roll = [&seed](uint32_t percent) {
+        seed = seed * 1103515245u + 12345u;
+        return (seed >> 16) % 100 < percent;
+    };
+    int late = -1;
+    for (int seq = 0; seq < streamLength; ++seq)
+    {
+        if (roll(lossPercent))
+        {
+            ++stream.lost;
+            continue;
+        }
+        stream.order.push_back(seq);
+        if (late >= 0)
+        {
+            stream.order.push_back(late);
+            late = -1;
+        }
+        if (roll(duplicatePercent))
+        {
+            // Bản lặp tới sau khung kế tiếp, như trả lời muộn của lần get_data trước
+            late = seq;
+        }
+        if (stream.order.size() >= 2 && roll(reorderPercent))
+        {
+            std::swap(stream.order[stream.order.size() - 1], stream.order[stream.order.size() - 2]);
+        }
+    }
+    return stream;
+}
+
+Stream stream;
+ZigbeeServer *seqServer[2] = {nullptr, nullptr};
+uint64_t delivered[2] = {0, 0};
+uint32_t passes[2] = {0, 0};
+
+void setupSeq(int mode)
+{
+    if (!seqServer[mode])
+    {
+        stream = makeStream();
+        seqServer[mode] = new ZigbeeServer();
+        seqServer[mode]->provisionDevices({seqId});
+        seqServer[mode]->onMessage([mode](const char *id, const char *data) { ++delivered[mode]; });
+        seqServer[mode]->loop();
+    }
+}
+
+// Một lượt là cả dòng, lượt sau tiếp SEQ của lượt trước (quay vòng 16 bit như trên thiết bị)
+void runStream(int mode)
+{
+    uint32_t duplicates = health.total(HEALTH_DATA_DUPLICATES);
+    uint64_t before = delivered[mode];
+    Device *device = seqServer[mode]->deviceList.find(seqId);
+    uint32_t lostBefore = device->lost;
+    uint32_t base = passes[mode]++ * streamLength;
+    for (int seq : stream.order)
+    {
+        char body[96];
+        if (mode == 1)
+        {
+            snprintf(body, sizeof(body), "ID:%s,SEQ:%u,DATA:voltage:230.1,current:1.25,power:%d", seqId,
+                     (unsigned)((base + seq) & 0xFFFF), seq);
+        }
+        else
+        {
+            snprintf(body, sizeof(body), "ID:%s,DATA:voltage:230.1,current:1.25,power:%d", seqId, seq);
+        }
+        Serial1.inject(seqFrame(body));
+        seqServer[mode]->loop();
+    }
+    benchReport("injected", stream.order.size());
+    benchReport("unique_sent", streamLength - stream.lost);
+    benchReport("delivered", delivered[mode] - before);
+    benchReport("duplicates_dropped", health.total(HEALTH_DATA_DUPLICATES) - duplicates);
+    if (mode == 1)
+    {
+        benchReport("lost_counted", device->lost - lostBefore);
+        benchReport("lost_actual", stream.lost);
+    }
+}
+
+}
+
+// Mốc so sánh: không có SEQ, mọi khung lặp đi thẳng tới messageCallback
+BENCHMARK("seq/stream_no_seq", [] { setupSeq(0); }, [] { runStream(0); });
+
+// Có SEQ: khung lặp bị bỏ trước khi phân tích, khung đảo thứ tự vẫn được nhận, khoảng trống đếm là mất
+BENCHMARK("seq/stream_dedup", [] { setupSeq(1); }, [] { runStream(1); });
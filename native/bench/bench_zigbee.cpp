@@ -0,0 +1,385 @@
+// Benchmark đường nhận của ZigbeeServer: CRC, handleCommand, handleData.
+#include "bench.h"
+#include "zigbeeServer.h"
+#include "zigbeeFleet.h"
+
+namespace {
+
+std::string frame(const std::string &body)
+{
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(body.c_str(), body.length()));
+    return body + ",CRC:" + crc;
+}
+
+// Khung ACK thiết bị gửi lại: ID:<id>,CMD:<cmd>,CRC:...
+std::string ackFrame(const std::string &id, const std::string &cmd)
+{
+    return frame("ID:" + id + ",CMD:" + cmd) + "\n";
+}
+
+const std::string commandBody = "ID:TBE0123456789ZB,SECRECT_KEY:123,CMD:led_status:1";
+const std::string dataBody = "ID:TBE0123456789ZB,DATA:voltage:230.1,current:1.25,power:287.6";
+const std::string block256(256, 'x');
+
+std::string commandFrame;
+std::string dataFrame;
+ZigbeeServer *server = nullptr;
+
+void setupServer()
+{
+    commandFrame = frame(commandBody) + "\n";
+    dataFrame = frame(dataBody) + "\n";
+    if (!server)
+    {
+        server = new ZigbeeServer();
+        server->onMessage([](const char *id, const char *data) { benchDoNotOptimize(data); });
+        server->provisionDevices({"TBE0123456789ZB"});
+        server->loop();
+    }
+}
+
+}
+
+BENCHMARK("calculateCRC32/52B", nullptr, [] {
+    benchDoNotOptimize(ZigbeeServer::calculateCRC32(commandBody.c_str(), commandBody.length()));
+});
+
+BENCHMARK("calculateCRC32/256B", nullptr, [] {
+    benchDoNotOptimize(ZigbeeServer::calculateCRC32(block256.c_str(), block256.length()));
+});
+
+BENCHMARK("checkCRC32/command", [] { commandFrame = frame(commandBody); }, [] {
+    benchDoNotOptimize(ZigbeeServer::checkCRC32(commandFrame));
+});
+
+BENCHMARK("handleCommand/led_status", setupServer, [] {
+    Serial1.inject(commandFrame);
+    server->loop();
+});
+
+BENCHMARK("handleData/3fields", setupServer, [] {
+    Serial1.inject(dataFrame);
+    server->loop();
+});
+
+namespace {
+
+const std::string schemaBody = "ID:TBE0123456789ZB,CMD:schema:voltage@1,current@2,power@1";
+const std::string positionalBody = "ID:TBE0123456789ZB,DATA:2301,125,2876";
+std::string positionalFrame;
+std::string positionalSample;
+
+// Thiết bị đã báo schema một lần, sau đó chỉ gửi giá trị theo vị trí
+void setupPositional()
+{
+    setupServer();
+    positionalFrame = frame(positionalBody) + "\n";
+    Serial1.inject(frame(schemaBody) + "\n");
+    server->loop();
+    server->onMessage([](const char *id, const char *data) { positionalSample = data; });
+}
+
+}
+
+BENCHMARK("handleData/positional", setupPositional, [] {
+    Serial1.inject(positionalFrame);
+    server->loop();
+    benchReport("wire_bytes", positionalFrame.size());
+    benchReport("keyvalue_wire_bytes", dataFrame.size());
+    benchReport("expanded_ok", positionalSample == "voltage:230.1,current:1.25,power:287.6");
+});
+
+namespace {
+
+std::string appFrame;
+size_t appDelivered = 0;
+size_t appRuns = 0;
+
+// Lệnh riêng của ứng dụng, tên chứa "led_status" nhưng không phải lệnh led_status
+void setupAppCommand()
+{
+    setupServer();
+    appDelivered = appRuns = 0;
+    appFrame = frame("ID:TBE0123456789ZB,CMD:get_led_status:1") + "\n";
+    server->onMessage([](const char *id, const char *data) { ++appDelivered; });
+}
+
+void setupRegisteredCommand()
+{
+    setupServer();
+    appDelivered = appRuns = 0;
+    appFrame = frame("ID:TBE0123456789ZB,CMD:set_scene:3") + "\n";
+    server->onCommand("set_scene", [](const CommandFrame &command) { appDelivered += command.args == "3"; });
+}
+
+}
+
+BENCHMARK("handleCommand/app_command", setupAppCommand, [] {
+    Serial1.inject(appFrame);
+    server->loop();
+    benchReport("delivered_ratio", (double)appDelivered / ++appRuns);
+});
+
+BENCHMARK("handleCommand/registered", setupRegisteredCommand, [] {
+    Serial1.inject(appFrame);
+    server->loop();
+    benchReport("delivered_ratio", (double)appDelivered / ++appRuns);
+});
+
+namespace {
+
+ZigbeeServer *provisionServer = nullptr;
+std::vector<std::string> fleetA, fleetB;
+bool useFleetA = false;
+
+void setupProvision()
+{
+    if (!provisionServer)
+    {
+        provisionServer = new ZigbeeServer();
+        char id[DEVICE_ID_SIZE];
+        for (int i = 0; i < ZIGBEE_MAX_DEVICES; ++i)
+        {
+            snprintf(id, sizeof(id), "TBE%012dZB", i);
+            fleetA.push_back(id);
+            snprintf(id, sizeof(id), "TBF%012dZB", i);
+            fleetB.push_back(id);
+        }
+    }
+    benchReport("device_bytes", sizeof(Device));
+    benchReport("table_bytes", provisionServer->deviceList.bytes() + provisionServer->pendingDeviceList.bytes());
+}
+
+}
+
+// Mỗi op thay toàn bộ 64 thiết bị: đo chi phí cấp phép lại và số lần cấp phát của bảng thiết bị
+BENCHMARK("provision/64devices", setupProvision, [] {
+    useFleetA = !useFleetA;
+    provisionServer->provisionDevices(useFleetA ? fleetA : fleetB);
+    provisionServer->loop();
+    benchDoNotOptimize(provisionServer->deviceList.size());
+});
+
+namespace {
+
+const int groupSize = 50;
+ZigbeeServer *groupServer = nullptr;
+std::vector<std::string> lights;
+size_t txFrames = 0;
+size_t groupConfirmed = 0;
+
+// Thiết bị giả: ACK mọi lệnh nhận được, với khung GROUP thì mọi thành viên cùng ACK
+void ackTransmit(const uint8_t *data, size_t length)
+{
+    std::string frame((const char *)data, length);
+    ++txFrames;
+    size_t cmdPos = frame.find(",CMD:");
+    size_t crcPos = frame.rfind(",CRC:");
+    if (cmdPos == std::string::npos || crcPos == std::string::npos)
+    {
+        return;
+    }
+    std::string cmd = frame.substr(cmdPos + 5, crcPos - cmdPos - 5);
+    std::string acks;
+    if (frame.compare(0, 6, "GROUP:") == 0)
+    {
+        for (const std::string &id : lights)
+        {
+            acks += ackFrame(id, cmd);
+        }
+    }
+    else if (frame.compare(0, 3, "ID:") == 0)
+    {
+        acks = ackFrame(frame.substr(3, frame.find(',') - 3), cmd);
+    }
+    Serial1.inject(acks);
+}
+
+void setupGroup()
+{
+    if (!groupServer)
+    {
+        groupServer = new ZigbeeServer();
+        char id[DEVICE_ID_SIZE];
+        for (int i = 0; i < groupSize; ++i)
+        {
+            snprintf(id, sizeof(id), "LIGHT%03d", i);
+            lights.push_back(id);
+        }
+        groupServer->provisionDevices(lights);
+        groupServer->onGroupResult([](const GroupResult &result) { groupConfirmed += result.confirmed.size(); });
+        groupServer->defineGroup("hall", lights);
+        Serial1.onTransmit = ackTransmit;
+        while (groupServer->queueDepth() > 0)
+        {
+            groupServer->loop();
+        }
+        Serial1.onTransmit = nullptr;
+        Serial1.takeTx();
+    }
+}
+
+void runFleet(bool grouped)
+{
+    txFrames = 0;
+    groupConfirmed = 0;
+    Serial1.onTransmit = ackTransmit;
+    if (grouped)
+    {
+        groupServer->sendGroupCommand("hall", "led_status:1");
+    }
+    else
+    {
+        for (const std::string &id : lights)
+        {
+            groupServer->sendCommand(id.c_str(), "led_status:1");
+        }
+    }
+    while (groupServer->queueDepth() > 0 || Serial1.available())
+    {
+        groupServer->loop();
+    }
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+    benchReport("tx_frames", txFrames);
+    if (grouped)
+    {
+        benchReport("confirmed", groupConfirmed);
+    }
+}
+
+}
+
+// Bật 50 đèn: 50 lệnh đơn lẻ (mỗi lệnh một lần truyền và chờ ACK) so với một khung GROUP
+BENCHMARK("fleet/50x_unicast", setupGroup, [] { runFleet(false); });
+BENCHMARK("fleet/group_50", setupGroup, [] { runFleet(true); });
+
+namespace {
+
+size_t shadowRound = 0;
+size_t shadowFrames = 0;
+
+// Cloud đẩy lại cùng trạng thái cho cả đội: sau lần đầu shadow không gửi thêm khung nào
+void runRepush()
+{
+    txFrames = 0;
+    Serial1.onTransmit = ackTransmit;
+    // Mỗi 64 vòng đổi trạng thái một lần để vẫn có lệnh thật cần gửi
+    const char *value = (++shadowRound / 64) % 2 ? "0" : "1";
+    for (const std::string &id : lights)
+    {
+        groupServer->setDesired(id.c_str(), "led_status", value);
+    }
+    do
+    {
+        groupServer->loop();
+    } while (groupServer->queueDepth() > 0 || Serial1.available());
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+    shadowFrames += txFrames;
+    benchReport("tx_frames_per_op", (double)shadowFrames / shadowRound);
+    benchReport("suppressed", groupServer->shadowSuppressed());
+}
+
+}
+
+BENCHMARK("shadow/repush_50", setupGroup, runRepush);
+
+namespace {
+
+ZigbeeFleet *fleet = nullptr;
+ZigbeeServer *shards[2];
+size_t fleetTx[2];
+size_t fleetResults = 0;
+size_t fleetConfirmed = 0;
+
+// Thiết bị giả trên từng UART: thành viên của shard ACK lệnh, chỉ các đèn nối với coordinator đó trả lời khung GROUP
+void ackShard(HardwareSerial &serial, size_t index, const uint8_t *data, size_t length)
+{
+    std::string frame((const char *)data, length);
+    ++fleetTx[index];
+    size_t cmdPos = frame.find(",CMD:");
+    size_t crcPos = frame.rfind(",CRC:");
+    if (cmdPos == std::string::npos || crcPos == std::string::npos)
+    {
+        return;
+    }
+    std::string cmd = frame.substr(cmdPos + 5, crcPos - cmdPos - 5);
+    std::string acks;
+    if (frame.compare(0, 6, "GROUP:") == 0)
+    {
+        for (size_t i = index * groupSize / 2; i < (index + 1) * groupSize / 2; ++i)
+        {
+            acks += ackFrame(lights[i], cmd);
+        }
+    }
+    else if (frame.compare(0, 3, "ID:") == 0)
+    {
+        acks = ackFrame(frame.substr(3, frame.find(',') - 3), cmd);
+    }
+    serial.inject(acks);
+}
+
+void drainShards()
+{
+    Serial1.onTransmit = [](const uint8_t *data, size_t length) { ackShard(Serial1, 0, data, length); };
+    Serial2.onTransmit = [](const uint8_t *data, size_t length) { ackShard(Serial2, 1, data, length); };
+    do
+    {
+        shards[0]->loop();
+        shards[1]->loop();
+    } while (fleet->queueDepth() > 0 || Serial1.available() || Serial2.available());
+    Serial1.onTransmit = nullptr;
+    Serial2.onTransmit = nullptr;
+    Serial1.takeTx();
+    Serial2.takeTx();
+}
+
+// Hai coordinator, mỗi bên nửa số đèn: fleet học shard sở hữu từ khung DATA đầu tiên
+void setupShards()
+{
+    setupGroup();
+    if (!fleet)
+    {
+        shards[0] = new ZigbeeServer(ZigbeeTransport(), ZIGBEE_MAX_DEVICES, groupSize);
+        shards[1] = new ZigbeeServer(ZigbeeTransport(&Serial2, 26, 27, 9600, "ZigbeeServerTask2"), ZIGBEE_MAX_DEVICES, groupSize);
+        fleet = new ZigbeeFleet();
+        fleet->addShard(*shards[0]);
+        fleet->addShard(*shards[1]);
+        fleet->onGroupResult([](const GroupResult &result)
+        {
+            ++fleetResults;
+            fleetConfirmed += result.confirmed.size();
+        });
+        fleet->provisionDevices(lights);
+        for (int i = 0; i < groupSize; ++i)
+        {
+            (i < groupSize / 2 ? Serial1 : Serial2).inject(frame("ID:" + lights[i] + ",DATA:power:0") + "\n");
+        }
+        drainShards();
+        // Lần loop sau khi nhận thiết bị mới áp dụng danh sách cấp phép của từng shard
+        drainShards();
+        fleet->defineGroup("hall", lights);
+        drainShards();
+    }
+}
+
+void runShards()
+{
+    fleetTx[0] = fleetTx[1] = 0;
+    fleetResults = 0;
+    fleetConfirmed = 0;
+    fleet->sendGroupCommand("hall", "led_status:1");
+    drainShards();
+    benchReport("tx_frames", fleetTx[0] + fleetTx[1]);
+    benchReport("results", fleetResults);
+    benchReport("confirmed", fleetConfirmed);
+    benchReport("shard0_devices", shards[0]->deviceList.size());
+    benchReport("shard1_devices", shards[1]->deviceList.size());
+}
+
+}
+
+// Nhóm 50 đèn trải trên hai UART: mỗi coordinator một khung GROUP, onGroupResult nhận một kết quả gộp
+BENCHMARK("shards/group_2x25", setupShards, runShards);
@@ -0,0 +1,106 @@
+// Giải mã luồng log nhị phân của DeferredLog (bật bằng POST /api/log binary=1) đã ghi lại từ serial:
+//
+//   pio device monitor --raw > log.bin
+//   pio run -e native_logdecode && .pio/build/native_logdecode/program log.bin
+//
+// Các byte không thuộc frame nhị phân (vd: ESP_LOG của module khác) được in ra nguyên vẹn.
+#include "DeferredLog.h"
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Site {
+    uint8_t level;
+    std::string module;
+    std::string format;
+};
+
+const char LEVEL_CHARS[] = "NEWIDV";
+
+}
+
+int main(int argc, char **argv)
+{
+    FILE *file = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+
+    std::map<uint16_t, Site> sites;
+    size_t records = 0, unknown = 0, dropped = 0;
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        bool isFrame = pos + 5 <= data.size() && data[pos] == 'D' && data[pos + 1] == 'L' && data[pos + 2] <= DLOG_FRAME_DROPPED;
+        uint16_t len = 0;
+        if (isFrame)
+        {
+            memcpy(&len, &data[pos + 3], 2);
+            isFrame = pos + 5 + len <= data.size();
+        }
+        if (!isFrame)
+        {
+            fputc(data[pos++], stdout);
+            continue;
+        }
+
+        uint8_t type = data[pos + 2];
+        const uint8_t *payload = &data[pos + 5];
+        pos += 5 + len;
+
+        if (type == DLOG_FRAME_SITE && len >= 5)
+        {
+            uint16_t id;
+            memcpy(&id, payload, 2);
+            Site &site = sites[id];
+            site.level = payload[2];
+            site.module.assign((const char *)payload + 3, strnlen((const char *)payload + 3, len - 3));
+            size_t formatStart = 3 + site.module.size() + 1;
+            if (formatStart < len)
+            {
+                site.format.assign((const char *)payload + formatStart, strnlen((const char *)payload + formatStart, len - formatStart));
+            }
+        }
+        else if (type == DLOG_FRAME_RECORD && len >= 7)
+        {
+            uint16_t id;
+            uint32_t t;
+            memcpy(&id, payload, 2);
+            memcpy(&t, payload + 2, 4);
+            auto it = sites.find(id);
+            if (it == sites.end())
+            {
+                printf("? (%u) <site %u chưa có mô tả>\n", (unsigned)t, id);
+                ++unknown;
+                continue;
+            }
+            char line[512];
+            DeferredLog::format(it->second.format.c_str(), payload + 7, len - 7, line, sizeof(line));
+            printf("%c (%u) %s: %s\n", LEVEL_CHARS[it->second.level % 6], (unsigned)t, it->second.module.c_str(), line);
+            ++records;
+        }
+        else if (type == DLOG_FRAME_DROPPED && len >= 5)
+        {
+            uint32_t lost;
+            memcpy(&lost, payload + 1, 4);
+            printf("W DeferredLog: %u records dropped on ring %u\n", (unsigned)lost, payload[0]);
+            dropped += lost;
+        }
+    }
+    fprintf(stderr, "decoded %u records, %u without site, %u dropped on device\n",
+            (unsigned)records, (unsigned)unknown, (unsigned)dropped);
+    return 0;
+}
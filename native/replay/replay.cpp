@@ -0,0 +1,330 @@
+// Phát lại một capture ZBCAP (lấy qua GET /api/capture hoặc lệnh 'C' trên serial)
+// vào ZigbeeServer thông qua Serial1 giả, rồi in kết quả dạng JSON:
+//
+//   pio run -e native_replay && .pio/build/native_replay/program capture.zbcap
+//       [--fast | --speed x] [--devices all|none|id1,id2] [--verbose]
+//
+// Khung RX được đẩy vào Serial1 theo đúng mốc thời gian đã ghi (hoặc liền nhau với --fast).
+// Khung TX được gửi lại bằng sendCommand/broadcastMessage; khi server thực sự truyền lệnh,
+// các khung RX ghi sau đó được đẩy vào để vòng chờ ACK nhận được như trên thiết bị thật.
+// Lệnh không được ACK vẫn chờ đủ ZIGBEE_CONNECT_TIMEOUT, có thể rút ngắn bằng build flag.
+#include "zigbeeServer.h"
+#include "native_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace {
+
+struct Frame {
+    uint32_t t_us;
+    FrameDirection dir;
+    std::string data;
+};
+
+struct HandlerStats {
+    std::vector<double> latencyUs;
+    uint64_t allocs = 0;
+};
+
+std::vector<Frame> frames;
+size_t cursor = 0;
+std::string lastCommand;        // Lệnh TX gần nhất đã gửi, dùng để nhận ra các lần retry
+uint32_t lastCommandT = 0;
+size_t txMismatch = 0;
+size_t retriesSkipped = 0;
+ZigbeeServer server;            // Serial1, như shard mặc định trên thiết bị
+
+bool loadCapture(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    // Capture lấy qua serial có thể lẫn log phía trước, tìm header
+    const char *magic = FRAME_CAPTURE_MAGIC;
+    auto it = std::search(data.begin(), data.end(), magic, magic + 5);
+    if (it == data.end() || data.end() - it < FRAME_CAPTURE_HEADER_SIZE)
+    {
+        fprintf(stderr, "%s: no ZBCAP header\n", path);
+        return false;
+    }
+    size_t pos = it - data.begin();
+    if (data[pos + 5] != FRAME_CAPTURE_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported version %u\n", path, data[pos + 5]);
+        return false;
+    }
+    uint32_t length;
+    memcpy(&length, &data[pos + 8], 4);
+    pos += FRAME_CAPTURE_HEADER_SIZE;
+    size_t end = std::min(data.size(), pos + length);
+
+    while (pos + FRAME_CAPTURE_RECORD_SIZE <= end)
+    {
+        Frame frame;
+        uint16_t len;
+        memcpy(&frame.t_us, &data[pos], 4);
+        frame.dir = (FrameDirection)data[pos + 4];
+        memcpy(&len, &data[pos + 5], 2);
+        pos += FRAME_CAPTURE_RECORD_SIZE;
+        if (pos + len > end)
+        {
+            fprintf(stderr, "%s: truncated record\n", path);
+            break;
+        }
+        frame.data.assign((const char *)&data[pos], len);
+        pos += len;
+        frames.push_back(std::move(frame));
+    }
+    return true;
+}
+
+std::string stripCrc(const std::string &frame)
+{
+    size_t pos = frame.rfind(",CRC:");
+    return pos == std::string::npos ? frame : frame.substr(0, pos);
+}
+
+// Tên handler để gom thống kê: "cmd/led_status", "data", "tx/get_data", ...
+std::string handlerName(const Frame &frame)
+{
+    std::string body = stripCrc(frame.data);
+    size_t pos = body.find("CMD:");
+    if (pos != std::string::npos)
+    {
+        std::string cmd = body.substr(pos + 4);
+        if (cmd.compare(0, 4, "BRD:") != 0)
+        {
+            cmd = cmd.substr(0, cmd.find(':'));
+        }
+        return (frame.dir == FRAME_TX ? "tx/" : "cmd/") + cmd;
+    }
+    if (body.find("DATA:") != std::string::npos)
+    {
+        return frame.dir == FRAME_TX ? "tx/data" : "data";
+    }
+    return frame.dir == FRAME_TX ? "tx/other" : "other";
+}
+
+// Gửi lại lệnh TX qua API công khai để đi đúng đường enqueue -> loop
+bool resend(const std::string &command)
+{
+    if (command == "CMD:BRD:DISC")
+    {
+        server.broadcastMessage();
+        return true;
+    }
+    size_t key = command.find(",SECRECT_KEY:");
+    size_t cmd = command.find(",CMD:");
+    if (command.compare(0, 3, "ID:") != 0 || key == std::string::npos || cmd == std::string::npos || cmd < key)
+    {
+        return false;
+    }
+    std::string id = command.substr(3, key - 3);
+    std::string secret = command.substr(key + 13, cmd - key - 13);
+    server.sendCommand(id.c_str(), secret.c_str(), command.c_str() + cmd + 5);
+    return true;
+}
+
+// Server vừa truyền một khung: khớp với TX đang chờ rồi đẩy các RX ghi ngay sau nó
+void onTransmit(const uint8_t *data, size_t length)
+{
+    std::string sent((const char *)data, length);
+    if (!sent.empty() && sent.back() == '\n')
+    {
+        sent.pop_back();
+    }
+    if (cursor >= frames.size() || frames[cursor].dir != FRAME_TX)
+    {
+        return;
+    }
+    if (frames[cursor].data != sent)
+    {
+        ++txMismatch;
+    }
+    // Chỉ những khung tới trong cửa sổ chờ ACK mới được vòng chờ trên thiết bị đọc
+    uint32_t sentT = frames[cursor].t_us;
+    ++cursor;
+    std::string rx;
+    while (cursor < frames.size() && frames[cursor].dir == FRAME_RX &&
+           frames[cursor].t_us - sentT < (uint32_t)ZIGBEE_CONNECT_TIMEOUT * 1000)
+    {
+        rx += frames[cursor].data;
+        rx += '\n';
+        ++cursor;
+    }
+    Serial1.inject(rx);
+}
+
+void printStats(const std::string &name, HandlerStats &stats)
+{
+    std::vector<double> &v = stats.latencyUs;
+    std::sort(v.begin(), v.end());
+    double sum = 0;
+    for (double x : v)
+    {
+        sum += x;
+    }
+    printf("{\"handler\":\"%s\",\"frames\":%u,\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"allocs_per_frame\":%.2f}\n",
+           name.c_str(), (unsigned)v.size(), sum / v.size(), v[v.size() / 2],
+           v[std::min(v.size() - 1, v.size() * 99 / 100)], v.back(), (double)stats.allocs / v.size());
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = nullptr;
+    const char *devices = "all";
+    double speed = 1.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--fast"))
+        {
+            speed = 0;
+        }
+        else if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+        {
+            speed = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--devices") && i + 1 < argc)
+        {
+            devices = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--verbose"))
+        {
+            native_log_level = 5;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+    if (!path)
+    {
+        fprintf(stderr, "usage: %s capture.zbcap [--fast | --speed x] [--devices all|none|id1,id2] [--verbose]\n", argv[0]);
+        return 2;
+    }
+    if (!loadCapture(path))
+    {
+        return 1;
+    }
+
+    // Danh sách thiết bị do cloud cấp không có trong capture: mặc định coi mọi ID xuất hiện là đã cấp phép
+    std::vector<std::string> ids;
+    if (!strcmp(devices, "all"))
+    {
+        for (const Frame &frame : frames)
+        {
+            if (frame.data.compare(0, 3, "ID:") == 0)
+            {
+                std::string id = frame.data.substr(3, frame.data.find(',') - 3);
+                if (std::find(ids.begin(), ids.end(), id) == ids.end())
+                {
+                    ids.push_back(id);
+                }
+            }
+        }
+    }
+    else if (strcmp(devices, "none"))
+    {
+        std::istringstream stream(devices);
+        std::string id;
+        while (std::getline(stream, id, ','))
+        {
+            ids.push_back(id);
+        }
+    }
+
+    size_t samples = 0;
+    server.onMessage([&samples](const char *id, const char *data) { ++samples; });
+    server.provisionDevices(ids);
+    server.loop();
+    Serial1.captureTx = false;
+    Serial1.onTransmit = onTransmit;
+
+    std::map<std::string, HandlerStats> stats;
+    auto start = std::chrono::steady_clock::now();
+    uint32_t t0 = frames.empty() ? 0 : frames[0].t_us;
+    uint64_t allocs0 = nativeAllocCount.load();
+    size_t handled = 0;
+
+    while (cursor < frames.size())
+    {
+        const Frame &frame = frames[cursor];
+        if (speed > 0)
+        {
+            // Trừ không dấu để vẫn đúng khi micros() tràn
+            auto due = start + std::chrono::microseconds((uint64_t)((uint32_t)(frame.t_us - t0) / speed));
+            std::this_thread::sleep_until(due);
+        }
+
+        std::string name = handlerName(frame);
+        if (frame.dir == FRAME_RX)
+        {
+            Serial1.inject(frame.data + "\n");
+            ++cursor;
+        }
+        else
+        {
+            std::string command = stripCrc(frame.data);
+            // Lặp lại trong khoảng retry là lần gửi lại của cùng lệnh, server tự quyết định có retry hay không
+            if (command == lastCommand && frame.t_us - lastCommandT < (uint32_t)ZIGBEE_CONNECT_RETRY * ZIGBEE_CONNECT_TIMEOUT * 1000)
+            {
+                ++retriesSkipped;
+                ++cursor;
+                continue;
+            }
+            if (!resend(command))
+            {
+                ++txMismatch;
+                ++cursor;
+                continue;
+            }
+            lastCommand = command;
+            lastCommandT = frame.t_us;
+        }
+
+        uint64_t allocs = nativeAllocCount.load();
+        auto t = std::chrono::steady_clock::now();
+        server.loop();
+        // Vẫn còn dữ liệu do onTransmit đẩy vào thì xử lý hết trong cùng khung
+        while (Serial1.available())
+        {
+            server.loop();
+        }
+        HandlerStats &s = stats[name];
+        s.latencyUs.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count());
+        s.allocs += nativeAllocCount.load() - allocs;
+        ++handled;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t span = frames.empty() ? 0 : frames.back().t_us - t0;
+    printf("{\"capture\":\"%s\",\"frames\":%u,\"handled\":%u,\"samples\":%u,\"elapsed_s\":%.3f,\"capture_s\":%.3f,"
+           "\"frames_per_sec\":%.0f,\"allocs_per_frame\":%.2f,\"retries_skipped\":%u,\"tx_mismatch\":%u}\n",
+           path, (unsigned)frames.size(), (unsigned)handled, (unsigned)samples, elapsed, span / 1e6,
+           frames.size() / elapsed, (double)(nativeAllocCount.load() - allocs0) / std::max<size_t>(handled, 1),
+           (unsigned)retriesSkipped, (unsigned)txMismatch);
+    for (auto &entry : stats)
+    {
+        printStats(entry.first, entry.second);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+// Shim Arduino tối thiểu để biên dịch thư viện của dự án trên Linux (env:native).
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define T0 4
+
+unsigned long millis();
+unsigned long micros();
+// Chỉ có trên bản native: đẩy millis()/micros() tới trước để benchmark chạy được timer dài mà không phải chờ
+void native_advance_time(unsigned long ms);
+void delay(unsigned long ms);
+inline void pinMode(int, int) {}
+inline void digitalWrite(int, int) {}
+inline int touchRead(int) { return 100; }
+
+class String
+{
+  public:
+    String() {}
+    String(const char *s) : _s(s ? s : "") {}
+    String(const std::string &s) : _s(s) {}
+    String(char c) : _s(1, c) {}
+    explicit String(int v) : _s(std::to_string(v)) {}
+    explicit String(unsigned int v) : _s(std::to_string(v)) {}
+    explicit String(long v) : _s(std::to_string(v)) {}
+    explicit String(unsigned long v) : _s(std::to_string(v)) {}
+    explicit String(double v, unsigned int decimals = 2);
+
+    const char *c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.size(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+    void clear() { _s.clear(); }
+
+    bool concat(const char *s) { if (!s) return false; _s += s; return true; }
+    bool concat(const char *s, unsigned int n) { if (!s) return false; _s.append(s, n); return true; }
+    bool concat(char c) { _s += c; return true; }
+    bool concat(const String &s) { _s += s._s; return true; }
+
+    String &operator=(const char *s) { _s = s ? s : ""; return *this; }
+    String &operator+=(const String &s) { _s += s._s; return *this; }
+    String &operator+=(const char *s) { if (s) _s += s; return *this; }
+    String &operator+=(char c) { _s += c; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+    friend String operator+(const String &a, const char *b) { return String(a._s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b._s); }
+
+    bool operator==(const String &o) const { return _s == o._s; }
+    bool operator==(const char *o) const { return o && _s == o; }
+    bool operator!=(const String &o) const { return _s != o._s; }
+    bool operator<(const String &o) const { return _s < o._s; }
+    char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : 0; }
+    char charAt(unsigned int i) const { return (*this)[i]; }
+
+    int indexOf(char c, unsigned int from = 0) const { return find(_s.find(c, from)); }
+    int indexOf(const char *s, unsigned int from = 0) const { return find(_s.find(s, from)); }
+    String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const { return from >= _s.size() || to <= from ? String() : String(_s.substr(from, to - from)); }
+    bool equalsIgnoreCase(const String &o) const;
+    void replace(const String &find, const String &replace);
+    void trim();
+    long toInt() const { return atol(_s.c_str()); }
+    double toDouble() const { return atof(_s.c_str()); }
+
+  private:
+    static int find(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    std::string _s;
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return print(String(v)); }
+    size_t print(unsigned long v) { return print(String(v)); }
+    size_t println() { return write("\n"); }
+    template <typename T> size_t println(const T &v) { return print(v) + println(); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() { return -1; }
+    String readStringUntil(char terminator);
+};
+
+#include "HardwareSerial.h"
+
+class EspClass
+{
+  public:
+    void restart() { exit(0); }
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+extern EspClass ESP;
@@ -0,0 +1,278 @@
+#pragma once
+// AsyncWebServer giả: lưu route và handler đã đăng ký, request được tạo và gọi trực tiếp từ test.
+// AsyncEventSource giữ hàng đợi của từng client như thư viện thật: tối đa SSE_MAX_QUEUED_MESSAGES bản tin,
+// bản tin tới khi hàng đợi đầy bị bỏ. Client giả chỉ nhận bản tin khi test gọi drain() (mạng chậm).
+#include "Arduino.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef SSE_MAX_QUEUED_MESSAGES
+#define SSE_MAX_QUEUED_MESSAGES 32
+#endif
+
+typedef enum
+{
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+} WebRequestMethod;
+
+class AsyncWebServerRequest;
+typedef std::function<bool(AsyncWebServerRequest *request)> ArRequestFilterFunction;
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+
+inline bool ON_STA_FILTER(AsyncWebServerRequest *request) { return true; }
+inline bool ON_AP_FILTER(AsyncWebServerRequest *request) { return true; }
+
+class AsyncWebParameter
+{
+  public:
+    AsyncWebParameter(const String &name, const String &value) : _name(name), _value(value) {}
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+
+  private:
+    String _name;
+    String _value;
+};
+
+class AsyncWebServerResponse
+{
+  public:
+    virtual ~AsyncWebServerResponse() {}
+    void addHeader(const String &name, const String &value) { headers[name.c_str()] = value.c_str(); }
+
+    int code = 200;
+    std::string contentType;
+    std::string body;
+    std::map<std::string, std::string> headers;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print
+{
+  public:
+    size_t write(uint8_t c) override { body += (char)c; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { body.append((const char *)buffer, size); return size; }
+    using Print::write;
+};
+
+class AsyncWebServerRequest
+{
+  public:
+    AsyncWebServerRequest(WebRequestMethod method, const char *url) : _method(method), _url(url) {}
+
+    // Tham số query (post = false) hoặc form body (post = true)
+    void addParam(const char *name, const char *value, bool post = false)
+    {
+        (post ? _post : _query).emplace_back(name, value);
+    }
+    bool hasParam(const char *name, bool post = false) const { return getParam(name, post) != nullptr; }
+    const AsyncWebParameter *getParam(const char *name, bool post = false) const
+    {
+        for (const AsyncWebParameter &param : post ? _post : _query)
+        {
+            if (param.name() == name)
+            {
+                return &param;
+            }
+        }
+        return nullptr;
+    }
+
+    void send(int code, const char *contentType, const char *content)
+    {
+        response.reset(new AsyncWebServerResponse());
+        response->code = code;
+        response->contentType = contentType;
+        response->body = content;
+    }
+    void send(AsyncWebServerResponse *sent) { response.reset(sent); }
+    AsyncResponseStream *beginResponseStream(const char *contentType)
+    {
+        AsyncResponseStream *stream = new AsyncResponseStream();
+        stream->contentType = contentType;
+        return stream;
+    }
+    AsyncWebServerResponse *beginChunkedResponse(const char *contentType, AwsResponseFiller filler)
+    {
+        AsyncWebServerResponse *chunked = new AsyncWebServerResponse();
+        chunked->contentType = contentType;
+        uint8_t buffer[512];
+        size_t n;
+        while ((n = filler(buffer, sizeof(buffer), chunked->body.size())) > 0)
+        {
+            chunked->body.append((const char *)buffer, n);
+        }
+        return chunked;
+    }
+
+    WebRequestMethod method() const { return _method; }
+    const std::string &url() const { return _url; }
+
+    std::unique_ptr<AsyncWebServerResponse> response;
+
+  private:
+    WebRequestMethod _method;
+    std::string _url;
+    std::vector<AsyncWebParameter> _query;
+    std::vector<AsyncWebParameter> _post;
+};
+
+class AsyncWebHandler
+{
+  public:
+    virtual ~AsyncWebHandler() {}
+    AsyncWebHandler &setFilter(ArRequestFilterFunction filter) { _filter = filter; return *this; }
+
+  protected:
+    ArRequestFilterFunction _filter;
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler
+{
+  public:
+    AsyncCallbackWebHandler(const char *uri, WebRequestMethod method, ArRequestHandlerFunction handler)
+        : uri(uri), method(method), handler(handler) {}
+
+    std::string uri;
+    WebRequestMethod method;
+    ArRequestHandlerFunction handler;
+};
+
+class AsyncEventSourceClient
+{
+  public:
+    struct Message
+    {
+        std::string event;
+        std::string data;
+    };
+
+    void send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0)
+    {
+        if (_queue.size() >= SSE_MAX_QUEUED_MESSAGES)
+        {
+            ++dropped;
+            return;
+        }
+        _queue.push_back({event ? event : "", message ? message : ""});
+    }
+    size_t packetsWaiting() const { return _queue.size(); }
+    bool connected() const { return true; }
+
+    // Mạng đưa tối đa n bản tin trong hàng đợi tới client
+    void drain(size_t n)
+    {
+        for (; n > 0 && !_queue.empty(); --n)
+        {
+            received.push_back(_queue.front());
+            _queue.pop_front();
+        }
+    }
+
+    std::vector<Message> received;
+    uint32_t dropped = 0;       // Bản tin bị bỏ vì hàng đợi đầy
+
+  private:
+    std::deque<Message> _queue;
+};
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncEventSource : public AsyncWebHandler
+{
+  public:
+    AsyncEventSource(const String &url) : _url(url.c_str()) {}
+    const char *url() const { return _url.c_str(); }
+    void onConnect(ArEventHandlerFunction callback) { _connectCallback = callback; }
+
+    void send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0)
+    {
+        for (auto &client : _clients)
+        {
+            client->send(message, event, id, reconnect);
+        }
+    }
+    size_t count() const { return _clients.size(); }
+    size_t avgPacketsWaiting() const
+    {
+        if (_clients.empty())
+        {
+            return 0;
+        }
+        size_t waiting = 0;
+        for (const auto &client : _clients)
+        {
+            waiting += client->packetsWaiting();
+        }
+        return waiting / _clients.size();
+    }
+
+    // Một trình duyệt mở /api/events
+    AsyncEventSourceClient *connect()
+    {
+        _clients.emplace_back(new AsyncEventSourceClient());
+        if (_connectCallback)
+        {
+            _connectCallback(_clients.back().get());
+        }
+        return _clients.back().get();
+    }
+
+  private:
+    std::string _url;
+    ArEventHandlerFunction _connectCallback;
+    std::vector<std::unique_ptr<AsyncEventSourceClient>> _clients;
+};
+
+class AsyncWebServer
+{
+  public:
+    AsyncWebServer(uint16_t port) {}
+    void begin() {}
+
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethod method, ArRequestHandlerFunction handler)
+    {
+        _routes.emplace_back(new AsyncCallbackWebHandler(uri, method, handler));
+        return *_routes.back();
+    }
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler)
+    {
+        _handlers.push_back(handler);
+        return *handler;
+    }
+
+    // Gọi handler của route như khi request tới, trả về false nếu không có route
+    bool handle(AsyncWebServerRequest &request)
+    {
+        for (const auto &route : _routes)
+        {
+            if (route->uri == request.url() && route->method == request.method())
+            {
+                route->handler(&request);
+                return true;
+            }
+        }
+        return false;
+    }
+    AsyncEventSource *eventSource(const char *url)
+    {
+        for (AsyncWebHandler *handler : _handlers)
+        {
+            AsyncEventSource *source = dynamic_cast<AsyncEventSource *>(handler);
+            if (source && strcmp(source->url(), url) == 0)
+            {
+                return source;
+            }
+        }
+        return nullptr;
+    }
+
+  private:
+    std::vector<std::unique_ptr<AsyncCallbackWebHandler>> _routes;
+    std::vector<AsyncWebHandler *> _handlers;
+};
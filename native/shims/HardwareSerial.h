@@ -0,0 +1,58 @@
+#pragma once
+// UART giả: dữ liệu nhận được đẩy vào rx, dữ liệu gửi đi được ghi vào tx (hoặc onTransmit).
+#include "Arduino.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+
+#define SERIAL_8N1 0x800001c
+
+enum SerialHwFlowCtrl {
+    UART_HW_FLOWCTRL_DISABLE = 0,
+    UART_HW_FLOWCTRL_RTS = 1,
+    UART_HW_FLOWCTRL_CTS = 2,
+    UART_HW_FLOWCTRL_CTS_RTS = 3
+};
+
+class HardwareSerial : public Stream
+{
+  public:
+    explicit HardwareSerial(int uart) : _uart(uart) {}
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1) { _baud = baud; }
+    void end() {}
+    void updateBaudRate(unsigned long baud) { _baud = baud; }
+    unsigned long baudRate() { return _baud; }
+    size_t setRxBufferSize(size_t size) { return size; }
+    size_t setTxBufferSize(size_t size) { return size; }
+    bool setPins(int8_t rxPin, int8_t txPin, int8_t ctsPin = -1, int8_t rtsPin = -1) { return true; }
+    bool setHwFlowCtrlMode(uint8_t mode = UART_HW_FLOWCTRL_CTS_RTS, uint8_t threshold = 64) { return true; }
+    void onReceive(std::function<void(void)> callback, bool onlyOnTimeout = false) { _onReceive = callback; }
+    void flush() {}
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    // Phía "thiết bị" của UART giả
+    void inject(const char *data, size_t length);
+    void inject(const std::string &data) { inject(data.data(), data.size()); }
+    std::string takeTx();
+
+    std::function<void(const uint8_t *data, size_t length)> onTransmit;
+    bool captureTx = true;
+
+  private:
+    int _uart;
+    unsigned long _baud = 0;
+    std::mutex _lock;
+    std::deque<uint8_t> _rx;
+    std::string _tx;
+    std::function<void(void)> _onReceive;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
@@ -0,0 +1,15 @@
+#pragma once
+#include "WiFiUdp.h"
+#include <time.h>
+
+class NTPClient
+{
+  public:
+    NTPClient(WiFiUDP &udp, const char *server, long offset = 0, unsigned long interval = 60000) {}
+    void begin() {}
+    bool update() { return true; }
+    bool forceUpdate() { return true; }
+    bool isTimeSet() const { return true; }
+    unsigned long getEpochTime() const { return (unsigned long)time(nullptr); }
+    String getFormattedTime() const { return "00:00:00"; }
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include "Arduino.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// NVS giả trong RAM, chia theo namespace như trên thiết bị; mất khi thoát chương trình
+class Preferences
+{
+  public:
+    bool begin(const char *name, bool readOnly = false);
+    void end() {}
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t length);
+    size_t putBytes(const char *key, const void *buffer, size_t length);
+    String getString(const char *key, const String &defaultValue = String());
+    size_t putString(const char *key, const char *value);
+    bool isKey(const char *key);
+    bool remove(const char *key);
+
+    static uint32_t writes;     // Số lần putBytes, tương ứng số lần ghi flash
+
+  private:
+    std::map<std::string, std::vector<uint8_t>> *_space = nullptr;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include "Arduino.h"
+
+#define WL_CONNECTED 3
+#define WL_CONNECT_FAILED 4
+#define WL_CONNECTION_LOST 5
+#define WL_DISCONNECTED 6
+#define WIFI_OFF 0
+#define WIFI_STA 1
+#define WIFI_AP 2
+
+class IPAddress
+{
+  public:
+    String toString() const { return "127.0.0.1"; }
+};
+
+class Client : public Stream
+{
+  public:
+    virtual int connect(const char *host, uint16_t port) { return 1; }
+    virtual uint8_t connected() { return 1; }
+    virtual void stop() {}
+    int available() override { return 0; }
+    int read() override { return -1; }
+    size_t write(uint8_t c) override { return 1; }
+    using Print::write;
+};
+
+class WiFiClient : public Client
+{
+  public:
+    int fd() const { return -1; }   // Không có socket thật, PEClient quay về chờ theo timer
+};
+
+class WiFiClass
+{
+  public:
+    void mode(int m) {}
+    void begin(const char *ssid, const char *password) {}
+    int status() { return WL_CONNECTED; }
+    void disconnect() {}
+    IPAddress localIP() { return IPAddress(); }
+    IPAddress softAPIP() { return IPAddress(); }
+    bool softAP(const char *ssid, const char *password, int channel = 1, bool hidden = false, int maxConnections = 4) { return true; }
+};
+extern WiFiClass WiFi;
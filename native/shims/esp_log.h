@@ -0,0 +1,13 @@
+#pragma once
+// Shim esp_log cho bản build native: luôn format như trên ESP32 để đo đúng chi phí,
+// chỉ in ra stderr khi mức log <= native_log_level (mặc định 0 = không in).
+#include <stdio.h>
+
+extern int native_log_level;
+void native_log(int level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, fmt, ...) native_log(1, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) native_log(2, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) native_log(3, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) native_log(4, tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) native_log(5, tag, fmt, ##__VA_ARGS__)
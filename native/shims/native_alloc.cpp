@@ -0,0 +1,43 @@
+#include "native_alloc.h"
+#include <new>
+#include <stdlib.h>
+
+std::atomic<uint64_t> nativeAllocCount(0);
+std::atomic<uint64_t> nativeAllocBytes(0);
+
+void *operator new(size_t size)
+{
+    nativeAllocCount.fetch_add(1, std::memory_order_relaxed);
+    nativeAllocBytes.fetch_add(size, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
@@ -0,0 +1,8 @@
+#pragma once
+// Đếm cấp phát bộ nhớ trên host: operator new được thay thế trong native_alloc.cpp,
+// dùng chung cho benchmark và công cụ replay.
+#include <stdint.h>
+#include <atomic>
+
+extern std::atomic<uint64_t> nativeAllocCount;
+extern std::atomic<uint64_t> nativeAllocBytes;
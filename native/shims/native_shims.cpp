@@ -0,0 +1,618 @@
+// Hiện thực các shim Arduino/FreeRTOS bằng thư viện chuẩn C++ cho env:native.
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <Preferences.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int native_log_level = 0;
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+WiFiClass WiFi;
+EspClass ESP;
+
+uint32_t PubSubClient::publishCount = 0;
+uint64_t PubSubClient::publishBytes = 0;
+uint32_t PubSubClient::publishTooLarge = 0;
+std::function<void(const char *, const uint8_t *, unsigned int)> PubSubClient::onPublish;
+
+uint32_t Preferences::writes = 0;
+
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> nvs;
+
+bool Preferences::begin(const char *name, bool readOnly)
+{
+    _space = &nvs[name];
+    return true;
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+    auto it = _space->find(key);
+    return it == _space->end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t length)
+{
+    auto it = _space->find(key);
+    if (it == _space->end() || it->second.size() > length)
+    {
+        return 0;
+    }
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *buffer, size_t length)
+{
+    (*_space)[key].assign((const uint8_t *)buffer, (const uint8_t *)buffer + length);
+    ++writes;
+    return length;
+}
+
+String Preferences::getString(const char *key, const String &defaultValue)
+{
+    auto it = _space->find(key);
+    return it == _space->end() ? defaultValue : String(std::string(it->second.begin(), it->second.end()));
+}
+
+size_t Preferences::putString(const char *key, const char *value)
+{
+    return putBytes(key, value, strlen(value));
+}
+
+bool Preferences::isKey(const char *key)
+{
+    return _space->count(key) > 0;
+}
+
+bool Preferences::remove(const char *key)
+{
+    return _space->erase(key) > 0;
+}
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+void native_log(int level, const char *tag, const char *fmt, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, args);
+    va_end(args);
+    if (level <= native_log_level)
+    {
+        fprintf(stderr, "[%c] %s: %s\n", "?EWIDV"[level], tag, buffer);
+    }
+}
+
+static std::atomic<uint64_t> clockOffsetUs(0);
+
+unsigned long millis()
+{
+    return (unsigned long)((std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() + clockOffsetUs.load()) / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count() + clockOffsetUs.load());
+}
+
+void native_advance_time(unsigned long ms)
+{
+    clockOffsetUs += (uint64_t)ms * 1000;
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// ---------------------------------------------------------------- String / Print
+
+String::String(double v, unsigned int decimals)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", decimals, v);
+    _s = buffer;
+}
+
+bool String::equalsIgnoreCase(const String &o) const
+{
+    if (_s.size() != o._s.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < _s.size(); ++i)
+    {
+        if (tolower((unsigned char)_s[i]) != tolower((unsigned char)o._s[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void String::replace(const String &find, const String &replace)
+{
+    if (find._s.empty())
+    {
+        return;
+    }
+    size_t pos = 0;
+    while ((pos = _s.find(find._s, pos)) != std::string::npos)
+    {
+        _s.replace(pos, find._s.size(), replace._s);
+        pos += replace._s.size();
+    }
+}
+
+void String::trim()
+{
+    size_t begin = _s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+    {
+        _s.clear();
+        return;
+    }
+    size_t end = _s.find_last_not_of(" \t\r\n");
+    _s = _s.substr(begin, end - begin + 1);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        write(buffer[i]);
+    }
+    return size;
+}
+
+size_t Print::printf(const char *format, ...)
+{
+    char buffer[512];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n < 0)
+    {
+        return 0;
+    }
+    return write((const uint8_t *)buffer, std::min((size_t)n, sizeof(buffer) - 1));
+}
+
+String Stream::readStringUntil(char terminator)
+{
+    String result;
+    while (available())
+    {
+        int c = read();
+        if (c < 0 || c == terminator)
+        {
+            break;
+        }
+        result += (char)c;
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------- HardwareSerial
+
+int HardwareSerial::available()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return (int)_rx.size();
+}
+
+int HardwareSerial::read()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_rx.empty())
+    {
+        return -1;
+    }
+    int c = _rx.front();
+    _rx.pop_front();
+    return c;
+}
+
+int HardwareSerial::peek()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _rx.empty() ? -1 : _rx.front();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if (_uart == 0)
+    {
+        if (native_log_level > 0)
+        {
+            fwrite(buffer, 1, size, stderr);
+        }
+        return size;
+    }
+    if (onTransmit)
+    {
+        onTransmit(buffer, size);
+    }
+    if (captureTx)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _tx.append((const char *)buffer, size);
+    }
+    return size;
+}
+
+void HardwareSerial::inject(const char *data, size_t length)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        _rx.insert(_rx.end(), data, data + length);
+    }
+    if (_onReceive)
+    {
+        _onReceive();
+    }
+}
+
+std::string HardwareSerial::takeTx()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    std::string tx;
+    tx.swap(_tx);
+    return tx;
+}
+
+// ---------------------------------------------------------------- PubSubClient
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+    if (!_connected)
+    {
+        return false;
+    }
+    if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length > _bufferSize)
+    {
+        ++publishTooLarge;
+        return false;
+    }
+    ++publishCount;
+    publishBytes += length;
+    if (onPublish)
+    {
+        onPublish(topic, payload, length);
+    }
+    return true;
+}
+
+void PubSubClient::deliver(const char *topic, const char *payload)
+{
+    if (_callback)
+    {
+        std::vector<uint8_t> data(payload, payload + strlen(payload));
+        std::string name(topic);
+        _callback(&name[0], data.data(), (unsigned int)data.size());
+    }
+}
+
+// ---------------------------------------------------------------- FreeRTOS
+
+struct NativeTask
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    uint32_t notification = 0;
+    bool notified = false;
+    void *tls[configNUM_THREAD_LOCAL_STORAGE_POINTERS] = {};
+};
+
+struct NativeSemaphore
+{
+    std::timed_mutex mutex;
+    std::recursive_timed_mutex recursive;   // Chỉ dùng qua các hàm *Recursive
+};
+
+struct NativeQueue
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t itemSize;
+};
+
+struct NativeEventGroup
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+static thread_local NativeTask *currentTask = nullptr;
+static std::mutex criticalLock;
+
+template <typename Lock, typename Predicate>
+static bool waitFor(std::condition_variable &cv, Lock &lock, TickType_t wait, Predicate predicate)
+{
+    if (wait == portMAX_DELAY)
+    {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(wait), predicate);
+}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    criticalLock.lock();
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    criticalLock.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    NativeTask *task = new NativeTask();
+    if (handle)
+    {
+        *handle = task;
+    }
+    std::thread([fn, arg, task]() {
+        currentTask = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    // Không thể dừng std::thread từ bên ngoài; task tự kết thúc khi hàm trả về
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    if (!currentTask)
+    {
+        currentTask = new NativeTask();
+    }
+    return currentTask;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t handle)
+{
+    return 0;
+}
+
+BaseType_t xPortGetCoreID()
+{
+    return 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t wait)
+{
+    NativeTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+    waitFor(task->cv, lock, wait, [task] { return task->notification != 0; });
+    uint32_t value = task->notification;
+    if (value)
+    {
+        task->notification = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle)
+{
+    return xTaskNotify(handle, 0, eIncrement);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t handle, uint32_t value, eNotifyAction action)
+{
+    {
+        std::lock_guard<std::mutex> guard(handle->lock);
+        switch (action)
+        {
+        case eSetBits: handle->notification |= value; break;
+        case eIncrement: ++handle->notification; break;
+        case eSetValueWithOverwrite: handle->notification = value; break;
+        default: break;
+        }
+        handle->notified = true;
+    }
+    handle->cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t wait)
+{
+    NativeTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->lock);
+    if (!task->notified)
+    {
+        task->notification &= ~clearOnEntry;
+    }
+    bool received = waitFor(task->cv, lock, wait, [task] { return task->notified; });
+    if (value)
+    {
+        *value = task->notification;
+    }
+    if (received)
+    {
+        task->notification &= ~clearOnExit;
+        task->notified = false;
+    }
+    return received ? pdTRUE : pdFALSE;
+}
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t handle, BaseType_t index)
+{
+    if (!handle)
+    {
+        handle = xTaskGetCurrentTaskHandle();
+    }
+    return handle->tls[index];
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t handle, BaseType_t index, void *value)
+{
+    if (!handle)
+    {
+        handle = xTaskGetCurrentTaskHandle();
+    }
+    handle->tls[index] = value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new NativeSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    if (wait == portMAX_DELAY)
+    {
+        semaphore->mutex.lock();
+        return pdTRUE;
+    }
+    return semaphore->mutex.try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->mutex.unlock();
+    return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return new NativeSemaphore();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+    if (wait == portMAX_DELAY)
+    {
+        semaphore->recursive.lock();
+        return pdTRUE;
+    }
+    return semaphore->recursive.try_lock_for(std::chrono::milliseconds(wait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore)
+{
+    semaphore->recursive.unlock();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    NativeQueue *queue = new NativeQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->cv, lock, wait, [queue] { return queue->items.size() < queue->length; }))
+    {
+        return pdFALSE;
+    }
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if (!waitFor(queue->cv, lock, wait, [queue] { return !queue->items.empty(); }))
+    {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new NativeEventGroup();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    std::lock_guard<std::mutex> guard(group->lock);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t wait)
+{
+    std::unique_lock<std::mutex> lock(group->lock);
+    auto ready = [group, bits, waitForAll] {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool satisfied = waitFor(group->cv, lock, wait, ready);
+    EventBits_t value = group->bits;
+    if (satisfied && clearOnExit)
+    {
+        group->bits &= ~bits;
+    }
+    return value;
+}
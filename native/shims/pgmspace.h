@@ -0,0 +1,5 @@
+#pragma once
+#define PROGMEM
+#define PSTR(s) (s)
+#define memcpy_P memcpy
+#define strlen_P strlen
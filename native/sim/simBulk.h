@@ -0,0 +1,279 @@
+#ifndef SIMBULK_H
+#define SIMBULK_H
+// Thiết bị đích và đường truyền mất khung giả lập cho kênh bulk, dùng chung cho benchmark và test trên host.
+// BulkTransfer chạy với đồng hồ ảo, thời gian truyền tính theo baud của UART.
+#include "bulkTransfer.h"
+#include "esp_rom_crc.h"
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define SIM_BULK_BAUD 9600
+#define SIM_BULK_LATENCY 30         // ms coordinator -> radio -> thiết bị và ngược lại
+#define SIM_BULK_TRANSFER 0xF1A5C0DE
+
+inline std::vector<uint8_t> simDecodeBase64(const std::string &text)
+{
+    static int8_t table[256];
+    static bool ready = false;
+    if (!ready)
+    {
+        const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        memset(table, -1, sizeof(table));
+        for (int i = 0; i < 64; ++i)
+        {
+            table[(uint8_t)alphabet[i]] = i;
+        }
+        ready = true;
+    }
+    std::vector<uint8_t> out;
+    uint32_t chunk = 0;
+    int bits = 0;
+    for (char c : text)
+    {
+        if (table[(uint8_t)c] < 0)
+        {
+            break;
+        }
+        chunk = (chunk << 6) | table[(uint8_t)c];
+        bits += 6;
+        if (bits >= 8)
+        {
+            bits -= 8;
+            out.push_back((chunk >> bits) & 0xFF);
+        }
+    }
+    return out;
+}
+
+// Ảnh thử nghiệm giả ngẫu nhiên, cùng nội dung mỗi lần chạy
+inline std::vector<uint8_t> simBulkImage(uint32_t size)
+{
+    std::vector<uint8_t> image(size);
+    uint32_t x = 0x12345678;
+    for (uint8_t &byte : image)
+    {
+        x = x * 1664525u + 1013904223u;
+        byte = x >> 24;
+    }
+    return image;
+}
+
+// Thiết bị đầu cuối: ghi block vào "flash" của nó, nhớ tiến độ qua lần mở kênh sau (resume)
+struct SimBulkDevice
+{
+    std::string id = "TBE0123456789ZB";
+    uint32_t transfer = 0;
+    uint32_t size = 0;
+    uint32_t blockSize = 0;
+    std::vector<uint8_t> received;
+    std::vector<bool> have;
+
+    uint32_t next() const
+    {
+        uint32_t n = 0;
+        while (n < have.size() && have[n])
+        {
+            ++n;
+        }
+        return n;
+    }
+
+    std::string ack(const std::string &suffix = "")
+    {
+        uint32_t n = next();
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < 32 && n + 1 + i < have.size(); ++i)
+        {
+            if (have[n + 1 + i])
+            {
+                mask |= 1u << i;
+            }
+        }
+        char text[64];
+        snprintf(text, sizeof(text), "ID:%s,BACK:%08X:%u:%08X%s", id.c_str(), (unsigned)transfer, (unsigned)n,
+                 (unsigned)mask, suffix.c_str());
+        return text;
+    }
+
+    // Trả về khung trả lời (chưa có CRC), rỗng nếu không trả lời
+    std::string handle(const std::string &frame)
+    {
+        size_t pos;
+        if ((pos = frame.find(",BULK:")) != std::string::npos)
+        {
+            unsigned tid, total, value;
+            char kind[8];
+            if (sscanf(frame.c_str() + pos + 6, "%x:%7[A-Z]:%u:%x", &tid, kind, &total, &value) != 4)
+            {
+                return "";
+            }
+            if (!strcmp(kind, "OPEN"))
+            {
+                sscanf(frame.c_str() + pos + 6, "%x:%7[A-Z]:%u:%u", &tid, kind, &total, &value);
+                if (tid != transfer || total != size)
+                {
+                    transfer = tid;
+                    size = total;
+                    blockSize = value;
+                    received.assign(total, 0);
+                    have.assign((total + value - 1) / value, false);
+                }
+                return ack();
+            }
+            bool ok = next() == have.size() && esp_rom_crc32_le(0, received.data(), size) == value;
+            return ack(ok ? ":OK" : ":ERR");
+        }
+        if ((pos = frame.find(",BLK:")) != std::string::npos)
+        {
+            unsigned tid, seq, crc;
+            int payload = 0;
+            if (sscanf(frame.c_str() + pos + 5, "%x:%u:%x:%n", &tid, &seq, &crc, &payload) != 3 || tid != transfer ||
+                seq >= have.size())
+            {
+                return "";
+            }
+            std::vector<uint8_t> data = simDecodeBase64(frame.substr(pos + 5 + payload));
+            if (esp_rom_crc32_le(0, data.data(), data.size()) != crc)
+            {
+                return "";
+            }
+            memcpy(&received[seq * blockSize], data.data(), data.size());
+            have[seq] = true;
+            return ack();
+        }
+        return "";
+    }
+};
+
+// Đường truyền bán song công giả lập: mỗi chiều một hàng đợi, mất khung theo xác suất
+struct SimLossyLink
+{
+    uint32_t seed = 1;
+    uint32_t lossPercent = 0;
+    uint32_t now = 0;
+    uint32_t txFree = 0;    // Lúc UART chiều đi rảnh
+    uint64_t wireBytes = 0;
+    bool down = false;      // Mất hẳn kết nối (thiết bị tắt nguồn)
+    int32_t firstBlock = -1;    // Block đầu tiên gửi đi sau OPEN gần nhất, -1 nếu chưa gửi block nào
+    std::deque<std::pair<uint32_t, std::string>> replies;
+    SimBulkDevice *device = nullptr;
+
+    bool lost()
+    {
+        seed = seed * 1103515245u + 12345u;
+        return down || (seed >> 16) % 100 < lossPercent;
+    }
+
+    uint32_t airtime(size_t bytes) const
+    {
+        return (uint32_t)((bytes + 10) * 10 * 1000 / SIM_BULK_BAUD);  // 10 bit/byte, cộng CRC và xuống dòng
+    }
+
+    // Ghi UART chặn tới khi khung rời đi, như buffer TX đầy trên thiết bị thật
+    uint32_t send(const std::string &frame)
+    {
+        wireBytes += frame.size() + 14;
+        size_t pos = frame.find(",BLK:");
+        unsigned tid, seq;
+        if (frame.find(":OPEN:") != std::string::npos)
+        {
+            firstBlock = -1;
+        }
+        else if (firstBlock < 0 && pos != std::string::npos && sscanf(frame.c_str() + pos + 5, "%x:%u", &tid, &seq) == 2)
+        {
+            firstBlock = seq;
+        }
+        txFree = std::max(txFree, now) + airtime(frame.size());
+        now = txFree;
+        if (lost())
+        {
+            return now;
+        }
+        std::string reply = device->handle(frame);
+        if (!reply.empty() && !lost())
+        {
+            replies.emplace_back(txFree + SIM_BULK_LATENCY + airtime(reply.size()), reply);
+        }
+        return now;
+    }
+};
+
+struct SimBulkRun
+{
+    uint32_t elapsedMs = 0;
+    uint64_t wireBytes = 0;
+    uint32_t pausedAt = 0;      // Block liên tiếp thiết bị đã nhận khi lần truyền tạm dừng
+    int32_t resumedFrom = -1;   // Block đầu tiên gửi đi sau khi resume, -1 nếu không resume
+    BulkStatus status;
+    bool imageOk = false;
+};
+
+// Chạy tới khi xong, hỏng, hoặc tạm dừng (outageAt: block mà sau khi được ACK thì mất kết nối outageMs,
+// tạm dừng vì hết retry thì resume khi kết nối trở lại)
+inline SimBulkRun simRunBulk(const std::vector<uint8_t> &image, uint32_t lossPercent,
+                             uint8_t window = ZIGBEE_BULK_WINDOW, uint32_t outageAt = UINT32_MAX,
+                             uint32_t outageMs = 0)
+{
+    BulkTransfer bulk(ZIGBEE_BULK_BLOCK_SIZE, window, 400);
+    SimBulkDevice device;
+    SimLossyLink link;
+    link.device = &device;
+    link.lossPercent = lossPercent;
+    BulkTransfer::Sender send = [&link](const std::string &frame) { return link.send(frame); };
+    BulkSource source = [&image](uint32_t offset, uint8_t *buffer, size_t length) {
+        memcpy(buffer, image.data() + offset, length);
+        return length;
+    };
+    SimBulkRun run;
+    uint32_t outageEnd = 0;
+    bool resumed = false;
+
+    bulk.start(device.id.c_str(), SIM_BULK_TRANSFER, image.size(), source);
+    while (true)
+    {
+        uint32_t wait = bulk.poll(link.now, send);
+        BulkState state = bulk.status().state;
+        if (state == BULK_PAUSED && link.down)
+        {
+            // Thiết bị trở lại sau khi mất điện: mở lại kênh, thiết bị báo block cần tiếp theo
+            link.now = std::max(link.now, outageEnd);
+            link.down = false;
+            run.pausedAt = device.next();
+            resumed = true;
+            bulk.resume();
+            continue;
+        }
+        if (state == BULK_DONE || state == BULK_FAILED || state == BULK_PAUSED)
+        {
+            break;
+        }
+        // Tới ACK kế tiếp hoặc hạn chót, rồi xử lý mọi ACK đã tới như processIncoming() trước lần poll sau
+        uint32_t deadline = link.now + wait;
+        if (!link.replies.empty() && link.replies.front().first < deadline)
+        {
+            deadline = std::max(link.now, link.replies.front().first);
+        }
+        link.now = deadline;
+        while (!link.replies.empty() && link.replies.front().first <= link.now)
+        {
+            bulk.handleAck(link.replies.front().second);
+            link.replies.pop_front();
+        }
+        if (!link.down && bulk.status().acked >= outageAt)
+        {
+            link.down = true;
+            outageEnd = link.now + outageMs;
+            outageAt = UINT32_MAX;
+        }
+    }
+    run.elapsedMs = link.now;
+    run.wireBytes = link.wireBytes;
+    run.resumedFrom = resumed ? link.firstBlock : -1;
+    run.status = bulk.status();
+    run.imageOk = device.received == image;
+    return run;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef SIMLINK_H
+#define SIMLINK_H
+// Coordinator Zigbee giả trên Serial1 giả, dùng chung cho benchmark và test trên host: trả lời bắt tay baud,
+// ACK lệnh, và tính thời gian ảo theo byte trên dây ở baud hiện tại cộng thời gian coordinator xử lý mỗi khung.
+#include "zigbeeServer.h"
+#include <functional>
+#include <string>
+
+#define SIM_LINK_TURNAROUND 1000    // us coordinator chuyển khung giữa UART và radio
+
+inline std::string simLinkFrame(const std::string &body)
+{
+    char crc[9];
+    snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(body.c_str(), body.length()));
+    return body + ",CRC:" + crc + "\n";
+}
+
+// Coordinator giả: hỗ trợ tới maxRate, đường truyền chỉ chạy được tới lineLimit, trên noisyAbove thì
+// corruptPercent khung nó gửi bị hỏng. Khung server gửi ở baud khác baud của nó là nhiễu, bị bỏ.
+struct SimCoordinator
+{
+    uint32_t rate = 9600;
+    uint32_t previous = 9600;
+    uint32_t maxRate = 921600;
+    uint32_t lineLimit = 921600;
+    uint32_t noisyAbove = 921600;
+    uint32_t corruptPercent = 0;
+    uint32_t seed = 7;
+    uint32_t deafHandshakes = 0;    // Số khung CMD:BAUD tới bị bỏ qua (firmware đang bận/khởi động lại)
+    bool checking = false;      // Đã OK, chờ CHECK ở baud mới
+    uint32_t garbled = 0;       // Khung server liên tiếp không đọc được
+    uint64_t wireBytes = 0;
+    uint64_t frames = 0;
+    uint64_t virtualUs = 0;
+
+    bool lineOk() const
+    {
+        return rate <= lineLimit;
+    }
+
+    void account(size_t bytes)
+    {
+        wireBytes += bytes;
+        ++frames;
+        virtualUs += (uint64_t)bytes * 10 * 1000000 / rate + SIM_LINK_TURNAROUND;
+    }
+
+    void send(const std::string &body)
+    {
+        std::string wire = simLinkFrame(body);
+        account(wire.size());
+        if (!lineOk())
+        {
+            return;
+        }
+        seed = seed * 1103515245u + 12345u;
+        if (rate > noisyAbove && (seed >> 16) % 100 < corruptPercent)
+        {
+            wire[wire.size() / 2] ^= 0x20;
+        }
+        Serial1.inject(wire);
+    }
+
+    void receive(const uint8_t *data, size_t length)
+    {
+        if (Serial1.baudRate() != rate && checking)
+        {
+            // Không có CHECK ở baud mới trước hạn: coordinator tự về baud cũ
+            rate = previous;
+            checking = false;
+        }
+        account(length);
+        if (Serial1.baudRate() != rate || !lineOk())
+        {
+            // Lâu không nghe được khung hợp lệ nào: về baud ban đầu
+            if (++garbled >= 3)
+            {
+                rate = 9600;
+                garbled = 0;
+            }
+            return;
+        }
+        garbled = 0;
+        std::string frame((const char *)data, length);
+        std::string body = frame.substr(0, frame.rfind(",CRC:"));
+        if (body.compare(0, 9, "CMD:BAUD:") == 0)
+        {
+            if (deafHandshakes > 0)
+            {
+                --deafHandshakes;
+                return;
+            }
+            uint32_t requested = strtoul(body.c_str() + 9, nullptr, 10);
+            if (body.find(":CHECK") != std::string::npos)
+            {
+                checking = false;
+                send(body);
+                return;
+            }
+            bool ok = requested <= maxRate;
+            send(body + (ok ? ":OK" : ":NO"));
+            if (ok)
+            {
+                previous = rate;
+                rate = requested;
+                checking = true;
+            }
+            return;
+        }
+        size_t cmd = body.find(",CMD:");
+        if (body.compare(0, 3, "ID:") == 0 && cmd != std::string::npos)
+        {
+            send(body.substr(0, body.find(',')) + body.substr(cmd));
+        }
+    }
+};
+
+/**
+ * @name SimLink
+ * @brief ZigbeeServer (baud ban đầu 9600, thương lượng tới maxBaud) nối với một SimCoordinator qua Serial1 giả.
+ * Mỗi bước chạy một vòng loop() của server, mọi khung server ghi ra tới coordinator ngay lúc ghi.
+ * Serial1 là một, nên mỗi lúc chỉ một SimLink được chạy bước
+ */
+struct SimLink
+{
+    SimLink(uint32_t maxBaud, const SimCoordinator &peer, const char *deviceId)
+        : server(ZigbeeTransport(&Serial1, 16, 17, 9600, "LinkTask", maxBaud)), coordinator(peer), id(deviceId)
+    {
+        server.provisionDevices({id});
+        run([this]() { server.renegotiateBaud(); });
+    }
+    SimLink(const SimLink &) = delete;
+    SimLink &operator=(const SimLink &) = delete;
+
+    // Chạy step rồi một vòng loop() với UART ở baud server đang dùng
+    void run(std::function<void()> step)
+    {
+        Serial1.begin(server.linkBaud());
+        Serial1.onTransmit = [this](const uint8_t *data, size_t length) { coordinator.receive(data, length); };
+        step();
+        server.loop();
+        Serial1.onTransmit = nullptr;
+        Serial1.takeTx();
+    }
+
+    // Một lệnh + ACK rồi DATA thiết bị gửi lên
+    void exchange()
+    {
+        run([this]() {
+            coordinator.send("ID:" + id + ",DATA:voltage:230.1,current:1.25,power:287.6");
+            server.sendCommand(id.c_str(), "123", "led_status:1");
+        });
+    }
+
+    // Một cửa sổ DATA không cần ACK: mỗi khung hỏng là một lỗi CRC phía server
+    void sendWindow()
+    {
+        run([this]() {
+            for (int i = 0; i < ZIGBEE_LINK_WINDOW; ++i)
+            {
+                coordinator.send("ID:" + id + ",DATA:voltage:230.1,current:1.25,power:287.6");
+            }
+        });
+    }
+
+    // Sau ZIGBEE_BAUD_RETRY (thời gian ảo): timer của server tới hạn trong vòng loop() này
+    void waitBaudRetry()
+    {
+        run([]() { native_advance_time(ZIGBEE_BAUD_RETRY); });
+    }
+
+    // Server và coordinator cùng một baud
+    bool inSync() const
+    {
+        return server.linkBaud() == coordinator.rate;
+    }
+
+    ZigbeeServer server;
+    SimCoordinator coordinator;
+    std::string id;
+};
+
+#endif
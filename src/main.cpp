@@ -1,18 +1,28 @@
 #include <Arduino.h>
 #include "zigbeeServer.h"
+#include "zigbeeFleet.h"
 #include "PEClient.h"
 #include "esp_log.h"
-#include <Preferences.h>
+#include <ConfigStore.h>
 #include <AsyncTCP.h>
 #include <DNSServer.h>
 #include <ESPAsyncWebServer.h>
 #include "page.h"
+#include "LocalApi.h"
+#include "metrics.h"
+#include "LatencyTrace.h"
+#include "Health.h"
+#include "DeferredLog.h"
+#include "Reactor.h"
+#include "Boot.h"
+#include "RuleEngine.h"
 #include <HTTPClient.h>
 #include <sstream>
 #include <vector>
 #include <deque>
 #include <string>
 #include <queue>  
+#include <memory>
 #include <WiFiUdp.h>
 #include <NTPClient.h>
 #include <freertos/FreeRTOS.h>
@@ -20,6 +30,7 @@
 #include <freertos/queue.h>
 
 #define FLASH_NAME_SPACE "piot"
+#define RULES_KEY "rules" // Bộ luật đang chạy (JSON), nạp lại khi khởi động kể cả khi chưa có mạng
 #define SSID_AP "Smart Meter"
 #define PASSWORD_AP "12345678"
 #define MAX_AP_CONNECTIONS 1
@@ -38,57 +49,90 @@
 // #define PASSWORD "06102003"
 #define LED1_PIN 2
 
+// Kích thước vòng đệm capture khung Zigbee, 0 = tắt (có thể bật qua POST /api/capture)
+#ifndef ZIGBEE_CAPTURE_SIZE
+#define ZIGBEE_CAPTURE_SIZE 0
+#endif
+// Coordinator thứ hai trên Serial2, bật bằng build flag -DZIGBEE_SHARD2
+#ifndef ZIGBEE_SHARD2_RX_PIN
+#define ZIGBEE_SHARD2_RX_PIN 26
+#endif
+#ifndef ZIGBEE_SHARD2_TX_PIN
+#define ZIGBEE_SHARD2_TX_PIN 27
+#endif
+#ifndef ZIGBEE_SHARD2_BAUD
+#define ZIGBEE_SHARD2_BAUD 9600
+#endif
+#define METRICS_RETRY_INTERVAL 1000 // ms, thử gửi lại metric còn trong hàng đợi khi MQTT mất kết nối
+#define MQTT_READY_POLL_INTERVAL 100 // ms, bước boot "mqtt" chờ kết nối MQTT
+
 WiFiUDP ntpUDP;
 NTPClient timeClient(ntpUDP, "pool.ntp.org",3600 * 0, 60000); // Update mỗi 60 giây
 WiFiClient wifiClient;
-Preferences preferences;
+NvsConfigBackend configBackend(FLASH_NAME_SPACE);
+ConfigStore configStore(configBackend);
 AsyncWebServer server(80);
 DNSServer dnsServer;
 
 bool isAPMode = false;
-
-ZigbeeServer zigbeeServer;
+bool isServerStarted = false;
+
+ZigbeeServer zigbeeServer; // Serial1, RX 16 / TX 17
+#ifdef ZIGBEE_SHARD2
+ZigbeeServer zigbeeServer2(ZigbeeTransport(&Serial2, ZIGBEE_SHARD2_RX_PIN, ZIGBEE_SHARD2_TX_PIN, ZIGBEE_SHARD2_BAUD, "ZigbeeServerTask2"));
+#endif
+ZigbeeFleet zigbeeFleet;
+RegistryStore registryStore(FLASH_NAME_SPACE, "zb0");
+#ifdef ZIGBEE_SHARD2
+RegistryStore registryStore2(FLASH_NAME_SPACE, "zb1");
+#endif
+LocalApi localApi(server, zigbeeFleet, metricHistory);
+RuleEngine ruleEngine;
+Preferences rulesPreferences;
+
+DLOG_MODULE(mainLog, "Main");
 
 void led1Callback(String value);
 void sendAttributes();
 void onCollectData(const char *id, const char *data);
+void onDeviceStatus(const char *id, bool online);
+void onDevicesChanged();
+void onGroupResult(const GroupResult &result);
 void getDevice(String value);
+void rulesCallback(String value);
+void loadRules();
+void initHealth();
+void initIngest();
+void initZigbee();
+void initConfig();
+void startLocalApi();
+void reportBoot();
+void sendHealth();
+#ifdef LATENCY_TRACE
+void sendLatencyAttributes();
+#endif
 
 void checkSwitchButton(void *pvParameters);
 void handleFormSubmit(AsyncWebServerRequest *request);
-void reloadPreferences();
-String setupResponeHTML();
-
-struct Metric {
-    std::string name;
-    double value;
-    uint64_t ts;
-};
+void handlePortalPage(AsyncWebServerRequest *request);
+void handleStaticAsset(AsyncWebServerRequest *request, const StaticAsset &asset);
 
 struct Attribute {
     std::string name;
     std::string value;
 };
 
-struct FlashData
-{
-  String ssid;
-  String password;
-  String name;
-  String device_id;
-  String access_token;
-  String client_id;
-  String mqtt_username;
-  String mqtt_password;
-  int poll_interval;
-};
-FlashData flashData;
 
 PEClient peClient;
+TaskHandle_t switchTaskHandle = NULL;
+TaskHandle_t metricsTaskHandle = NULL;
+TaskHandle_t loopTaskHandle = NULL; // Task Arduino chạy setup()/loop(), lấy trong setup() vì initHealth chạy ở task nền
+Reactor metricsReactor("SendMetricsTask");
+int metricsRetryTimer = -1;
+int ntpStage = -1;
+int healthStage = -1;
 
-std::queue<Metric> metricQueue; // Khai báo queue để lưu trữ các metric
 std::vector<Attribute> attributes; // Khai báo vector attributes
-SemaphoreHandle_t metricQueueMutex; // Mutex để bảo vệ truy cập vào hàng đợi
 
 class CaptiveRequestHandler : public AsyncWebHandler
 {
@@ -102,34 +146,29 @@ public:
     return true;
   }
 
+  // Các URL dò captive portal của điện thoại/PC (/generate_204, /hotspot-detect.html,
+  // /connecttest.txt, ...) chỉ cần một redirect rỗng về trang cấu hình
   void handleRequest(AsyncWebServerRequest *request)
   {
-    request->send_P(200, "text/html", setupResponeHTML().c_str());
+    request->redirect("http://" + WiFi.softAPIP().toString() + "/");
   }
 };
 
 /**
- * @name sendMetricsTask
- * @brief Gửi dữ liệu đo được lên MQTT
+ * @name sendMetrics
+ * @brief Gửi dữ liệu đo được lên MQTT, chạy trong task SendMetricsTask khi có metric mới
  * 
- * @param {void*} pvParameters - Tham số truyền vào
+ * @param None
  * 
  * @return None
  */
-void sendMetricsTask(void *pvParameters) {
-    while (true) {
-        if (peClient.connected()) {
-            if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
-                while (!metricQueue.empty()) {
-                    Metric metric = metricQueue.front();
-                    ESP_LOGI("Main", "Sending metric %s: %f - %llu", metric.name.c_str(), metric.value, metric.ts);
-                    peClient.sendMetric(metric.ts, metric.name.c_str(), metric.value);
-                    metricQueue.pop();
-                }
-                xSemaphoreGive(metricQueueMutex);
-            }
-        }
-        vTaskDelay(10 / portTICK_PERIOD_MS); // Delay 1 giây giữa các lần gửi
+void sendMetrics() {
+    if (peClient.connected()) {
+        publishMetrics(peClient);
+    }
+    // Mất kết nối hoặc batch gửi lỗi: metric còn trong hàng đợi hoặc trong batch được thử lại sau
+    if (!peClient.connected() || metricQueueDepth() > 0 || peClient.gatewayPending() > 0) {
+        metricsReactor.arm(metricsRetryTimer, METRICS_RETRY_INTERVAL);
     }
 }
 
@@ -144,59 +183,148 @@ void sendMetricsTask(void *pvParameters) {
 void setup()
 {
     Serial.begin(115200);
-    zigbeeServer.begin();
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+    deferredLog.begin(); // Task ưu tiên thấp format log của đường dữ liệu
+
+    // Đường nhận dữ liệu sống trước khi mở UART: khung DATA đầu tiên đã có callback, mutex và task gửi metric
+    int ingest = boot.inlineStage("ingest", initIngest);
+    boot.inlineStage("zigbee", initZigbee, {ingest});
+    int config = boot.inlineStage("config", initConfig);
+    // Các bước cần mạng chạy nền, setup() trả về ngay
+    int network = boot.stage("network", [] { peClient.begin(); }, {config}); // Chặn tới khi có WiFi
+    boot.stage("local_api", startLocalApi, {network});
+    ntpStage = boot.stage("ntp", [] {
+        timeClient.begin(); // Bắt đầu NTP client
+        timeClient.update(); // Cập nhật thời gian ngay lập tức
+    }, {network});
+    healthStage = boot.stage("health", initHealth, {network});
+    int mqtt = boot.stage("mqtt", [] {
+        while (!peClient.connected())
+        {
+            delay(MQTT_READY_POLL_INTERVAL);
+        }
+    }, {network});
+    boot.stage("report", reportBoot, {mqtt});
+    boot.start();
+}
 
+/**
+ * @name initIngest
+ * @brief Hàng đợi metric, task SendMetricsTask và callback của fleet Zigbee
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void initIngest()
+{
+    initMetrics();
+
+    // Tạo task SendMetricsTask chạy trên Core 1, chỉ thức dậy khi collectMetrics có metric mới
+    uint32_t metricsEvent = metricsReactor.on(sendMetrics);
+    metricsRetryTimer = metricsReactor.after(METRICS_RETRY_INTERVAL, sendMetrics);
+    metricsReactor.disarm(metricsRetryTimer);
+    onMetricQueued([metricsEvent]() { metricsReactor.notify(metricsEvent); });
+    metricsReactor.start(10000, 1, 1);
+    metricsTaskHandle = metricsReactor.taskHandle();
+
+    zigbeeFleet.onChange(onDevicesChanged);
+    zigbeeFleet.onMessage(onCollectData);
+    zigbeeFleet.onDeviceStatus(onDeviceStatus);
+    zigbeeFleet.updatePendingList(onDevicesChanged);
+    zigbeeFleet.onGroupResult(onGroupResult);
+
+    // Lệnh của luật đi thẳng vào hàng đợi lệnh Zigbee, không qua cloud
+    ruleEngine.onAction([](const char *id, const char *cmd) { zigbeeFleet.sendCommand(id, cmd); });
+    loadRules();
+}
+
+/**
+ * @name initZigbee
+ * @brief Nạp danh sách thiết bị đã lưu và khởi động các coordinator
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void initZigbee()
+{
+    zigbeeServer.persistRegistry(registryStore);
+    zigbeeFleet.addShard(zigbeeServer);
+#ifdef ZIGBEE_SHARD2
+    zigbeeServer2.persistRegistry(registryStore2);
+    zigbeeFleet.addShard(zigbeeServer2);
+#endif
+    if (ZIGBEE_CAPTURE_SIZE > 0) {
+        for (size_t i = 0; i < zigbeeFleet.shardCount(); ++i) {
+            zigbeeFleet.shard(i).enableCapture(ZIGBEE_CAPTURE_SIZE);
+        }
+    }
+    zigbeeFleet.begin();
+    zigbeeFleet.setDesired("TBE0123456789ZB", "led_status", "1");
+}
+
+/**
+ * @name initConfig
+ * @brief Đọc cấu hình, chuẩn bị PEClient và task nút bấm (không chờ mạng)
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void initConfig()
+{
     xTaskCreatePinnedToCore(
         checkSwitchButton,   /* Function to implement the task */
         "checkSwitchButton", /* Name of the task */
         2048,                /* Stack size in words */
         NULL,                /* Task input parameter */
         0,                   /* Priority of the task */
-        NULL,                /* Task handle. */
+        &switchTaskHandle,   /* Task handle. */
         0
     );
 
-    reloadPreferences();
+    configStore.begin();
+    const Config &config = configStore.get();
     Serial.println("Connecting to WiFi");
-    Serial.println(flashData.ssid);
-    Serial.println(flashData.password);
-
-    peClient.init(flashData.ssid.c_str(), flashData.password.c_str(), MQTT_SERVER, MQTT_PORT, flashData.client_id.c_str(), flashData.mqtt_username.c_str(), flashData.mqtt_password.c_str());
-    peClient.begin();
+    Serial.println(config.ssid);
 
+    peClient.init(config.ssid, config.password, MQTT_SERVER, MQTT_PORT, config.client_id, config.mqtt_username, config.mqtt_password);
     peClient.on("led1", led1Callback);
     peClient.on("devices", getDevice);
-
-    while (!peClient.connected())
-    {
-        ESP_LOGI("Main", "Waiting for MQTT connection...");
-        delay(1000);
-    }
+    peClient.on("rules", rulesCallback);
 
     pinMode(LED1_PIN, OUTPUT);
     digitalWrite(LED1_PIN, LOW);
-    sendAttributes();
-
-    metricQueueMutex = xSemaphoreCreateMutex(); // Tạo mutex
+}
 
-    timeClient.begin(); // Bắt đầu NTP client
-    timeClient.update(); // Cập nhật thời gian ngay lập tức
+/**
+ * @name startLocalApi
+ * @brief API cục bộ chạy ngay khi có WiFi, không phụ thuộc kết nối MQTT
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void startLocalApi()
+{
+    localApi.begin();
+    server.begin();
+    isServerStarted = true;
+}
 
-    // Tạo task sendMetricsTask chạy trên Core 1
-    xTaskCreatePinnedToCore(
-        sendMetricsTask,
-        "SendMetricsTask",
-        10000,
-        NULL,
-        1,
-        NULL,
-        1 // Chạy trên core 1
-    );
-    
-    zigbeeServer.onChange(sendAttributes);
-    zigbeeServer.onMessage(onCollectData);
-    zigbeeServer.updatePendingList(sendAttributes);
-    zigbeeServer.sendCommand("TBE0123456789ZB","led_status:1");
+/**
+ * @name reportBoot
+ * @brief MQTT đã kết nối: gửi attribute và thời điểm sẵn sàng của từng bước khởi động
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void reportBoot()
+{
+    sendAttributes();
+    peClient.sendAttribute("boot", boot.summary().c_str());
 }
 
 /**
@@ -209,8 +337,30 @@ void setup()
  */
 void loop()
 {
-    timeClient.update(); // Cập nhật thời gian mỗi chu kỳ loop
-    ESP_LOGI("Main", "NTP Time: %s", timeClient.getFormattedTime().c_str());
+    if (boot.ready(ntpStage)) {
+        timeClient.update(); // Cập nhật thời gian mỗi chu kỳ loop
+        ESP_LOGI("Main", "NTP Time: %s", timeClient.getFormattedTime().c_str());
+    }
+    // Gõ 'C' trên serial monitor để xuất capture nhị phân của shard 0 (tìm header "ZBCAP"), '1'..'3' cho các shard khác
+    if (Serial.available()) {
+        int key = Serial.read();
+        size_t shard = key == 'C' ? 0 : (size_t)(key - '0');
+        if ((key == 'C' || (key >= '1' && key <= '3')) && shard < zigbeeFleet.shardCount()) {
+            zigbeeFleet.shard(shard).capture().dump(Serial);
+        }
+    }
+#ifdef LATENCY_TRACE
+    static unsigned long lastTraceReport = 0;
+    if (peClient.connected() && millis() - lastTraceReport >= LATENCY_TRACE_REPORT_INTERVAL) {
+        lastTraceReport = millis();
+        sendLatencyAttributes();
+    }
+#endif
+    static unsigned long lastHealthReport = 0;
+    if (boot.ready(healthStage) && peClient.connected() && millis() - lastHealthReport >= HEALTH_REPORT_INTERVAL) {
+        lastHealthReport = millis();
+        sendHealth();
+    }
     delay(1000);
 }
 
@@ -239,31 +389,77 @@ void led1Callback(String value)
 {
     digitalWrite(LED1_PIN, stringToBool(value));
 }
+/**
+ * @name getDevice
+ * @brief Nhận toàn bộ danh sách ID thiết bị từ cloud và cấp phép một lần
+ * 
+ * @param {String} value - Danh sách ID, phân tách bởi dấu phẩy
+ * 
+ * @return None
+ */
 void getDevice(String value)
 {   
     ESP_LOGI("Get Device","Device ID: %s", value.c_str());
-    std::vector<String> deviceIds;
-    int start = 0;
-    int end = value.indexOf(',');
-    
-    while (end != -1) {
-        String id = value.substring(start, end);
-        id.trim();
-        ESP_LOGI("Get Device","ID: %s", id.c_str());
-        if (id.length() > 0) {
-            zigbeeServer.addDevice(id.c_str());
-            ESP_LOGI("Get Device","Pushed back ID: %s", id.c_str());
+    std::vector<std::string> deviceIds;
+    const char *p = value.c_str();
+
+    while (*p) {
+        while (isspace((unsigned char)*p)) ++p;
+        const char *start = p;
+        while (*p && *p != ',') ++p;
+        const char *end = p;
+        while (end > start && isspace((unsigned char)end[-1])) --end;
+        if (end > start) {
+            deviceIds.emplace_back(start, end);
         }
-        start = end + 1;
-        end = value.indexOf(',', start);
+        if (*p == ',') ++p;
     }
-    
-    // Xử lý phần tử cuối cùng
-    String lastId = value.substring(start);
-    lastId.trim();
-    if (lastId.length() > 0) {
-        zigbeeServer.addDevice(lastId.c_str());
-        ESP_LOGI("Get Device","Pushed back ID: %s", lastId.c_str());
+
+    zigbeeFleet.provisionDevices(deviceIds);
+}
+
+/**
+ * @name rulesCallback
+ * @brief Nhận bộ luật mới từ attribute "rules", chạy ngay và lưu flash nếu biên dịch được
+ * 
+ * @param {String} value - JSON bộ luật (xem RuleSpec)
+ * 
+ * @return None
+ */
+void rulesCallback(String value)
+{
+    std::string error;
+    if (!ruleEngine.load(value.c_str(), error)) {
+        peClient.sendAttribute("rules_status", ("error: " + error).c_str());
+        return;
+    }
+    if (rulesPreferences.begin(FLASH_NAME_SPACE, false)) {
+        rulesPreferences.putBytes(RULES_KEY, value.c_str(), value.length());
+        rulesPreferences.end();
+    }
+    peClient.sendAttribute("rules_status", ("ok: " + std::to_string(ruleEngine.size()) + " rules").c_str());
+}
+
+/**
+ * @name loadRules
+ * @brief Nạp bộ luật đã lưu để luật chạy ngay từ khung DATA đầu tiên
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void loadRules()
+{
+    if (!rulesPreferences.begin(FLASH_NAME_SPACE, true)) {
+        return;
+    }
+    size_t length = rulesPreferences.getBytesLength(RULES_KEY);
+    std::string text(length, '\0');
+    bool read = length > 0 && rulesPreferences.getBytes(RULES_KEY, &text[0], length) == length;
+    rulesPreferences.end();
+    std::string error;
+    if (read && !ruleEngine.load(text.c_str(), error)) {
+        DLOGW(mainLog, "Stored rules rejected: %s", error.c_str());
     }
 }
 
@@ -284,14 +480,15 @@ void sendAttributes()
     attributes.push_back(attr);
     attr.name = "pendingDevices";
     String deviceIds = "";
-    for (size_t i = 0; i < zigbeeServer.pendingDeviceList.size(); ++i)
+    zigbeeFleet.forEachDevice([&deviceIds](const Device &device, bool pending, size_t shard)
     {
-        deviceIds += zigbeeServer.pendingDeviceList[i].id.c_str();
-        if (i < zigbeeServer.pendingDeviceList.size() - 1)
+        if (!pending) return;
+        if (deviceIds.length() > 0)
         {
             deviceIds += ","; // Thêm dấu phẩy giữa các ID, trừ ID cuối cùng
         }
-    }
+        deviceIds += device.id;
+    });
     attr.value = deviceIds.c_str();
     attributes.push_back(attr);
     for (Attribute attr : attributes)
@@ -301,6 +498,74 @@ void sendAttributes()
     }
 }
 
+/**
+ * @name initHealth
+ * @brief Đăng ký các task và hàng đợi cần theo dõi cho telemetry sức khoẻ
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void initHealth()
+{
+    health.watchTask("zigbee", zigbeeServer.taskHandle());
+#ifdef ZIGBEE_SHARD2
+    health.watchTask("zigbee2", zigbeeServer2.taskHandle());
+#endif
+    health.watchTask("mqtt", peClient.mqttTaskHandle);
+    health.watchTask("switch", switchTaskHandle);
+    health.watchTask("metrics", metricsTaskHandle);
+    health.watchTask("loop", loopTaskHandle);
+    health.addGauge("metric_q", [] { return (uint32_t)metricQueueDepth(); });
+    health.addGauge("history", [] { return metricHistory.samples(); });
+    health.addGauge("rule_eval", [] { return ruleEngine.evaluations(); });
+    health.addGauge("rule_act", [] { return ruleEngine.actions(); });
+    health.addGauge("cmd_q", [] { return (uint32_t)zigbeeFleet.queueDepth(); });
+    health.addGauge("sse_drop", [] { return localApi.droppedSamples(); });
+    health.addGauge("cap_drop", [] { return zigbeeFleet.captureDropped(); });
+    health.addGauge("shadow_skip", [] { return zigbeeFleet.shadowSuppressed(); });
+    health.addGauge("wake_zb", [] { return zigbeeFleet.wakeups(); });
+    health.addGauge("wake_mqtt", [] { return peClient.reactor().wakeups(); });
+    health.addGauge("wake_metrics", [] { return metricsReactor.wakeups(); });
+}
+
+/**
+ * @name sendHealth
+ * @brief Gửi toàn bộ chỉ số sức khoẻ trong một bản tin metrics
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void sendHealth()
+{
+    JsonDocument doc;
+    health.collect(doc["metrics"].to<JsonObject>());
+    if (!peClient.sendMetrics(doc)) {
+        ESP_LOGW("Main", "Health telemetry not sent");
+    }
+}
+
+#ifdef LATENCY_TRACE
+/**
+ * @name sendLatencyAttributes
+ * @brief Gửi tóm tắt histogram độ trễ của từng chặng làm attribute "latency_<chặng>"
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void sendLatencyAttributes()
+{
+    for (uint8_t i = 0; i < TRACE_STAGE_COUNT; ++i)
+    {
+        TraceStage stage = (TraceStage)i;
+        String key = String("latency_") + LatencyTrace::stageName(stage);
+        peClient.sendAttribute(key.c_str(), latencyTrace.summary(stage).c_str());
+    }
+}
+#endif
+
 /**
  * @name onCollectData
  * @brief Hàm thu thập dữ liệu từ thiết bị
@@ -312,60 +577,59 @@ void sendAttributes()
  */
 void onCollectData(const char *id, const char *data)
 {
-    ESP_LOGI("Main", "Collect data from device %s: %s", id, data);
-    std::istringstream dataStream(data);
-    std::string item;
-    bool hasComma = strchr(data, ',') != nullptr; // Kiểm tra xem chuỗi có chứa dấu phẩy không
-
-    if (hasComma) {
-        while (std::getline(dataStream, item, ',')) {
-            std::istringstream itemStream(item);
-            std::string key;
-            std::string valueStr;
-            if (std::getline(itemStream, key, ':') && std::getline(itemStream, valueStr)) {
-                std::string metricName = key + "_" + id;
-                double value = std::stod(valueStr);
-                uint64_t timestamp = timeClient.getEpochTime(); // Lấy thời gian từ NTP client
-                timestamp *= 1000; // Chuyển đổi sang milliseconds
-                ESP_LOGI("Main", "Collected metric %s: %f - %llu", metricName.c_str(), value, timestamp);
-                Metric metric = {metricName, value, timestamp};
-
-                // Thêm metric vào hàng đợi
-                if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
-                    metricQueue.push(metric);
-                    xSemaphoreGive(metricQueueMutex);
-                }
-            }
-        }
+    DLOGI(mainLog, "Collect data from device %s: %s", id, data);
+    ruleEngine.ingest(id, data);
+    localApi.publishSample(id, data);
+
+    uint64_t timestamp = timeClient.getEpochTime(); // Lấy thời gian từ NTP client
+    timestamp *= 1000; // Chuyển đổi sang milliseconds
+    collectMetrics(id, data, timestamp, zigbeeFleet.rxStamp());
+}
+
+/**
+ * @name onDeviceStatus
+ * @brief Báo thiết bị con kết nối/mất kết nối lên gateway API
+ * 
+ * @param {const char*} id - ID của thiết bị
+ * @param {bool} online - Trạng thái kết nối
+ * 
+ * @return None
+ */
+void onDeviceStatus(const char *id, bool online)
+{
+    if (online) {
+        peClient.connectDevice(id);
     } else {
-        std::istringstream itemStream(data);
-        std::string key;
-        std::string valueStr;
-        if (std::getline(itemStream, key, ':') && std::getline(itemStream, valueStr)) {
-            std::string metricName = key + "_" + id;
-            double value = std::stod(valueStr);
-            uint64_t timestamp = timeClient.getEpochTime(); // Lấy thời gian từ NTP client
-            timestamp *= 1000; // Chuyển đổi sang milliseconds
-            ESP_LOGI("Main", "Collected metric %s: %f - %lld", metricName.c_str(), value, timestamp);
-            Metric metric = {metricName, value, timestamp};
-
-            // Thêm metric vào hàng đợi
-            if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
-                metricQueue.push(metric);
-                xSemaphoreGive(metricQueueMutex);
-            }
-        }
+        peClient.disconnectDevice(id);
     }
+    localApi.publishDeviceStatus(id, online);
+}
 
-    if (metricQueue.size() > 100) {
-      ESP_LOGI("Main", "Clearing metric queue");
-        if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
-            while (metricQueue.size() > 100) {
-                metricQueue.pop();
-            }
-            xSemaphoreGive(metricQueueMutex);
-        }
-    }
+/**
+ * @name onDevicesChanged
+ * @brief Danh sách thiết bị thay đổi: cập nhật attribute và báo cho client cục bộ
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void onDevicesChanged()
+{
+    sendAttributes();
+    localApi.publishDevicesChanged();
+}
+
+/**
+ * @name onGroupResult
+ * @brief Lệnh nhóm đã xong (tất cả thành viên ACK hoặc hết hạn): báo kết quả cho client cục bộ
+ * 
+ * @param {const GroupResult&} result - Thành viên đã/chưa xác nhận
+ * 
+ * @return None
+ */
+void onGroupResult(const GroupResult &result)
+{
+    localApi.publishGroupResult(result);
 }
 
 void checkSwitchButton(void *pvparameter) {
@@ -405,12 +669,19 @@ void checkSwitchButton(void *pvparameter) {
           WiFi.mode(WIFI_AP);
           WiFi.softAP(SSID_AP, PASSWORD_AP, 1, false, MAX_AP_CONNECTIONS);
 
-          server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-                    { request->send_P(200, "text/html", setupResponeHTML().c_str()); });
+          server.on("/", HTTP_GET, handlePortalPage);
+          for (size_t i = 0; i < STATIC_ASSET_COUNT; ++i) {
+            const StaticAsset &asset = static_assets[i];
+            server.on(asset.url, HTTP_GET, [&asset](AsyncWebServerRequest *request)
+                      { handleStaticAsset(request, asset); });
+          }
           server.on("/submit", HTTP_POST, handleFormSubmit);
           dnsServer.start(53, "*", WiFi.softAPIP());
           server.addHandler(new CaptiveRequestHandler()).setFilter(ON_AP_FILTER);
-          server.begin();
+          if (!isServerStarted) {
+            server.begin();
+            isServerStarted = true;
+          }
           isAPMode = true;
           // xTaskCreatePinnedToCore(
           //     readandprint,   /* Function to implement the task */
@@ -431,106 +702,115 @@ void checkSwitchButton(void *pvparameter) {
   }
 }
 
-String setupResponeHTML() {
-  reloadPreferences();
-  Serial.println("request index");
-  // Serial.println(flashData.ssid);
-  String responseHTML = String(index_html);
-  // Serial.println(responseHTML);
-  ESP_LOGI("Setup", "client_id: %s", flashData.client_id.c_str());
-  responseHTML.replace("$ssid", flashData.ssid);
-  responseHTML.replace("$password", flashData.password);
-  responseHTML.replace("$device_id", flashData.device_id);
-  responseHTML.replace("$name", flashData.name);
-  responseHTML.replace("$mqtt_username", flashData.mqtt_username);
-  responseHTML.replace("$mqtt_password", flashData.mqtt_password);
-  responseHTML.replace("$access_token", flashData.access_token);
-  responseHTML.replace("$client_id", flashData.client_id);
-  // for (int i = 0; i < flashData.leight(); i++)
-  // {
-  //   responseHTML.replace("$" + flashData[i], flashData[flashData[i]]);
-  // }
-
-  // Serial.println("==================================================================");
-  // Serial.println(responseHTML);
-  return responseHTML;
+/**
+ * @name portalValue
+ * @brief Giá trị cho các placeholder của trang cấu hình
+ * 
+ * @param {int8_t} var - Placeholder (PageVar)
+ * 
+ * @return {String} - Giá trị hiện tại trong ConfigStore
+ */
+String portalValue(int8_t var)
+{
+  const Config &config = configStore.get();
+  switch (var) {
+    case PAGE_VAR_SSID: return config.ssid;
+    case PAGE_VAR_PASSWORD: return config.password;
+    case PAGE_VAR_DEVICE_ID: return config.device_id;
+    case PAGE_VAR_CLIENT_ID: return config.client_id;
+    case PAGE_VAR_MQTT_USERNAME: return config.mqtt_username;
+    case PAGE_VAR_MQTT_PASSWORD: return config.mqtt_password;
+    case PAGE_VAR_ACCESS_TOKEN: return config.access_token;
+    case PAGE_VAR_POLL_INTERVAL: return String((unsigned long)config.poll_interval);
+    default: return String();
+  }
 }
 
-void handleFormSubmit(AsyncWebServerRequest *request)
+/**
+ * @name handlePortalPage
+ * @brief Stream trang cấu hình bằng chunked response từ các đoạn tĩnh trong flash
+ * 
+ * @param {AsyncWebServerRequest*} request - Request
+ * 
+ * @return None
+ */
+void handlePortalPage(AsyncWebServerRequest *request)
 {
-  if (request->hasParam("ssid", true))
-  {
-    AsyncWebParameter *ssid = request->getParam("ssid", true);
-    flashData.ssid = ssid->value();
-  }
-  if (request->hasParam("password", true))
-  {
-    AsyncWebParameter *password = request->getParam("password", true);
-    flashData.password = password->value();
-  }
-  if (request->hasParam("device_id", true))
-  {
-    AsyncWebParameter *device_id = request->getParam("device_id", true);
-    flashData.device_id = device_id->value();
-  }
-  if (request->hasParam("name", true))
-  {
-    AsyncWebParameter *name = request->getParam("name", true);
-    flashData.name = name->value();
-  }
-  if (request->hasParam("mqtt_username", true))
-  {
-    AsyncWebParameter *mqtt_username = request->getParam("mqtt_username", true);
-    flashData.mqtt_username = mqtt_username->value();
-  }
+  std::shared_ptr<PageRenderer> renderer = std::make_shared<PageRenderer>(index_chunks, INDEX_CHUNK_COUNT, portalValue);
+  AsyncWebServerResponse *response = request->beginChunkedResponse("text/html",
+      [renderer](uint8_t *buffer, size_t maxLen, size_t index) { return renderer->fill(buffer, maxLen); });
+  response->addHeader("Cache-Control", "no-store");
+  request->send(response);
+}
 
-  if (request->hasParam("mqtt_password", true))
-  {
-    AsyncWebParameter *mqtt_password = request->getParam("mqtt_password", true);
-    flashData.mqtt_password = mqtt_password->value();
+/**
+ * @name handleStaticAsset
+ * @brief Trả file tĩnh đã nén gzip sẵn, hỗ trợ ETag/304
+ * 
+ * @param {AsyncWebServerRequest*} request - Request
+ * @param {const StaticAsset&} asset - File tĩnh
+ * 
+ * @return None
+ */
+void handleStaticAsset(AsyncWebServerRequest *request, const StaticAsset &asset)
+{
+  if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value() == asset.etag) {
+    request->send(304);
+    return;
   }
+  AsyncWebServerResponse *response = request->beginResponse_P(200, asset.contentType, asset.gzip, asset.length);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", asset.etag);
+  response->addHeader("Cache-Control", "max-age=86400");
+  request->send(response);
+}
 
-  if (request->hasParam("access_token", true))
+/**
+ * @name copyParam
+ * @brief Chép tham số form (nếu có) vào trường cấu hình
+ * 
+ * @param {AsyncWebServerRequest*} request - Request
+ * @param {const char*} name - Tên tham số
+ * @param {char*} field - Trường cấu hình
+ * @param {size_t} size - Kích thước trường
+ * 
+ * @return None
+ */
+void copyParam(AsyncWebServerRequest *request, const char *name, char *field, size_t size)
+{
+  if (request->hasParam(name, true))
   {
-    AsyncWebParameter *access_token = request->getParam("access_token", true);
-    flashData.access_token = access_token->value();
+    ConfigStore::setField(field, size, request->getParam(name, true)->value().c_str());
   }
+}
 
-  if (request->hasParam("client_id", true))
+void handleFormSubmit(AsyncWebServerRequest *request)
+{
+  Config config = configStore.get();
+  copyParam(request, "ssid", config.ssid, sizeof(config.ssid));
+  copyParam(request, "password", config.password, sizeof(config.password));
+  copyParam(request, "device_id", config.device_id, sizeof(config.device_id));
+  copyParam(request, "name", config.name, sizeof(config.name));
+  copyParam(request, "mqtt_username", config.mqtt_username, sizeof(config.mqtt_username));
+  copyParam(request, "mqtt_password", config.mqtt_password, sizeof(config.mqtt_password));
+  copyParam(request, "access_token", config.access_token, sizeof(config.access_token));
+  copyParam(request, "client_id", config.client_id, sizeof(config.client_id));
+  if (request->hasParam("poll_interval", true))
   {
-    AsyncWebParameter *client_id = request->getParam("client_id", true);
-    flashData.client_id = client_id->value();
+    long interval = request->getParam("poll_interval", true)->value().toInt();
+    if (interval > 0) config.poll_interval = interval;
   }
 
-  ESP_LOGI("Setup", "client_id: %s", flashData.client_id.c_str());
-
-  preferences.putString("ssid", flashData.ssid);
-  preferences.putString("password", flashData.password);
-  preferences.putString("device_id", flashData.device_id);
-  preferences.putString("name", flashData.name);
-  // preferences.putString("access_token", flashData.access_token);
-  preferences.putString("client_id", flashData.client_id);
-  preferences.putString("mqtt_username", flashData.mqtt_username);
-  preferences.putString("mqtt_password", flashData.mqtt_password);
+  ESP_LOGI("Setup", "client_id: %s", config.client_id);
 
-  preferences.end();
+  // Một lần ghi duy nhất, bản cấu hình cũ vẫn còn nguyên nếu mất điện giữa chừng
+  if (!configStore.commit(config))
+  {
+    request->send(500, "text/plain", "Save failed");
+    return;
+  }
   String message = "<!DOCTYPE html><html><head><meta charset=\"UTF-8\"><title>Smart Meter</title></head><body><h1>Smart Meter</h1><p>Setup successfully!</p></body></html>";
   request->send(200, "text/html", message);
   delay(1000);
   ESP.restart();
 }
-void reloadPreferences()
-{
-  preferences.begin(FLASH_NAME_SPACE, false);
-  Serial.println("reloadPreferences");
-  flashData.ssid = preferences.getString("ssid", "");
-  flashData.password = preferences.getString("password", "");
-  flashData.device_id = preferences.getString("device_id", "");
-  flashData.name = preferences.getString("name", "");
-  flashData.access_token = preferences.getString("access_token", "");
-  flashData.client_id = preferences.getString("client_id", "");
-  flashData.mqtt_username = preferences.getString("mqtt_username", "");
-  flashData.mqtt_password = preferences.getString("mqtt_password", "");
-
-  Serial.println(flashData.ssid);
-}
\ No newline at end of file
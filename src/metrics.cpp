@@ -0,0 +1,146 @@
+#include "metrics.h"
+#include "DeferredLog.h"
+#include "deviceTable.h"
+#include <sstream>
+
+// ID dài nhất bảng thiết bị nhận được phải có chỗ trong metricHistory, nếu không lịch sử bị bỏ âm thầm
+static_assert(TIMESERIES_NAME_SIZE >= DEVICE_ID_SIZE, "TIMESERIES_NAME_SIZE must hold any device ID");
+
+DLOG_MODULE(metricsLog, "metrics");
+
+std::queue<Metric> metricQueue; // Khai báo queue để lưu trữ các metric
+SemaphoreHandle_t metricQueueMutex; // Mutex để bảo vệ truy cập vào hàng đợi
+TimeSeries metricHistory; // Metric gần đây giữ lại trên gateway sau khi đã publish
+static std::function<void()> metricQueuedCallback;
+
+/**
+ * @name initMetrics
+ * @brief Tạo mutex cho hàng đợi metric
+ * 
+ * @param None
+ * 
+ * @return None
+ */
+void initMetrics()
+{
+    metricQueueMutex = xSemaphoreCreateMutex(); // Tạo mutex
+}
+
+/**
+ * @name collectMetrics
+ * @brief Tách dữ liệu key:value,... của thiết bị thành các metric, đưa vào hàng đợi và metricHistory
+ * 
+ * @param {const char*} id - ID của thiết bị
+ * @param {const char*} data - Dữ liệu từ thiết bị
+ * @param {uint64_t} timestamp - Thời gian (ms)
+ * @param {uint32_t} rxStamp - micros() khi khung tới UART, chỉ dùng khi bật LATENCY_TRACE
+ * 
+ * @return None
+ */
+void collectMetrics(const char *id, const char *data, uint64_t timestamp, uint32_t rxStamp)
+{
+    std::istringstream dataStream(data);
+    std::string item;
+
+    while (std::getline(dataStream, item, ',')) {
+        std::istringstream itemStream(item);
+        std::string key;
+        std::string valueStr;
+        if (std::getline(itemStream, key, ':') && std::getline(itemStream, valueStr)) {
+            double value = std::stod(valueStr);
+            DLOGD(metricsLog, "Collected metric %s: %f - %llu", key, value, timestamp);
+            metricHistory.append(id, key.c_str(), timestamp, value);
+            Metric metric = {id, key, value, timestamp};
+#ifdef LATENCY_TRACE
+            metric.rxStamp = rxStamp;
+#endif
+
+            // Thêm metric vào hàng đợi
+            if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
+                metricQueue.push(metric);
+                xSemaphoreGive(metricQueueMutex);
+            }
+        }
+    }
+
+    TRACE_SINCE(TRACE_SAMPLE_QUEUE, rxStamp);
+
+    // Kiểm tra và cắt hàng đợi trong cùng một lần giữ mutex, các shard task vẫn đang push vào
+    size_t dropped = 0;
+    if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
+        while (metricQueue.size() > METRIC_QUEUE_LIMIT) {
+            metricQueue.pop();
+            health.count(HEALTH_METRICS_DROPPED);
+            ++dropped;
+        }
+        xSemaphoreGive(metricQueueMutex);
+    }
+    if (dropped > 0) {
+        DLOGW(metricsLog, "Clearing metric queue");
+    }
+    if (metricQueuedCallback) {
+        metricQueuedCallback();
+    }
+}
+
+/**
+ * @name onMetricQueued
+ * @brief Đăng ký callback được gọi sau mỗi lần collectMetrics đưa metric vào hàng đợi
+ * 
+ * @param {std::function<void()>} callback - Hàm đánh thức task gửi metric
+ * 
+ * @return None
+ */
+void onMetricQueued(std::function<void()> callback)
+{
+    metricQueuedCallback = callback;
+}
+
+/**
+ * @name publishMetrics
+ * @brief Gửi metric đang chờ theo batch gateway, dừng lại (giữ metric trong hàng đợi) khi batch không gửi được
+ * 
+ * @param {PEClient&} client - MQTT client
+ * 
+ * @return {size_t} - Số metric đã lấy ra khỏi hàng đợi
+ */
+size_t publishMetrics(PEClient &client)
+{
+    size_t count = 0;
+#ifdef LATENCY_TRACE
+    std::vector<uint32_t> rxStamps;
+#endif
+    if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
+        while (!metricQueue.empty()) {
+            Metric metric = metricQueue.front();
+            DLOGD(metricsLog, "Sending metric %s/%s: %f - %llu", metric.device, metric.name, metric.value, metric.ts);
+            // Batch không gửi được: để metric lại trong hàng đợi, lần sau thử lại
+            if (!client.gatewayMetric(metric.device.c_str(), metric.ts, metric.name.c_str(), metric.value)) {
+                break;
+            }
+#ifdef LATENCY_TRACE
+            rxStamps.push_back(metric.rxStamp);
+#endif
+            metricQueue.pop();
+            ++count;
+        }
+        xSemaphoreGive(metricQueueMutex);
+    }
+    client.flushGateway(); // Gửi phần còn lại của batch cho tất cả thiết bị
+#ifdef LATENCY_TRACE
+    for (uint32_t rxStamp : rxStamps) {
+        TRACE_SINCE(TRACE_SAMPLE_PUBLISH, rxStamp);
+    }
+#endif
+    return count;
+}
+
+size_t metricQueueDepth()
+{
+    size_t depth = 0;
+    if (xSemaphoreTake(metricQueueMutex, portMAX_DELAY) == pdTRUE) {
+        depth = metricQueue.size();
+        xSemaphoreGive(metricQueueMutex);
+    }
+    return depth;
+}
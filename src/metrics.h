@@ -0,0 +1,35 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <functional>
+#include <queue>
+#include <string>
+#include "PEClient.h"
+#include "LatencyTrace.h"
+#include "Health.h"
+#include "TimeSeries.h"
+
+#define METRIC_QUEUE_LIMIT 100
+
+struct Metric {
+    std::string device;
+    std::string name;
+    double value;
+    uint64_t ts;
+#ifdef LATENCY_TRACE
+    uint32_t rxStamp;   // micros() khi khung DATA tới UART
+#endif
+};
+
+extern std::queue<Metric> metricQueue;
+extern SemaphoreHandle_t metricQueueMutex;
+extern TimeSeries metricHistory;
+
+void initMetrics();
+void collectMetrics(const char *id, const char *data, uint64_t timestamp, uint32_t rxStamp = 0);
+void onMetricQueued(std::function<void()> callback);
+size_t publishMetrics(PEClient &client);
+size_t metricQueueDepth();
+
+#endif
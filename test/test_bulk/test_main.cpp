@@ -0,0 +1,151 @@
+// Test kênh bulk trên host với thiết bị và đường truyền giả lập (native/sim/simBulk.h): ảnh tới thiết bị
+// đủ và đúng từng byte khi mất khung, resume tiếp tục từ block thiết bị cần chứ không gửi lại từ đầu,
+// và cùng đường đó qua ZigbeeServer với Serial1 giả.
+//   pio test -e native_test -f test_bulk
+#include <unity.h>
+#include "simBulk.h"
+#include "zigbeeServer.h"
+
+namespace {
+
+const uint32_t imageSize = 16 * 1024;
+std::vector<uint8_t> image;
+
+void assertDelivered(const SimBulkRun &run)
+{
+    TEST_ASSERT_EQUAL_STRING(BulkStatus::stateName(BULK_DONE), BulkStatus::stateName(run.status.state));
+    TEST_ASSERT_EQUAL_UINT32(run.status.blocks, run.status.acked);
+    TEST_ASSERT_TRUE(run.imageOk);
+}
+
+}
+
+void setUp()
+{
+    if (image.empty())
+    {
+        image = simBulkImage(imageSize);
+    }
+}
+
+void tearDown()
+{
+}
+
+void test_lossless_delivers_image()
+{
+    SimBulkRun run = simRunBulk(image, 0);
+    assertDelivered(run);
+    TEST_ASSERT_EQUAL_UINT32(0, run.status.retransmits);
+    TEST_ASSERT_EQUAL_UINT32(run.status.blocks, run.status.sent);
+}
+
+void test_loss10_retransmits_and_delivers_image()
+{
+    // Mất 10% khung mỗi chiều, với vài seed khác nhau qua cửa sổ 1 và cửa sổ mặc định
+    for (uint8_t window : {(uint8_t)1, (uint8_t)ZIGBEE_BULK_WINDOW})
+    {
+        SimBulkRun run = simRunBulk(image, 10, window);
+        assertDelivered(run);
+        TEST_ASSERT_GREATER_THAN(0, run.status.retransmits);
+    }
+}
+
+void test_resume_continues_from_paused_block()
+{
+    // Thiết bị mất kết nối sau khi ACK block 100, lâu hơn số lần retry: lần truyền tạm dừng rồi resume
+    SimBulkRun run = simRunBulk(image, 5, ZIGBEE_BULK_WINDOW, 100, 10000);
+    assertDelivered(run);
+    TEST_ASSERT_GREATER_OR_EQUAL(100, run.pausedAt);
+    // Sau OPEN, block đầu tiên gửi lại là block thiết bị cần, không phải block 0
+    TEST_ASSERT_EQUAL_INT32(run.pausedAt, run.resumedFrom);
+}
+
+namespace {
+
+ZigbeeServer *server = nullptr;
+SimBulkDevice serverDevice;
+BulkStatus serverResult;
+uint32_t dropEvery = 0;     // Bỏ mỗi khung thứ n server gửi tới thiết bị, 0 = không bỏ
+uint32_t transmitted = 0;
+
+size_t readImage(uint32_t offset, uint8_t *buffer, size_t length)
+{
+    memcpy(buffer, image.data() + offset, length);
+    return length;
+}
+
+// Gửi ảnh qua ZigbeeServer, thiết bị giả trả lời ngay trên Serial1 giả. Vòng loop() không gửi gì thì
+// đồng hồ ảo nhảy tới hạn chót ACK để block mất được gửi lại
+void runServer()
+{
+    if (!server)
+    {
+        server = new ZigbeeServer();
+        server->provisionDevices({serverDevice.id});
+        server->onBulkResult([](const BulkStatus &status) { serverResult = status; });
+        server->loop();
+    }
+    serverResult = BulkStatus();
+    serverDevice = SimBulkDevice();
+    transmitted = 0;
+    Serial1.onTransmit = [](const uint8_t *data, size_t length) {
+        ++transmitted;
+        if (dropEvery && transmitted % dropEvery == 0)
+        {
+            return;
+        }
+        std::string frame((const char *)data, length - 1);
+        std::string reply = serverDevice.handle(frame.substr(0, frame.rfind(",CRC:")));
+        if (!reply.empty())
+        {
+            char crc[9];
+            snprintf(crc, sizeof(crc), "%08X", ZigbeeServer::calculateCRC32(reply.c_str(), reply.length()));
+            Serial1.inject(reply + ",CRC:" + crc + "\n");
+        }
+    };
+    TEST_ASSERT_TRUE(server->sendBulk(serverDevice.id.c_str(), SIM_BULK_TRANSFER, image.size(), readImage));
+    for (int idle = 0; serverResult.state == BULK_IDLE && idle < 1000;)
+    {
+        uint32_t before = transmitted;
+        server->loop();
+        if (transmitted == before)
+        {
+            ++idle;
+            native_advance_time(ZIGBEE_BULK_TIMEOUT);
+        }
+    }
+    Serial1.onTransmit = nullptr;
+    Serial1.takeTx();
+}
+
+}
+
+void test_server_delivers_image()
+{
+    dropEvery = 0;
+    runServer();
+    TEST_ASSERT_EQUAL_STRING(BulkStatus::stateName(BULK_DONE), BulkStatus::stateName(serverResult.state));
+    TEST_ASSERT_TRUE(serverDevice.received == image);
+    TEST_ASSERT_EQUAL_UINT32(0, serverResult.retransmits);
+}
+
+void test_server_retransmits_lost_blocks()
+{
+    dropEvery = 7;
+    runServer();
+    TEST_ASSERT_EQUAL_STRING(BulkStatus::stateName(BULK_DONE), BulkStatus::stateName(serverResult.state));
+    TEST_ASSERT_TRUE(serverDevice.received == image);
+    TEST_ASSERT_GREATER_THAN(0, serverResult.retransmits);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lossless_delivers_image);
+    RUN_TEST(test_loss10_retransmits_and_delivers_image);
+    RUN_TEST(test_resume_continues_from_paused_block);
+    RUN_TEST(test_server_delivers_image);
+    RUN_TEST(test_server_retransmits_lost_blocks);
+    return UNITY_END();
+}
@@ -0,0 +1,282 @@
+// Test ConfigStore trên host: hai slot A/B lưu trong file thay cho NVS, giả lập mất điện giữa lần ghi
+// (slot bị cắt ngắn hoặc chỉ ghi được một phần đè lên nội dung cũ) và byte hỏng trong slot.
+//   pio test -e native_test -f test_config_store
+#include <unity.h>
+#include <ConfigStore.h>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+/**
+ * @name FileConfigBackend
+ * @brief Mỗi slot là một file. tearAt >= 0 thì lần ghi kế tiếp chỉ ghi được tearAt byte đầu rồi "mất điện":
+ * truncate = true để file bị cắt ngắn, false để phần sau giữ nội dung cũ (0xFF nếu slot còn trống).
+ */
+class FileConfigBackend : public ConfigBackend
+{
+  public:
+    FileConfigBackend(const std::string &prefix) : _prefix(prefix) {}
+
+    size_t read(uint8_t slot, void *buffer, size_t length) override
+    {
+        std::vector<uint8_t> data = load(slot);
+        if (data.size() != length)
+        {
+            return 0;
+        }
+        memcpy(buffer, data.data(), length);
+        return length;
+    }
+
+    bool write(uint8_t slot, const void *buffer, size_t length) override
+    {
+        const uint8_t *bytes = (const uint8_t *)buffer;
+        std::vector<uint8_t> data(bytes, bytes + length);
+        bool torn = tearAt >= 0 && (size_t)tearAt < length;
+        if (torn)
+        {
+            std::vector<uint8_t> old = load(slot);
+            old.resize(length, 0xFF);
+            data.resize(tearAt);
+            if (!truncate)
+            {
+                data.insert(data.end(), old.begin() + tearAt, old.end());
+            }
+            tearAt = -1;
+        }
+        store(slot, data);
+        return !torn;
+    }
+
+    // Đảo một bit trong slot như một byte flash bị hỏng
+    void corrupt(uint8_t slot, size_t offset)
+    {
+        std::vector<uint8_t> data = load(slot);
+        data[offset] ^= 0x10;
+        store(slot, data);
+    }
+
+    void erase()
+    {
+        for (uint8_t slot = 0; slot < 2; ++slot)
+        {
+            std::remove(path(slot).c_str());
+        }
+    }
+
+    long tearAt = -1;
+    bool truncate = true;
+
+  private:
+    std::string path(uint8_t slot) const
+    {
+        return _prefix + (slot ? "_b.bin" : "_a.bin");
+    }
+
+    std::vector<uint8_t> load(uint8_t slot) const
+    {
+        std::vector<uint8_t> data;
+        FILE *file = fopen(path(slot).c_str(), "rb");
+        if (!file)
+        {
+            return data;
+        }
+        uint8_t chunk[256];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            data.insert(data.end(), chunk, chunk + n);
+        }
+        fclose(file);
+        return data;
+    }
+
+    void store(uint8_t slot, const std::vector<uint8_t> &data) const
+    {
+        FILE *file = fopen(path(slot).c_str(), "wb");
+        TEST_ASSERT_NOT_NULL(file);
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+
+    std::string _prefix;
+};
+
+const size_t slotSize = sizeof(ConfigHeader) + sizeof(Config);
+std::string prefix;
+
+Config makeConfig(const char *ssid, uint32_t pollInterval)
+{
+    Config config = {};
+    ConfigStore::setField(config.ssid, sizeof(config.ssid), ssid);
+    ConfigStore::setField(config.device_id, sizeof(config.device_id), "gateway-01");
+    config.poll_interval = pollInterval;
+    return config;
+}
+
+// Khởi động lại: ConfigStore mới trên cùng các file
+bool reboot(Config &config, uint32_t &sequence)
+{
+    FileConfigBackend backend(prefix);
+    ConfigStore store(backend);
+    bool loaded = store.begin();
+    config = store.get();
+    sequence = store.sequence();
+    return loaded;
+}
+
+// Ghi hai bản (slot A rồi B), bản thứ ba sẽ ghi đè slot A
+void commitTwo()
+{
+    FileConfigBackend backend(prefix);
+    backend.erase();
+    ConfigStore store(backend);
+    store.begin();
+    TEST_ASSERT_TRUE(store.commit(makeConfig("first", 10)));
+    TEST_ASSERT_TRUE(store.commit(makeConfig("second", 20)));
+}
+
+// Mất điện khi ghi bản thứ ba (slot A) sau cutAt byte
+void tearThird(long cutAt, bool truncate)
+{
+    commitTwo();
+    FileConfigBackend backend(prefix);
+    ConfigStore store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    backend.tearAt = cutAt;
+    backend.truncate = truncate;
+    TEST_ASSERT_FALSE(store.commit(makeConfig("third", 30)));
+}
+
+// Các điểm cắt: đầu slot, trong header, ngay sau header, giữa payload, ngay trước poll_interval (trường cuối)
+std::vector<long> cutPoints()
+{
+    return {0, 1, (long)sizeof(ConfigHeader) / 2, (long)sizeof(ConfigHeader), (long)slotSize / 2,
+            (long)(sizeof(ConfigHeader) + offsetof(Config, poll_interval))};
+}
+
+}
+
+void setUp()
+{
+    const char *tmp = getenv("TMPDIR");
+    prefix = std::string(tmp ? tmp : "/tmp") + "/configstore_" + std::to_string(getpid());
+    FileConfigBackend(prefix).erase();
+}
+
+void tearDown()
+{
+    FileConfigBackend(prefix).erase();
+}
+
+void test_empty_flash_uses_defaults()
+{
+    Config config;
+    uint32_t sequence;
+    TEST_ASSERT_FALSE(reboot(config, sequence));
+    TEST_ASSERT_EQUAL_STRING("", config.ssid);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_DEFAULT_POLL_INTERVAL, config.poll_interval);
+}
+
+void test_loads_newest_slot()
+{
+    commitTwo();
+    Config config;
+    uint32_t sequence;
+    TEST_ASSERT_TRUE(reboot(config, sequence));
+    TEST_ASSERT_EQUAL_STRING("second", config.ssid);
+    TEST_ASSERT_EQUAL_UINT32(20, config.poll_interval);
+    TEST_ASSERT_EQUAL_UINT32(2, sequence);
+}
+
+void test_truncated_write_keeps_previous_slot()
+{
+    std::vector<long> points = cutPoints();
+    points.push_back(slotSize - 1);
+    for (long cutAt : points)
+    {
+        tearThird(cutAt, true);
+        Config config;
+        uint32_t sequence;
+        TEST_ASSERT_TRUE(reboot(config, sequence));
+        TEST_ASSERT_EQUAL_STRING("second", config.ssid);
+        TEST_ASSERT_EQUAL_UINT32(2, sequence);
+    }
+}
+
+void test_partial_overwrite_keeps_previous_slot()
+{
+    // Slot A vẫn đủ độ dài nhưng nửa sau còn là bản "first": chỉ CRC phát hiện được
+    for (long cutAt : cutPoints())
+    {
+        tearThird(cutAt, false);
+        Config config;
+        uint32_t sequence;
+        TEST_ASSERT_TRUE(reboot(config, sequence));
+        TEST_ASSERT_EQUAL_STRING("second", config.ssid);
+        TEST_ASSERT_EQUAL_UINT32(2, sequence);
+    }
+}
+
+void test_commit_after_torn_write_reuses_torn_slot()
+{
+    tearThird(slotSize / 2, false);
+    {
+        FileConfigBackend backend(prefix);
+        ConfigStore store(backend);
+        TEST_ASSERT_TRUE(store.begin());
+        TEST_ASSERT_TRUE(store.commit(makeConfig("third", 30)));
+    }
+    Config config;
+    uint32_t sequence;
+    TEST_ASSERT_TRUE(reboot(config, sequence));
+    TEST_ASSERT_EQUAL_STRING("third", config.ssid);
+    TEST_ASSERT_EQUAL_UINT32(3, sequence);
+}
+
+void test_corrupt_byte_in_each_slot()
+{
+    // Hỏng slot mới nhất (B) thì quay về A, hỏng slot cũ (A) thì vẫn dùng B
+    const uint8_t slots[2] = {1, 0};
+    const char *expected[2] = {"first", "second"};
+    for (int i = 0; i < 2; ++i)
+    {
+        for (size_t offset : {(size_t)0, sizeof(ConfigHeader) - 1, slotSize / 2, slotSize - 1})
+        {
+            commitTwo();
+            FileConfigBackend(prefix).corrupt(slots[i], offset);
+            Config config;
+            uint32_t sequence;
+            TEST_ASSERT_TRUE(reboot(config, sequence));
+            TEST_ASSERT_EQUAL_STRING(expected[i], config.ssid);
+        }
+    }
+}
+
+void test_both_slots_corrupt_uses_defaults()
+{
+    commitTwo();
+    FileConfigBackend(prefix).corrupt(0, slotSize / 2);
+    FileConfigBackend(prefix).corrupt(1, slotSize / 2);
+    Config config;
+    uint32_t sequence;
+    TEST_ASSERT_FALSE(reboot(config, sequence));
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_DEFAULT_POLL_INTERVAL, config.poll_interval);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_flash_uses_defaults);
+    RUN_TEST(test_loads_newest_slot);
+    RUN_TEST(test_truncated_write_keeps_previous_slot);
+    RUN_TEST(test_partial_overwrite_keeps_previous_slot);
+    RUN_TEST(test_commit_after_torn_write_reuses_torn_slot);
+    RUN_TEST(test_corrupt_byte_in_each_slot);
+    RUN_TEST(test_both_slots_corrupt_uses_defaults);
+    return UNITY_END();
+}
@@ -0,0 +1,95 @@
+// Test thương lượng baud trên host với coordinator giả (native/sim/simLink.h): hạ baud khi tỉ lệ lỗi cao,
+// thử lại khi lần bắt tay đầu không có trả lời, và thương lượng lại sau khi hạ baud thất bại.
+//   pio test -e native_test -f test_link
+#include <unity.h>
+#include "simLink.h"
+
+namespace {
+
+const char linkId[] = "TBE0123456789ZB";
+
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_fallback_to_clean_rate()
+{
+    // Thương lượng được 921600 nhưng trên 115200 thì 25% khung hỏng: server hạ dần 460800, 230400, 115200
+    SimCoordinator coordinator;
+    coordinator.noisyAbove = 115200;
+    coordinator.corruptPercent = 25;
+    SimLink link(921600, coordinator, linkId);
+    TEST_ASSERT_EQUAL_UINT32(921600, link.server.linkBaud());
+    for (int window = 0; window < 8 && link.server.linkBaud() > 115200; ++window)
+    {
+        link.sendWindow();
+    }
+    TEST_ASSERT_EQUAL_UINT32(115200, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(link.coordinator.rate, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(3, link.server.baudFallbacks());
+
+    // Ở baud sạch thì không hạ thêm
+    link.sendWindow();
+    link.exchange();
+    TEST_ASSERT_EQUAL_UINT32(115200, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(3, link.server.baudFallbacks());
+    TEST_ASSERT_TRUE(link.inSync());
+}
+
+void test_retry_after_no_reply()
+{
+    // Coordinator bỏ qua lần bắt tay đầu: server ở 9600, timer ZIGBEE_BAUD_RETRY thương lượng lại tới 921600
+    SimCoordinator coordinator;
+    coordinator.deafHandshakes = 1;
+    SimLink link(921600, coordinator, linkId);
+    TEST_ASSERT_EQUAL_UINT32(9600, link.server.linkBaud());
+    TEST_ASSERT_TRUE(link.inSync());
+
+    link.waitBaudRetry();
+    TEST_ASSERT_EQUAL_UINT32(921600, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(link.coordinator.rate, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(0, link.server.baudFallbacks());
+
+    link.exchange();
+    TEST_ASSERT_TRUE(link.inSync());
+}
+
+void test_renegotiate_after_failed_fallback()
+{
+    // Hạ baud vì nhiễu nhưng coordinator không nghe được lệnh hạ: CHECK thất bại, hai phía về 9600,
+    // rồi timer thương lượng lại tới 460800, trần mới sau lần hạ
+    SimCoordinator coordinator;
+    coordinator.noisyAbove = 460800;
+    coordinator.corruptPercent = 25;
+    SimLink link(921600, coordinator, linkId);
+    TEST_ASSERT_EQUAL_UINT32(921600, link.server.linkBaud());
+    link.coordinator.deafHandshakes = 1;
+
+    link.sendWindow();
+    TEST_ASSERT_EQUAL_UINT32(9600, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(link.coordinator.rate, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(1, link.server.baudFallbacks());
+
+    link.waitBaudRetry();
+    TEST_ASSERT_EQUAL_UINT32(460800, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(link.coordinator.rate, link.server.linkBaud());
+    TEST_ASSERT_EQUAL_UINT32(1, link.server.baudFallbacks());
+
+    link.exchange();
+    TEST_ASSERT_TRUE(link.inSync());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fallback_to_clean_rate);
+    RUN_TEST(test_retry_after_no_reply);
+    RUN_TEST(test_renegotiate_after_failed_fallback);
+    return UNITY_END();
+}
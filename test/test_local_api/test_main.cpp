@@ -0,0 +1,180 @@
+// Test luồng SSE của LocalApi trên host với nhiều client chậm: sample bị bỏ bớt khi hàng đợi trung bình vượt
+// LOCAL_API_SAMPLE_BACKLOG, còn sự kiện status/devices vẫn tới mọi client, không bị thư viện bỏ vì hàng đợi đầy.
+// Cùng các route REST đọc dữ liệu lấy từ khung thiết bị.
+//   pio test -e native_test -f test_local_api
+#include <unity.h>
+#include <LocalApi.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char *sample = "voltage:230.1,current:1.25,power:287.6";
+
+struct Harness
+{
+    AsyncWebServer server{80};
+    ZigbeeFleet fleet;
+    TimeSeries history{4096};
+    LocalApi api{server, fleet, history};
+    AsyncEventSource *events = nullptr;
+    std::vector<AsyncEventSourceClient *> clients;
+
+    Harness(size_t subscribers)
+    {
+        api.begin();
+        events = server.eventSource("/api/events");
+        TEST_ASSERT_NOT_NULL(events);
+        for (size_t i = 0; i < subscribers; ++i)
+        {
+            clients.push_back(events->connect());
+        }
+    }
+
+    size_t maxWaiting() const
+    {
+        size_t waiting = 0;
+        for (AsyncEventSourceClient *client : clients)
+        {
+            waiting = std::max(waiting, client->packetsWaiting());
+        }
+        return waiting;
+    }
+};
+
+std::vector<std::string> received(AsyncEventSourceClient *client, const char *event)
+{
+    std::vector<std::string> data;
+    for (const AsyncEventSourceClient::Message &message : client->received)
+    {
+        if (message.event == event)
+        {
+            data.push_back(message.data);
+        }
+    }
+    return data;
+}
+
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_slow_clients_shed_samples_keep_status()
+{
+    // Mỗi vòng: 4 sample, 1 status, mỗi 10 vòng một devices; mạng chỉ đưa được 3 bản tin/vòng tới mỗi client
+    const size_t subscribers = 12;
+    const int rounds = 300;
+    Harness harness(subscribers);
+    size_t maxWaiting = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            harness.api.publishSample("TBE0123456789ZB", sample);
+        }
+        harness.api.publishDeviceStatus("TBE0123456789ZB", round % 2 == 0);
+        if (round % 10 == 0)
+        {
+            harness.api.publishDevicesChanged();
+        }
+        maxWaiting = std::max(maxWaiting, harness.maxWaiting());
+        for (AsyncEventSourceClient *client : harness.clients)
+        {
+            client->drain(3);
+        }
+    }
+    for (AsyncEventSourceClient *client : harness.clients)
+    {
+        client->drain(SSE_MAX_QUEUED_MESSAGES);
+    }
+
+    TEST_ASSERT_GREATER_THAN(0, harness.api.droppedSamples());
+    TEST_ASSERT_LESS_OR_EQUAL(SSE_MAX_QUEUED_MESSAGES, maxWaiting);
+    for (AsyncEventSourceClient *client : harness.clients)
+    {
+        TEST_ASSERT_EQUAL_UINT32(0, client->dropped);
+        std::vector<std::string> status = received(client, "status");
+        TEST_ASSERT_EQUAL_UINT32(rounds, status.size());
+        TEST_ASSERT_EQUAL_UINT32(rounds / 10, received(client, "devices").size());
+        TEST_ASSERT_GREATER_THAN(0, received(client, "sample").size());
+    }
+}
+
+void test_fast_clients_get_every_sample()
+{
+    Harness harness(8);
+    for (int round = 0; round < 100; ++round)
+    {
+        harness.api.publishSample("TBE0123456789ZB", sample);
+        harness.api.publishDeviceStatus("TBE0123456789ZB", true);
+        for (AsyncEventSourceClient *client : harness.clients)
+        {
+            client->drain(2);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, harness.api.droppedSamples());
+    for (AsyncEventSourceClient *client : harness.clients)
+    {
+        client->drain(SSE_MAX_QUEUED_MESSAGES);
+        TEST_ASSERT_EQUAL_UINT32(100, received(client, "sample").size());
+        TEST_ASSERT_EQUAL_UINT32(100, received(client, "status").size());
+    }
+}
+
+void test_no_clients_no_work()
+{
+    Harness harness(0);
+    harness.api.publishSample("TBE0123456789ZB", sample);
+    TEST_ASSERT_EQUAL_UINT32(0, harness.api.droppedSamples());
+}
+
+void test_long_sample_is_not_truncated()
+{
+    // DATA dài gần ZIGBEE_MAX_FRAME sau khi mở rộng theo schema
+    std::string data;
+    for (int i = 0; data.size() < 480; ++i)
+    {
+        data += (i ? ",metric_" : "metric_") + std::to_string(i) + ":" + std::to_string(1000 + i) + ".25";
+    }
+    Harness harness(1);
+    harness.api.publishSample("TBE0123456789ZB", data.c_str());
+    harness.clients[0]->drain(SSE_MAX_QUEUED_MESSAGES);
+    std::vector<std::string> samples = received(harness.clients[0], "sample");
+    TEST_ASSERT_EQUAL_UINT32(1, samples.size());
+    TEST_ASSERT_TRUE(samples[0].find(data) != std::string::npos);
+    TEST_ASSERT_TRUE(samples[0].back() == '}');
+}
+
+void test_history_escapes_names()
+{
+    // ID và tên metric lấy từ khung thiết bị, có thể chứa '"' hoặc '\\'
+    const char *id = "TBE\"01";
+    const char *metric = "temp\\in";
+    Harness harness(0);
+    TEST_ASSERT_TRUE(harness.history.append(id, metric, 60000, 21.5));
+    AsyncWebServerRequest request(HTTP_GET, "/api/history");
+    request.addParam("id", id);
+    request.addParam("metric", metric);
+    TEST_ASSERT_TRUE(harness.server.handle(request));
+    TEST_ASSERT_NOT_NULL(request.response.get());
+    const std::string &body = request.response->body;
+    TEST_ASSERT_TRUE(body.find("{\"id\":\"TBE\\\"01\",\"metric\":\"temp\\\\in\",") == 0);
+    TEST_ASSERT_TRUE(body.back() == '}');
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_slow_clients_shed_samples_keep_status);
+    RUN_TEST(test_fast_clients_get_every_sample);
+    RUN_TEST(test_no_clients_no_work);
+    RUN_TEST(test_long_sample_is_not_truncated);
+    RUN_TEST(test_history_escapes_names);
+    return UNITY_END();
+}
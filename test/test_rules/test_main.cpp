@@ -0,0 +1,76 @@
+// Test RuleSet trên host: metric chưa có sample (NaN) làm mọi so sánh sai, kể cả !=, nên luật không chạy
+// lệnh trước khi mọi thiết bị nó đọc đã báo giá trị.
+//   pio test -e native_test -f test_rules
+#include <unity.h>
+#include <RuleEngine.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+RuleSpec makeSpec(const char *when)
+{
+    RuleSpec spec;
+    spec.name = "test";
+    spec.device = "TBE01";
+    spec.when = when;
+    spec.then = {"TBE03", "relay:0"};
+    spec.otherwise = {"TBE03", "relay:1"};
+    return spec;
+}
+
+// Nạp một luật rồi đưa các khung theo thứ tự, trả về lệnh của khung cuối
+std::vector<RuleAction> run(const char *when, const std::vector<std::pair<const char *, const char *>> &frames)
+{
+    RuleSet rules;
+    std::string error;
+    TEST_ASSERT_TRUE_MESSAGE(rules.add(makeSpec(when), error), error.c_str());
+    std::vector<RuleAction> actions;
+    uint32_t now = 0;
+    for (const auto &frame : frames)
+    {
+        actions.clear();
+        rules.ingest(frame.first, frame.second, now += 1000, actions);
+    }
+    return actions;
+}
+
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_missing_metric_compares_false()
+{
+    // TBE02 chưa báo state: mọi so sánh với nó đều sai, luật không chuyển sang đúng
+    const char *conditions[] = {"power > 1 && TBE02.state != 0", "power > 1 && TBE02.state == 0",
+                                "power > 1 && TBE02.state < 1", "power > 1 && TBE02.state >= 0"};
+    for (const char *when : conditions)
+    {
+        std::vector<RuleAction> actions = run(when, {{"TBE01", "power:5"}});
+        TEST_ASSERT_EQUAL_UINT32(0, actions.size());
+    }
+}
+
+void test_not_equal_fires_once_metric_arrives()
+{
+    std::vector<RuleAction> actions = run("power > 1 && TBE02.state != 0", {{"TBE01", "power:5"}, {"TBE02", "state:1"}});
+    TEST_ASSERT_EQUAL_UINT32(1, actions.size());
+    TEST_ASSERT_EQUAL_STRING("relay:0", actions[0].cmd.c_str());
+
+    actions = run("power > 1 && TBE02.state != 0", {{"TBE01", "power:5"}, {"TBE02", "state:0"}});
+    TEST_ASSERT_EQUAL_UINT32(0, actions.size());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_missing_metric_compares_false);
+    RUN_TEST(test_not_equal_fires_once_metric_arrives);
+    return UNITY_END();
+}
@@ -0,0 +1,142 @@
+"""
+build_page.py - Sinh lib/web/page.h từ lib/web/index.html và lib/web/static/.
+
+index.html được cắt thành các đoạn tĩnh xen kẽ với placeholder dạng $ten,
+để trang có thể stream từng đoạn mà không cần copy/replace toàn bộ trên heap.
+Các file trong static/ được nén gzip sẵn kèm ETag.
+
+Chạy tự động trước khi build (extra_scripts = pre:tools/build_page.py)
+hoặc chạy tay: python tools/build_page.py
+"""
+import gzip
+import os
+import re
+import zlib
+
+try:
+    Import("env")  # noqa: F821 - chỉ có khi chạy trong PlatformIO
+    PROJECT_DIR = env["PROJECT_DIR"]  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+WEB_DIR = os.path.join(PROJECT_DIR, "lib", "web")
+TEMPLATE = os.path.join(WEB_DIR, "index.html")
+STATIC_DIR = os.path.join(WEB_DIR, "static")
+OUTPUT = os.path.join(WEB_DIR, "page.h")
+
+PLACEHOLDER = re.compile(r"\$([a-z_]+)")
+MIME_TYPES = {".css": "text/css", ".js": "application/javascript"}
+
+
+def c_string(text):
+    out = []
+    for line in text.splitlines(True):
+        escaped = line.replace("\\", "\\\\").replace('"', '\\"').replace("\n", "\\n")
+        out.append('  "%s"' % escaped)
+    return "\n".join(out) if out else '  ""'
+
+
+def c_bytes(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("  " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "\n".join(rows)
+
+
+def symbol(name):
+    return re.sub(r"[^0-9a-zA-Z]", "_", name)
+
+
+def split_template(html):
+    chunks = []
+    variables = []
+    pos = 0
+    for match in PLACEHOLDER.finditer(html):
+        name = match.group(1)
+        if name not in variables:
+            variables.append(name)
+        chunks.append((html[pos:match.start()], name))
+        pos = match.end()
+    chunks.append((html[pos:], None))
+    return chunks, variables
+
+
+def static_assets():
+    if not os.path.isdir(STATIC_DIR):
+        return []
+    assets = []
+    for name in sorted(os.listdir(STATIC_DIR)):
+        ext = os.path.splitext(name)[1]
+        if ext not in MIME_TYPES:
+            continue
+        with open(os.path.join(STATIC_DIR, name), "rb") as f:
+            raw = f.read()
+        data = gzip.compress(raw, 9, mtime=0)
+        etag = "%08x" % (zlib.crc32(raw) & 0xFFFFFFFF)
+        assets.append((name, MIME_TYPES[ext], data, etag))
+    return assets
+
+
+def sources():
+    files = [TEMPLATE, os.path.abspath(__file__)]
+    if os.path.isdir(STATIC_DIR):
+        files += [os.path.join(STATIC_DIR, n) for n in os.listdir(STATIC_DIR)]
+    return files
+
+
+def up_to_date():
+    if not os.path.exists(OUTPUT):
+        return False
+    built = os.path.getmtime(OUTPUT)
+    return all(os.path.getmtime(f) <= built for f in sources())
+
+
+def generate():
+    with open(TEMPLATE, encoding="utf-8") as f:
+        html = f.read()
+    chunks, variables = split_template(html)
+    assets = static_assets()
+
+    lines = [
+        "// Sinh tự động bởi tools/build_page.py - không sửa tay,",
+        "// sửa lib/web/index.html hoặc lib/web/static/ rồi build lại.",
+        "#ifndef _index_page_h",
+        "#define _index_page_h",
+        "",
+        "#include <pgmspace.h>",
+        '#include "pageRenderer.h"',
+        "",
+        "enum PageVar : int8_t {",
+        "  PAGE_VAR_NONE = -1,",
+    ]
+    lines += ["  PAGE_VAR_%s," % v.upper() for v in variables]
+    lines += ["};", ""]
+
+    for i, (text, _) in enumerate(chunks):
+        lines.append("const char index_chunk_%d[] PROGMEM =" % i)
+        lines.append(c_string(text) + ";")
+    lines.append("")
+    lines.append("const PageChunk index_chunks[] = {")
+    for i, (text, var) in enumerate(chunks):
+        ref = "PAGE_VAR_%s" % var.upper() if var else "PAGE_VAR_NONE"
+        lines.append("  {index_chunk_%d, %d, %s}," % (i, len(text.encode("utf-8")), ref))
+    lines += ["};", "#define INDEX_CHUNK_COUNT %d" % len(chunks), ""]
+
+    for name, mime, data, etag in assets:
+        sym = symbol(name)
+        lines.append("const uint8_t %s_gz[] PROGMEM = {" % sym)
+        lines.append(c_bytes(data))
+        lines.append("};")
+    lines.append("")
+    lines.append("const StaticAsset static_assets[] = {")
+    for name, mime, data, etag in assets:
+        lines.append('  {"/%s", "%s", %s_gz, %d, "\\"%s\\""},' % (name, mime, symbol(name), len(data), etag))
+    lines += ["};", "#define STATIC_ASSET_COUNT %d" % len(assets), "", "#endif", ""]
+
+    with open(OUTPUT, "w", encoding="utf-8", newline="\n") as f:
+        f.write("\n".join(lines))
+    print("build_page: %s (%d chunks, %d assets)" % (OUTPUT, len(chunks), len(assets)))
+
+
+if not up_to_date():
+    generate()